@@ -27,6 +27,8 @@ Environment:
 #include "i219v_hw.h"
 #include "i219v_hw_extended.h"
 #include "i219v_gaming.h"
+#include "i219v_moderation.h"
+#include "i219v_phy.h"
 #include "DeviceContext.h"
 #include "Trace.h"
 
@@ -284,6 +286,49 @@ I219vEvtAdapterSetCapabilities(
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_ADAPTER, "NetAdapter capabilities set (consolidated)");
 }
 
+// Чтение состояния соединения из устройства и сообщение его NetAdapterCx
+// Вызывается при запуске адаптера и из рабочего элемента по прерыванию LSC.
+// Скорость и дуплекс берутся из STATUS; подробности из PHY (ведущий/ведомый,
+// EEE) читает I219vGetLinkState через кэш регистров соединения.
+// Пороги динамической модерации масштабируются по скорости: при 100 и
+// 10 Мбит/с та же загрузка канала дает в 10 и 100 раз меньше пакетов.
+VOID
+I219vIndicateLinkState(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    NET_ADAPTER_LINK_STATE linkState;
+    UINT32 statusReg;
+
+    statusReg = I219vReadRegister(DeviceContext, I219V_REG_STATUS);
+
+    DeviceContext->LinkUp = (statusReg & I219V_STATUS_LU) ? TRUE : FALSE;
+    DeviceContext->FullDuplex = (statusReg & I219V_STATUS_FD) ? TRUE : FALSE;
+    DeviceContext->LinkSpeed = DeviceContext->LinkUp ? I219vDecodeLinkSpeed(statusReg) : 0;
+
+    I219vModerationSetLinkSpeed(DeviceContext, DeviceContext->LinkSpeed);
+
+    if (DeviceContext->LinkUp) {
+        NET_ADAPTER_LINK_STATE_INIT(
+            &linkState,
+            (NDIS_LINK_SPEED)DeviceContext->LinkSpeed * 1000000,
+            MediaConnectStateConnected,
+            DeviceContext->FullDuplex ? MediaDuplexStateFull : MediaDuplexStateHalf,
+            NetAdapterPauseFunctionTypeUnsupported, // Example
+            NetAdapterAutoNegotiationFlagXmitLinkSpeed |
+            NetAdapterAutoNegotiationFlagRcvLinkSpeed |
+            NetAdapterAutoNegotiationFlagDuplexMode
+        );
+    } else {
+        NET_ADAPTER_LINK_STATE_INIT_DISCONNECTED(&linkState);
+    }
+    NetAdapterSetLinkState(DeviceContext->NetAdapter, &linkState);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_ADAPTER, "Link %s, %u Mbps %s duplex, STATUS: 0x%08x",
+              DeviceContext->LinkUp ? "up" : "down", DeviceContext->LinkSpeed,
+              DeviceContext->FullDuplex ? "full" : "half", statusReg);
+}
+
 // Обработчик запуска адаптера (moved from NetAdapterConfig.c)
 VOID
 I219vEvtAdapterStart(
@@ -292,8 +337,6 @@ I219vEvtAdapterStart(
 {
     NTSTATUS status;
     PI219V_DEVICE_CONTEXT deviceContext;
-    NET_ADAPTER_LINK_STATE linkState;
-    UINT32 statusReg;
     WDFDEVICE device;
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_ADAPTER, "Starting NetAdapter (consolidated)");
@@ -311,43 +354,17 @@ I219vEvtAdapterStart(
         return;
     }
 
-    // Инициализация прерываний (assuming I219vInitializeInterrupt is defined and available)
-    // This was in NetAdapterConfig.c's Start. It implies interrupt object needs to be valid.
-    // The interrupt object is typically created in EvtDevicePrepareHardware or EvtDeviceD0Entry.
-    // Let's assume it's created and just needs enabling or connecting here if applicable.
-    // For now, ensure the function exists or remove if init is done elsewhere.
-    // status = I219vInitializeInterrupt(device); // This needs to be available or removed.
-    // if (!NT_SUCCESS(status)) {
-    //     TraceEvents(TRACE_LEVEL_ERROR, TRACE_ADAPTER,
-    //               "I219vInitializeInterrupt failed %!STATUS!", status);
-    //     I219vCleanupDatapath(deviceContext); // Clean up what was done
-    //     return;
-    // }
-
+    // Объект прерывания создается в I219vEvtDeviceAdd (I219vInitializeInterrupt)
+    // и подключается инфраструктурой WDF при переходе в D0
 
     // Включение устройства (hardware enable)
     I219vEnableDevice(deviceContext); // Assumes this function correctly enables HW for operation
 
-    // Проверка состояния соединения
-    // This logic is similar to I219vEvtAdapterSetCurrentLinkState.
-    // SetCurrentLinkState is a callback. Here, we might want to report the *initial* state.
-    statusReg = I219vReadRegister(deviceContext, I219V_REG_STATUS);
+    // Асинхронный доступ к PHY: завершения MDIC приходят через прерывание и таймер
+    I219vStartPhyEngine(deviceContext);
 
-    if (statusReg & I219V_STATUS_LU) {
-        NET_ADAPTER_LINK_STATE_INIT(
-            &linkState,
-            NDIS_LINK_SPEED_1000MBPS, // Example, should be determined from HW
-            MediaConnectStateConnected,
-            MediaDuplexStateFull,     // Example, should be determined from HW
-            NetAdapterPauseFunctionTypeUnsupported, // Example
-            NetAdapterAutoNegotiationFlagXmitLinkSpeed |
-            NetAdapterAutoNegotiationFlagRcvLinkSpeed |
-            NetAdapterAutoNegotiationFlagDuplexMode
-        );
-    } else {
-        NET_ADAPTER_LINK_STATE_INIT_DISCONNECTED(&linkState);
-    }
-    NetAdapterSetLinkState(NetAdapter, &linkState);
+    // Сообщение начального состояния соединения
+    I219vIndicateLinkState(deviceContext);
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_ADAPTER, "NetAdapter started successfully (consolidated)");
 }
@@ -366,6 +383,15 @@ I219vEvtAdapterStop(
     device = NetAdapterGetWdfDevice(NetAdapter);
     deviceContext = I219vGetDeviceContext(device);
 
+    // Отмена запросов к PHY до отключения устройства; после запуска
+    // регистры соединения читаются заново
+    I219vStopPhyEngine(deviceContext);
+    I219vInvalidatePhyLinkCache(deviceContext);
+
+    // Таймеры модерации и опроса не должны обращаться к остановленному устройству
+    I219vStopModeration(deviceContext);
+    I219vStopStormGuard(deviceContext);
+
     // Отключение устройства (hardware disable)
     I219vDisableDevice(deviceContext); // Assumes this function correctly disables HW
 
@@ -32,3 +32,6 @@ VOID I219vEnableDevice(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 VOID I219vDisableDevice(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 VOID I219vPauseDevice(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 VOID I219vRestartDevice(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+
+// Чтение состояния соединения из устройства и сообщение его NetAdapterCx
+VOID I219vIndicateLinkState(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
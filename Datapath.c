@@ -28,27 +28,6 @@ Environment:
 #include "Datapath.h"
 #include "Trace.h"
 
-// Структура дескриптора приема
-typedef struct _I219V_RX_DESC {
-    UINT64 BufferAddr;    // Адрес буфера
-    UINT16 Length;        // Длина принятого пакета
-    UINT16 Checksum;      // Контрольная сумма
-    UINT8  Status;        // Статус дескриптора
-    UINT8  Errors;        // Ошибки
-    UINT16 VlanTag;       // VLAN тег
-} I219V_RX_DESC, *PI219V_RX_DESC;
-
-// Структура дескриптора передачи
-typedef struct _I219V_TX_DESC {
-    UINT64 BufferAddr;    // Адрес буфера
-    UINT16 Length;        // Длина пакета
-    UINT8  CSO;           // Смещение контрольной суммы
-    UINT8  CMD;           // Команды
-    UINT8  Status;        // Статус
-    UINT8  CSS;           // Смещение начала контрольной суммы
-    UINT16 Special;       // Специальные поля
-} I219V_TX_DESC, *PI219V_TX_DESC;
-
 // Инициализация кольца дескрипторов приема
 NTSTATUS
 I219vInitializeRxRing(
@@ -92,9 +71,9 @@ I219vInitializeRxRing(
     rxRingPA = WdfCommonBufferGetAlignedLogicalAddress(rxRingBuffer);
 
     // Инициализация дескрипторов приема
+    // Буферы приема предоставляются NetAdapterCx через кольцо фрагментов
+    // и записываются в дескрипторы в I219vEvtRxQueueAdvance
     for (i = 0; i < I219V_RX_RING_SIZE; i++) {
-        // В реальной реализации здесь бы выделялись буферы для приема данных
-        // и их адреса записывались бы в дескрипторы
         rxRing[i].BufferAddr = 0;
         rxRing[i].Status = 0;
     }
@@ -103,13 +82,15 @@ I219vInitializeRxRing(
     DeviceContext->RxRingBuffer = rxRingBuffer;
     DeviceContext->RxRing = rxRing;
     DeviceContext->RxRingPA = rxRingPA;
+    DeviceContext->RxNextToUse = 0;
+    DeviceContext->RxNextToClean = 0;
 
     // Настройка регистров устройства
     I219vWriteRegister(DeviceContext, I219V_REG_RDBAL, (UINT32)rxRingPA.LowPart);
     I219vWriteRegister(DeviceContext, I219V_REG_RDBAH, (UINT32)rxRingPA.HighPart);
     I219vWriteRegister(DeviceContext, I219V_REG_RDLEN, (UINT32)rxRingSize);
     I219vWriteRegister(DeviceContext, I219V_REG_RDH, 0);
-    I219vWriteRegister(DeviceContext, I219V_REG_RDT, I219V_RX_RING_SIZE - 1);
+    I219vWriteRegister(DeviceContext, I219V_REG_RDT, 0);
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DATAPATH, 
               "RX ring initialized: VA=%p, PA=0x%llx, Size=%llu", 
@@ -171,6 +152,8 @@ I219vInitializeTxRing(
     DeviceContext->TxRingBuffer = txRingBuffer;
     DeviceContext->TxRing = txRing;
     DeviceContext->TxRingPA = txRingPA;
+    DeviceContext->TxNextToUse = 0;
+    DeviceContext->TxNextToClean = 0;
 
     // Настройка регистров устройства
     I219vWriteRegister(DeviceContext, I219V_REG_TDBAL, (UINT32)txRingPA.LowPart);
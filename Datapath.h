@@ -26,6 +26,45 @@ Environment:
 // Максимальный размер пакета
 #define I219V_MAX_PACKET_SIZE 16384
 
+// Структура дескриптора приема
+typedef struct _I219V_RX_DESC {
+    UINT64 BufferAddr;    // Адрес буфера
+    UINT16 Length;        // Длина принятого пакета
+    UINT16 Checksum;      // Контрольная сумма
+    UINT8  Status;        // Статус дескриптора
+    UINT8  Errors;        // Ошибки
+    UINT16 VlanTag;       // VLAN тег
+} I219V_RX_DESC, *PI219V_RX_DESC;
+
+// Структура дескриптора передачи
+typedef struct _I219V_TX_DESC {
+    UINT64 BufferAddr;    // Адрес буфера
+    UINT16 Length;        // Длина пакета
+    UINT8  CSO;           // Смещение контрольной суммы
+    UINT8  CMD;           // Команды
+    UINT8  Status;        // Статус
+    UINT8  CSS;           // Смещение начала контрольной суммы
+    UINT16 Special;       // Специальные поля
+} I219V_TX_DESC, *PI219V_TX_DESC;
+
+// Биты поля CMD дескриптора передачи
+#define I219V_TXD_CMD_EOP   0x01  // End Of Packet
+#define I219V_TXD_CMD_IFCS  0x02  // Insert FCS
+#define I219V_TXD_CMD_RS    0x08  // Report Status
+#define I219V_TXD_CMD_VLE   0x40  // VLAN Packet Enable (тег берется из поля Special)
+#define I219V_TXD_CMD_IDE   0x80  // Interrupt Delay Enable (прерывание откладывается по TIDV/TADV)
+
+// Биты поля Status дескриптора приема
+#define I219V_RXD_STAT_DD   0x01  // Descriptor Done
+#define I219V_RXD_STAT_EOP  0x02  // End Of Packet
+
+// Ошибки приема, при которых кадр отбрасывается
+// (CE, SE, SEQ, CXE, RXE; ошибки контрольных сумм IPE/TCPE обрабатываются стеком)
+#define I219V_RXD_ERR_FRAME_MASK    0x97
+
+// Биты поля Status дескриптора передачи
+#define I219V_TXD_STAT_DD   0x01  // Descriptor Done
+
 // Объявление функций для работы с путями данных
 NTSTATUS I219vInitializeRxRing(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 NTSTATUS I219vInitializeTxRing(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
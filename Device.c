@@ -9,7 +9,8 @@ Module Name:
 Abstract:
 
     Реализация функций для работы с устройством Intel i219-v
-    Содержит обработчики событий устройства WDF
+    Содержит обработчики событий PnP и питания устройства WDF;
+    регистрируются в I219vEvtDeviceAdd (Driver.c).
 
 Environment:
 
@@ -23,108 +24,25 @@ Environment:
 #include "Driver.h"
 #include "Device.h"
 #include "Adapter.h"
-#include "Trace.h"
+#include "i219v_gaming.h"
 #include "i219v_hw.h"
+#include "i219v_moderation.h"
+#include "i219v_phy.h"
+#include "i219v_storm.h"
+#include "DeviceContext.h"
+#include "Trace.h"
 
 #ifdef ALLOC_PRAGMA
-#pragma alloc_text (PAGE, I219vEvtDeviceAdd)
 #pragma alloc_text (PAGE, I219vEvtDevicePrepareHardware)
 #pragma alloc_text (PAGE, I219vEvtDeviceReleaseHardware)
 #pragma alloc_text (PAGE, I219vEvtDeviceD0Entry)
 #pragma alloc_text (PAGE, I219vEvtDeviceD0Exit)
 #endif
 
-// Структура контекста устройства
-typedef struct _I219V_DEVICE_CONTEXT {
-    // Базовый адрес регистров устройства
-    PVOID RegisterBase;
-    
-    // Физический адрес регистров устройства
-    PHYSICAL_ADDRESS RegisterBasePA;
-    
-    // Размер области регистров
-    ULONG RegisterSize;
-    
-    // Объект NetAdapter
-    NETADAPTER NetAdapter;
-    
-    // MAC-адрес устройства
-    UCHAR MacAddress[6];
-    
-    // Состояние устройства
-    BOOLEAN DeviceInitialized;
-    
-    // Ресурсы прерываний
-    WDFINTERRUPT Interrupt;
-    
-} I219V_DEVICE_CONTEXT, *PI219V_DEVICE_CONTEXT;
-
-WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(I219V_DEVICE_CONTEXT, I219vGetDeviceContext)
-
-// Обработчик добавления устройства
-NTSTATUS
-I219vEvtDeviceAdd(
-    _In_ WDFDRIVER Driver,
-    _Inout_ PWDFDEVICE_INIT DeviceInit
-    )
-{
-    NTSTATUS status;
-    WDF_OBJECT_ATTRIBUTES deviceAttributes;
-    WDFDEVICE device;
-    PI219V_DEVICE_CONTEXT deviceContext;
-    NET_ADAPTER_CONFIG netAdapterConfig;
-    NETADAPTER netAdapter;
-    WDF_PNPPOWER_EVENT_CALLBACKS pnpPowerCallbacks;
-
-    UNREFERENCED_PARAMETER(Driver);
-
-    PAGED_CODE();
-
-    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "I219v Device: Entering I219vEvtDeviceAdd");
-
-    // Настройка обратных вызовов PnP и Power
-    WDF_PNPPOWER_EVENT_CALLBACKS_INIT(&pnpPowerCallbacks);
-    pnpPowerCallbacks.EvtDevicePrepareHardware = I219vEvtDevicePrepareHardware;
-    pnpPowerCallbacks.EvtDeviceReleaseHardware = I219vEvtDeviceReleaseHardware;
-    pnpPowerCallbacks.EvtDeviceD0Entry = I219vEvtDeviceD0Entry;
-    pnpPowerCallbacks.EvtDeviceD0Exit = I219vEvtDeviceD0Exit;
-    WdfDeviceInitSetPnpPowerEventCallbacks(DeviceInit, &pnpPowerCallbacks);
-
-    // Создание объекта устройства WDF
-    WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&deviceAttributes, I219V_DEVICE_CONTEXT);
-    status = WdfDeviceCreate(&DeviceInit, &deviceAttributes, &device);
-    if (!NT_SUCCESS(status)) {
-        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "WdfDeviceCreate failed %!STATUS!", status);
-        return status;
-    }
-
-    // Получение контекста устройства
-    deviceContext = I219vGetDeviceContext(device);
-    RtlZeroMemory(deviceContext, sizeof(I219V_DEVICE_CONTEXT));
-
-    // Инициализация конфигурации NetAdapter
-    NET_ADAPTER_CONFIG_INIT(&netAdapterConfig, I219vEvtAdapterCreateRxQueue, I219vEvtAdapterCreateTxQueue);
-    netAdapterConfig.EvtAdapterSetCapabilities = I219vEvtAdapterSetCapabilities;
-    netAdapterConfig.EvtAdapterStart = I219vEvtAdapterStart;
-    netAdapterConfig.EvtAdapterStop = I219vEvtAdapterStop;
-    netAdapterConfig.EvtAdapterPause = I219vEvtAdapterPause;
-    netAdapterConfig.EvtAdapterRestart = I219vEvtAdapterRestart;
-
-    // Создание объекта NetAdapter
-    status = NetAdapterCreate(device, &netAdapterConfig, &netAdapter);
-    if (!NT_SUCCESS(status)) {
-        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "NetAdapterCreate failed %!STATUS!", status);
-        return status;
-    }
-
-    // Сохранение объекта NetAdapter в контексте устройства
-    deviceContext->NetAdapter = netAdapter;
-
-    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "I219v Device: Exiting I219vEvtDeviceAdd, Status=%!STATUS!", status);
-    return status;
-}
-
 // Обработчик подготовки аппаратного обеспечения
+// Отображает BAR0 в RegisterBase и проверяет область для быстрых обращений
+// пути данных; до успешной проверки быстрые обращения идут через
+// проверяющий слой доступа (см. I219vReadRegisterFast).
 NTSTATUS
 I219vEvtDevicePrepareHardware(
     _In_ WDFDEVICE Device,
@@ -140,11 +58,14 @@ I219vEvtDevicePrepareHardware(
     BOOLEAN foundMemory = FALSE;
     BOOLEAN foundInterrupt = FALSE;
 
+    UNREFERENCED_PARAMETER(ResourcesRaw);
+
     PAGED_CODE();
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "I219v Device: Entering I219vEvtDevicePrepareHardware");
 
     deviceContext = I219vGetDeviceContext(Device);
+    deviceContext->FastRegistersValidated = FALSE;
 
     // Получение количества ресурсов
     resourceCount = WdfCmResourceListGetCount(ResourcesTranslated);
@@ -155,11 +76,14 @@ I219vEvtDevicePrepareHardware(
 
         switch (descriptor->Type) {
         case CmResourceTypeMemory:
-            // Обработка ресурса памяти (регистры устройства)
-            deviceContext->RegisterBasePA = descriptor->u.Memory.Start;
+            // Регистры устройства - первый ресурс памяти (BAR0)
+            if (foundMemory) {
+                break;
+            }
+
             deviceContext->RegisterSize = descriptor->u.Memory.Length;
             deviceContext->RegisterBase = MmMapIoSpaceEx(
-                deviceContext->RegisterBasePA,
+                descriptor->u.Memory.Start,
                 deviceContext->RegisterSize,
                 PAGE_READWRITE | PAGE_NOCACHE
             );
@@ -178,8 +102,8 @@ I219vEvtDevicePrepareHardware(
             break;
 
         case CmResourceTypeInterrupt:
-            // Обработка ресурса прерывания
-            // Настройка прерывания будет выполнена позже
+            // Объект прерывания создан в I219vEvtDeviceAdd, ресурс
+            // связывается с ним инфраструктурой WDF
             foundInterrupt = TRUE;
             TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, 
                 "Interrupt resource found, vector %d, level %d, affinity %lx", 
@@ -207,25 +131,23 @@ I219vEvtDevicePrepareHardware(
         goto Exit;
     }
 
-    // Чтение MAC-адреса из EEPROM устройства
+    // Однократная проверка области регистров для быстрых обращений пути данных
+    status = I219vValidateFastRegisterMap(deviceContext);
+    if (!NT_SUCCESS(status)) {
+        goto Exit;
+    }
+
+    // Чтение MAC-адреса (RAL/RAH)
     status = I219vReadMacAddress(deviceContext);
     if (!NT_SUCCESS(status)) {
         TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "Failed to read MAC address %!STATUS!", status);
         goto Exit;
     }
 
-    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, 
-        "MAC Address: %02X-%02X-%02X-%02X-%02X-%02X",
-        deviceContext->MacAddress[0],
-        deviceContext->MacAddress[1],
-        deviceContext->MacAddress[2],
-        deviceContext->MacAddress[3],
-        deviceContext->MacAddress[4],
-        deviceContext->MacAddress[5]);
-
 Exit:
     if (!NT_SUCCESS(status)) {
         // Освобождение ресурсов в случае ошибки
+        deviceContext->FastRegistersValidated = FALSE;
         if (deviceContext->RegisterBase != NULL) {
             MmUnmapIoSpace(deviceContext->RegisterBase, deviceContext->RegisterSize);
             deviceContext->RegisterBase = NULL;
@@ -253,7 +175,10 @@ I219vEvtDeviceReleaseHardware(
 
     deviceContext = I219vGetDeviceContext(Device);
 
-    // Освобождение отображенной области регистров
+    // Быстрые обращения запрещаются до снятия отображения; копия регистров
+    // не переживает новое назначение ресурсов
+    deviceContext->FastRegistersValidated = FALSE;
+    I219vInvalidateRegisterShadow(deviceContext);
     if (deviceContext->RegisterBase != NULL) {
         MmUnmapIoSpace(deviceContext->RegisterBase, deviceContext->RegisterSize);
         deviceContext->RegisterBase = NULL;
@@ -280,6 +205,9 @@ I219vEvtDeviceD0Entry(
 
     deviceContext = I219vGetDeviceContext(Device);
 
+    // Из D3 устройство выходит со значениями регистров по умолчанию
+    I219vInvalidateRegisterShadow(deviceContext);
+
     // Инициализация аппаратного обеспечения
     status = I219vInitializeHardware(deviceContext);
     if (!NT_SUCCESS(status)) {
@@ -289,6 +217,14 @@ I219vEvtDeviceD0Entry(
 
     deviceContext->DeviceInitialized = TRUE;
 
+    // Профиль, сохраненный до отображения регистров (EvtDeviceAdd) или до
+    // сброса, записывается в устройство; ошибка не препятствует работе
+    status = I219vRestoreGamingRegisters(deviceContext);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_WARNING, TRACE_DEVICE, "I219vRestoreGamingRegisters failed %!STATUS!", status);
+        status = STATUS_SUCCESS;
+    }
+
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "I219v Device: Exiting I219vEvtDeviceD0Entry, Status=%!STATUS!", status);
     return status;
 }
@@ -309,50 +245,20 @@ I219vEvtDeviceD0Exit(
 
     deviceContext = I219vGetDeviceContext(Device);
 
+    // Таймеры пути данных не должны обращаться к устройству вне D0
+    I219vStopModeration(deviceContext);
+    I219vStopStormGuard(deviceContext);
+
     // Отключение аппаратного обеспечения
     if (deviceContext->DeviceInitialized) {
         I219vShutdownHardware(deviceContext);
         deviceContext->DeviceInitialized = FALSE;
     }
 
-    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "I219v Device: Exiting I219vEvtDeviceD0Exit");
-    return STATUS_SUCCESS;
-}
+    // В D3 регистры MAC и состояние соединения PHY теряют значения
+    I219vInvalidateRegisterShadow(deviceContext);
+    I219vInvalidatePhyLinkCache(deviceContext);
 
-// Чтение MAC-адреса из EEPROM устройства
-NTSTATUS
-I219vReadMacAddress(
-    _In_ PI219V_DEVICE_CONTEXT DeviceContext
-    )
-{
-    // Эта функция будет реализована в i219v_hw.c
-    // Здесь используем временный MAC-адрес для примера
-    DeviceContext->MacAddress[0] = 0x00;
-    DeviceContext->MacAddress[1] = 0x1B;
-    DeviceContext->MacAddress[2] = 0x21;
-    DeviceContext->MacAddress[3] = 0x34;
-    DeviceContext->MacAddress[4] = 0x56;
-    DeviceContext->MacAddress[5] = 0x78;
-
-    return STATUS_SUCCESS;
-}
-
-// Инициализация аппаратного обеспечения
-NTSTATUS
-I219vInitializeHardware(
-    _In_ PI219V_DEVICE_CONTEXT DeviceContext
-    )
-{
-    // Эта функция будет реализована в i219v_hw.c
-    // Здесь просто возвращаем успешный статус
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "I219v Device: Exiting I219vEvtDeviceD0Exit");
     return STATUS_SUCCESS;
 }
-
-// Отключение аппаратного обеспечения
-VOID
-I219vShutdownHardware(
-    _In_ PI219V_DEVICE_CONTEXT DeviceContext
-    )
-{
-    // Эта функция будет реализована в i219v_hw.c
-}
@@ -22,7 +22,18 @@ Environment:
 #include <ntddk.h>
 #include <wdf.h>
 #include <netadaptercx.h>
+#include "Queue.h"
+#include "i219v_hw.h"
 #include "i219v_gaming.h"
+#include "i219v_qos.h"
+#include "i219v_flow.h"
+#include "i219v_rtt.h"
+#include "i219v_moderation.h"
+#include "i219v_storm.h"
+#include "i219v_latency.h"
+#include "i219v_mmio.h"
+#include "i219v_phy.h"
+#include "i219v_reset.h"
 
 // Структура контекста устройства
 typedef struct _I219V_DEVICE_CONTEXT {
@@ -38,15 +49,32 @@ typedef struct _I219V_DEVICE_CONTEXT {
     PHYSICAL_ADDRESS IoBasePA;             // Физический адрес базы ввода-вывода
     PVOID IoBase;                          // Виртуальный адрес базы ввода-вывода
     ULONG IoSize;                          // Размер области ввода-вывода
+    PVOID RegisterBase;                    // Отображенная область регистров (обращения i219v_hw.c)
+    ULONG RegisterSize;                    // Размер отображенной области регистров
+    BOOLEAN FastRegistersValidated;        // Область проверена для быстрых обращений пути данных
+    I219V_REGISTER_SHADOW RegisterShadow;  // Теневая копия управляющих регистров (собственная блокировка)
     ULONG InterruptVector;                 // Вектор прерывания
     ULONG InterruptLevel;                  // Уровень прерывания
     WDFINTERRUPT Interrupt;                // Дескриптор прерывания
+    WDFWORKITEM LinkWorkItem;              // Обработка изменения соединения на PASSIVE_LEVEL
+    volatile LONG PendingInterruptCauses;  // Причины из ICR, ожидающие обработки в DPC
+    BOOLEAN InterruptAutoMask;             // CTRL_EXT.IAME включен, IAM = I219V_ICR_AUTO_MASK_CAUSES
+    volatile LONG RxNotificationEnabled;   // Очередь приема ожидает уведомления о новых кадрах
+    volatile LONG TxNotificationEnabled;   // Очередь передачи ожидает уведомления о завершениях
+    volatile LONG64 RxIsrTimeUs;           // Время ISR с причиной приема (для обратной связи модерации)
+    NETPACKETQUEUE RxQueue;                // Очередь приема
+    NETPACKETQUEUE TxQueue;                // Очередь передачи
+    I219V_INTERRUPT_STATS InterruptStats;  // Статистика прерываний
+    WDFDPC DatapathDpc;                    // DPC с заданным целевым процессором
+    volatile ULONG DpcTargetProcessor;     // Целевой процессор DatapathDpc (I219V_PROCESSOR_AUTO - DPC прерывания)
+    I219V_AFFINITY_INFO Affinity;          // Привязка к процессорам и размещение DPC
 
     // Параметры адаптера
     UCHAR MacAddress[6];                   // MAC-адрес
     UINT32 LinkSpeed;                      // Скорость соединения
     BOOLEAN FullDuplex;                    // Флаг полного дуплекса
     UINT32 MTU;                            // Максимальный размер пакета
+    BOOLEAN VlanOffloadEnabled;            // Оффлоад VLAN запрошен явно (CTRL.VME без учета маркировки QoS)
 
     // Параметры производительности
     UINT32 ReceiveBufferSize;              // Размер буфера приема
@@ -55,6 +83,25 @@ typedef struct _I219V_DEVICE_CONTEXT {
     UINT32 TransmitDescriptors;            // Количество дескрипторов передачи
     UINT32 InterruptModeration;            // Уровень модерации прерываний
 
+    // Кольца дескрипторов
+    WDFDMAENABLER DmaEnabler;              // DMA Enabler устройства
+    WDFCOMMONBUFFER RxRingBuffer;          // Общий буфер кольца приема
+    struct _I219V_RX_DESC* RxRing;         // Виртуальный адрес кольца приема
+    PHYSICAL_ADDRESS RxRingPA;             // Физический адрес кольца приема
+    UINT32 RxNextToUse;                    // Следующий дескриптор приема для постановки буфера (RDT)
+    UINT32 RxNextToClean;                  // Следующий дескриптор приема для проверки завершения
+    NET_EXTENSION RxVirtualAddressExtension; // Расширение фрагмента приема: виртуальный адрес
+    NET_EXTENSION RxLogicalAddressExtension; // Расширение фрагмента приема: логический (DMA) адрес
+    WDFCOMMONBUFFER TxRingBuffer;          // Общий буфер кольца передачи
+    struct _I219V_TX_DESC* TxRing;         // Виртуальный адрес кольца передачи
+    PHYSICAL_ADDRESS TxRingPA;             // Физический адрес кольца передачи
+    UINT32 TxNextToUse;                    // Следующий свободный дескриптор передачи (TDT)
+    UINT32 TxNextToClean;                  // Следующий дескриптор передачи для проверки завершения
+    NET_EXTENSION TxVirtualAddressExtension; // Расширение фрагмента: виртуальный адрес
+    NET_EXTENSION TxLogicalAddressExtension; // Расширение фрагмента: логический (DMA) адрес
+    I219V_PACKET_METADATA TxPacketMetadata[I219V_TX_RING_SIZE]; // Метаданные пакетов по слоту первого дескриптора
+    I219V_TX_LATENCY_SLOT TxLatencySlots[I219V_TX_RING_SIZE];   // Метки времени пакетов по слоту первого дескриптора
+
     // Игровые функции и оптимизации Killer Performance
     I219V_GAMING_PROFILE GamingProfile;                // Текущий игровой профиль
     I219V_GAMING_PERFORMANCE_STATS GamingPerformanceStats; // Статистика производительности
@@ -70,7 +117,47 @@ typedef struct _I219V_DEVICE_CONTEXT {
     UINT32 BackgroundTrafficCount;         // Счетчик фонового трафика
     UINT64 LastPerformanceUpdateTime;      // Время последнего обновления статистики производительности
 
+    // Маркировка DSCP/802.1p передаваемых пакетов
+    I219V_QOS_MARKING_CONFIG QosMarkingConfig;         // Настройки маркировки (защищены GamingSettingsLock)
+    I219V_QOS_MARKING_STATS QosMarkingStats;           // Статистика маркировки
+
+    // Отслеживание объемных потоков передачи
+    I219V_FLOW_TRACKER FlowTracker;                    // Трекер потоков (защищен GamingSettingsLock)
+
+    // Пассивное измерение RTT
+    I219V_RTT_STATE Rtt;                               // Состояние и статистика RTT (защищены GamingSettingsLock)
+
+    // Динамическая модерация прерываний
+    I219V_MODERATION_STATE Moderation;                 // Состояние модерации (защищено GamingSettingsLock)
+
+    // Защита от шторма прерываний
+    I219V_STORM_STATE Storm;                           // Состояние и статистика (защищены GamingSettingsLock)
+
+    // Задержка по этапам пути данных
+    I219V_LATENCY_STATE Latency;                       // Метки времени и гистограммы (защищены GamingSettingsLock)
+
+    // Профилировщик обращений к регистрам
+    I219V_MMIO_PROFILE MmioProfile;                    // Счетчики (атомарные, без блокировки)
+
+    // Асинхронный доступ к PHY через MDIC
+    I219V_PHY_ENGINE PhyEngine;                        // Очередь запросов (защищена собственной блокировкой)
+    I219V_PHY_LINK_CACHE PhyLinkCache;                 // Кэш регистров соединения (защищен блокировкой PhyEngine)
+    I219V_PHY_DIAG_STATE PhyDiagnostics;               // Снимок диагностики (защищен блокировкой PhyEngine)
+
+    // Последовательность сброса MAC и PHY
+    I219V_RESET_SEQUENCER ResetSequencer;              // Фазы и длительности (меняет только таймер во время сброса)
+
+#if I219V_DEVICE_MODEL
+    // Поведенческая модель устройства вместо области регистров (NULL - оборудование)
+    struct _I219V_DEVICE_MODEL* DeviceModel;
+#endif
+
     // Синхронизация для игровых настроек и статистики
     WDFSPINLOCK GamingSettingsLock;        // Блокировка для защиты доступа к игровым настройкам и статистике
 
 } I219V_DEVICE_CONTEXT, *PI219V_DEVICE_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE(I219V_DEVICE_CONTEXT);
+
+// Получение контекста устройства (Driver.c)
+PI219V_DEVICE_CONTEXT I219vGetDeviceContext(_In_ WDFDEVICE Device);
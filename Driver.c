@@ -26,6 +26,13 @@ Environment:
 #include "Adapter.h"
 #include "i219v_hw.h"
 #include "i219v_gaming.h"
+#include "i219v_qos.h"
+#include "i219v_flow.h"
+#include "i219v_rtt.h"
+#include "i219v_moderation.h"
+#include "i219v_phy.h"
+#include "i219v_reset.h"
+#include "DeviceContext.h"
 #include "Trace.h"
 
 // Версия драйвера
@@ -101,11 +108,21 @@ I219vEvtDeviceAdd(
     NETADAPTER_INIT* adapterInit = NULL;
     NETADAPTER adapter = NULL;
     PI219V_DEVICE_CONTEXT deviceContext = NULL;
+    WDF_PNPPOWER_EVENT_CALLBACKS pnpPowerCallbacks;
 
     UNREFERENCED_PARAMETER(Driver);
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "Device Add");
 
+    // Обработчики PnP и питания (Device.c): отображение регистров в
+    // PrepareHardware, инициализация оборудования при входе в D0
+    WDF_PNPPOWER_EVENT_CALLBACKS_INIT(&pnpPowerCallbacks);
+    pnpPowerCallbacks.EvtDevicePrepareHardware = I219vEvtDevicePrepareHardware;
+    pnpPowerCallbacks.EvtDeviceReleaseHardware = I219vEvtDeviceReleaseHardware;
+    pnpPowerCallbacks.EvtDeviceD0Entry = I219vEvtDeviceD0Entry;
+    pnpPowerCallbacks.EvtDeviceD0Exit = I219vEvtDeviceD0Exit;
+    WdfDeviceInitSetPnpPowerEventCallbacks(DeviceInit, &pnpPowerCallbacks);
+
     // Настройка атрибутов устройства
     WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&deviceAttributes, I219V_DEVICE_CONTEXT);
     deviceAttributes.EvtCleanupCallback = I219vEvtDeviceContextCleanup;
@@ -133,6 +150,12 @@ I219vEvtDeviceAdd(
         goto Exit;
     }
 
+    // Теневая копия управляющих регистров (до первого обращения к устройству)
+    status = I219vInitializeRegisterShadow(deviceContext);
+    if (!NT_SUCCESS(status)) {
+        goto Exit;
+    }
+
     // Инициализация устройства
     status = I219vInitializeDevice(deviceContext);
     if (!NT_SUCCESS(status)) {
@@ -140,6 +163,35 @@ I219vEvtDeviceAdd(
         goto Exit;
     }
 
+    // Создание объекта прерывания (WdfInterruptCreate допустим только в EvtDeviceAdd
+    // и EvtDevicePrepareHardware)
+    status = I219vInitializeInterrupt(device);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "I219vInitializeInterrupt failed: %!STATUS!", status);
+        goto Exit;
+    }
+
+    // Таймер опроса для защиты от шторма прерываний
+    status = I219vInitializeStormGuard(deviceContext);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "I219vInitializeStormGuard failed: %!STATUS!", status);
+        goto Exit;
+    }
+
+    // Асинхронный доступ к PHY (инициализация устройства выше использует синхронный)
+    status = I219vInitializePhyEngine(deviceContext);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "I219vInitializePhyEngine failed: %!STATUS!", status);
+        goto Exit;
+    }
+
+    // Таймер последовательности сброса (сброс выполняется при входе в D0)
+    status = I219vInitializeResetSequencer(deviceContext);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "I219vInitializeResetSequencer failed: %!STATUS!", status);
+        goto Exit;
+    }
+
     // Создание инициализатора адаптера
     adapterInit = NetAdapterInitAllocate(device);
     if (adapterInit == NULL) {
@@ -169,6 +221,42 @@ I219vEvtDeviceAdd(
     // Сохранение дескриптора адаптера
     deviceContext->NetAdapter = adapter;
 
+    // Привязка прерывания и DPC к процессорам (политика прерывания задается
+    // в EvtDeviceAdd и применяется при назначении ресурсов)
+    status = I219vLoadAffinityConfiguration(deviceContext);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_WARNING, TRACE_DRIVER, "I219vLoadAffinityConfiguration failed: %!STATUS!", status);
+    }
+
+    // Маркировка QoS инициализируется до игровых функций и затем
+    // переопределяется ключевыми словами INF
+    I219vInitializeQosMarking(deviceContext);
+
+    status = I219vLoadQosMarkingConfiguration(deviceContext);
+    if (!NT_SUCCESS(status)) {
+        // Отсутствие конфигурации не критично - остаются значения по умолчанию
+        TraceEvents(TRACE_LEVEL_WARNING, TRACE_DRIVER, "I219vLoadQosMarkingConfiguration failed: %!STATUS!", status);
+    }
+
+    // Инициализация трекера потоков
+    I219vInitializeFlowTracker(deviceContext);
+    I219vInitializeRtt(deviceContext);
+    I219vInitializeLatency(deviceContext);
+
+    // Модерация прерываний инициализируется до применения игрового профиля,
+    // который задает границы шкалы ITR
+    status = I219vInitializeModeration(deviceContext);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "I219vInitializeModeration failed: %!STATUS!", status);
+        goto Exit;
+    }
+
+    status = I219vLoadModerationConfiguration(deviceContext);
+    if (!NT_SUCCESS(status)) {
+        // Отсутствие конфигурации не критично - остается автоматический режим
+        TraceEvents(TRACE_LEVEL_WARNING, TRACE_DRIVER, "I219vLoadModerationConfiguration failed: %!STATUS!", status);
+    }
+
     // Инициализация игровых функций
     status = I219vInitializeGamingFeatures(deviceContext);
     if (!NT_SUCCESS(status)) {
@@ -39,14 +39,8 @@ Environment:
 // have been moved or their logic integrated into Adapter.c and Driver.c
 // to consolidate the NetAdapter initialization path.
 
-// If I219vInitializeInterrupt was only used by the old I219vEvtAdapterStart in this file,
-// and is not called from the new consolidated I219vEvtAdapterStart (now in Adapter.c),
-// it might also be orphaned. For now, its definition is assumed to be elsewhere if still needed
-// (e.g. in i219v_hw.c or similar, and called during device D0Entry or PrepareHardware).
-// The call to I219vInitializeInterrupt was commented out in the consolidated I219vEvtAdapterStart.
-// If it's truly unused, it should be removed from its definition file.
-// If it IS used by the new Start, its prototype needs to be available in Adapter.c.
-// For this refactoring, we assume I219vInitializeInterrupt is handled elsewhere (e.g. D0Entry).
+// I219vInitializeInterrupt is implemented in Queue.c together with the ISR/DPC
+// and is called from I219vEvtDeviceAdd in Driver.c.
 
 // The functions I219vEnableDevice, I219vDisableDevice, I219vPauseDevice, I219vRestartDevice
 // were called from the EvtAdapterXXX handlers that were in this file.
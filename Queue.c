@@ -28,116 +28,406 @@ Environment:
 #include "i219v_hw.h"
 #include "i219v_hw_extended.h"
 #include "i219v_gaming.h"
+#include "i219v_qos.h"
+#include "i219v_flow.h"
+#include "i219v_rtt.h"
+#include "i219v_moderation.h"
+#include "i219v_storm.h"
+#include "i219v_latency.h"
+#include "i219v_phy.h"
+#include "Datapath.h"
 #include "DeviceContext.h"
 #include "Trace.h"
 
-// Обработчик передачи пакетов
+// Ключевые слова INF для привязки пути данных к процессорам
+#define I219V_AFFINITY_KEYWORD_DATAPATH_CPU     L"DatapathCpu"
+#define I219V_AFFINITY_KEYWORD_BUSY_CORE_MASK   L"BusyCoreMask"
+
+// Количество свободных дескрипторов в кольце передачи
+// (один дескриптор всегда остается незанятым, чтобы TDT не догнал TDH)
+static
+UINT32
+I219vTxFreeDescriptors(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    UINT32 used = (DeviceContext->TxNextToUse + I219V_TX_RING_SIZE - DeviceContext->TxNextToClean) % I219V_TX_RING_SIZE;
+
+    return I219V_TX_RING_SIZE - 1 - used;
+}
+
+// Возврат ОС пакетов, дескрипторы которых обработаны устройством
+// За вызов возвращается не более I219V_TX_RECLAIM_BUDGET пакетов.
+// Вызывается под GamingSettingsLock. Возвращает количество завершенных пакетов.
+static
+UINT32
+I219vTxReclaimPackets(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ NET_RING* PacketRing,
+    _In_ NET_RING* FragmentRing
+    )
+{
+    PI219V_TX_DESC txRing = DeviceContext->TxRing;
+    UINT32 packetIndex = PacketRing->BeginIndex;
+    UINT32 nextToClean = DeviceContext->TxNextToClean;
+    UINT32 completions = 0;
+    UINT64 completeCycles = I219V_LATENCY_TIMESTAMP();
+
+    while (packetIndex != PacketRing->NextIndex)
+    {
+        if (completions == I219V_TX_RECLAIM_BUDGET)
+        {
+            // Остаток будет возвращен следующим вызовом продвижения очереди
+            DeviceContext->InterruptStats.TxBudgetExhausted++;
+            break;
+        }
+
+        NET_PACKET* packet = NetRingGetPacketAtIndex(PacketRing, packetIndex);
+
+        if (!packet->Ignore)
+        {
+            // Бит RS выставляется только в последнем дескрипторе пакета
+            UINT32 lastDescriptor = (nextToClean + packet->FragmentCount - 1) % I219V_TX_RING_SIZE;
+
+            if ((txRing[lastDescriptor].Status & I219V_TXD_STAT_DD) == 0)
+            {
+                break;
+            }
+
+            // Учет задержки передачи по этапам
+            I219vLatencyRecordTx(DeviceContext, &DeviceContext->TxLatencySlots[nextToClean], completeCycles);
+
+            // Метаданные слота больше не действительны: буферы возвращаются ОС
+            DeviceContext->TxPacketMetadata[nextToClean].Classified = FALSE;
+            DeviceContext->TxPacketMetadata[nextToClean].HeaderBuffer = NULL;
+
+            for (UINT32 i = 0; i < packet->FragmentCount; i++)
+            {
+                txRing[nextToClean].Status = 0;
+                nextToClean = (nextToClean + 1) % I219V_TX_RING_SIZE;
+            }
+
+            completions++;
+        }
+
+        FragmentRing->BeginIndex = NetRingAdvanceIndex(FragmentRing, packet->FragmentIndex, packet->FragmentCount);
+        packetIndex = NetRingIncrementIndex(PacketRing, packetIndex);
+    }
+
+    PacketRing->BeginIndex = packetIndex;
+    DeviceContext->TxNextToClean = nextToClean;
+
+    return completions;
+}
+
+// Заполнение метаданных передаваемого пакета
+// Заголовки разбираются один раз; класс и приоритет затем определяются
+// пакетной классификацией, и все последующие стадии читают результат
+// из метаданных слота вместо повторного разбора заголовков.
+static
 VOID
-I219vEvtTxQueueAdvance(
-    _In_ NETPACKETQUEUE TxQueue
+I219vTxPrepareMetadata(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ NET_PACKET const* Packet,
+    _In_ NET_RING* FragmentRing,
+    _In_ BOOLEAN ParseHeaders,
+    _Out_ PI219V_PACKET_METADATA Metadata
     )
 {
-    WDFDEVICE device = NetPacketQueueGetDevice(TxQueue);
-    PI219V_DEVICE_CONTEXT deviceContext = I219vGetDeviceContext(device);
-    NET_RING_COLLECTION const* rings = NetPacketQueueGetRingCollection(TxQueue);
-    NET_RING* packetRing = rings->Rings[NET_RING_TYPE_PACKET];
-    NET_RING* fragmentRing = rings->Rings[NET_RING_TYPE_FRAGMENT];
-    UINT32 packetIndex = packetRing->BeginIndex;
+    UINT32 fragmentIndex = Packet->FragmentIndex;
+    NET_FRAGMENT* firstFragment = NetRingGetFragmentAtIndex(FragmentRing, fragmentIndex);
+
+    RtlZeroMemory(Metadata, sizeof(I219V_PACKET_METADATA));
+    Metadata->Class = I219V_TRAFFIC_CLASS_BACKGROUND;
+    Metadata->Priority = I219V_TRAFFIC_PRIORITY_LOW;
+
+    // Заголовки Ethernet/IP должны находиться в первом фрагменте
+    Metadata->HeaderBuffer = (PUCHAR)NetExtensionGetFragmentVirtualAddress(
+        &DeviceContext->TxVirtualAddressExtension, fragmentIndex)->VirtualAddress + firstFragment->Offset;
+    Metadata->HeaderBufferLength = (UINT32)firstFragment->ValidLength;
+
+    for (UINT32 i = 0; i < Packet->FragmentCount; i++)
+    {
+        Metadata->FrameLength += (UINT32)NetRingGetFragmentAtIndex(FragmentRing, fragmentIndex)->ValidLength;
+        fragmentIndex = NetRingIncrementIndex(FragmentRing, fragmentIndex);
+    }
+
+    if (ParseHeaders)
+    {
+        Metadata->HeadersValid = I219vParsePacketHeaders(Metadata->HeaderBuffer,
+                                                         Metadata->HeaderBufferLength,
+                                                         &Metadata->Headers);
+    }
+}
+
+// Постановка пакетов в кольцо передачи и возврат завершенных
+// Тело I219vEvtTxQueueAdvance, отделенное от очереди NetAdapterCx:
+// тесты на модели устройства вызывают его с собственными кольцами.
+VOID
+I219vTxAdvanceRings(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Inout_ NET_RING* PacketRing,
+    _Inout_ NET_RING* FragmentRing
+    )
+{
+    PI219V_TX_DESC txRing = DeviceContext->TxRing;
+    UINT32 packetIndex = PacketRing->NextIndex;
+    UINT32 batchPackets[I219V_CLASSIFY_BATCH_SIZE];
+    PI219V_PACKET_METADATA batchMetadata[I219V_CLASSIFY_BATCH_SIZE];
+    UINT32 tail;
+    UINT32 firstTail;
+    UINT32 postedPackets = 0;
+    UINT32 postedBytes = 0;
+    UINT32 completions;
+    UINT64 now = KeQueryInterruptTime();
+    UINT64 nowUs = I219vRttGetTimeUs(DeviceContext);
+    BOOLEAN ringFull = FALSE;
+    BOOLEAN descriptorsPosted = FALSE;
     BOOLEAN prioritizationEnabled;
     BOOLEAN latencyReductionEnabled;
+    BOOLEAN markingEnabled;
+    BOOLEAN txDelayEnabled;
 
-    TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_QUEUE, "TX Queue Advance");
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
 
-    WdfSpinLockAcquire(deviceContext->GamingSettingsLock);
+    prioritizationEnabled = DeviceContext->TrafficPrioritizationEnabled;
+    latencyReductionEnabled = DeviceContext->LatencyReductionEnabled;
+    markingEnabled = DeviceContext->QosMarkingConfig.EnableDscpMarking ||
+                     DeviceContext->QosMarkingConfig.EnablePriorityTagging;
+    txDelayEnabled = DeviceContext->Moderation.TxDelayEnabled;
+    tail = DeviceContext->TxNextToUse;
+    firstTail = tail;
 
-    prioritizationEnabled = deviceContext->TrafficPrioritizationEnabled;
-    latencyReductionEnabled = deviceContext->LatencyReductionEnabled;
-
-    // Обработка всех пакетов в очереди
-    while (packetIndex != packetRing->EndIndex)
+    // Пакеты обрабатываются пачками до I219V_CLASSIFY_BATCH_SIZE
+    while (packetIndex != PacketRing->EndIndex && !ringFull)
     {
-        NET_PACKET* packet = NetRingGetPacketAtIndex(packetRing, packetIndex);
-        UINT32 fragmentIndex = packet->FragmentIndex;
-        UINT32 fragmentCount = packet->FragmentCount;
-        BOOLEAN isHighPriority = FALSE;
-
-        // Если включена приоритизация трафика, определяем приоритет пакета
-        // Все доступы к deviceContext->GamingPerformanceStats и другим счетчикам
-        // теперь защищены одним внешним WdfSpinLockAcquire/Release.
-        if (prioritizationEnabled)
+        UINT32 batchCount = 0;
+        UINT32 metadataCount = 0;
+        UINT32 slot = tail;
+        UINT32 freeDescriptors = I219vTxFreeDescriptors(DeviceContext);
+        UINT64 submitCycles = I219V_LATENCY_TIMESTAMP();
+
+        // Стадия сбора: разбор заголовков и резервирование слотов
+        while (packetIndex != PacketRing->EndIndex && batchCount < I219V_CLASSIFY_BATCH_SIZE)
         {
-            // Анализ пакета для определения типа трафика
-            if (I219vIsGamingTraffic((PNET_PACKET)packet))
+            NET_PACKET* packet = NetRingGetPacketAtIndex(PacketRing, packetIndex);
+
+            if (!packet->Ignore)
             {
-                NTSTATUS PrioStatus;
-                // Установка высокого приоритета для игрового трафика
-                isHighPriority = TRUE;
-                PrioStatus = I219vSetPacketPriority(deviceContext, (PNET_PACKET)packet, I219V_TRAFFIC_PRIORITY_HIGHEST);
-                if (!NT_SUCCESS(PrioStatus)) {
-                    TraceEvents(TRACE_LEVEL_WARNING, TRACE_QUEUE, "I219vSetPacketPriority (Highest) failed: %!STATUS!", PrioStatus);
+                // Недостаточно дескрипторов - оставшиеся пакеты будут отправлены
+                // при следующем вызове после освобождения кольца
+                if (packet->FragmentCount > freeDescriptors)
+                {
+                    // Время ожидания освобождения кольца входит в задержку пакета
+                    if (DeviceContext->Latency.TxBlockedCycles == 0)
+                    {
+                        DeviceContext->Latency.TxBlockedCycles = submitCycles;
+                    }
+                    ringFull = TRUE;
+                    break;
+                }
+
+                // Метка получения пакета от стека
+                DeviceContext->TxLatencySlots[slot].SubmitCycles = submitCycles;
+                if (DeviceContext->Latency.TxBlockedCycles != 0)
+                {
+                    DeviceContext->TxLatencySlots[slot].SubmitCycles = DeviceContext->Latency.TxBlockedCycles;
+                    DeviceContext->Latency.TxBlockedCycles = 0;
                 }
-                deviceContext->GamingPerformanceStats.HighPriorityPacketsSent++;
-                deviceContext->GameTrafficCount++;
+
+                // Метаданные хранятся в слоте первого дескриптора пакета
+                batchMetadata[metadataCount] = &DeviceContext->TxPacketMetadata[slot];
+                I219vTxPrepareMetadata(DeviceContext, packet, FragmentRing, prioritizationEnabled, batchMetadata[metadataCount]);
+                metadataCount++;
+
+                slot = (slot + packet->FragmentCount) % I219V_TX_RING_SIZE;
+                freeDescriptors -= packet->FragmentCount;
             }
-            else if (I219vIsVoiceTraffic((PNET_PACKET)packet))
+
+            batchPackets[batchCount++] = packetIndex;
+            packetIndex = NetRingIncrementIndex(PacketRing, packetIndex);
+        }
+
+        // Стадия классификации (вся пачка за один проход)
+        if (prioritizationEnabled && metadataCount > 0)
+        {
+            I219vClassifyMetadataBatch(batchMetadata, metadataCount);
+        }
+
+        // Стадии статистики, маркировки и записи дескрипторов
+        for (UINT32 b = 0; b < batchCount; b++)
+        {
+            NET_PACKET* packet = NetRingGetPacketAtIndex(PacketRing, batchPackets[b]);
+            UINT32 fragmentIndex = packet->FragmentIndex;
+            UINT32 fragmentCount = packet->FragmentCount;
+            PI219V_PACKET_METADATA metadata;
+            PI219V_TX_LATENCY_SLOT latencySlot;
+
+            if (packet->Ignore)
             {
-                // Установка высокого приоритета для голосового трафика
-                isHighPriority = TRUE;
-                PrioStatus = I219vSetPacketPriority(deviceContext, (PNET_PACKET)packet, I219V_TRAFFIC_PRIORITY_HIGH);
-                if (!NT_SUCCESS(PrioStatus)) {
-                    TraceEvents(TRACE_LEVEL_WARNING, TRACE_QUEUE, "I219vSetPacketPriority (High) failed: %!STATUS!", PrioStatus);
+                // Дескрипторы не пишутся, но фрагменты пакета передаются
+                // устройству вместе с ним: I219vTxReclaimPackets продвигает
+                // BeginIndex кольца фрагментов и за игнорируемыми пакетами
+                for (UINT32 i = 0; i < fragmentCount; i++)
+                {
+                    fragmentIndex = NetRingIncrementIndex(FragmentRing, fragmentIndex);
                 }
-                deviceContext->GamingPerformanceStats.HighPriorityPacketsSent++;
-                deviceContext->VoiceTrafficCount++;
+
+                FragmentRing->NextIndex = fragmentIndex;
+                continue;
             }
-            else if (I219vIsStreamingTraffic((PNET_PACKET)packet))
+
+            metadata = &DeviceContext->TxPacketMetadata[tail];
+            latencySlot = &DeviceContext->TxLatencySlots[tail];
+
+            // Стадия учета потоков: обновление трекера и понижение
+            // приоритета объемных потоков, попавших в высокий класс
+            if (metadata->Classified)
             {
-                // Установка среднего приоритета для стримингового трафика
-                PrioStatus = I219vSetPacketPriority(deviceContext, (PNET_PACKET)packet, I219V_TRAFFIC_PRIORITY_MEDIUM);
-                if (!NT_SUCCESS(PrioStatus)) {
-                    TraceEvents(TRACE_LEVEL_WARNING, TRACE_QUEUE, "I219vSetPacketPriority (Medium) failed: %!STATUS!", PrioStatus);
+                I219vFlowTrackerUpdate(DeviceContext, metadata, now);
+
+                // Начало пассивного замера RTT потока
+                I219vRttOnTransmit(DeviceContext, metadata, nowUs);
+            }
+
+            // Стадия статистики
+            // Все доступы к DeviceContext->GamingPerformanceStats и другим счетчикам
+            // защищены одним внешним WdfSpinLockAcquire/Release.
+            if (metadata->Classified)
+            {
+                switch (metadata->Class)
+                {
+                case I219V_TRAFFIC_CLASS_GAME:
+                    DeviceContext->GameTrafficCount++;
+                    break;
+                case I219V_TRAFFIC_CLASS_VOICE:
+                    DeviceContext->VoiceTrafficCount++;
+                    break;
+                case I219V_TRAFFIC_CLASS_STREAMING:
+                    DeviceContext->StreamingTrafficCount++;
+                    break;
+                default:
+                    DeviceContext->BackgroundTrafficCount++;
+                    break;
+                }
+
+                if (metadata->Priority <= I219V_TRAFFIC_PRIORITY_HIGH)
+                {
+                    DeviceContext->GamingPerformanceStats.HighPriorityPacketsSent++;
+
+                    // Если включено снижение задержки и пакет имеет высокий приоритет
+                    if (latencyReductionEnabled)
+                    {
+                        DeviceContext->GamingPerformanceStats.LowLatencyPacketsSent++;
+                    }
                 }
-                deviceContext->StreamingTrafficCount++;
             }
-            else
+
+            // Стадия маркировки DSCP/802.1p
+            if (markingEnabled && metadata->Classified)
             {
-                // Установка низкого приоритета для фонового трафика
-                PrioStatus = I219vSetPacketPriority(deviceContext, (PNET_PACKET)packet, I219V_TRAFFIC_PRIORITY_LOW);
-                if (!NT_SUCCESS(PrioStatus)) {
-                    TraceEvents(TRACE_LEVEL_WARNING, TRACE_QUEUE, "I219vSetPacketPriority (Low) failed: %!STATUS!", PrioStatus);
+                if (metadata->HeadersValid)
+                {
+                    I219vQosMarkPacket(DeviceContext, metadata);
+                }
+                else
+                {
+                    DeviceContext->QosMarkingStats.UnparsedPackets++;
                 }
-                deviceContext->BackgroundTrafficCount++;
             }
-        }
 
-        // Если включено снижение задержки и пакет имеет высокий приоритет
-        if (latencyReductionEnabled && isHighPriority)
-        {
-            // Отправка пакета с минимальной задержкой
-            // В реальной реализации здесь бы выполнялась оптимизация отправки
-            deviceContext->GamingPerformanceStats.LowLatencyPacketsSent++;
-        }
+            // Запись дескрипторов для всех фрагментов пакета
+            for (UINT32 i = 0; i < fragmentCount; i++)
+            {
+                NET_FRAGMENT* fragment = NetRingGetFragmentAtIndex(FragmentRing, fragmentIndex);
+                PI219V_TX_DESC txDesc = &txRing[tail];
 
-        // Обработка всех фрагментов пакета
-        for (UINT32 i = 0; i < fragmentCount; i++)
-        {
-            NET_FRAGMENT* fragment = NetRingGetFragmentAtIndex(fragmentRing, fragmentIndex + i);
-            
-            // В реальной реализации здесь бы выполнялась отправка фрагмента
-            // с учетом приоритета и настроек снижения задержки
+                txDesc->BufferAddr = NetExtensionGetFragmentLogicalAddress(
+                    &DeviceContext->TxLogicalAddressExtension, fragmentIndex)->LogicalAddress + fragment->Offset;
+                txDesc->Length = (UINT16)fragment->ValidLength;
+                txDesc->CSO = 0;
+                txDesc->CSS = 0;
+                txDesc->Status = 0;
+                txDesc->Special = 0;
+                txDesc->CMD = I219V_TXD_CMD_IFCS;
+
+                if (i == fragmentCount - 1)
+                {
+                    txDesc->CMD |= I219V_TXD_CMD_EOP | I219V_TXD_CMD_RS;
+
+                    // Прерывание о завершении откладывается таймерами TIDV/TADV
+                    if (txDelayEnabled)
+                    {
+                        txDesc->CMD |= I219V_TXD_CMD_IDE;
+                    }
+
+                    // Тег 802.1Q вставляется устройством из поля Special
+                    if (metadata->InsertVlanTag)
+                    {
+                        txDesc->CMD |= I219V_TXD_CMD_VLE;
+                        txDesc->Special = metadata->VlanTag;
+                    }
+                }
+
+                tail = (tail + 1) % I219V_TX_RING_SIZE;
+                fragmentIndex = NetRingIncrementIndex(FragmentRing, fragmentIndex);
+            }
+
+            FragmentRing->NextIndex = fragmentIndex;
+            descriptorsPosted = TRUE;
+
+            // Метка записи дескрипторов пакета
+            latencySlot->PostCycles = I219V_LATENCY_TIMESTAMP();
+            latencySlot->Descriptors = (UINT16)fragmentCount;
+            latencySlot->Priority = (UCHAR)metadata->Priority;
+
+            // Обновление статистики
+            DeviceContext->GamingPerformanceStats.TotalPacketsSent++;
+            postedPackets++;
+            postedBytes += metadata->FrameLength;
         }
+    }
+
+    PacketRing->NextIndex = packetIndex;
+
+    // Один доступ к TDT на все поставленные пакеты
+    if (descriptorsPosted)
+    {
+        KeMemoryBarrier();
+        DeviceContext->TxNextToUse = tail;
+        I219vWriteRegisterFast(DeviceContext, TDT, tail);
+
+        I219vLatencyStampDoorbell(DeviceContext, firstTail, tail, I219V_LATENCY_TIMESTAMP());
+    }
+
+    // Возврат завершенных пакетов
+    completions = I219vTxReclaimPackets(DeviceContext, PacketRing, FragmentRing);
 
-        // Обновление статистики
-        deviceContext->GamingPerformanceStats.TotalPacketsSent++;
+    // Учет нагрузки для динамической модерации прерываний
+    I219vModerationSample(DeviceContext, 0, postedPackets, completions, postedBytes, now);
 
-        // Пометка пакета как завершенного
-        packet->Scratch = 0;
-        packetRing->BeginIndex = NetRingIncrementIndex(packetRing, packetIndex);
-        packetIndex = packetRing->BeginIndex;
+    // Учет нагрузки для выхода из режима опроса
+    if (DeviceContext->Storm.PollingActive) {
+        DeviceContext->Storm.WindowPackets += completions;
     }
 
-    // Обновление указателей очереди
-    fragmentRing->BeginIndex = NetRingGetFragmentIndex(fragmentRing, packetRing->BeginIndex);
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Обработчик передачи пакетов
+VOID
+I219vEvtTxQueueAdvance(
+    _In_ NETPACKETQUEUE TxQueue
+    )
+{
+    WDFDEVICE device = NetPacketQueueGetDevice(TxQueue);
+    NET_RING_COLLECTION const* rings = NetPacketQueueGetRingCollection(TxQueue);
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_QUEUE, "TX Queue Advance");
+
+    I219vTxAdvanceRings(I219vGetDeviceContext(device),
+                        rings->Rings[NET_RING_TYPE_PACKET],
+                        rings->Rings[NET_RING_TYPE_FRAGMENT]);
 }
 
 // Обработчик приема пакетов
@@ -151,86 +441,192 @@ I219vEvtRxQueueAdvance(
     NET_RING_COLLECTION const* rings = NetPacketQueueGetRingCollection(RxQueue);
     NET_RING* packetRing = rings->Rings[NET_RING_TYPE_PACKET];
     NET_RING* fragmentRing = rings->Rings[NET_RING_TYPE_FRAGMENT];
-    UINT32 packetIndex = packetRing->BeginIndex;
+    PI219V_RX_DESC rxRing = deviceContext->RxRing;
+    UINT32 nextToClean;
+    UINT32 nextToUse;
+    UINT32 receivedPackets = 0;
+    UINT32 receivedBytes = 0;
+    UINT32 harvested = 0;
+    UINT64 harvestCycles[I219V_RX_HARVEST_BUDGET];
+    UCHAR harvestClasses[I219V_RX_HARVEST_BUDGET];
+    UINT32 latencySamples = 0;
+    UINT64 nowUs;
+    LONG64 isrTimeUs;
+    BOOLEAN descriptorsPosted = FALSE;
     BOOLEAN prioritizationEnabled;
     BOOLEAN latencyReductionEnabled;
 
     TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_QUEUE, "RX Queue Advance");
 
-    // Проверка наличия свободных пакетов и фрагментов
-    if (NetRingGetRangeCount(packetRing, packetRing->EndIndex, packetRing->NextIndex) == 0 ||
-        NetRingGetRangeCount(fragmentRing, fragmentRing->EndIndex, fragmentRing->NextIndex) == 0)
-    {
-        // Нет свободных пакетов или фрагментов
-        return;
-    }
-
     WdfSpinLockAcquire(deviceContext->GamingSettingsLock);
 
     prioritizationEnabled = deviceContext->TrafficPrioritizationEnabled;
     latencyReductionEnabled = deviceContext->LatencyReductionEnabled;
+    nowUs = I219vRttGetTimeUs(deviceContext);
+    nextToClean = deviceContext->RxNextToClean;
 
-    // В реальной реализации здесь бы выполнялся прием пакетов из аппаратных буферов
-    // и заполнение колец пакетов и фрагментов
+    // Сбор принятых кадров: дескрипторы и фрагменты продвигаются синхронно,
+    // так как буферы ставятся в кольцо дескрипторов в порядке кольца фрагментов
+    // (не более I219V_RX_HARVEST_BUDGET кадров за вызов)
+    while (nextToClean != deviceContext->RxNextToUse &&
+           packetRing->BeginIndex != packetRing->EndIndex)
+    {
+        PI219V_RX_DESC rxDesc = &rxRing[nextToClean];
+        UINT32 fragmentIndex = fragmentRing->BeginIndex;
+        NET_FRAGMENT* fragment;
+        NET_PACKET* packet;
 
-    // Для примера просто обновляем статистику
-    deviceContext->GamingPerformanceStats.TotalPacketsReceived++;
+        if ((rxDesc->Status & I219V_RXD_STAT_DD) == 0)
+        {
+            break;
+        }
 
-    // Если включена приоритизация трафика, обрабатываем принятые пакеты
-    // Все доступы к deviceContext->GamingPerformanceStats и другим счетчикам
-    // теперь защищены одним внешним WdfSpinLockAcquire/Release.
-    if (prioritizationEnabled)
-    {
-        // Обработка всех принятых пакетов
-        while (packetIndex != packetRing->EndIndex)
+        if (harvested == I219V_RX_HARVEST_BUDGET)
         {
-            NET_PACKET* packet = NetRingGetPacketAtIndex(packetRing, packetIndex);
-            BOOLEAN isHighPriority = FALSE;
+            deviceContext->InterruptStats.RxBudgetExhausted++;
+            break;
+        }
+        harvested++;
 
-            // Анализ пакета для определения типа трафика
-            if (I219vIsGamingTraffic((PNET_PACKET)packet))
-            {
-                // Обработка игрового трафика с высоким приоритетом
-                isHighPriority = TRUE;
-                deviceContext->GamingPerformanceStats.HighPriorityPacketsReceived++;
-                deviceContext->GameTrafficCount++;
-            }
-            else if (I219vIsVoiceTraffic((PNET_PACKET)packet))
-            {
-                // Обработка голосового трафика с высоким приоритетом
-                isHighPriority = TRUE;
-                deviceContext->GamingPerformanceStats.HighPriorityPacketsReceived++;
-                deviceContext->VoiceTrafficCount++;
-            }
-            else if (I219vIsStreamingTraffic((PNET_PACKET)packet))
-            {
-                // Обработка стримингового трафика
-                deviceContext->StreamingTrafficCount++;
-            }
-            else
+        // Поля дескриптора читаются только после проверки DD
+        KeMemoryBarrier();
+
+        fragment = NetRingGetFragmentAtIndex(fragmentRing, fragmentIndex);
+        fragment->ValidLength = rxDesc->Length;
+        fragment->Offset = 0;
+
+        packet = NetRingGetPacketAtIndex(packetRing, packetRing->BeginIndex);
+        packet->FragmentIndex = fragmentIndex;
+        packet->FragmentCount = 1;
+
+        // Кадры с ошибками и кадры, не уместившиеся в один буфер, стеку не передаются
+        packet->Ignore = ((rxDesc->Status & I219V_RXD_STAT_EOP) == 0 ||
+                          (rxDesc->Errors & I219V_RXD_ERR_FRAME_MASK) != 0) ? 1 : 0;
+
+        if (!packet->Ignore)
+        {
+            deviceContext->GamingPerformanceStats.TotalPacketsReceived++;
+            receivedPackets++;
+            receivedBytes += rxDesc->Length;
+
+            // Момент сбора дескриптора для гистограмм задержки
+            // (без классификации кадр учитывается как фоновый)
+            harvestCycles[latencySamples] = I219V_LATENCY_TIMESTAMP();
+            harvestClasses[latencySamples] = I219V_TRAFFIC_CLASS_BACKGROUND;
+
+            // Если включена приоритизация трафика, классифицируем принятый пакет
+            // Все доступы к deviceContext->GamingPerformanceStats и другим счетчикам
+            // защищены одним внешним WdfSpinLockAcquire/Release.
+            if (prioritizationEnabled)
             {
-                // Обработка фонового трафика
-                deviceContext->BackgroundTrafficCount++;
+                I219V_PACKET_METADATA metadata;
+
+                RtlZeroMemory(&metadata, sizeof(I219V_PACKET_METADATA));
+                metadata.HeaderBuffer = (PUCHAR)NetExtensionGetFragmentVirtualAddress(
+                    &deviceContext->RxVirtualAddressExtension, fragmentIndex)->VirtualAddress;
+                metadata.HeaderBufferLength = rxDesc->Length;
+                metadata.FrameLength = rxDesc->Length;
+
+                I219vClassifyPacket(&metadata);
+                harvestClasses[latencySamples] = (UCHAR)metadata.Class;
+
+                switch (metadata.Class)
+                {
+                case I219V_TRAFFIC_CLASS_GAME:
+                    deviceContext->GameTrafficCount++;
+                    break;
+                case I219V_TRAFFIC_CLASS_VOICE:
+                    deviceContext->VoiceTrafficCount++;
+                    break;
+                case I219V_TRAFFIC_CLASS_STREAMING:
+                    deviceContext->StreamingTrafficCount++;
+                    break;
+                default:
+                    deviceContext->BackgroundTrafficCount++;
+                    break;
+                }
+
+                if (metadata.Priority <= I219V_TRAFFIC_PRIORITY_HIGH)
+                {
+                    deviceContext->GamingPerformanceStats.HighPriorityPacketsReceived++;
+
+                    // Если включено снижение задержки и пакет имеет высокий приоритет
+                    if (latencyReductionEnabled)
+                    {
+                        deviceContext->GamingPerformanceStats.LowLatencyPacketsReceived++;
+                    }
+                }
+
+                // Завершение пассивного замера RTT встречного потока
+                if (metadata.HeadersValid)
+                {
+                    I219vRttOnReceive(deviceContext, &metadata, nowUs);
+                }
             }
 
-            // Если включено снижение задержки и пакет имеет высокий приоритет
-            if (latencyReductionEnabled && isHighPriority)
+            latencySamples++;
+        }
+
+        rxDesc->Status = 0;
+        nextToClean = (nextToClean + 1) % I219V_RX_RING_SIZE;
+        fragmentRing->BeginIndex = NetRingIncrementIndex(fragmentRing, fragmentIndex);
+        packetRing->BeginIndex = NetRingIncrementIndex(packetRing, packetRing->BeginIndex);
+    }
+
+    deviceContext->RxNextToClean = nextToClean;
+
+    // Гистограммы задержки: кадры переданы стеку продвижением BeginIndex
+    I219vLatencyRecordRx(deviceContext, harvestCycles, harvestClasses, latencySamples, I219V_LATENCY_TIMESTAMP());
+
+    // Обратная связь модерации: задержка от ISR с причиной приема до
+    // передачи собранных кадров стеку
+    if (receivedPackets != 0)
+    {
+        isrTimeUs = InterlockedExchange64(&deviceContext->RxIsrTimeUs, 0);
+        if (isrTimeUs != 0)
+        {
+            UINT64 indicateTimeUs = I219vRttGetTimeUs(deviceContext);
+
+            if (indicateTimeUs >= (UINT64)isrTimeUs && indicateTimeUs - (UINT64)isrTimeUs <= I219V_LATENCY_BUDGET_MAX_US)
             {
-                // Обработка пакета с минимальной задержкой
-                // В реальной реализации здесь бы выполнялась оптимизация обработки
-                deviceContext->GamingPerformanceStats.LowLatencyPacketsReceived++;
+                I219vModerationReportDelay(deviceContext, (UINT32)(indicateTimeUs - (UINT64)isrTimeUs));
             }
-
-            // Переход к следующему пакету
-            packetIndex = NetRingIncrementIndex(packetRing, packetIndex);
         }
     }
 
-    WdfSpinLockRelease(deviceContext->GamingSettingsLock);
+    // Учет нагрузки для динамической модерации прерываний
+    I219vModerationSample(deviceContext, receivedPackets, 0, 0, receivedBytes, KeQueryInterruptTime());
+
+    if (deviceContext->Storm.PollingActive) {
+        deviceContext->Storm.WindowPackets += receivedPackets;
+    }
+
+    // Постановка свободных буферов в кольцо дескрипторов
+    // (один дескриптор всегда остается незанятым, чтобы RDT не догнал RDH)
+    nextToUse = deviceContext->RxNextToUse;
+    while (fragmentRing->NextIndex != fragmentRing->EndIndex &&
+           (nextToUse + 1) % I219V_RX_RING_SIZE != nextToClean)
+    {
+        UINT32 fragmentIndex = fragmentRing->NextIndex;
+
+        rxRing[nextToUse].BufferAddr = NetExtensionGetFragmentLogicalAddress(
+            &deviceContext->RxLogicalAddressExtension, fragmentIndex)->LogicalAddress;
+        rxRing[nextToUse].Status = 0;
+
+        nextToUse = (nextToUse + 1) % I219V_RX_RING_SIZE;
+        fragmentRing->NextIndex = NetRingIncrementIndex(fragmentRing, fragmentIndex);
+        descriptorsPosted = TRUE;
+    }
 
-    // Обновление указателей очереди
-    packetRing->EndIndex = packetRing->NextIndex;
-    fragmentRing->EndIndex = fragmentRing->NextIndex;
+    // Один доступ к RDT на все поставленные буферы
+    if (descriptorsPosted)
+    {
+        KeMemoryBarrier();
+        deviceContext->RxNextToUse = nextToUse;
+        I219vWriteRegisterFast(deviceContext, RDT, nextToUse);
+    }
+
+    WdfSpinLockRelease(deviceContext->GamingSettingsLock);
 }
 
 // Обработчик создания очереди передачи
@@ -248,8 +644,9 @@ I219vEvtCreateTxQueue(
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_QUEUE, "Creating TX queue");
 
-    // Установка обработчика продвижения очереди
+    // Установка обработчиков продвижения очереди и включения уведомлений
     NetPacketQueueSetAdvanceHandler(Configuration, I219vEvtTxQueueAdvance, deviceContext);
+    NetPacketQueueSetNotificationEnabledHandler(Configuration, I219vEvtTxQueueSetNotificationEnabled, deviceContext);
 
     // Инициализация атрибутов очереди
     WDF_OBJECT_ATTRIBUTES_INIT(&txQueueAttributes);
@@ -266,6 +663,21 @@ I219vEvtCreateTxQueue(
         return status;
     }
 
+    // Получение расширений фрагментов с виртуальным и логическим адресом буфера
+    NET_EXTENSION_QUERY extensionQuery;
+
+    NET_EXTENSION_QUERY_INIT(&extensionQuery,
+                             NET_FRAGMENT_EXTENSION_VIRTUAL_ADDRESS_NAME,
+                             NET_FRAGMENT_EXTENSION_VIRTUAL_ADDRESS_VERSION_1,
+                             NetExtensionTypeFragment);
+    NetTxQueueGetExtension(txQueue, &extensionQuery, &deviceContext->TxVirtualAddressExtension);
+
+    NET_EXTENSION_QUERY_INIT(&extensionQuery,
+                             NET_FRAGMENT_EXTENSION_LOGICAL_ADDRESS_NAME,
+                             NET_FRAGMENT_EXTENSION_LOGICAL_ADDRESS_VERSION_1,
+                             NetExtensionTypeFragment);
+    NetTxQueueGetExtension(txQueue, &extensionQuery, &deviceContext->TxLogicalAddressExtension);
+
     // Если включена приоритизация трафика, настраиваем очередь для поддержки приоритетов
     BOOLEAN trafficPrioritizationForQueueSetup;
     WdfSpinLockAcquire(deviceContext->GamingSettingsLock);
@@ -276,6 +688,8 @@ I219vEvtCreateTxQueue(
         // Например, создание нескольких физических очередей с разными приоритетами
     }
 
+    deviceContext->TxQueue = txQueue;
+
     *TxQueue = txQueue;
     return STATUS_SUCCESS;
 }
@@ -295,8 +709,9 @@ I219vEvtCreateRxQueue(
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_QUEUE, "Creating RX queue");
 
-    // Установка обработчика продвижения очереди
+    // Установка обработчиков продвижения очереди и включения уведомлений
     NetPacketQueueSetAdvanceHandler(Configuration, I219vEvtRxQueueAdvance, deviceContext);
+    NetPacketQueueSetNotificationEnabledHandler(Configuration, I219vEvtRxQueueSetNotificationEnabled, deviceContext);
 
     // Инициализация атрибутов очереди
     WDF_OBJECT_ATTRIBUTES_INIT(&rxQueueAttributes);
@@ -313,6 +728,21 @@ I219vEvtCreateRxQueue(
         return status;
     }
 
+    // Получение расширений фрагментов с виртуальным и логическим адресом буфера
+    NET_EXTENSION_QUERY extensionQuery;
+
+    NET_EXTENSION_QUERY_INIT(&extensionQuery,
+                             NET_FRAGMENT_EXTENSION_VIRTUAL_ADDRESS_NAME,
+                             NET_FRAGMENT_EXTENSION_VIRTUAL_ADDRESS_VERSION_1,
+                             NetExtensionTypeFragment);
+    NetRxQueueGetExtension(rxQueue, &extensionQuery, &deviceContext->RxVirtualAddressExtension);
+
+    NET_EXTENSION_QUERY_INIT(&extensionQuery,
+                             NET_FRAGMENT_EXTENSION_LOGICAL_ADDRESS_NAME,
+                             NET_FRAGMENT_EXTENSION_LOGICAL_ADDRESS_VERSION_1,
+                             NetExtensionTypeFragment);
+    NetRxQueueGetExtension(rxQueue, &extensionQuery, &deviceContext->RxLogicalAddressExtension);
+
     // Если включена приоритизация трафика, настраиваем очередь для поддержки приоритетов
     BOOLEAN trafficPrioritizationForQueueSetup;
     WdfSpinLockAcquire(deviceContext->GamingSettingsLock);
@@ -323,6 +753,566 @@ I219vEvtCreateRxQueue(
         // Например, создание нескольких физических очередей с разными приоритетами
     }
 
+    deviceContext->RxQueue = rxQueue;
+
     *RxQueue = rxQueue;
     return STATUS_SUCCESS;
 }
+
+// Включение/отключение уведомлений очереди приема
+// NetAdapterCx включает уведомление, когда очередь простаивает; только тогда
+// причина приема снова разрешается в IMS.
+VOID
+I219vEvtRxQueueSetNotificationEnabled(
+    _In_ NETPACKETQUEUE RxQueue,
+    _In_ BOOLEAN NotificationEnabled
+    )
+{
+    PI219V_DEVICE_CONTEXT deviceContext = I219vGetDeviceContext(NetPacketQueueGetDevice(RxQueue));
+
+    InterlockedExchange(&deviceContext->RxNotificationEnabled, NotificationEnabled ? 1 : 0);
+
+    // В режиме опроса очередь уведомляет таймер, причина остается замаскированной
+    if (NotificationEnabled) {
+        I219vStormUnmaskCauses(deviceContext, I219V_ICR_RX_CAUSES);
+    } else {
+        I219vWriteRegisterFast(deviceContext, IMC, I219V_ICR_RX_CAUSES);
+    }
+}
+
+// Включение/отключение уведомлений очереди передачи
+VOID
+I219vEvtTxQueueSetNotificationEnabled(
+    _In_ NETPACKETQUEUE TxQueue,
+    _In_ BOOLEAN NotificationEnabled
+    )
+{
+    PI219V_DEVICE_CONTEXT deviceContext = I219vGetDeviceContext(NetPacketQueueGetDevice(TxQueue));
+
+    InterlockedExchange(&deviceContext->TxNotificationEnabled, NotificationEnabled ? 1 : 0);
+
+    if (NotificationEnabled) {
+        I219vStormUnmaskCauses(deviceContext, I219V_ICR_TX_CAUSES);
+    } else {
+        I219vWriteRegisterFast(deviceContext, IMC, I219V_ICR_TX_CAUSES);
+    }
+}
+
+// Создание объекта прерывания и рабочего элемента обработки соединения
+// Вызывается из I219vEvtDeviceAdd.
+NTSTATUS
+I219vInitializeInterrupt(
+    _In_ WDFDEVICE Device
+    )
+{
+    NTSTATUS status;
+    PI219V_DEVICE_CONTEXT deviceContext = I219vGetDeviceContext(Device);
+    WDF_INTERRUPT_CONFIG interruptConfig;
+    WDF_WORKITEM_CONFIG workItemConfig;
+    WDF_DPC_CONFIG dpcConfig;
+    WDF_OBJECT_ATTRIBUTES attributes;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_QUEUE, "Initializing interrupt");
+
+    WDF_INTERRUPT_CONFIG_INIT(&interruptConfig, I219vEvtInterruptIsr, I219vEvtInterruptDpc);
+
+    status = WdfInterruptCreate(Device, &interruptConfig, WDF_NO_OBJECT_ATTRIBUTES, &deviceContext->Interrupt);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfInterruptCreate failed: %!STATUS!", status);
+        return status;
+    }
+
+    // Изменение состояния соединения обрабатывается на PASSIVE_LEVEL,
+    // чтобы медленная работа с PHY не задерживала обработку пакетов в DPC
+    WDF_WORKITEM_CONFIG_INIT(&workItemConfig, I219vEvtLinkWorkItem);
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Device;
+
+    status = WdfWorkItemCreate(&workItemConfig, &attributes, &deviceContext->LinkWorkItem);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfWorkItemCreate failed: %!STATUS!", status);
+        return status;
+    }
+
+    // Отдельный DPC для обработки причин на выбранном процессоре; DPC
+    // прерывания выполняется там, где пришло прерывание, и не перенацеливается
+    WDF_DPC_CONFIG_INIT(&dpcConfig, I219vEvtDatapathDpc);
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Device;
+
+    status = WdfDpcCreate(&dpcConfig, &attributes, &deviceContext->DatapathDpc);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfDpcCreate failed: %!STATUS!", status);
+        return status;
+    }
+
+    deviceContext->DpcTargetProcessor = I219V_PROCESSOR_AUTO;
+    RtlZeroMemory(&deviceContext->Affinity, sizeof(I219V_AFFINITY_INFO));
+    deviceContext->Affinity.Config.DatapathProcessor = I219V_PROCESSOR_AUTO;
+    deviceContext->Affinity.InterruptProcessor = I219V_PROCESSOR_AUTO;
+    deviceContext->Affinity.DpcProcessor = I219V_PROCESSOR_AUTO;
+
+    deviceContext->PendingInterruptCauses = 0;
+    deviceContext->RxNotificationEnabled = 0;
+    deviceContext->TxNotificationEnabled = 0;
+    deviceContext->RxIsrTimeUs = 0;
+    RtlZeroMemory(&deviceContext->InterruptStats, sizeof(I219V_INTERRUPT_STATS));
+
+    return STATUS_SUCCESS;
+}
+
+// Признак в PendingInterruptCauses: причины пути данных были замаскированы
+// автоматически, и DPC должен повторно разрешить не сработавшие из них
+#define I219V_PENDING_AUTO_MASKED   I219V_ICR_INT_ASSERTED
+
+// Обработчик прерывания
+// ICR читается один раз (чтение сбрасывает причины), обнаруженные причины
+// маскируются и передаются в DPC. Другой работы на DIRQL не выполняется.
+// При автомаскировании (CTRL_EXT.IAME) чтение ICR само маскирует причины
+// приема и передачи, и запись в IMC нужна только для причины соединения:
+// за прерывание выполняется одно чтение и не более одной записи.
+BOOLEAN
+I219vEvtInterruptIsr(
+    _In_ WDFINTERRUPT Interrupt,
+    _In_ ULONG MessageID
+    )
+{
+    PI219V_DEVICE_CONTEXT deviceContext = I219vGetDeviceContext(WdfInterruptGetDevice(Interrupt));
+    UINT64 isrCycles = I219V_LATENCY_TIMESTAMP();
+    UINT32 icr;
+    UINT32 causes;
+    UINT32 maskCauses;
+    UINT32 mmioAccesses = 1;
+    BOOLEAN autoMasked;
+
+    UNREFERENCED_PARAMETER(MessageID);
+
+    icr = I219vReadRegisterFast(deviceContext, ICR);
+    deviceContext->InterruptStats.IsrMmioReads++;
+
+    // Нулевое значение - прерывание другого устройства на общей линии,
+    // все единицы - устройство удалено
+    causes = (icr != 0xFFFFFFFF) ? (icr & I219V_ICR_HANDLED_CAUSES) : 0;
+    if (causes == 0) {
+        deviceContext->InterruptStats.SpuriousInterrupts++;
+        if (deviceContext->InterruptStats.IsrMaxMmioAccesses < mmioAccesses) {
+            deviceContext->InterruptStats.IsrMaxMmioAccesses = mmioAccesses;
+        }
+        return FALSE;
+    }
+
+    autoMasked = deviceContext->InterruptAutoMask && (icr & I219V_ICR_INT_ASSERTED) != 0;
+    maskCauses = autoMasked ? (causes & ~I219V_ICR_AUTO_MASK_CAUSES) : causes;
+
+    if (maskCauses != 0) {
+        I219vWriteRegisterFast(deviceContext, IMC, maskCauses);
+        deviceContext->InterruptStats.IsrMmioWrites++;
+        mmioAccesses++;
+    }
+
+    if (autoMasked) {
+        deviceContext->InterruptStats.AutoMaskedInterrupts++;
+        causes |= I219V_PENDING_AUTO_MASKED;
+    }
+
+    if (deviceContext->InterruptStats.IsrMaxMmioAccesses < mmioAccesses) {
+        deviceContext->InterruptStats.IsrMaxMmioAccesses = mmioAccesses;
+    }
+
+    if (causes & I219V_ICR_RX_CAUSES) {
+        // Сохраняется время первого необработанного прерывания приема
+        InterlockedCompareExchange64(&deviceContext->RxIsrTimeUs, (LONG64)I219vRttGetTimeUs(deviceContext), 0);
+        InterlockedCompareExchange64(&deviceContext->Latency.RxIsrCycles, (LONG64)isrCycles, 0);
+    }
+
+    InterlockedOr(&deviceContext->PendingInterruptCauses, (LONG)causes);
+    deviceContext->InterruptStats.Interrupts++;
+    deviceContext->Affinity.LastIsrProcessor = KeGetCurrentProcessorIndex();
+
+    // При заданном процессоре причины обрабатываются перенацеленным DPC
+    if (deviceContext->DpcTargetProcessor != I219V_PROCESSOR_AUTO) {
+        WdfDpcEnqueue(deviceContext->DatapathDpc);
+    } else {
+        WdfInterruptQueueDpcForIsr(Interrupt);
+    }
+
+    return TRUE;
+}
+
+// Учет процессора, на котором выполняется DPC
+static
+VOID
+I219vRecordDpcProcessor(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_AFFINITY_INFO affinity = &DeviceContext->Affinity;
+    ULONG processor = KeGetCurrentProcessorIndex();
+
+    affinity->LastDpcProcessor = processor;
+
+    if (processor < I219V_AFFINITY_MAX_PROCESSORS) {
+        affinity->DpcsPerProcessor[processor]++;
+
+        if (affinity->Config.BusyCoreMask & (1ULL << processor)) {
+            affinity->DpcsOnBusyCores++;
+        }
+    }
+}
+
+// Обработка причин прерывания на уровне DISPATCH_LEVEL
+// Причины обрабатываются раздельно: сначала прием и передача (сбор кадров и
+// возврат пакетов выполняются в продвижении очередей со своими бюджетами),
+// затем изменение соединения передается рабочему элементу.
+static
+VOID
+I219vProcessInterruptCauses(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    UINT64 dpcCycles = I219V_LATENCY_TIMESTAMP();
+    UINT32 causes;
+
+    causes = (UINT32)InterlockedExchange(&DeviceContext->PendingInterruptCauses, 0);
+    if (causes == 0) {
+        // Причины уже забраны другим DPC (например, при смене процессора)
+        return;
+    }
+
+    DeviceContext->InterruptStats.Dpcs++;
+    I219vRecordDpcProcessor(DeviceContext);
+
+    // Автомаскирование маскирует все причины из IAM, в том числе не
+    // сработавшие: причина очереди, ожидающей уведомления, разрешается снова
+    if ((causes & I219V_PENDING_AUTO_MASKED) && !DeviceContext->Storm.PollingActive) {
+        UINT32 rearmCauses = 0;
+
+        if ((causes & I219V_ICR_RX_CAUSES) == 0 && DeviceContext->RxNotificationEnabled) {
+            rearmCauses |= I219V_ICR_RX_CAUSES;
+        }
+        if ((causes & I219V_ICR_TX_CAUSES) == 0 && DeviceContext->TxNotificationEnabled) {
+            rearmCauses |= I219V_ICR_TX_CAUSES;
+        }
+        if (rearmCauses != 0) {
+            I219vStormUnmaskCauses(DeviceContext, rearmCauses);
+        }
+    }
+
+    // Защита от шторма прерываний: при превышении порога причины приема
+    // и передачи маскируются, и очереди обслуживает таймер опроса
+    I219vStormCheckInterruptRate(DeviceContext);
+
+    // Прием: уведомление очереди; причина снова разрешается, когда очередь
+    // обработает все кадры и включит уведомления
+    if (causes & I219V_ICR_RX_CAUSES) {
+        DeviceContext->InterruptStats.RxCauses++;
+        if (causes & I219V_IMS_SRPD) {
+            DeviceContext->InterruptStats.SmallPacketInterrupts++;
+        }
+        InterlockedCompareExchange64(&DeviceContext->Latency.RxDpcCycles, (LONG64)dpcCycles, 0);
+
+        if (InterlockedExchange(&DeviceContext->RxNotificationEnabled, 0) != 0) {
+            NetRxQueueNotifyMoreReceivedPacketsAvailable(DeviceContext->RxQueue);
+        }
+    }
+
+    // Передача: аналогично приему
+    if (causes & I219V_ICR_TX_CAUSES) {
+        DeviceContext->InterruptStats.TxCauses++;
+
+        if (InterlockedExchange(&DeviceContext->TxNotificationEnabled, 0) != 0) {
+            NetTxQueueNotifyMoreCompletedPacketsAvailable(DeviceContext->TxQueue);
+        }
+    }
+
+    // Изменение соединения: причина разрешается рабочим элементом после обработки
+    if (causes & I219V_ICR_LINK_CAUSES) {
+        DeviceContext->InterruptStats.LinkCauses++;
+        WdfWorkItemEnqueue(DeviceContext->LinkWorkItem);
+    }
+
+    // Завершение операции MDIC: причина разрешается при запуске следующей операции
+    if (causes & I219V_ICR_PHY_CAUSES) {
+        I219vServicePhyEngine(DeviceContext);
+    }
+}
+
+// DPC прерывания (процессор не задан)
+VOID
+I219vEvtInterruptDpc(
+    _In_ WDFINTERRUPT Interrupt,
+    _In_ WDFOBJECT AssociatedObject
+    )
+{
+    UNREFERENCED_PARAMETER(AssociatedObject);
+
+    I219vProcessInterruptCauses(I219vGetDeviceContext(WdfInterruptGetDevice(Interrupt)));
+}
+
+// DPC пути данных, перенацеленный на выбранный процессор
+VOID
+I219vEvtDatapathDpc(
+    _In_ WDFDPC Dpc
+    )
+{
+    I219vProcessInterruptCauses(I219vGetDeviceContext(WdfDpcGetParentObject(Dpc)));
+}
+
+// Рабочий элемент обработки изменения состояния соединения
+VOID
+I219vEvtLinkWorkItem(
+    _In_ WDFWORKITEM WorkItem
+    )
+{
+    PI219V_DEVICE_CONTEXT deviceContext = I219vGetDeviceContext(WdfWorkItemGetParentObject(WorkItem));
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_QUEUE, "Link status change");
+
+    // Регистры соединения PHY изменились: кэш заполнит следующий подробный запрос
+    I219vInvalidatePhyLinkCache(deviceContext);
+
+    I219vIndicateLinkState(deviceContext);
+
+    // Причина обработана - повторное разрешение прерывания LSC
+    I219vWriteRegister(deviceContext, I219V_REG_IMS, I219V_ICR_LINK_CAUSES);
+}
+
+// Получение статистики прерываний
+VOID
+I219vGetInterruptStats(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PI219V_INTERRUPT_STATS InterruptStats
+    )
+{
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    RtlCopyMemory(InterruptStats, &DeviceContext->InterruptStats, sizeof(I219V_INTERRUPT_STATS));
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Выбор процессора пути данных (только группа 0)
+// Явно заданный процессор имеет приоритет; иначе при непустой маске занятых
+// ядер выбирается старший активный процессор вне маски (младшие ядра обычно
+// заняты системой и потоками игры). Без настроек выбор остается за системой.
+static
+ULONG
+I219vSelectDatapathProcessor(
+    _In_ PI219V_AFFINITY_CONFIG AffinityConfig
+    )
+{
+    ULONG processorCount = KeQueryActiveProcessorCountEx(0);
+    ULONG processor;
+
+    if (processorCount > I219V_AFFINITY_MAX_PROCESSORS) {
+        processorCount = I219V_AFFINITY_MAX_PROCESSORS;
+    }
+
+    if (AffinityConfig->DatapathProcessor != I219V_PROCESSOR_AUTO) {
+        return AffinityConfig->DatapathProcessor;
+    }
+
+    if (AffinityConfig->BusyCoreMask == 0) {
+        return I219V_PROCESSOR_AUTO;
+    }
+
+    for (processor = processorCount; processor-- > 0; ) {
+        if ((AffinityConfig->BusyCoreMask & (1ULL << processor)) == 0) {
+            return processor;
+        }
+    }
+
+    // Все ядра отмечены занятыми - выбор остается за системой
+    return I219V_PROCESSOR_AUTO;
+}
+
+// Проверка настроек привязки
+static
+NTSTATUS
+I219vValidateAffinityConfig(
+    _In_ PI219V_AFFINITY_CONFIG AffinityConfig
+    )
+{
+    ULONG processorCount = KeQueryActiveProcessorCountEx(0);
+
+    if (AffinityConfig->DatapathProcessor != I219V_PROCESSOR_AUTO &&
+        (AffinityConfig->DatapathProcessor >= processorCount ||
+         AffinityConfig->DatapathProcessor >= I219V_AFFINITY_MAX_PROCESSORS)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "Invalid datapath processor: %u", AffinityConfig->DatapathProcessor);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+// Перенацеливание DPC пути данных
+// Пока DPC перенацеливается, причины обрабатывает DPC прерывания, поэтому
+// ISR не ставит в очередь объект, целевой процессор которого меняется.
+// Целевой процессор переключается под блокировкой прерывания: после ее
+// освобождения ISR уже не поставит DatapathDpc в очередь. Отмена может
+// снять DPC, чьи причины остались в PendingInterruptCauses; тогда их
+// забирает DPC прерывания, иначе RX/TX остались бы замаскированными.
+// Вызывается на PASSIVE_LEVEL.
+static
+NTSTATUS
+I219vRetargetDatapathDpc(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ ULONG Processor
+    )
+{
+    NTSTATUS status;
+    PROCESSOR_NUMBER processorNumber;
+
+    WdfInterruptAcquireLock(DeviceContext->Interrupt);
+    InterlockedExchange((volatile LONG*)&DeviceContext->DpcTargetProcessor, (LONG)I219V_PROCESSOR_AUTO);
+    WdfInterruptReleaseLock(DeviceContext->Interrupt);
+
+    WdfDpcCancel(DeviceContext->DatapathDpc, TRUE);
+
+    WdfInterruptAcquireLock(DeviceContext->Interrupt);
+    if (DeviceContext->PendingInterruptCauses != 0) {
+        WdfInterruptQueueDpcForIsr(DeviceContext->Interrupt);
+    }
+    WdfInterruptReleaseLock(DeviceContext->Interrupt);
+
+    if (Processor != I219V_PROCESSOR_AUTO) {
+        status = KeGetProcessorNumberFromIndex(Processor, &processorNumber);
+        if (!NT_SUCCESS(status)) {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "KeGetProcessorNumberFromIndex failed: %!STATUS!", status);
+            return status;
+        }
+
+        status = KeSetTargetProcessorDpcEx(WdfDpcWdmGetDpc(DeviceContext->DatapathDpc), &processorNumber);
+        if (!NT_SUCCESS(status)) {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "KeSetTargetProcessorDpcEx failed: %!STATUS!", status);
+            return status;
+        }
+
+        WdfInterruptAcquireLock(DeviceContext->Interrupt);
+        InterlockedExchange((volatile LONG*)&DeviceContext->DpcTargetProcessor, (LONG)Processor);
+        WdfInterruptReleaseLock(DeviceContext->Interrupt);
+    }
+
+    DeviceContext->Affinity.DpcProcessor = Processor;
+
+    return STATUS_SUCCESS;
+}
+
+// Загрузка привязки из ключевых слов INF и настройка политики прерывания
+// Вызывается из I219vEvtDeviceAdd после создания адаптера: политика
+// прерывания применяется при назначении ресурсов.
+NTSTATUS
+I219vLoadAffinityConfiguration(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    NTSTATUS status;
+    NETCONFIGURATION configuration;
+    ULONG value;
+    I219V_AFFINITY_CONFIG affinityConfig;
+    WDF_INTERRUPT_EXTENDED_POLICY policy;
+    ULONG processor;
+    DECLARE_CONST_UNICODE_STRING(datapathCpuKeyword, I219V_AFFINITY_KEYWORD_DATAPATH_CPU);
+    DECLARE_CONST_UNICODE_STRING(busyCoreMaskKeyword, I219V_AFFINITY_KEYWORD_BUSY_CORE_MASK);
+
+    affinityConfig.DatapathProcessor = I219V_PROCESSOR_AUTO;
+    affinityConfig.BusyCoreMask = 0;
+
+    status = NetAdapterOpenConfiguration(DeviceContext->NetAdapter, WDF_NO_OBJECT_ATTRIBUTES, &configuration);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "NetAdapterOpenConfiguration failed: %!STATUS!", status);
+        return status;
+    }
+
+    // DatapathCpu: 0 - автоматический выбор, N - процессор N-1
+    if (NT_SUCCESS(NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS,
+                                              &datapathCpuKeyword, &value)) && value != 0) {
+        affinityConfig.DatapathProcessor = value - 1;
+    }
+
+    if (NT_SUCCESS(NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS,
+                                              &busyCoreMaskKeyword, &value))) {
+        affinityConfig.BusyCoreMask = value;
+    }
+
+    NetConfigurationClose(configuration);
+
+    status = I219vValidateAffinityConfig(&affinityConfig);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    DeviceContext->Affinity.Config = affinityConfig;
+
+    processor = I219vSelectDatapathProcessor(&affinityConfig);
+    if (processor == I219V_PROCESSOR_AUTO) {
+        return STATUS_SUCCESS;
+    }
+
+    // Прерывание направляется на тот же процессор, что и DPC, чтобы
+    // обработка причин не требовала межпроцессорного вызова
+    WDF_INTERRUPT_EXTENDED_POLICY_INIT(&policy);
+    policy.Policy = WdfIrqPolicySpecifiedProcessors;
+    policy.Priority = WdfIrqPriorityHigh;
+    policy.TargetProcessorSetAndGroup.Mask = (KAFFINITY)1 << processor;
+    policy.TargetProcessorSetAndGroup.Group = 0;
+
+    WdfInterruptSetExtendedPolicy(DeviceContext->Interrupt, &policy);
+    DeviceContext->Affinity.InterruptProcessor = processor;
+
+    status = I219vRetargetDatapathDpc(DeviceContext, processor);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_QUEUE,
+              "Datapath affinity: processor %u, busy core mask 0x%I64x",
+              processor, affinityConfig.BusyCoreMask);
+
+    return STATUS_SUCCESS;
+}
+
+// Изменение привязки DPC во время работы (IOCTL, PASSIVE_LEVEL)
+// Перенацеливается только DPC; процессор линии прерывания закрепляется при
+// назначении ресурсов и меняется ключевыми словами INF при перезапуске устройства.
+NTSTATUS
+I219vSetAffinityConfig(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ PI219V_AFFINITY_CONFIG AffinityConfig
+    )
+{
+    NTSTATUS status;
+    ULONG processor;
+
+    if (KeGetCurrentIrql() != PASSIVE_LEVEL) {
+        return STATUS_INVALID_DEVICE_STATE;
+    }
+
+    status = I219vValidateAffinityConfig(AffinityConfig);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    processor = I219vSelectDatapathProcessor(AffinityConfig);
+
+    status = I219vRetargetDatapathDpc(DeviceContext, processor);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    DeviceContext->Affinity.Config = *AffinityConfig;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_QUEUE,
+              "Datapath DPC affinity changed: processor %u, busy core mask 0x%I64x",
+              processor, AffinityConfig->BusyCoreMask);
+
+    return STATUS_SUCCESS;
+}
+
+// Получение привязки и распределения DPC по процессорам
+VOID
+I219vGetAffinityInfo(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PI219V_AFFINITY_INFO AffinityInfo
+    )
+{
+    RtlCopyMemory(AffinityInfo, &DeviceContext->Affinity, sizeof(I219V_AFFINITY_INFO));
+}
@@ -27,14 +27,65 @@ Environment:
 #define I219V_RX_RING_SIZE 256
 #define I219V_TX_RING_SIZE 256
 
+// Бюджеты обработки за один вызов продвижения очереди
+#define I219V_RX_HARVEST_BUDGET     64      // Принятых кадров
+#define I219V_TX_RECLAIM_BUDGET     128     // Завершенных пакетов передачи
+
+// Статистика прерываний
+typedef struct _I219V_INTERRUPT_STATS {
+    UINT64 Interrupts;                              // Обработанные прерывания
+    UINT64 SpuriousInterrupts;                      // Прерывания без причины (общая линия)
+    UINT64 Dpcs;                                    // Выполненные DPC
+    UINT64 RxCauses;                                // Прерывания с причиной приема
+    UINT64 TxCauses;                                // Прерывания с причиной передачи
+    UINT64 LinkCauses;                              // Прерывания с причиной изменения соединения
+    UINT64 SmallPacketInterrupts;                   // Немедленные прерывания по мелкому пакету (SRPD)
+    UINT64 RxBudgetExhausted;                       // Вызовы приема, исчерпавшие бюджет
+    UINT64 TxBudgetExhausted;                       // Вызовы передачи, исчерпавшие бюджет
+    UINT64 AutoMaskedInterrupts;                    // Прерывания, замаскированные автоматически (без записи IMC)
+    UINT64 IsrMmioReads;                            // Чтения регистров в ISR
+    UINT64 IsrMmioWrites;                           // Записи регистров в ISR
+    UINT32 IsrMaxMmioAccesses;                      // Наибольшее число обращений к регистрам за одно прерывание
+} I219V_INTERRUPT_STATS, *PI219V_INTERRUPT_STATS;
+
+// Привязка прерывания и DPC к процессорам (группа 0)
+#define I219V_AFFINITY_MAX_PROCESSORS   64
+#define I219V_PROCESSOR_AUTO            0xFFFFFFFF  // Процессор выбирается системой
+
+// Настройки привязки пути данных к процессорам
+typedef struct _I219V_AFFINITY_CONFIG {
+    ULONG DatapathProcessor;                        // Процессор прерывания и DPC (I219V_PROCESSOR_AUTO - автоматически)
+    ULONG64 BusyCoreMask;                           // Занятые ядра (например, поток отрисовки игры), DPC их избегает
+} I219V_AFFINITY_CONFIG, *PI219V_AFFINITY_CONFIG;
+
+// Текущая привязка и фактическое размещение DPC
+typedef struct _I219V_AFFINITY_INFO {
+    I219V_AFFINITY_CONFIG Config;                   // Настройки
+    ULONG InterruptProcessor;                       // Процессор, заданный политике прерывания при запуске
+    ULONG DpcProcessor;                             // Текущий целевой процессор DPC
+    ULONG LastIsrProcessor;                         // Процессор последнего ISR
+    ULONG LastDpcProcessor;                         // Процессор последнего DPC
+    UINT64 DpcsOnBusyCores;                         // DPC, выполненные на занятых ядрах
+    UINT64 DpcsPerProcessor[I219V_AFFINITY_MAX_PROCESSORS]; // Количество DPC по процессорам
+} I219V_AFFINITY_INFO, *PI219V_AFFINITY_INFO;
+
 // Объявление обработчиков очередей
 EVT_PACKET_QUEUE_ADVANCE I219vEvtRxQueueAdvance;
 EVT_PACKET_QUEUE_ADVANCE I219vEvtTxQueueAdvance;
+EVT_PACKET_QUEUE_SET_NOTIFICATION_ENABLED I219vEvtRxQueueSetNotificationEnabled;
+EVT_PACKET_QUEUE_SET_NOTIFICATION_ENABLED I219vEvtTxQueueSetNotificationEnabled;
 
 // Объявление обработчиков прерываний
 EVT_WDF_INTERRUPT_ISR I219vEvtInterruptIsr;
 EVT_WDF_INTERRUPT_DPC I219vEvtInterruptDpc;
+EVT_WDF_WORKITEM I219vEvtLinkWorkItem;
+EVT_WDF_DPC I219vEvtDatapathDpc;
 
 // Объявление вспомогательных функций
 NTSTATUS I219vInitializeInterrupt(_In_ WDFDEVICE Device);
+VOID I219vGetInterruptStats(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_INTERRUPT_STATS InterruptStats);
+NTSTATUS I219vLoadAffinityConfiguration(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+NTSTATUS I219vSetAffinityConfig(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ PI219V_AFFINITY_CONFIG AffinityConfig);
+VOID I219vGetAffinityInfo(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_AFFINITY_INFO AffinityInfo);
 NTSTATUS I219vInitializeQueues(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vTxAdvanceRings(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Inout_ NET_RING* PacketRing, _Inout_ NET_RING* FragmentRing);
@@ -0,0 +1,357 @@
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_flow.c
+
+Abstract:
+
+    Реализация трекера "тяжелых" потоков для драйвера Intel i219-v.
+    Использует алгоритм Space-Saving с весом в байтах: таблица фиксированного
+    размера хранит самые объемные потоки, при переполнении вытесняется запись
+    с минимальным счетчиком. Потоки классов HIGH/HIGHEST, превысившие порог
+    скорости, автоматически переводятся в низкий приоритет.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+#include "Driver.h"
+#include "Device.h"
+#include "i219v_gaming.h"
+#include "i219v_flow.h"
+#include "DeviceContext.h"
+#include "Trace.h"
+
+// Формирование ключа потока из разобранных заголовков
+static
+VOID
+I219vBuildFlowKey(
+    _In_ PI219V_PACKET_METADATA Metadata,
+    _Out_ PI219V_FLOW_KEY Key
+    )
+{
+    PUCHAR ipHeader = Metadata->HeaderBuffer + Metadata->Headers.L3Offset;
+
+    RtlZeroMemory(Key, sizeof(I219V_FLOW_KEY));
+    Key->IpVersion = Metadata->Headers.IpVersion;
+    Key->Protocol = Metadata->Headers.Protocol;
+    Key->SourcePort = Metadata->Headers.SourcePort;
+    Key->DestinationPort = Metadata->Headers.DestinationPort;
+
+    if (Key->IpVersion == 4) {
+        RtlCopyMemory(Key->SourceAddress, ipHeader + 12, 4);
+        RtlCopyMemory(Key->DestinationAddress, ipHeader + 16, 4);
+    } else {
+        RtlCopyMemory(Key->SourceAddress, ipHeader + 8, 16);
+        RtlCopyMemory(Key->DestinationAddress, ipHeader + 24, 16);
+    }
+}
+
+// Хеш ключа потока (FNV-1a)
+static
+UINT32
+I219vHashFlowKey(
+    _In_ PI219V_FLOW_KEY Key
+    )
+{
+    const UCHAR* bytes = (const UCHAR*)Key;
+    UINT32 hash = 2166136261u;
+
+    for (UINT32 i = 0; i < sizeof(I219V_FLOW_KEY); i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// Удаление записи из цепочки корзины
+static
+VOID
+I219vFlowUnlink(
+    _Inout_ PI219V_FLOW_TRACKER Tracker,
+    _In_ UCHAR Index
+    )
+{
+    PUCHAR link = &Tracker->Buckets[Tracker->Entries[Index].Hash % I219V_FLOW_HASH_BUCKETS];
+
+    while (*link != I219V_FLOW_INVALID_INDEX) {
+        if (*link == Index) {
+            *link = Tracker->Entries[Index].NextInBucket;
+            return;
+        }
+        link = &Tracker->Entries[*link].NextInBucket;
+    }
+}
+
+// Поиск записи потока по ключу
+static
+PI219V_FLOW_ENTRY
+I219vFlowLookup(
+    _In_ PI219V_FLOW_TRACKER Tracker,
+    _In_ PI219V_FLOW_KEY Key,
+    _In_ UINT32 Hash
+    )
+{
+    UCHAR index = Tracker->Buckets[Hash % I219V_FLOW_HASH_BUCKETS];
+
+    while (index != I219V_FLOW_INVALID_INDEX) {
+        PI219V_FLOW_ENTRY entry = &Tracker->Entries[index];
+
+        if (entry->Hash == Hash && RtlEqualMemory(&entry->Key, Key, sizeof(I219V_FLOW_KEY))) {
+            return entry;
+        }
+        index = entry->NextInBucket;
+    }
+
+    return NULL;
+}
+
+// Инициализация трекера потоков
+VOID
+I219vInitializeFlowTracker(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_FLOW_TRACKER tracker = &DeviceContext->FlowTracker;
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+
+    RtlZeroMemory(tracker, sizeof(I219V_FLOW_TRACKER));
+    RtlFillMemory(tracker->Buckets, sizeof(tracker->Buckets), I219V_FLOW_INVALID_INDEX);
+    tracker->Config.EnableAutoDemotion = TRUE;
+    tracker->Config.DemotionThresholdKbps = I219V_FLOW_DEFAULT_DEMOTION_KBPS;
+
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Установка настроек трекера потоков
+NTSTATUS
+I219vSetFlowTrackerConfig(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ PI219V_FLOW_TRACKER_CONFIG Config
+    )
+{
+    PI219V_FLOW_TRACKER tracker = &DeviceContext->FlowTracker;
+
+    if (Config->EnableAutoDemotion && Config->DemotionThresholdKbps == 0) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+
+    tracker->Config = *Config;
+
+    // При отключении понижения все потоки возвращаются к исходному приоритету
+    if (!Config->EnableAutoDemotion) {
+        for (UINT32 i = 0; i < I219V_FLOW_TABLE_SIZE; i++) {
+            tracker->Entries[i].Demoted = FALSE;
+        }
+        tracker->Stats.DemotedFlows = 0;
+    }
+
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
+              "Flow tracker configured: AutoDemotion=%d, Threshold=%u Kbps",
+              Config->EnableAutoDemotion, Config->DemotionThresholdKbps);
+
+    return STATUS_SUCCESS;
+}
+
+// Получение самых объемных потоков
+VOID
+I219vGetTopFlows(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PI219V_TOP_FLOWS TopFlows
+    )
+{
+    PI219V_FLOW_TRACKER tracker = &DeviceContext->FlowTracker;
+    BOOLEAN selected[I219V_FLOW_TABLE_SIZE] = { 0 };
+
+    RtlZeroMemory(TopFlows, sizeof(I219V_TOP_FLOWS));
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+
+    TopFlows->Stats = tracker->Stats;
+
+    // Частичная сортировка выбором: N проходов по таблице
+    while (TopFlows->Count < I219V_FLOW_TOP_N) {
+        UINT32 best = I219V_FLOW_TABLE_SIZE;
+        PI219V_FLOW_ENTRY entry;
+        PI219V_FLOW_REPORT report;
+
+        for (UINT32 i = 0; i < I219V_FLOW_TABLE_SIZE; i++) {
+            if (tracker->Entries[i].InUse && !selected[i] &&
+                (best == I219V_FLOW_TABLE_SIZE || tracker->Entries[i].Bytes > tracker->Entries[best].Bytes)) {
+                best = i;
+            }
+        }
+
+        if (best == I219V_FLOW_TABLE_SIZE) {
+            break;
+        }
+
+        selected[best] = TRUE;
+        entry = &tracker->Entries[best];
+        report = &TopFlows->Flows[TopFlows->Count++];
+
+        report->Key = entry->Key;
+        report->Bytes = entry->Bytes;
+        report->Error = entry->Error;
+        report->Packets = entry->Packets;
+        report->RateKbps = entry->RateKbps;
+        report->Class = entry->Class;
+        report->Priority = entry->Priority;
+        report->Demoted = entry->Demoted;
+        report->RttSamples = entry->RttSamples;
+        report->AverageRttUs = entry->AverageRttUs;
+        report->MinRttUs = entry->MinRttUs;
+        report->PeakRttUs = entry->PeakRttUs;
+    }
+
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Поиск отслеживаемого потока передачи, ответом на который является принятый пакет
+// (ключ принятого пакета с переставленными адресами и портами)
+PI219V_FLOW_ENTRY
+I219vFlowTrackerFindReverse(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ PI219V_PACKET_METADATA Metadata
+    )
+{
+    I219V_FLOW_KEY key;
+    I219V_FLOW_KEY reverseKey;
+
+    if (!Metadata->HeadersValid) {
+        return NULL;
+    }
+
+    I219vBuildFlowKey(Metadata, &key);
+
+    RtlZeroMemory(&reverseKey, sizeof(I219V_FLOW_KEY));
+    RtlCopyMemory(reverseKey.SourceAddress, key.DestinationAddress, sizeof(reverseKey.SourceAddress));
+    RtlCopyMemory(reverseKey.DestinationAddress, key.SourceAddress, sizeof(reverseKey.DestinationAddress));
+    reverseKey.SourcePort = key.DestinationPort;
+    reverseKey.DestinationPort = key.SourcePort;
+    reverseKey.Protocol = key.Protocol;
+    reverseKey.IpVersion = key.IpVersion;
+
+    return I219vFlowLookup(&DeviceContext->FlowTracker, &reverseKey, I219vHashFlowKey(&reverseKey));
+}
+
+// Учет пакета в трекере потоков
+// Вызывается из пути передачи под GamingSettingsLock после классификации.
+// Возвращает запись потока (указатель действителен до выхода из обработчика
+// передачи) и понижает приоритет пакета, если поток помечен как объемный.
+PI219V_FLOW_ENTRY
+I219vFlowTrackerUpdate(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Inout_ PI219V_PACKET_METADATA Metadata,
+    _In_ UINT64 Now
+    )
+{
+    PI219V_FLOW_TRACKER tracker = &DeviceContext->FlowTracker;
+    PI219V_FLOW_ENTRY entry;
+    I219V_FLOW_KEY key;
+    UINT32 hash;
+
+    if (!Metadata->HeadersValid) {
+        return NULL;
+    }
+
+    I219vBuildFlowKey(Metadata, &key);
+    hash = I219vHashFlowKey(&key);
+
+    entry = I219vFlowLookup(tracker, &key, hash);
+    if (entry == NULL) {
+        UINT64 minBytes = MAXUINT64;
+        UCHAR victim = 0;
+
+        // Свободная запись или запись с минимальным счетчиком (Space-Saving)
+        for (UCHAR i = 0; i < I219V_FLOW_TABLE_SIZE; i++) {
+            if (!tracker->Entries[i].InUse) {
+                victim = i;
+                minBytes = 0;
+                break;
+            }
+            if (tracker->Entries[i].Bytes < minBytes) {
+                minBytes = tracker->Entries[i].Bytes;
+                victim = i;
+            }
+        }
+
+        entry = &tracker->Entries[victim];
+        if (entry->InUse) {
+            I219vFlowUnlink(tracker, victim);
+            if (entry->Demoted) {
+                tracker->Stats.DemotedFlows--;
+            }
+            tracker->Stats.Evictions++;
+        } else {
+            tracker->Stats.TrackedFlows++;
+        }
+
+        // Новый поток наследует счетчик вытесненного как верхнюю границу погрешности
+        RtlZeroMemory(entry, sizeof(I219V_FLOW_ENTRY));
+        entry->Key = key;
+        entry->Hash = hash;
+        entry->InUse = TRUE;
+        entry->Bytes = minBytes;
+        entry->Error = minBytes;
+        entry->WindowStartTime = Now;
+        entry->NextInBucket = tracker->Buckets[hash % I219V_FLOW_HASH_BUCKETS];
+        tracker->Buckets[hash % I219V_FLOW_HASH_BUCKETS] = victim;
+    }
+
+    entry->Class = Metadata->Class;
+    entry->Priority = Metadata->Priority;
+    entry->Bytes += Metadata->FrameLength;
+    entry->Packets++;
+    entry->WindowBytes += Metadata->FrameLength;
+
+    // Решение о понижении принимается по завершении окна измерения
+    if (Now - entry->WindowStartTime >= I219V_FLOW_RATE_WINDOW) {
+        UINT64 rateKbps = (entry->WindowBytes * 8 * 10000) / (Now - entry->WindowStartTime);
+
+        entry->RateKbps = (UINT32)min(rateKbps, MAXUINT32);
+        entry->WindowBytes = 0;
+        entry->WindowStartTime = Now;
+
+        if (tracker->Config.EnableAutoDemotion) {
+            if (!entry->Demoted &&
+                entry->Priority <= I219V_TRAFFIC_PRIORITY_HIGH &&
+                entry->RateKbps > tracker->Config.DemotionThresholdKbps) {
+                entry->Demoted = TRUE;
+                tracker->Stats.DemotedFlows++;
+                tracker->Stats.DemotionEvents++;
+                TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_QUEUE,
+                          "Flow %u->%u demoted: %u Kbps exceeds %u Kbps",
+                          entry->Key.SourcePort, entry->Key.DestinationPort,
+                          entry->RateKbps, tracker->Config.DemotionThresholdKbps);
+            } else if (entry->Demoted &&
+                       entry->RateKbps < tracker->Config.DemotionThresholdKbps / 2) {
+                // Гистерезис: приоритет восстанавливается при падении ниже половины порога
+                entry->Demoted = FALSE;
+                tracker->Stats.DemotedFlows--;
+                tracker->Stats.RestoreEvents++;
+            }
+        }
+    }
+
+    if (entry->Demoted) {
+        (VOID)I219vSetPacketPriority(DeviceContext, Metadata, I219V_TRAFFIC_PRIORITY_LOW);
+    }
+
+    Metadata->FlowEntry = entry;
+    return entry;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_flow.h
+
+Abstract:
+
+    Заголовочный файл для модуля отслеживания потоков Intel i219-v.
+    Содержит объявления структур и функций трекера "тяжелых" потоков
+    (алгоритм Space-Saving) с автоматическим понижением приоритета
+    объемных потоков, ошибочно попавших в высокий класс.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+#include "i219v_gaming.h"
+
+// Количество отслеживаемых потоков (ограничивает объем памяти трекера)
+#define I219V_FLOW_TABLE_SIZE           64
+#define I219V_FLOW_HASH_BUCKETS         128
+#define I219V_FLOW_INVALID_INDEX        0xFF
+
+// Максимальное количество потоков в отчете IOCTL
+#define I219V_FLOW_TOP_N                16
+
+// Окно измерения скорости потока (единицы KeQueryInterruptTime - 100 нс)
+#define I219V_FLOW_RATE_WINDOW          (100 * 10000)      // 100 мс
+
+// Порог понижения приоритета по умолчанию
+#define I219V_FLOW_DEFAULT_DEMOTION_KBPS    20000           // 20 Мбит/с
+
+// Ключ потока (5-tuple)
+typedef struct _I219V_FLOW_KEY {
+    UCHAR SourceAddress[16];                        // Адрес источника (IPv4 - первые 4 байта)
+    UCHAR DestinationAddress[16];                   // Адрес назначения (IPv4 - первые 4 байта)
+    UINT16 SourcePort;                              // Порт источника
+    UINT16 DestinationPort;                         // Порт назначения
+    UCHAR Protocol;                                 // Протокол L4
+    UCHAR IpVersion;                                // 4 или 6
+    UINT16 Reserved;
+} I219V_FLOW_KEY, *PI219V_FLOW_KEY;
+
+// Запись отслеживаемого потока
+typedef struct _I219V_FLOW_ENTRY {
+    I219V_FLOW_KEY Key;                             // Ключ потока
+    UINT32 Hash;                                    // Хеш ключа
+    BOOLEAN InUse;                                  // Запись занята
+    BOOLEAN Demoted;                                // Приоритет потока понижен
+    UCHAR NextInBucket;                             // Следующая запись в цепочке корзины
+    I219V_TRAFFIC_CLASS Class;                      // Класс, определенный классификатором
+    I219V_TRAFFIC_PRIORITY_LEVEL Priority;          // Приоритет, определенный классификатором
+    UINT64 Bytes;                                   // Оценка объема в байтах (счетчик Space-Saving)
+    UINT64 Error;                                   // Максимальная погрешность оценки
+    UINT64 Packets;                                 // Пакеты с момента появления записи
+    UINT64 WindowStartTime;                         // Начало текущего окна измерения скорости
+    UINT64 WindowBytes;                             // Байты в текущем окне
+    UINT32 RateKbps;                                // Скорость за последнее полное окно
+
+    // Пассивное измерение RTT (см. i219v_rtt.c)
+    BOOLEAN RttPending;                             // Ожидается ответ на замеряемый пакет
+    UINT32 RttPendingSeqEnd;                        // TCP: подтверждение, завершающее замер
+    UINT64 RttPendingTimeUs;                        // Время отправки замеряемого пакета
+    UINT64 RttReverseTimeUs;                        // UDP: время последнего пакета встречного направления
+    UINT32 RttSamples;                              // Количество замеров потока
+    UINT32 LastRttUs;                               // Последний замер
+    UINT32 AverageRttUs;                            // Скользящее среднее
+    UINT32 MinRttUs;                                // Минимальный замер
+    UINT32 PeakRttUs;                               // Максимальный замер
+} I219V_FLOW_ENTRY, *PI219V_FLOW_ENTRY;
+
+// Настройки трекера потоков
+typedef struct _I219V_FLOW_TRACKER_CONFIG {
+    BOOLEAN EnableAutoDemotion;                     // Автоматическое понижение объемных потоков
+    UINT32 DemotionThresholdKbps;                   // Порог скорости для потоков HIGH/HIGHEST
+} I219V_FLOW_TRACKER_CONFIG, *PI219V_FLOW_TRACKER_CONFIG;
+
+// Статистика трекера потоков
+typedef struct _I219V_FLOW_TRACKER_STATS {
+    UINT32 TrackedFlows;                            // Занятые записи
+    UINT32 DemotedFlows;                            // Потоки с пониженным приоритетом
+    UINT64 Evictions;                               // Вытеснения записей
+    UINT64 DemotionEvents;                          // Случаи понижения приоритета
+    UINT64 RestoreEvents;                           // Случаи восстановления приоритета
+} I219V_FLOW_TRACKER_STATS, *PI219V_FLOW_TRACKER_STATS;
+
+// Состояние трекера потоков
+typedef struct _I219V_FLOW_TRACKER {
+    I219V_FLOW_TRACKER_CONFIG Config;
+    I219V_FLOW_TRACKER_STATS Stats;
+    I219V_FLOW_ENTRY Entries[I219V_FLOW_TABLE_SIZE];
+    UCHAR Buckets[I219V_FLOW_HASH_BUCKETS];         // Первая запись цепочки каждой корзины
+} I219V_FLOW_TRACKER, *PI219V_FLOW_TRACKER;
+
+// Запись отчета о потоке
+typedef struct _I219V_FLOW_REPORT {
+    I219V_FLOW_KEY Key;
+    UINT64 Bytes;
+    UINT64 Error;
+    UINT64 Packets;
+    UINT32 RateKbps;
+    I219V_TRAFFIC_CLASS Class;
+    I219V_TRAFFIC_PRIORITY_LEVEL Priority;
+    BOOLEAN Demoted;
+    UINT32 RttSamples;                              // Количество замеров RTT
+    UINT32 AverageRttUs;                            // Среднее RTT (мкс)
+    UINT32 MinRttUs;                                // Минимальное RTT (мкс)
+    UINT32 PeakRttUs;                               // Максимальное RTT (мкс)
+} I219V_FLOW_REPORT, *PI219V_FLOW_REPORT;
+
+// Отчет о самых объемных потоках (IOCTL_I219V_GET_TOP_FLOWS)
+typedef struct _I219V_TOP_FLOWS {
+    UINT32 Count;                                   // Количество заполненных записей
+    I219V_FLOW_TRACKER_STATS Stats;
+    I219V_FLOW_REPORT Flows[I219V_FLOW_TOP_N];      // Потоки по убыванию объема
+} I219V_TOP_FLOWS, *PI219V_TOP_FLOWS;
+
+// Объявление функций трекера потоков
+VOID I219vInitializeFlowTracker(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+NTSTATUS I219vSetFlowTrackerConfig(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ PI219V_FLOW_TRACKER_CONFIG Config);
+VOID I219vGetTopFlows(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_TOP_FLOWS TopFlows);
+
+// Учет пакета в пути передачи (вызывается под GamingSettingsLock)
+PI219V_FLOW_ENTRY I219vFlowTrackerFindReverse(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ PI219V_PACKET_METADATA Metadata);
+PI219V_FLOW_ENTRY I219vFlowTrackerUpdate(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Inout_ PI219V_PACKET_METADATA Metadata, _In_ UINT64 Now);
@@ -21,12 +21,23 @@ Environment:
 #include <ntddk.h>
 #include <wdf.h>
 #include <netadaptercx.h>
+#include <initguid.h>
+#if defined(_M_AMD64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define I219V_CLASSIFY_SSE2 1
+#endif
 #include "Driver.h"
 #include "Device.h"
 #include "Adapter.h"
 #include "i219v_hw.h"
 #include "i219v_hw_extended.h"
 #include "i219v_gaming.h"
+#include "i219v_qos.h"
+#include "i219v_flow.h"
+#include "i219v_rtt.h"
+#include "i219v_moderation.h"
+#include "i219v_mmio.h"
+#include "i219v_phy.h"
 #include "DeviceContext.h"
 #include "Trace.h"
 
@@ -120,7 +131,94 @@ I219vInitializeGamingFeatures(
     return status;
 }
 
+// Этапы применения игровых настроек к регистрам
+// Изменения собираются в транзакцию: при применении профиля целиком
+// повторные изменения одних и тех же регистров сливаются в одну запись.
+// Каждый регистр задает один этап, учитывающий все влияющие на него
+// настройки: конфликт двух этапов отменяет транзакцию.
+
+// Приоритизация трафика и контроль пропускной способности: биты QoS в
+// TXCW/RXCW и регистр приоритетов (приоритизация включает и поддержку QoS)
+static
+VOID
+I219vStageQosControl(
+    _Inout_ PI219V_REGISTER_TRANSACTION Transaction,
+    _In_ BOOLEAN TrafficPrioritization,
+    _In_ BOOLEAN BandwidthControl
+    )
+{
+    if (TrafficPrioritization) {
+        I219vTransactionModify(Transaction, I219V_REG_TXCW, 0, I219V_TXCW_QOS_ENABLE);
+        I219vTransactionModify(Transaction, I219V_REG_RXCW, 0, I219V_RXCW_QOS_ENABLE);
+        I219vTransactionWrite(Transaction, I219V_REG_TQAVCC, I219V_TQAVCC_GAMING_PRIORITY);
+    } else {
+        I219vTransactionModify(Transaction, I219V_REG_TXCW, I219V_TXCW_QOS_ENABLE, 0);
+        I219vTransactionModify(Transaction, I219V_REG_RXCW, I219V_RXCW_QOS_ENABLE, 0);
+        I219vTransactionWrite(Transaction, I219V_REG_TQAVCC, BandwidthControl ? I219V_TQAVCC_QOS_ENABLE : 0);
+    }
+}
+
+// Порог предвыборки дескрипторов: минимальный при снижении задержки,
+// низкий при настройке буферов для игр, иначе порог по умолчанию
+static
+VOID
+I219vStageDescriptorThresholds(
+    _Inout_ PI219V_REGISTER_TRANSACTION Transaction,
+    _In_ BOOLEAN LatencyReduction,
+    _In_ BOOLEAN GamingBuffers
+    )
+{
+    UINT32 pthresh = LatencyReduction ? 1 : (GamingBuffers ? 2 : 8);
+
+    I219vTransactionModify(Transaction, I219V_REG_RXDCTL,
+                           I219V_RXDCTL_PTHRESH_MASK, pthresh << I219V_RXDCTL_PTHRESH_SHIFT);
+    I219vTransactionModify(Transaction, I219V_REG_TXDCTL,
+                           I219V_TXDCTL_PTHRESH_MASK, pthresh << I219V_TXDCTL_PTHRESH_SHIFT);
+}
+
+// Управление энергопотреблением: биты EEE и ASPM в CTRL
+static
+VOID
+I219vStageSmartPowerManagement(
+    _Inout_ PI219V_REGISTER_TRANSACTION Transaction,
+    _In_ BOOLEAN Enable
+    )
+{
+    if (Enable) {
+        I219vTransactionModify(Transaction, I219V_REG_CTRL, 0, I219V_CTRL_EEE_ENABLE | I219V_CTRL_ASPM_ENABLE);
+    } else {
+        I219vTransactionModify(Transaction, I219V_REG_CTRL, I219V_CTRL_EEE_ENABLE | I219V_CTRL_ASPM_ENABLE, 0);
+    }
+}
+
+// Проверка параметров профиля до обращения к устройству
+static
+NTSTATUS
+I219vValidateGamingProfile(
+    _In_ PI219V_GAMING_PROFILE GamingProfile
+    )
+{
+    PI219V_DELAY_TIMERS timers = &GamingProfile->DelayTimers;
+
+    if (timers->RxDelayUs > I219V_DELAY_TIMER_MAX_US || timers->RxAbsoluteDelayUs > I219V_DELAY_TIMER_MAX_US ||
+        timers->TxDelayUs > I219V_DELAY_TIMER_MAX_US || timers->TxAbsoluteDelayUs > I219V_DELAY_TIMER_MAX_US) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (GamingProfile->SmallPacketThreshold > I219V_SMALL_PACKET_DETECT_MAX) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    return STATUS_SUCCESS;
+}
+
 // Применение игрового профиля
+// Параметры проверяются заранее, все изменения регистров профиля (QoS,
+// пороги дескрипторов, энергопотребление, ITR, таймеры задержки и RSRPD)
+// собираются в одну транзакцию: при ошибке сбора или фиксации устройство,
+// сохраненный профиль и состояние модерации не меняются. До инициализации
+// оборудования (EvtDeviceAdd) область регистров не отображена: профиль
+// только сохраняется, регистры записываются при входе в D0.
 NTSTATUS
 I219vApplyGamingProfile(
     _In_ PI219V_DEVICE_CONTEXT DeviceContext,
@@ -128,6 +226,10 @@ I219vApplyGamingProfile(
     )
 {
     NTSTATUS status = STATUS_SUCCESS;
+    I219V_REGISTER_TRANSACTION transaction;
+    I219V_GAMING_PROFILE previousProfile;
+    I219V_DELAY_TIMERS delayTimers = GamingProfile->DelayTimers;
+    BOOLEAN previousFlags[4];
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, 
               "Applying gaming profile: Type=%d, TrafficPrioritization=%d, LatencyReduction=%d, BandwidthControl=%d",
@@ -136,68 +238,84 @@ I219vApplyGamingProfile(
               GamingProfile->EnableLatencyReduction,
               GamingProfile->EnableBandwidthControl);
 
-    // Сохранение профиля в контексте устройства
+    status = I219vValidateGamingProfile(GamingProfile);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Invalid gaming profile, status %!STATUS!", status);
+        return status;
+    }
+
+    // Сохранение профиля и флагов в контексте устройства (прежние значения
+    // восстанавливаются, если транзакция не будет зафиксирована)
     WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    RtlCopyMemory(&previousProfile, &DeviceContext->GamingProfile, sizeof(I219V_GAMING_PROFILE));
+    previousFlags[0] = DeviceContext->TrafficPrioritizationEnabled;
+    previousFlags[1] = DeviceContext->LatencyReductionEnabled;
+    previousFlags[2] = DeviceContext->BandwidthControlEnabled;
+    previousFlags[3] = DeviceContext->SmartPowerManagementEnabled;
     RtlCopyMemory(&DeviceContext->GamingProfile, GamingProfile, sizeof(I219V_GAMING_PROFILE));
+    DeviceContext->TrafficPrioritizationEnabled = GamingProfile->EnableTrafficPrioritization;
+    DeviceContext->LatencyReductionEnabled = GamingProfile->EnableLatencyReduction;
+    DeviceContext->BandwidthControlEnabled = GamingProfile->EnableBandwidthControl;
+    DeviceContext->SmartPowerManagementEnabled = GamingProfile->EnableSmartPowerManagement;
     WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
 
-    // Применение настроек приоритизации трафика
-    status = I219vEnableTrafficPrioritization(DeviceContext, GamingProfile->EnableTrafficPrioritization);
-    if (!NT_SUCCESS(status)) {
-        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Failed to configure traffic prioritization, status %!STATUS!", status);
-        return status;
-    }
+    if (DeviceContext->DeviceInitialized) {
+        // Сбор изменений регистров: QoS, пороги дескрипторов, энергопотребление
+        // и модерация прерываний. Значение InterruptModeration 0 допустимо
+        // (профиль минимальной задержки): оно задает нижние границы шкалы.
+        I219vBeginRegisterTransaction(DeviceContext, &transaction);
+        I219vStageQosControl(&transaction, GamingProfile->EnableTrafficPrioritization,
+                             GamingProfile->EnableBandwidthControl);
+        I219vStageDescriptorThresholds(&transaction, GamingProfile->EnableLatencyReduction,
+                                       GamingProfile->ReceiveBufferSize != 0 || GamingProfile->TransmitBufferSize != 0);
+        I219vStageSmartPowerManagement(&transaction, GamingProfile->EnableSmartPowerManagement);
+        I219vStageInterruptModeration(DeviceContext, &transaction, GamingProfile->InterruptModeration);
+
+        // Таймеры задержки (нулевые значения отключают таймеры) и немедленное
+        // прерывание для мелких пакетов (0 отключает обнаружение)
+        status = I219vStageDelayTimers(&transaction, &delayTimers);
+        if (NT_SUCCESS(status)) {
+            status = I219vStageSmallPacketDetect(&transaction, GamingProfile->SmallPacketThreshold);
+        }
+        if (!NT_SUCCESS(status)) {
+            I219vTransactionFail(&transaction, status);
+        }
 
-    // Применение настроек снижения задержки
-    status = I219vEnableLatencyReduction(DeviceContext, GamingProfile->EnableLatencyReduction);
-    if (!NT_SUCCESS(status)) {
-        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Failed to configure latency reduction, status %!STATUS!", status);
-        return status;
+        status = I219vCommitRegisterTransaction(&transaction);
+    } else {
+        // Регистры запишут I219vInitializeHardware и I219vRestoreGamingRegisters
+        status = I219vNormalizeDelayTimers(&delayTimers);
     }
 
-    // Применение настроек контроля пропускной способности
-    status = I219vEnableBandwidthControl(DeviceContext, GamingProfile->EnableBandwidthControl);
     if (!NT_SUCCESS(status)) {
-        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Failed to configure bandwidth control, status %!STATUS!", status);
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Failed to apply gaming profile registers, status %!STATUS!", status);
+
+        WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+        RtlCopyMemory(&DeviceContext->GamingProfile, &previousProfile, sizeof(I219V_GAMING_PROFILE));
+        DeviceContext->TrafficPrioritizationEnabled = previousFlags[0];
+        DeviceContext->LatencyReductionEnabled = previousFlags[1];
+        DeviceContext->BandwidthControlEnabled = previousFlags[2];
+        DeviceContext->SmartPowerManagementEnabled = previousFlags[3];
+        WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
         return status;
     }
 
-    // Применение настроек управления энергопотреблением
-    status = I219vEnableSmartPowerManagement(DeviceContext, GamingProfile->EnableSmartPowerManagement);
-    if (!NT_SUCCESS(status)) {
-        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Failed to configure smart power management, status %!STATUS!", status);
-        return status;
+    // Размеры буферов
+    if (GamingProfile->ReceiveBufferSize != 0) {
+        DeviceContext->ReceiveBufferSize = GamingProfile->ReceiveBufferSize;
     }
-
-    // Оптимизация буферов
-    if (GamingProfile->ReceiveBufferSize != 0 || GamingProfile->TransmitBufferSize != 0) {
-        // Установка размеров буферов
-        if (GamingProfile->ReceiveBufferSize != 0) {
-            DeviceContext->ReceiveBufferSize = GamingProfile->ReceiveBufferSize;
-        }
-        if (GamingProfile->TransmitBufferSize != 0) {
-            DeviceContext->TransmitBufferSize = GamingProfile->TransmitBufferSize;
-        }
-        
-        // Применение оптимизаций буферов
-        status = I219vOptimizeBuffersForGaming(DeviceContext);
-        if (!NT_SUCCESS(status)) {
-            TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Failed to optimize buffers, status %!STATUS!", status);
-            return status;
-        }
+    if (GamingProfile->TransmitBufferSize != 0) {
+        DeviceContext->TransmitBufferSize = GamingProfile->TransmitBufferSize;
     }
 
-    // Оптимизация прерываний
-    if (GamingProfile->InterruptModeration != 0) {
-        DeviceContext->InterruptModeration = GamingProfile->InterruptModeration;
-        
-        // Применение оптимизаций прерываний
-        status = I219vOptimizeInterruptsForGaming(DeviceContext);
-        if (!NT_SUCCESS(status)) {
-            TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Failed to optimize interrupts, status %!STATUS!", status);
-            return status;
-        }
-    }
+    // Регистры модерации записаны транзакцией (или будут записаны при входе
+    // в D0); сохранение границ шкалы, таймеров задержки и порога мелких пакетов
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    DeviceContext->InterruptModeration = GamingProfile->InterruptModeration;
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    I219vModerationCommitSettings(DeviceContext, GamingProfile->InterruptModeration,
+                                  &delayTimers, GamingProfile->SmallPacketThreshold);
 
     // Настройка дескрипторов
     if (GamingProfile->ReceiveDescriptors != 0 || GamingProfile->TransmitDescriptors != 0) {
@@ -218,6 +336,40 @@ I219vApplyGamingProfile(
     return status;
 }
 
+// Восстановление регистров игровых настроек после сброса устройства
+// Вызывается из I219vEvtDeviceD0Entry после I219vInitializeHardware: CTRL.RST
+// возвращает регистры QoS, пороги дескрипторов и биты энергопотребления к
+// значениям по умолчанию. Регистры модерации восстанавливает
+// I219vInitializeHardware.
+NTSTATUS
+I219vRestoreGamingRegisters(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    I219V_REGISTER_TRANSACTION transaction;
+    BOOLEAN trafficPrioritization;
+    BOOLEAN latencyReduction;
+    BOOLEAN bandwidthControl;
+    BOOLEAN smartPowerManagement;
+    BOOLEAN gamingBuffers;
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    trafficPrioritization = DeviceContext->TrafficPrioritizationEnabled;
+    latencyReduction = DeviceContext->LatencyReductionEnabled;
+    bandwidthControl = DeviceContext->BandwidthControlEnabled;
+    smartPowerManagement = DeviceContext->SmartPowerManagementEnabled;
+    gamingBuffers = DeviceContext->GamingProfile.ReceiveBufferSize != 0 ||
+                    DeviceContext->GamingProfile.TransmitBufferSize != 0;
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    I219vBeginRegisterTransaction(DeviceContext, &transaction);
+    I219vStageQosControl(&transaction, trafficPrioritization, bandwidthControl);
+    I219vStageDescriptorThresholds(&transaction, latencyReduction, gamingBuffers);
+    I219vStageSmartPowerManagement(&transaction, smartPowerManagement);
+
+    return I219vCommitRegisterTransaction(&transaction);
+}
+
 // Включение/отключение приоритизации трафика
 NTSTATUS
 I219vEnableTrafficPrioritization(
@@ -225,7 +377,8 @@ I219vEnableTrafficPrioritization(
     _In_ BOOLEAN Enable
     )
 {
-    UINT32 txcw, rxcw;
+    I219V_REGISTER_TRANSACTION transaction;
+    BOOLEAN bandwidthControl;
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%s traffic prioritization", 
               Enable ? "Enabling" : "Disabling");
@@ -233,43 +386,13 @@ I219vEnableTrafficPrioritization(
     // Сохранение настройки в контексте устройства
     WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
     DeviceContext->TrafficPrioritizationEnabled = Enable;
+    bandwidthControl = DeviceContext->BandwidthControlEnabled;
     WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
 
-    if (Enable) {
-        // Чтение текущих значений регистров управления передачей и приемом
-        txcw = I219vReadRegister(DeviceContext, I219V_REG_TXCW);
-        rxcw = I219vReadRegister(DeviceContext, I219V_REG_RXCW);
-
-        // Модификация регистров для включения приоритизации трафика
-        // Установка битов QoS и приоритизации
-        txcw |= I219V_TXCW_QOS_ENABLE;
-        rxcw |= I219V_RXCW_QOS_ENABLE;
-
-        // Запись модифицированных значений
-        I219vWriteRegister(DeviceContext, I219V_REG_TXCW, txcw);
-        I219vWriteRegister(DeviceContext, I219V_REG_RXCW, rxcw);
-
-        // Настройка регистра управления приоритетами
-        I219vWriteRegister(DeviceContext, I219V_REG_TQAVCC, I219V_TQAVCC_GAMING_PRIORITY);
-    } else {
-        // Чтение текущих значений регистров управления передачей и приемом
-        txcw = I219vReadRegister(DeviceContext, I219V_REG_TXCW);
-        rxcw = I219vReadRegister(DeviceContext, I219V_REG_RXCW);
-
-        // Модификация регистров для отключения приоритизации трафика
-        // Сброс битов QoS и приоритизации
-        txcw &= ~I219V_TXCW_QOS_ENABLE;
-        rxcw &= ~I219V_RXCW_QOS_ENABLE;
-
-        // Запись модифицированных значений
-        I219vWriteRegister(DeviceContext, I219V_REG_TXCW, txcw);
-        I219vWriteRegister(DeviceContext, I219V_REG_RXCW, rxcw);
-
-        // Сброс регистра управления приоритетами
-        I219vWriteRegister(DeviceContext, I219V_REG_TQAVCC, 0);
-    }
+    I219vBeginRegisterTransaction(DeviceContext, &transaction);
+    I219vStageQosControl(&transaction, Enable, bandwidthControl);
 
-    return STATUS_SUCCESS;
+    return I219vCommitRegisterTransaction(&transaction);
 }
 
 // Включение/отключение снижения задержки
@@ -279,7 +402,8 @@ I219vEnableLatencyReduction(
     _In_ BOOLEAN Enable
     )
 {
-    UINT32 ctrl, rxdctl, txdctl;
+    NTSTATUS status;
+    I219V_REGISTER_TRANSACTION transaction;
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%s latency reduction", 
               Enable ? "Enabling" : "Disabling");
@@ -295,39 +419,13 @@ I219vEnableLatencyReduction(
     // For example, descriptor thresholds could be adjusted here if they are not part of I219vOptimizeBuffersForGaming.
 
     // Minimal descriptor thresholds are generally good for latency.
-    // This logic can remain or be moved to a profile application function.
-    // For now, let's keep it here as an explicit action of "LatencyReduction".
-    if (Enable) {
-        ctrl = I219vReadRegister(DeviceContext, I219V_REG_CTRL);
-        rxdctl = I219vReadRegister(DeviceContext, I219V_REG_RXDCTL);
-        txdctl = I219vReadRegister(DeviceContext, I219V_REG_TXDCTL);
-
-        // Ensure ITR is enabled so that ITR register value takes effect if not 0
-        // If ITR is 0 (for latency), ITR_ENABLE bit state doesn't matter as much.
-        // ctrl |= I219V_CTRL_ITR_ENABLE; // This will be handled by I219vOptimizeInterruptsForGaming
-
-        rxdctl &= ~I219V_RXDCTL_PTHRESH_MASK;
-        rxdctl |= (1 << I219V_RXDCTL_PTHRESH_SHIFT); // Minimal threshold
-        
-        txdctl &= ~I219V_TXDCTL_PTHRESH_MASK;
-        txdctl |= (1 << I219V_TXDCTL_PTHRESH_SHIFT); // Minimal threshold
-
-        I219vWriteRegister(DeviceContext, I219V_REG_RXDCTL, rxdctl);
-        I219vWriteRegister(DeviceContext, I219V_REG_TXDCTL, txdctl);
-        // I219vWriteRegister(DeviceContext, I219V_REG_CTRL, ctrl); // CTRL write deferred to I219vOptimizeInterruptsForGaming
-    } else {
-        // Restore default/balanced descriptor thresholds
-        rxdctl = I219vReadRegister(DeviceContext, I219V_REG_RXDCTL);
-        txdctl = I219vReadRegister(DeviceContext, I219V_REG_TXDCTL);
+    // I219vApplyGamingProfile stages the same change into its own transaction.
+    I219vBeginRegisterTransaction(DeviceContext, &transaction);
+    I219vStageDescriptorThresholds(&transaction, Enable, FALSE);
 
-        rxdctl &= ~I219V_RXDCTL_PTHRESH_MASK;
-        rxdctl |= (8 << I219V_RXDCTL_PTHRESH_SHIFT); // Default threshold
-        
-        txdctl &= ~I219V_TXDCTL_PTHRESH_MASK;
-        txdctl |= (8 << I219V_TXDCTL_PTHRESH_SHIFT); // Default threshold
-        
-        I219vWriteRegister(DeviceContext, I219V_REG_RXDCTL, rxdctl);
-        I219vWriteRegister(DeviceContext, I219V_REG_TXDCTL, txdctl);
+    status = I219vCommitRegisterTransaction(&transaction);
+    if (!NT_SUCCESS(status)) {
+        return status;
     }
 
     // Actual ITR value and ITR_ENABLE bit in CTRL is managed by I219vOptimizeInterruptsForGaming.
@@ -346,25 +444,24 @@ I219vEnableBandwidthControl(
     _In_ BOOLEAN Enable
     )
 {
+    I219V_REGISTER_TRANSACTION transaction;
+    BOOLEAN trafficPrioritization;
+
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%s bandwidth control", 
               Enable ? "Enabling" : "Disabling");
 
     // Сохранение настройки в контексте устройства
     WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
     DeviceContext->BandwidthControlEnabled = Enable;
+    trafficPrioritization = DeviceContext->TrafficPrioritizationEnabled;
     WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
 
     // Контроль пропускной способности в основном реализуется на уровне пользовательского режима
     // На уровне драйвера мы только включаем/отключаем поддержку QoS
-    if (Enable) {
-        // Включение поддержки QoS
-        I219vWriteRegister(DeviceContext, I219V_REG_TQAVCC, I219V_TQAVCC_QOS_ENABLE);
-    } else {
-        // Отключение поддержки QoS
-        I219vWriteRegister(DeviceContext, I219V_REG_TQAVCC, 0);
-    }
+    I219vBeginRegisterTransaction(DeviceContext, &transaction);
+    I219vStageQosControl(&transaction, trafficPrioritization, Enable);
 
-    return STATUS_SUCCESS;
+    return I219vCommitRegisterTransaction(&transaction);
 }
 
 // Включение/отключение интеллектуального управления энергопотреблением
@@ -374,7 +471,7 @@ I219vEnableSmartPowerManagement(
     _In_ BOOLEAN Enable
     )
 {
-    UINT32 ctrl;
+    I219V_REGISTER_TRANSACTION transaction;
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%s smart power management", 
               Enable ? "Enabling" : "Disabling");
@@ -384,57 +481,31 @@ I219vEnableSmartPowerManagement(
     DeviceContext->SmartPowerManagementEnabled = Enable;
     WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
 
-    // Чтение текущего значения регистра управления
-    ctrl = I219vReadRegister(DeviceContext, I219V_REG_CTRL);
+    // Energy Efficient Ethernet (EEE) и автоматическое управление энергопотреблением
+    I219vBeginRegisterTransaction(DeviceContext, &transaction);
+    I219vStageSmartPowerManagement(&transaction, Enable);
 
-    if (Enable) {
-        // Включение Energy Efficient Ethernet (EEE)
-        ctrl |= I219V_CTRL_EEE_ENABLE;
-        
-        // Включение автоматического управления энергопотреблением
-        ctrl |= I219V_CTRL_ASPM_ENABLE;
-    } else {
-        // Отключение Energy Efficient Ethernet (EEE)
-        ctrl &= ~I219V_CTRL_EEE_ENABLE;
-        
-        // Отключение автоматического управления энергопотреблением
-        ctrl &= ~I219V_CTRL_ASPM_ENABLE;
-    }
-
-    // Запись модифицированного значения
-    I219vWriteRegister(DeviceContext, I219V_REG_CTRL, ctrl);
-
-    return STATUS_SUCCESS;
+    return I219vCommitRegisterTransaction(&transaction);
 }
 
 // Установка приоритета пакета
+// Записывает приоритет в метаданные пакета; последующие стадии пути передачи
+// (маркировка, дескрипторы) используют его без повторной классификации.
+// Вызывается из пути передачи, который уже удерживает GamingSettingsLock.
 NTSTATUS
 I219vSetPacketPriority(
     _In_ PI219V_DEVICE_CONTEXT DeviceContext,
-    _In_ PNET_PACKET Packet,
+    _Inout_ PI219V_PACKET_METADATA Metadata,
     _In_ I219V_TRAFFIC_PRIORITY_LEVEL Priority
     )
 {
-    BOOLEAN trafficPrioritizationEnabled;
+    UNREFERENCED_PARAMETER(DeviceContext);
 
-    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
-    trafficPrioritizationEnabled = DeviceContext->TrafficPrioritizationEnabled;
-
-    // Проверка, включена ли приоритизация трафика
-    if (!trafficPrioritizationEnabled) {
-        WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
-        return STATUS_SUCCESS;
+    if (Priority < I219V_TRAFFIC_PRIORITY_HIGHEST || Priority > I219V_TRAFFIC_PRIORITY_LOWEST) {
+        return STATUS_INVALID_PARAMETER;
     }
 
-    // Установка приоритета пакета
-    // В реальной реализации здесь бы устанавливался приоритет в заголовке пакета
-    // или в дескрипторе передачи
-    
-    // Для примера просто увеличиваем счетчик пакетов с высоким приоритетом
-    if (Priority == I219V_TRAFFIC_PRIORITY_HIGHEST || Priority == I219V_TRAFFIC_PRIORITY_HIGH) {
-        DeviceContext->GamingPerformanceStats.HighPriorityPacketsSent++;
-    }
-    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+    Metadata->Priority = Priority;
 
     return STATUS_SUCCESS;
 }
@@ -445,88 +516,45 @@ I219vOptimizeBuffersForGaming(
     _In_ PI219V_DEVICE_CONTEXT DeviceContext
     )
 {
-    UINT32 rxdctl, txdctl;
+    I219V_REGISTER_TRANSACTION transaction;
+    BOOLEAN latencyReduction;
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "Optimizing buffers for gaming");
 
-    // Чтение текущих значений регистров управления дескрипторами
-    rxdctl = I219vReadRegister(DeviceContext, I219V_REG_RXDCTL);
-    txdctl = I219vReadRegister(DeviceContext, I219V_REG_TXDCTL);
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    latencyReduction = DeviceContext->LatencyReductionEnabled;
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
 
     // Настройка порогов дескрипторов для оптимальной производительности в играх
     // Для игр важно быстро обрабатывать пакеты, поэтому устанавливаем низкие пороги
-    rxdctl &= ~I219V_RXDCTL_PTHRESH_MASK;
-    rxdctl |= (2 << I219V_RXDCTL_PTHRESH_SHIFT); // Низкий порог для быстрой обработки
-    
-    txdctl &= ~I219V_TXDCTL_PTHRESH_MASK;
-    txdctl |= (2 << I219V_TXDCTL_PTHRESH_SHIFT); // Низкий порог для быстрой обработки
-
-    // Запись модифицированных значений
-    I219vWriteRegister(DeviceContext, I219V_REG_RXDCTL, rxdctl);
-    I219vWriteRegister(DeviceContext, I219V_REG_TXDCTL, txdctl);
+    // (минимальный порог снижения задержки сохраняется)
+    I219vBeginRegisterTransaction(DeviceContext, &transaction);
+    I219vStageDescriptorThresholds(&transaction, latencyReduction, TRUE);
 
     // Настройка размеров буферов
     // В реальной реализации здесь бы выполнялась настройка размеров буферов
     // в зависимости от профиля и доступной памяти
 
-    return STATUS_SUCCESS;
+    return I219vCommitRegisterTransaction(&transaction);
 }
 
 // Оптимизация прерываний для игр
+// Значение InterruptModeration профиля (0-100) задает границы шкалы ITR;
+// конкретное значение внутри границ выбирает динамическая модерация по
+// нагрузке пути данных (см. i219v_moderation.c). Если задан бюджет
+// задержки в микросекундах, он имеет приоритет над шкалой.
 NTSTATUS
 I219vOptimizeInterruptsForGaming(
     _In_ PI219V_DEVICE_CONTEXT DeviceContext
     )
 {
-    UINT32 ctrl;
-
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "Optimizing interrupts for gaming");
 
-    // Чтение текущего значения регистра управления
-    ctrl = I219vReadRegister(DeviceContext, I219V_REG_CTRL);
-
-    BOOLEAN latencyReductionEnabled;
-
-    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
-    latencyReductionEnabled = DeviceContext->LatencyReductionEnabled;
-    // Копируем InterruptModeration, так как он используется после возможного Release
-    UINT32 interruptModeration = DeviceContext->InterruptModeration;
-    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
-
-    UINT32 interruptModerationValue; // Local copy of the setting from DeviceContext
-
     WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
-    // Read the InterruptModeration value, which is expected to be set by gaming profiles (0-100)
-    interruptModerationValue = DeviceContext->InterruptModeration;
+    I219vModerationSetBounds(DeviceContext, DeviceContext->InterruptModeration);
     WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
 
-    // Чтение текущего значения регистра управления
-    ctrl = I219vReadRegister(DeviceContext, I219V_REG_CTRL);
-
-    // Map the 0-100 scale to ITR register values (0-255 representing 0-1020 usec, or specific values)
-    // For simplicity, let's map 0 directly to ITR=0 (minimal/disabled), and scale others.
-    // A value of 0 for interruptModerationValue (from Competitive profile) means minimal latency.
-    if (interruptModerationValue == 0) { // Minimal latency profile
-        ctrl &= ~I219V_CTRL_ITR_ENABLE; // Disable ITR for very lowest latency (or ITR=0)
-        I219vWriteRegister(DeviceContext, I219V_REG_ITR, 0); 
-    } else {
-        ctrl |= I219V_CTRL_ITR_ENABLE; // Enable ITR mechanism
-        UINT32 itrValue = 0;
-        // Scale 1-100 to hardware specific ITR values. Example scaling:
-        if (interruptModerationValue <= 20) { // Low latency
-            itrValue = 32;  // approx 12.8us if ITR unit is 0.25us, needs datasheet check for exact unit. Assuming 256 units = 256us for this hardware
-        } else if (interruptModerationValue <= 50) { // Balanced
-            itrValue = 64; 
-        } else if (interruptModerationValue <= 80) { // Higher throughput
-            itrValue = 96;
-        } else { // Max moderation
-            itrValue = 128; 
-        }
-        I219vWriteRegister(DeviceContext, I219V_REG_ITR, itrValue);
-    }
-
-    // Запись модифицированного значения
-    I219vWriteRegister(DeviceContext, I219V_REG_CTRL, ctrl);
+    I219vApplyInterruptModeration(DeviceContext);
 
     return STATUS_SUCCESS;
 }
@@ -566,6 +594,11 @@ I219vGetDefaultGamingProfile(
     GamingProfile->InterruptModeration = 50;
     GamingProfile->ReceiveDescriptors = 256;
     GamingProfile->TransmitDescriptors = 256;
+
+    // Объемный прием откладывается таймерами, мелкие пакеты прерывают сразу
+    GamingProfile->DelayTimers.RxDelayUs = 32;
+    GamingProfile->DelayTimers.RxAbsoluteDelayUs = 128;
+    GamingProfile->SmallPacketThreshold = 128;
 }
 
 // Получение профиля для соревновательных игр
@@ -585,9 +618,16 @@ I219vGetCompetitiveGamingProfile(
     GamingProfile->EnableSmartPowerManagement = FALSE; // Отключаем для максимальной производительности
     GamingProfile->ReceiveBufferSize = 4096;
     GamingProfile->TransmitBufferSize = 4096;
-    GamingProfile->InterruptModeration = 0; // Минимальная задержка
+    // Умеренная модерация: низкую задержку игровых пакетов обеспечивает
+    // обнаружение мелких пакетов, а не отключение модерации
+    GamingProfile->InterruptModeration = 20;
     GamingProfile->ReceiveDescriptors = 512;
     GamingProfile->TransmitDescriptors = 512;
+
+    // Объемный прием откладывается ненадолго, игровые пакеты прерывают сразу
+    GamingProfile->DelayTimers.RxDelayUs = 16;
+    GamingProfile->DelayTimers.RxAbsoluteDelayUs = 64;
+    GamingProfile->SmallPacketThreshold = I219V_GAMING_COMPETITIVE_SMALL_PACKET_SIZE;
 }
 
 // Получение профиля для стриминга игр
@@ -610,101 +650,315 @@ I219vGetStreamingGamingProfile(
     GamingProfile->InterruptModeration = 80; // Высокая модерация для стабильности
     GamingProfile->ReceiveDescriptors = 1024;
     GamingProfile->TransmitDescriptors = 1024;
+
+    // Пакетная обработка завершений при длительной отдаче потока:
+    // прием откладывается ненадолго, передача - значительно дольше
+    GamingProfile->DelayTimers.RxDelayUs = 8;
+    GamingProfile->DelayTimers.RxAbsoluteDelayUs = 32;
+    GamingProfile->DelayTimers.TxDelayUs = 64;
+    GamingProfile->DelayTimers.TxAbsoluteDelayUs = 256;
 }
 
-// Проверка, является ли пакет игровым трафиком
+// Разбор заголовков Ethernet/IP/TCP/UDP кадра
+// Возвращает FALSE, если кадр слишком короткий или не является IP-пакетом.
+// Для IPv6 цепочка расширенных заголовков не разбирается: порты
+// извлекаются только при TCP/UDP непосредственно после основного заголовка.
 BOOLEAN
-I219vIsGamingTraffic(
-    _In_ PNET_PACKET Packet
+I219vParsePacketHeaders(
+    _In_reads_bytes_(Length) PUCHAR Frame,
+    _In_ UINT32 Length,
+    _Out_ PI219V_PACKET_HEADERS Headers
     )
 {
-    // В реальной реализации здесь бы выполнялся анализ заголовков пакета
-    // для определения, является ли он игровым трафиком
-    
-    // Для примера просто проверяем порты
-    UINT16 sourcePort = 0;
-    UINT16 destinationPort = 0;
-    
-    // Получение портов из заголовков пакета
-    // В реальной реализации здесь бы выполнялся разбор заголовков IP и TCP/UDP
-    
-    // Проверка, соответствует ли порт игровым портам
-    for (UINT32 i = 0; i < GAME_PORT_COUNT; i++) {
-        if (sourcePort == GamePorts[i] || destinationPort == GamePorts[i]) {
+    UINT32 offset = I219V_ETHERNET_HEADER_SIZE;
+    UINT32 l4Offset;
+
+    RtlZeroMemory(Headers, sizeof(I219V_PACKET_HEADERS));
+
+    if (Length < I219V_ETHERNET_HEADER_SIZE) {
+        return FALSE;
+    }
+
+    Headers->EtherType = (UINT16)((Frame[12] << 8) | Frame[13]);
+
+    // Пропуск тега 802.1Q
+    if (Headers->EtherType == I219V_ETHERTYPE_VLAN) {
+        if (Length < I219V_ETHERNET_HEADER_SIZE + I219V_VLAN_TAG_SIZE) {
+            return FALSE;
+        }
+        Headers->VlanTagged = TRUE;
+        Headers->EtherType = (UINT16)((Frame[16] << 8) | Frame[17]);
+        offset += I219V_VLAN_TAG_SIZE;
+    }
+
+    Headers->L3Offset = (UINT16)offset;
+
+    if (Headers->EtherType == I219V_ETHERTYPE_IPV4) {
+        UINT32 ihl;
+
+        if (Length < offset + 20) {
+            return FALSE;
+        }
+        ihl = (Frame[offset] & 0x0F) * 4;
+        if (ihl < 20 || Length < offset + ihl) {
+            return FALSE;
+        }
+        Headers->IpVersion = 4;
+        Headers->Protocol = Frame[offset + 9];
+
+        // Для фрагментов IP (кроме первого) заголовка L4 нет
+        if (((Frame[offset + 6] & 0x1F) | Frame[offset + 7]) != 0) {
             return TRUE;
         }
+        l4Offset = offset + ihl;
+    } else if (Headers->EtherType == I219V_ETHERTYPE_IPV6) {
+        if (Length < offset + 40) {
+            return FALSE;
+        }
+        Headers->IpVersion = 6;
+        Headers->Protocol = Frame[offset + 6];
+        l4Offset = offset + 40;
+    } else {
+        return FALSE;
+    }
+
+    // Извлечение портов TCP/UDP
+    if ((Headers->Protocol == I219V_IP_PROTOCOL_TCP || Headers->Protocol == I219V_IP_PROTOCOL_UDP) &&
+        Length >= l4Offset + 4) {
+        Headers->L4Offset = (UINT16)l4Offset;
+        Headers->SourcePort = (UINT16)((Frame[l4Offset] << 8) | Frame[l4Offset + 1]);
+        Headers->DestinationPort = (UINT16)((Frame[l4Offset + 2] << 8) | Frame[l4Offset + 3]);
     }
-    
-    return FALSE;
+
+    return TRUE;
 }
 
-// Проверка, является ли пакет голосовым трафиком
-BOOLEAN
-I219vIsVoiceTraffic(
-    _In_ PNET_PACKET Packet
+// Классификация трафика по портам TCP/UDP
+// Порядок проверок совпадает с цепочкой I219vIs*Traffic: игры, голос, стриминг.
+I219V_TRAFFIC_CLASS
+I219vClassifyPorts(
+    _In_ UINT16 SourcePort,
+    _In_ UINT16 DestinationPort
     )
 {
-    // В реальной реализации здесь бы выполнялся анализ заголовков пакета
-    // для определения, является ли он голосовым трафиком
-    
-    // Для примера просто проверяем порты
-    UINT16 sourcePort = 0;
-    UINT16 destinationPort = 0;
-    
-    // Получение портов из заголовков пакета
-    // В реальной реализации здесь бы выполнялся разбор заголовков IP и TCP/UDP
-    
-    // Проверка, соответствует ли порт голосовым портам
-    for (UINT32 i = 0; i < VOICE_PORT_COUNT; i++) {
-        if (sourcePort == VoicePorts[i] || destinationPort == VoicePorts[i]) {
-            return TRUE;
+    UINT32 i;
+
+    for (i = 0; i < GAME_PORT_COUNT; i++) {
+        if (SourcePort == GamePorts[i] || DestinationPort == GamePorts[i]) {
+            return I219V_TRAFFIC_CLASS_GAME;
+        }
+    }
+
+    for (i = 0; i < VOICE_PORT_COUNT; i++) {
+        if (SourcePort == VoicePorts[i] || DestinationPort == VoicePorts[i]) {
+            return I219V_TRAFFIC_CLASS_VOICE;
+        }
+    }
+
+    for (i = 0; i < STREAMING_PORT_COUNT; i++) {
+        if (SourcePort == StreamingPorts[i] || DestinationPort == StreamingPorts[i]) {
+            return I219V_TRAFFIC_CLASS_STREAMING;
         }
     }
-    
-    return FALSE;
+
+    return I219V_TRAFFIC_CLASS_BACKGROUND;
 }
 
-// Проверка, является ли пакет стриминговым трафиком
-BOOLEAN
-I219vIsStreamingTraffic(
-    _In_ PNET_PACKET Packet
+// Приоритет по умолчанию для класса трафика
+I219V_TRAFFIC_PRIORITY_LEVEL
+I219vGetTrafficClassPriority(
+    _In_ I219V_TRAFFIC_CLASS TrafficClass
     )
 {
-    // В реальной реализации здесь бы выполнялся анализ заголовков пакета
-    // для определения, является ли он стриминговым трафиком
-    
-    // Для примера просто проверяем порты
-    UINT16 sourcePort = 0;
-    UINT16 destinationPort = 0;
-    
-    // Получение портов из заголовков пакета
-    // В реальной реализации здесь бы выполнялся разбор заголовков IP и TCP/UDP
-    
-    // Проверка, соответствует ли порт стриминговым портам
-    for (UINT32 i = 0; i < STREAMING_PORT_COUNT; i++) {
-        if (sourcePort == StreamingPorts[i] || destinationPort == StreamingPorts[i]) {
-            return TRUE;
+    switch (TrafficClass) {
+    case I219V_TRAFFIC_CLASS_GAME:
+        return I219V_TRAFFIC_PRIORITY_HIGHEST;
+    case I219V_TRAFFIC_CLASS_VOICE:
+        return I219V_TRAFFIC_PRIORITY_HIGH;
+    case I219V_TRAFFIC_CLASS_STREAMING:
+        return I219V_TRAFFIC_PRIORITY_MEDIUM;
+    default:
+        return I219V_TRAFFIC_PRIORITY_LOW;
+    }
+}
+
+// Классификация пакета
+// Разбирает заголовки из Metadata->HeaderBuffer и заполняет класс и приоритет.
+// Пакеты, заголовки которых не удалось разобрать, считаются фоновыми.
+VOID
+I219vClassifyPacket(
+    _Inout_ PI219V_PACKET_METADATA Metadata
+    )
+{
+    Metadata->HeadersValid = I219vParsePacketHeaders(Metadata->HeaderBuffer,
+                                                     Metadata->HeaderBufferLength,
+                                                     &Metadata->Headers);
+
+    if (Metadata->HeadersValid && Metadata->Headers.L4Offset != 0) {
+        Metadata->Class = I219vClassifyPorts(Metadata->Headers.SourcePort, Metadata->Headers.DestinationPort);
+    } else {
+        Metadata->Class = I219V_TRAFFIC_CLASS_BACKGROUND;
+    }
+
+    Metadata->Priority = I219vGetTrafficClassPriority(Metadata->Class);
+    Metadata->Classified = TRUE;
+}
+
+// Скалярная пакетная классификация (используется, если SSE2 недоступен)
+VOID
+I219vClassifyBatchScalar(
+    _Inout_ PI219V_CLASSIFY_BATCH Batch
+    )
+{
+    for (UINT32 i = 0; i < Batch->Count; i++) {
+        if (Batch->Protocol[i] == I219V_IP_PROTOCOL_TCP || Batch->Protocol[i] == I219V_IP_PROTOCOL_UDP) {
+            Batch->Class[i] = (UCHAR)I219vClassifyPorts(Batch->SourcePort[i], Batch->DestinationPort[i]);
+        } else {
+            Batch->Class[i] = (UCHAR)I219V_TRAFFIC_CLASS_BACKGROUND;
         }
     }
-    
-    return FALSE;
 }
 
-// Проверка, является ли пакет фоновым трафиком
-BOOLEAN
-I219vIsBackgroundTraffic(
-    _In_ PNET_PACKET Packet
+#ifdef I219V_CLASSIFY_SSE2
+// Маска совпадения порта источника или назначения с любым портом таблицы
+static
+__m128i
+I219vMatchPortTable(
+    _In_ __m128i SourcePorts,
+    _In_ __m128i DestinationPorts,
+    _In_reads_(PortCount) const UINT16* PortTable,
+    _In_ UINT32 PortCount
     )
 {
-    // Если пакет не является игровым, голосовым или стриминговым,
-    // то считаем его фоновым
-    if (!I219vIsGamingTraffic(Packet) && 
-        !I219vIsVoiceTraffic(Packet) && 
-        !I219vIsStreamingTraffic(Packet)) {
-        return TRUE;
-    }
-    
-    return FALSE;
+    __m128i match = _mm_setzero_si128();
+
+    for (UINT32 i = 0; i < PortCount; i++) {
+        __m128i port = _mm_set1_epi16((short)PortTable[i]);
+        match = _mm_or_si128(match, _mm_cmpeq_epi16(SourcePorts, port));
+        match = _mm_or_si128(match, _mm_cmpeq_epi16(DestinationPorts, port));
+    }
+
+    return match;
+}
+#endif
+
+// Пакетная классификация
+// Обрабатывает по 8 пакетов за проход (SSE2, 16-битные порты) без ветвлений
+// на каждый пакет; остаток пачки классифицируется скалярным кодом.
+// Приоритет классов совпадает с I219vClassifyPorts: игры > голос > стриминг.
+// AVX2 не используется: в режиме ядра его применение требует сохранения
+// расширенного состояния процессора (KeSaveExtendedProcessorState) на каждый вызов.
+VOID
+I219vClassifyBatch(
+    _Inout_ PI219V_CLASSIFY_BATCH Batch
+    )
+{
+#ifdef I219V_CLASSIFY_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i tcp = _mm_set1_epi16(I219V_IP_PROTOCOL_TCP);
+    const __m128i udp = _mm_set1_epi16(I219V_IP_PROTOCOL_UDP);
+    UINT32 vectorCount = Batch->Count & ~7u;
+    UINT32 i;
+
+    for (i = 0; i < vectorCount; i += 8) {
+        __m128i sourcePorts = _mm_load_si128((const __m128i*)&Batch->SourcePort[i]);
+        __m128i destinationPorts = _mm_load_si128((const __m128i*)&Batch->DestinationPort[i]);
+        __m128i protocol = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&Batch->Protocol[i]), zero);
+        __m128i hasPorts = _mm_or_si128(_mm_cmpeq_epi16(protocol, tcp), _mm_cmpeq_epi16(protocol, udp));
+        __m128i trafficClass = _mm_set1_epi16(I219V_TRAFFIC_CLASS_BACKGROUND);
+        __m128i match;
+
+        // Классы применяются от низшего приоритета к высшему, чтобы
+        // более приоритетное совпадение перезаписывало менее приоритетное
+        match = _mm_and_si128(hasPorts, I219vMatchPortTable(sourcePorts, destinationPorts, StreamingPorts, STREAMING_PORT_COUNT));
+        trafficClass = _mm_or_si128(_mm_andnot_si128(match, trafficClass),
+                                    _mm_and_si128(match, _mm_set1_epi16(I219V_TRAFFIC_CLASS_STREAMING)));
+
+        match = _mm_and_si128(hasPorts, I219vMatchPortTable(sourcePorts, destinationPorts, VoicePorts, VOICE_PORT_COUNT));
+        trafficClass = _mm_or_si128(_mm_andnot_si128(match, trafficClass),
+                                    _mm_and_si128(match, _mm_set1_epi16(I219V_TRAFFIC_CLASS_VOICE)));
+
+        match = _mm_and_si128(hasPorts, I219vMatchPortTable(sourcePorts, destinationPorts, GamePorts, GAME_PORT_COUNT));
+        trafficClass = _mm_andnot_si128(match, trafficClass);   // I219V_TRAFFIC_CLASS_GAME == 0
+
+        _mm_storel_epi64((__m128i*)&Batch->Class[i], _mm_packus_epi16(trafficClass, zero));
+    }
+
+    // Остаток пачки
+    for (; i < Batch->Count; i++) {
+        if (Batch->Protocol[i] == I219V_IP_PROTOCOL_TCP || Batch->Protocol[i] == I219V_IP_PROTOCOL_UDP) {
+            Batch->Class[i] = (UCHAR)I219vClassifyPorts(Batch->SourcePort[i], Batch->DestinationPort[i]);
+        } else {
+            Batch->Class[i] = (UCHAR)I219V_TRAFFIC_CLASS_BACKGROUND;
+        }
+    }
+#else
+    I219vClassifyBatchScalar(Batch);
+#endif
+}
+
+// Пакетная классификация метаданных пакетов
+// Собирает поля заголовков в I219V_CLASSIFY_BATCH, классифицирует пачку
+// и записывает класс и приоритет обратно в метаданные.
+VOID
+I219vClassifyMetadataBatch(
+    _Inout_updates_(Count) PI219V_PACKET_METADATA* Metadata,
+    _In_ UINT32 Count
+    )
+{
+    I219V_CLASSIFY_BATCH batch;
+    UINT32 base, i;
+
+    for (base = 0; base < Count; base += I219V_CLASSIFY_BATCH_SIZE) {
+        batch.Count = min(Count - base, I219V_CLASSIFY_BATCH_SIZE);
+
+        // Сбор полей заголовков в непрерывные массивы
+        for (i = 0; i < batch.Count; i++) {
+            PI219V_PACKET_METADATA metadata = Metadata[base + i];
+
+            if (metadata->HeadersValid && metadata->Headers.L4Offset != 0) {
+                batch.SourcePort[i] = metadata->Headers.SourcePort;
+                batch.DestinationPort[i] = metadata->Headers.DestinationPort;
+                batch.Protocol[i] = metadata->Headers.Protocol;
+            } else {
+                batch.SourcePort[i] = 0;
+                batch.DestinationPort[i] = 0;
+                batch.Protocol[i] = 0;
+            }
+        }
+
+        I219vClassifyBatch(&batch);
+
+        // Запись результатов в метаданные
+        for (i = 0; i < batch.Count; i++) {
+            PI219V_PACKET_METADATA metadata = Metadata[base + i];
+
+            metadata->Class = (I219V_TRAFFIC_CLASS)batch.Class[i];
+            metadata->Priority = I219vGetTrafficClassPriority(metadata->Class);
+            metadata->Classified = TRUE;
+        }
+    }
+}
+
+// Обработчик IOCTL-запросов интерфейса управления
+static
+VOID
+I219vEvtGamingIoDeviceControl(
+    _In_ WDFQUEUE Queue,
+    _In_ WDFREQUEST Request,
+    _In_ size_t OutputBufferLength,
+    _In_ size_t InputBufferLength,
+    _In_ ULONG IoControlCode
+    )
+{
+    PI219V_DEVICE_CONTEXT deviceContext = I219vGetDeviceContext(WdfIoQueueGetDevice(Queue));
+
+    UNREFERENCED_PARAMETER(OutputBufferLength);
+    UNREFERENCED_PARAMETER(InputBufferLength);
+    UNREFERENCED_PARAMETER(IoControlCode);
+
+    // Запрос завершается внутри обработчика или асинхронной операцией
+    (VOID)I219vHandleGamingIoctl(deviceContext, Request);
 }
 
 // Регистрация интерфейса для взаимодействия с пользовательским режимом
@@ -713,23 +967,217 @@ I219vRegisterGamingInterface(
     _In_ PI219V_DEVICE_CONTEXT DeviceContext
     )
 {
-    // В реальной реализации здесь бы выполнялась регистрация интерфейса
-    // для взаимодействия с пользовательским режимом через IOCTL
-    
-    // Для примера просто возвращаем успех
+    NTSTATUS status;
+    WDF_IO_QUEUE_CONFIG queueConfig;
+    WDFQUEUE queue;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "Registering gaming control interface");
+
+    // Создание интерфейса устройства
+    status = WdfDeviceCreateDeviceInterface(DeviceContext->Device, &GUID_DEVINTERFACE_I219V_GAMING, NULL);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfDeviceCreateDeviceInterface failed: %!STATUS!", status);
+        return status;
+    }
+
+    // Очередь для IOCTL-запросов управления
+    WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchParallel);
+    queueConfig.EvtIoDeviceControl = I219vEvtGamingIoDeviceControl;
+
+    status = WdfIoQueueCreate(DeviceContext->Device, &queueConfig, WDF_NO_OBJECT_ATTRIBUTES, &queue);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfIoQueueCreate failed: %!STATUS!", status);
+        return status;
+    }
+
+    status = WdfDeviceConfigureRequestDispatching(DeviceContext->Device, queue, WdfRequestTypeDeviceControl);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfDeviceConfigureRequestDispatching failed: %!STATUS!", status);
+        return status;
+    }
+
     return STATUS_SUCCESS;
 }
 
 // Обработка IOCTL-запросов от пользовательского режима
+// Запрос завершается внутри функции; возвращается статус завершения.
+// STATUS_PENDING - запрос завершит асинхронная операция (снимок диагностики PHY).
 NTSTATUS
 I219vHandleGamingIoctl(
     _In_ PI219V_DEVICE_CONTEXT DeviceContext,
     _In_ WDFREQUEST Request
     )
 {
-    // В реальной реализации здесь бы выполнялась обработка IOCTL-запросов
-    // от пользовательского режима для управления игровыми функциями
-    
-    // Для примера просто возвращаем успех
-    return STATUS_SUCCESS;
+    NTSTATUS status;
+    WDF_REQUEST_PARAMETERS params;
+    PVOID inputBuffer = NULL;
+    PVOID outputBuffer = NULL;
+    ULONG_PTR information = 0;
+
+    WDF_REQUEST_PARAMETERS_INIT(&params);
+    WdfRequestGetParameters(Request, &params);
+
+    switch (params.Parameters.DeviceIoControl.IoControlCode) {
+    case IOCTL_I219V_GET_QOS_MARKING:
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(I219V_QOS_MARKING_CONFIG), &outputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            I219vGetQosMarkingConfig(DeviceContext, (PI219V_QOS_MARKING_CONFIG)outputBuffer);
+            information = sizeof(I219V_QOS_MARKING_CONFIG);
+        }
+        break;
+
+    case IOCTL_I219V_SET_QOS_MARKING:
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(I219V_QOS_MARKING_CONFIG), &inputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            status = I219vSetQosMarkingConfig(DeviceContext, (PI219V_QOS_MARKING_CONFIG)inputBuffer);
+        }
+        break;
+
+    case IOCTL_I219V_GET_QOS_MARKING_STATS:
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(I219V_QOS_MARKING_STATS), &outputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+            RtlCopyMemory(outputBuffer, &DeviceContext->QosMarkingStats, sizeof(I219V_QOS_MARKING_STATS));
+            WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+            information = sizeof(I219V_QOS_MARKING_STATS);
+        }
+        break;
+
+    case IOCTL_I219V_GET_TOP_FLOWS:
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(I219V_TOP_FLOWS), &outputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            I219vGetTopFlows(DeviceContext, (PI219V_TOP_FLOWS)outputBuffer);
+            information = sizeof(I219V_TOP_FLOWS);
+        }
+        break;
+
+    case IOCTL_I219V_SET_FLOW_TRACKER:
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(I219V_FLOW_TRACKER_CONFIG), &inputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            status = I219vSetFlowTrackerConfig(DeviceContext, (PI219V_FLOW_TRACKER_CONFIG)inputBuffer);
+        }
+        break;
+
+    case IOCTL_I219V_GET_RTT_STATS:
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(I219V_RTT_STATS), &outputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            I219vGetRttStats(DeviceContext, (PI219V_RTT_STATS)outputBuffer);
+            information = sizeof(I219V_RTT_STATS);
+        }
+        break;
+
+    case IOCTL_I219V_SET_LATENCY_BUDGET:
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(UINT32), &inputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            status = I219vSetInterruptLatencyBudget(DeviceContext, *(PUINT32)inputBuffer);
+        }
+        break;
+
+    case IOCTL_I219V_GET_MODERATION_STATS:
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(I219V_MODERATION_STATS), &outputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            I219vGetModerationStats(DeviceContext, (PI219V_MODERATION_STATS)outputBuffer);
+            information = sizeof(I219V_MODERATION_STATS);
+        }
+        break;
+
+    case IOCTL_I219V_GET_INTERRUPT_STATS:
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(I219V_INTERRUPT_STATS), &outputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            I219vGetInterruptStats(DeviceContext, (PI219V_INTERRUPT_STATS)outputBuffer);
+            information = sizeof(I219V_INTERRUPT_STATS);
+        }
+        break;
+
+    case IOCTL_I219V_GET_AFFINITY:
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(I219V_AFFINITY_INFO), &outputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            I219vGetAffinityInfo(DeviceContext, (PI219V_AFFINITY_INFO)outputBuffer);
+            information = sizeof(I219V_AFFINITY_INFO);
+        }
+        break;
+
+    case IOCTL_I219V_SET_AFFINITY:
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(I219V_AFFINITY_CONFIG), &inputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            status = I219vSetAffinityConfig(DeviceContext, (PI219V_AFFINITY_CONFIG)inputBuffer);
+        }
+        break;
+
+    case IOCTL_I219V_GET_STORM_STATS:
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(I219V_STORM_STATS), &outputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            I219vGetStormStats(DeviceContext, (PI219V_STORM_STATS)outputBuffer);
+            information = sizeof(I219V_STORM_STATS);
+        }
+        break;
+
+    case IOCTL_I219V_GET_RX_LATENCY:
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(I219V_RX_LATENCY_STATS), &outputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            I219vGetRxLatencyStats(DeviceContext, (PI219V_RX_LATENCY_STATS)outputBuffer);
+            information = sizeof(I219V_RX_LATENCY_STATS);
+        }
+        break;
+
+    case IOCTL_I219V_GET_TX_LATENCY:
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(I219V_TX_LATENCY_STATS), &outputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            I219vGetTxLatencyStats(DeviceContext, (PI219V_TX_LATENCY_STATS)outputBuffer);
+            information = sizeof(I219V_TX_LATENCY_STATS);
+        }
+        break;
+
+    case IOCTL_I219V_RESET_LATENCY:
+        I219vResetLatencyStats(DeviceContext);
+        status = STATUS_SUCCESS;
+        break;
+
+    case IOCTL_I219V_GET_MMIO_PROFILE:
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(I219V_MMIO_PROFILE_STATS), &outputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            I219vGetMmioProfile(DeviceContext, (PI219V_MMIO_PROFILE_STATS)outputBuffer);
+            information = sizeof(I219V_MMIO_PROFILE_STATS);
+        }
+        break;
+
+    case IOCTL_I219V_RESET_MMIO_PROFILE:
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(I219V_MMIO_PROFILE_CONTROL), &inputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            I219vResetMmioProfile(DeviceContext, ((PI219V_MMIO_PROFILE_CONTROL)inputBuffer)->Enable != 0);
+        }
+        break;
+
+    case IOCTL_I219V_GET_PHY_DIAGNOSTICS:
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(I219V_PHY_DIAGNOSTICS), &outputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            status = I219vStartPhyDiagnostics(DeviceContext, Request, (PI219V_PHY_DIAGNOSTICS)outputBuffer);
+        }
+        break;
+
+    case IOCTL_I219V_GET_REGISTER_SHADOW:
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(I219V_REGISTER_SHADOW_STATS), &outputBuffer, NULL);
+        if (NT_SUCCESS(status)) {
+            I219vGetRegisterShadowStats(DeviceContext, (PI219V_REGISTER_SHADOW_STATS)outputBuffer);
+            information = sizeof(I219V_REGISTER_SHADOW_STATS);
+        }
+        break;
+
+    default:
+        status = STATUS_INVALID_DEVICE_REQUEST;
+        break;
+    }
+
+    // Запрос завершит обратный вызов асинхронной операции
+    if (status == STATUS_PENDING) {
+        return status;
+    }
+
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_WARNING, TRACE_DRIVER, "Gaming IOCTL 0x%08X failed: %!STATUS!",
+                  params.Parameters.DeviceIoControl.IoControlCode, status);
+    }
+
+    WdfRequestCompleteWithInformation(Request, status, information);
+    return status;
 }
@@ -22,6 +22,7 @@ Environment:
 #include <ntddk.h>
 #include <wdf.h>
 #include <netadaptercx.h>
+#include "i219v_moderation.h"
 
 // Типы игровых профилей
 typedef enum _I219V_GAMING_PROFILE_TYPE {
@@ -40,6 +41,13 @@ typedef enum _I219V_TRAFFIC_PRIORITY_LEVEL {
     I219V_TRAFFIC_PRIORITY_LOWEST = 4       // Наименьший приоритет (фоновые задачи)
 } I219V_TRAFFIC_PRIORITY_LEVEL;
 
+#define I219V_TRAFFIC_PRIORITY_COUNT    5
+
+// Порог RSRPD соревновательного профиля (байт): обновления состояния игры и
+// голосовые кадры укладываются в него, полноразмерные сегменты - нет.
+// Не связан с порогом классификации нагрузки I219V_MODERATION_SMALL_PACKET_SIZE.
+#define I219V_GAMING_COMPETITIVE_SMALL_PACKET_SIZE  256
+
 // Структура игрового профиля
 typedef struct _I219V_GAMING_PROFILE {
     I219V_GAMING_PROFILE_TYPE ProfileType;          // Тип профиля
@@ -52,6 +60,8 @@ typedef struct _I219V_GAMING_PROFILE {
     UINT32 InterruptModeration;                     // Уровень модерации прерываний (0-100)
     UINT32 ReceiveDescriptors;                      // Количество дескрипторов приема
     UINT32 TransmitDescriptors;                     // Количество дескрипторов передачи
+    I219V_DELAY_TIMERS DelayTimers;                 // Таймеры задержки прерываний RDTR/RADV/TIDV/TADV
+    UINT32 SmallPacketThreshold;                    // Немедленное прерывание для пакетов до этого размера (байт, 0 - отключено)
 } I219V_GAMING_PROFILE, *PI219V_GAMING_PROFILE;
 
 // Структура для отслеживания статистики производительности
@@ -70,14 +80,103 @@ typedef struct _I219V_GAMING_PERFORMANCE_STATS {
     UINT32 PeakBandwidthKbps;                       // Пиковая пропускная способность в Кбит/с
 } I219V_GAMING_PERFORMANCE_STATS, *PI219V_GAMING_PERFORMANCE_STATS;
 
+// Константы разбора заголовков пакета
+#define I219V_ETHERNET_HEADER_SIZE  14          // Размер заголовка Ethernet без тега
+#define I219V_VLAN_TAG_SIZE         4           // Размер тега 802.1Q
+#define I219V_ETHERTYPE_IPV4        0x0800      // EtherType IPv4
+#define I219V_ETHERTYPE_IPV6        0x86DD      // EtherType IPv6
+#define I219V_ETHERTYPE_VLAN        0x8100      // EtherType 802.1Q
+#define I219V_IP_PROTOCOL_TCP       6           // Протокол TCP
+#define I219V_IP_PROTOCOL_UDP       17          // Протокол UDP
+
+// Результат разбора заголовков пакета (смещения от начала кадра)
+typedef struct _I219V_PACKET_HEADERS {
+    UINT16 EtherType;                               // EtherType после тега VLAN (если есть)
+    BOOLEAN VlanTagged;                             // Кадр уже содержит тег 802.1Q
+    UCHAR IpVersion;                                // 4, 6 или 0 для не-IP кадров
+    UCHAR Protocol;                                 // Протокол L4 (TCP/UDP/...)
+    UINT16 L3Offset;                                // Смещение заголовка IP
+    UINT16 L4Offset;                                // Смещение заголовка TCP/UDP (0, если нет)
+    UINT16 SourcePort;                              // Порт источника (порядок хоста)
+    UINT16 DestinationPort;                         // Порт назначения (порядок хоста)
+} I219V_PACKET_HEADERS, *PI219V_PACKET_HEADERS;
+
+// Интерфейс устройства для управления игровыми функциями из пользовательского режима
+// {7C1F3E52-4B8A-4D2E-9A61-2F5D8C3B1E07}
+DEFINE_GUID(GUID_DEVINTERFACE_I219V_GAMING,
+    0x7c1f3e52, 0x4b8a, 0x4d2e, 0x9a, 0x61, 0x2f, 0x5d, 0x8c, 0x3b, 0x1e, 0x07);
+
+// Коды IOCTL интерфейса управления
+#define I219V_IOCTL_BASE                    0x900
+#define IOCTL_I219V_GET_QOS_MARKING         CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 0, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_I219V_SET_QOS_MARKING         CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 1, METHOD_BUFFERED, FILE_WRITE_ACCESS)
+#define IOCTL_I219V_GET_QOS_MARKING_STATS   CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 2, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_I219V_GET_TOP_FLOWS           CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 3, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_I219V_SET_FLOW_TRACKER        CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 4, METHOD_BUFFERED, FILE_WRITE_ACCESS)
+#define IOCTL_I219V_GET_RTT_STATS           CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 5, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_I219V_GET_MODERATION_STATS    CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 6, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_I219V_SET_LATENCY_BUDGET      CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 7, METHOD_BUFFERED, FILE_WRITE_ACCESS)
+#define IOCTL_I219V_GET_INTERRUPT_STATS     CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 8, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_I219V_GET_AFFINITY            CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 9, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_I219V_SET_AFFINITY            CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 10, METHOD_BUFFERED, FILE_WRITE_ACCESS)
+#define IOCTL_I219V_GET_STORM_STATS         CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 11, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_I219V_GET_RX_LATENCY          CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 12, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_I219V_RESET_LATENCY           CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 13, METHOD_BUFFERED, FILE_WRITE_ACCESS)
+#define IOCTL_I219V_GET_TX_LATENCY          CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 14, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_I219V_GET_MMIO_PROFILE        CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 15, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_I219V_RESET_MMIO_PROFILE      CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 16, METHOD_BUFFERED, FILE_WRITE_ACCESS)
+#define IOCTL_I219V_GET_PHY_DIAGNOSTICS     CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 17, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_I219V_GET_REGISTER_SHADOW     CTL_CODE(FILE_DEVICE_NETWORK, I219V_IOCTL_BASE + 18, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+// Классы трафика, определяемые классификатором
+typedef enum _I219V_TRAFFIC_CLASS {
+    I219V_TRAFFIC_CLASS_GAME = 0,           // Игровой трафик
+    I219V_TRAFFIC_CLASS_VOICE = 1,          // Голосовой чат
+    I219V_TRAFFIC_CLASS_STREAMING = 2,      // Стриминг
+    I219V_TRAFFIC_CLASS_BACKGROUND = 3      // Фоновый трафик
+} I219V_TRAFFIC_CLASS;
+
+#define I219V_TRAFFIC_CLASS_COUNT   4
+
+// Метаданные передаваемого пакета
+// Заполняются один раз при классификации и используются всеми
+// последующими стадиями пути передачи (статистика, маркировка, дескрипторы).
+typedef struct _I219V_PACKET_METADATA {
+    BOOLEAN Classified;                             // Пакет прошел классификацию
+    BOOLEAN HeadersValid;                           // Заголовки успешно разобраны
+    BOOLEAN InsertVlanTag;                          // Вставить тег 802.1Q из поля Special дескриптора
+    UINT16 VlanTag;                                 // Значение тега (PCP + VLAN ID)
+    I219V_TRAFFIC_CLASS Class;                      // Класс трафика
+    I219V_TRAFFIC_PRIORITY_LEVEL Priority;          // Итоговый приоритет пакета
+    struct _I219V_FLOW_ENTRY* FlowEntry;            // Запись отслеживаемого потока (NULL, если нет)
+    PUCHAR HeaderBuffer;                            // Начало кадра (первый фрагмент)
+    UINT32 HeaderBufferLength;                      // Длина данных первого фрагмента
+    UINT32 FrameLength;                             // Полная длина кадра
+    I219V_PACKET_HEADERS Headers;                   // Смещения и поля заголовков относительно HeaderBuffer
+} I219V_PACKET_METADATA, *PI219V_PACKET_METADATA;
+
+// Пакетная классификация: размер пачки и структура-накопитель
+// Поля заголовков пачки собираются в непрерывные массивы, чтобы
+// сравнение с таблицами портов выполнялось сразу для нескольких пакетов.
+#define I219V_CLASSIFY_BATCH_SIZE   64
+
+typedef struct _I219V_CLASSIFY_BATCH {
+    UINT32 Count;                                               // Количество пакетов в пачке
+    DECLSPEC_ALIGN(16) UINT16 SourcePort[I219V_CLASSIFY_BATCH_SIZE];        // Порты источника
+    DECLSPEC_ALIGN(16) UINT16 DestinationPort[I219V_CLASSIFY_BATCH_SIZE];   // Порты назначения
+    DECLSPEC_ALIGN(16) UCHAR Protocol[I219V_CLASSIFY_BATCH_SIZE];           // Протокол L4
+    DECLSPEC_ALIGN(16) UCHAR Class[I219V_CLASSIFY_BATCH_SIZE];              // Результат (I219V_TRAFFIC_CLASS)
+} I219V_CLASSIFY_BATCH, *PI219V_CLASSIFY_BATCH;
+
 // Объявление функций для игровых оптимизаций
 NTSTATUS I219vInitializeGamingFeatures(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 NTSTATUS I219vApplyGamingProfile(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ PI219V_GAMING_PROFILE GamingProfile);
+NTSTATUS I219vRestoreGamingRegisters(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 NTSTATUS I219vEnableTrafficPrioritization(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ BOOLEAN Enable);
 NTSTATUS I219vEnableLatencyReduction(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ BOOLEAN Enable);
 NTSTATUS I219vEnableBandwidthControl(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ BOOLEAN Enable);
 NTSTATUS I219vEnableSmartPowerManagement(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ BOOLEAN Enable);
-NTSTATUS I219vSetPacketPriority(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ PNET_PACKET Packet, _In_ I219V_TRAFFIC_PRIORITY_LEVEL Priority);
+NTSTATUS I219vSetPacketPriority(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Inout_ PI219V_PACKET_METADATA Metadata, _In_ I219V_TRAFFIC_PRIORITY_LEVEL Priority);
 NTSTATUS I219vOptimizeBuffersForGaming(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 NTSTATUS I219vOptimizeInterruptsForGaming(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 NTSTATUS I219vGetGamingPerformanceStats(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_GAMING_PERFORMANCE_STATS PerformanceStats);
@@ -88,10 +187,13 @@ VOID I219vGetCompetitiveGamingProfile(_Out_ PI219V_GAMING_PROFILE GamingProfile)
 VOID I219vGetStreamingGamingProfile(_Out_ PI219V_GAMING_PROFILE GamingProfile);
 
 // Функции для анализа и классификации трафика
-BOOLEAN I219vIsGamingTraffic(_In_ PNET_PACKET Packet);
-BOOLEAN I219vIsVoiceTraffic(_In_ PNET_PACKET Packet);
-BOOLEAN I219vIsStreamingTraffic(_In_ PNET_PACKET Packet);
-BOOLEAN I219vIsBackgroundTraffic(_In_ PNET_PACKET Packet);
+BOOLEAN I219vParsePacketHeaders(_In_reads_bytes_(Length) PUCHAR Frame, _In_ UINT32 Length, _Out_ PI219V_PACKET_HEADERS Headers);
+I219V_TRAFFIC_CLASS I219vClassifyPorts(_In_ UINT16 SourcePort, _In_ UINT16 DestinationPort);
+I219V_TRAFFIC_PRIORITY_LEVEL I219vGetTrafficClassPriority(_In_ I219V_TRAFFIC_CLASS TrafficClass);
+VOID I219vClassifyPacket(_Inout_ PI219V_PACKET_METADATA Metadata);
+VOID I219vClassifyBatch(_Inout_ PI219V_CLASSIFY_BATCH Batch);
+VOID I219vClassifyBatchScalar(_Inout_ PI219V_CLASSIFY_BATCH Batch);
+VOID I219vClassifyMetadataBatch(_Inout_updates_(Count) PI219V_PACKET_METADATA* Metadata, _In_ UINT32 Count);
 
 // Функции для взаимодействия с пользовательским режимом
 NTSTATUS I219vRegisterGamingInterface(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
@@ -24,17 +24,98 @@ Environment:
 #include "Device.h"
 #include "Adapter.h"
 #include "i219v_hw.h"
+#include "i219v_hw_extended.h"
+#include "i219v_model.h"
+#include "i219v_offload.h"
+#include "i219v_reset.h"
+#include "DeviceContext.h"
 #include "Trace.h"
 
+// Соответствие смещения регистра индексу теневой копии
+#define I219V_SHADOW_NONE   ((ULONG)-1)
+
+static
+ULONG
+I219vShadowIndex(
+    _In_ UINT32 Register
+    )
+{
+    switch (Register) {
+    case I219V_REG_CTRL:        return I219V_SHADOW_CTRL;
+    case I219V_REG_CTRL_EXT:    return I219V_SHADOW_CTRL_EXT;
+    case I219V_REG_RCTL:        return I219V_SHADOW_RCTL;
+    case I219V_REG_TCTL:        return I219V_SHADOW_TCTL;
+    case I219V_REG_RXDCTL:      return I219V_SHADOW_RXDCTL;
+    case I219V_REG_TXDCTL:      return I219V_SHADOW_TXDCTL;
+    case I219V_REG_RXCSUM:      return I219V_SHADOW_RXCSUM;
+    case I219V_REG_RFCTL:       return I219V_SHADOW_RFCTL;
+    case I219V_REG_TXCW:        return I219V_SHADOW_TXCW;
+    case I219V_REG_TQAVCC:      return I219V_SHADOW_TQAVCC;
+    default:                    return I219V_SHADOW_NONE;
+    }
+}
+
+// Обновление теневой копии после записи в регистр
+static
+VOID
+I219vShadowUpdate(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 Register,
+    _In_ UINT32 Value
+    )
+{
+    PI219V_REGISTER_SHADOW shadow = &DeviceContext->RegisterShadow;
+    ULONG index;
+
+    if (shadow->Lock == NULL) {
+        return;
+    }
+
+    // Сброс устройства возвращает все регистры к значениям по умолчанию
+    if (Register == I219V_REG_CTRL && (Value & I219V_CTRL_RST) != 0) {
+        I219vInvalidateRegisterShadow(DeviceContext);
+        return;
+    }
+
+    index = I219vShadowIndex(Register);
+    if (index == I219V_SHADOW_NONE) {
+        return;
+    }
+
+    WdfSpinLockAcquire(shadow->Lock);
+    shadow->Values[index] = Value;
+    shadow->ValidMask |= (1UL << index);
+    shadow->Generation++;
+    WdfSpinLockRelease(shadow->Lock);
+}
+
 // Чтение из регистра устройства
 UINT32
 I219vReadRegister(
     _In_ PI219V_DEVICE_CONTEXT DeviceContext,
     _In_ UINT32 Register
     )
+{
+    return I219vReadRegisterEx(DeviceContext, Register, I219V_MMIO_CATEGORY_CONTROL);
+}
+
+// Чтение из регистра устройства с категорией места вызова (для профилировщика)
+UINT32
+I219vReadRegisterEx(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 Register,
+    _In_ I219V_MMIO_CATEGORY Category
+    )
 {
     UINT32 value;
     
+#if I219V_DEVICE_MODEL
+    // Подключенная модель устройства обслуживает обращение вместо MMIO
+    if (DeviceContext->DeviceModel != NULL) {
+        return I219vModelReadRegister(DeviceContext->DeviceModel, Register);
+    }
+#endif
+
     // Проверка валидности базового адреса
     if (DeviceContext->RegisterBase == NULL) {
         TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "RegisterBase is NULL");
@@ -50,7 +131,16 @@ I219vReadRegister(
     }
     
     // Чтение значения регистра
-    value = READ_REGISTER_ULONG((PULONG)((PUCHAR)DeviceContext->RegisterBase + Register));
+#if I219V_MMIO_PROFILER
+    if (DeviceContext->MmioProfile.Enabled) {
+        value = I219vMmioProfileRead(DeviceContext, Register, Category);
+    } else
+#else
+    UNREFERENCED_PARAMETER(Category);
+#endif
+    {
+        value = READ_REGISTER_ULONG((PULONG)((PUCHAR)DeviceContext->RegisterBase + Register));
+    }
     
     TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_HARDWARE, 
               "Read Register 0x%x = 0x%x", Register, value);
@@ -66,6 +156,27 @@ I219vWriteRegister(
     _In_ UINT32 Value
     )
 {
+    I219vWriteRegisterEx(DeviceContext, Register, Value, I219V_MMIO_CATEGORY_CONTROL);
+}
+
+// Запись в регистр устройства с категорией места вызова (для профилировщика)
+VOID
+I219vWriteRegisterEx(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 Register,
+    _In_ UINT32 Value,
+    _In_ I219V_MMIO_CATEGORY Category
+    )
+{
+#if I219V_DEVICE_MODEL
+    // Подключенная модель устройства обслуживает обращение вместо MMIO
+    if (DeviceContext->DeviceModel != NULL) {
+        I219vModelWriteRegister(DeviceContext->DeviceModel, Register, Value);
+        I219vShadowUpdate(DeviceContext, Register, Value);
+        return;
+    }
+#endif
+
     // Проверка валидности базового адреса
     if (DeviceContext->RegisterBase == NULL) {
         TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "RegisterBase is NULL");
@@ -81,12 +192,464 @@ I219vWriteRegister(
     }
     
     // Запись значения в регистр
-    WRITE_REGISTER_ULONG((PULONG)((PUCHAR)DeviceContext->RegisterBase + Register), Value);
+#if I219V_MMIO_PROFILER
+    if (DeviceContext->MmioProfile.Enabled) {
+        I219vMmioProfileWrite(DeviceContext, Register, Value, Category);
+    } else
+#else
+    UNREFERENCED_PARAMETER(Category);
+#endif
+    {
+        WRITE_REGISTER_ULONG((PULONG)((PUCHAR)DeviceContext->RegisterBase + Register), Value);
+    }
+    
+    // Поддержание согласованности теневой копии
+    I219vShadowUpdate(DeviceContext, Register, Value);
     
     TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_HARDWARE, 
               "Write Register 0x%x = 0x%x", Register, Value);
 }
 
+// Инициализация теневой копии регистров
+NTSTATUS
+I219vInitializeRegisterShadow(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    NTSTATUS status;
+    WDF_OBJECT_ATTRIBUTES lockAttributes;
+
+    RtlZeroMemory(&DeviceContext->RegisterShadow, sizeof(I219V_REGISTER_SHADOW));
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&lockAttributes);
+    lockAttributes.ParentObject = DeviceContext->Device;
+
+    status = WdfSpinLockCreate(&lockAttributes, &DeviceContext->RegisterShadow.Lock);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "WdfSpinLockCreate failed for register shadow: %!STATUS!", status);
+        return status;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+// Сброс теневой копии (после сброса устройства или освобождения ресурсов)
+VOID
+I219vInvalidateRegisterShadow(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_REGISTER_SHADOW shadow = &DeviceContext->RegisterShadow;
+
+    if (shadow->Lock == NULL) {
+        return;
+    }
+
+    WdfSpinLockAcquire(shadow->Lock);
+    shadow->ValidMask = 0;
+    shadow->Generation++;
+    shadow->Stats.Invalidations++;
+    WdfSpinLockRelease(shadow->Lock);
+}
+
+// Чтение регистра через теневую копию
+// Для регистров вне копии выполняется обычное чтение MMIO. Промах
+// заполняет копию, только если за время чтения MMIO не было записи или
+// сброса: иначе прочитанное значение могло устареть.
+static
+UINT32
+I219vShadowRead(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 Register,
+    _In_ I219V_MMIO_CATEGORY Category
+    )
+{
+    PI219V_REGISTER_SHADOW shadow = &DeviceContext->RegisterShadow;
+    ULONG index = I219vShadowIndex(Register);
+    ULONG generation;
+    UINT32 value;
+
+    if (index == I219V_SHADOW_NONE || shadow->Lock == NULL) {
+        return I219vReadRegisterEx(DeviceContext, Register, Category);
+    }
+
+    WdfSpinLockAcquire(shadow->Lock);
+    if (shadow->ValidMask & (1UL << index)) {
+        value = shadow->Values[index];
+        shadow->Stats.Hits++;
+        WdfSpinLockRelease(shadow->Lock);
+        return value;
+    }
+    generation = shadow->Generation;
+    WdfSpinLockRelease(shadow->Lock);
+
+    value = I219vReadRegisterEx(DeviceContext, Register, Category);
+
+    // Копия заполняется только при отображенной области регистров
+    if (DeviceContext->RegisterBase != NULL && Register < DeviceContext->RegisterSize) {
+        WdfSpinLockAcquire(shadow->Lock);
+        shadow->Stats.Misses++;
+        if (shadow->Generation == generation) {
+            shadow->Values[index] = value;
+            shadow->ValidMask |= (1UL << index);
+        } else {
+            shadow->Stats.DiscardedFills++;
+        }
+        WdfSpinLockRelease(shadow->Lock);
+    }
+
+    return value;
+}
+
+UINT32
+I219vReadRegisterShadow(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 Register
+    )
+{
+    return I219vShadowRead(DeviceContext, Register, I219V_MMIO_CATEGORY_CONTROL);
+}
+
+// Чтение-модификация-запись регистра через теневую копию
+// Запись в устройство пропускается, если значение не изменилось.
+// Возвращает новое значение регистра.
+UINT32
+I219vModifyRegister(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 Register,
+    _In_ UINT32 ClearBits,
+    _In_ UINT32 SetBits
+    )
+{
+    PI219V_REGISTER_SHADOW shadow = &DeviceContext->RegisterShadow;
+    ULONG index = I219vShadowIndex(Register);
+    UINT32 oldValue;
+    UINT32 newValue;
+
+    oldValue = I219vReadRegisterShadow(DeviceContext, Register);
+    newValue = (oldValue & ~ClearBits) | SetBits;
+
+    if (newValue == oldValue && index != I219V_SHADOW_NONE && shadow->Lock != NULL) {
+        WdfSpinLockAcquire(shadow->Lock);
+        if (shadow->ValidMask & (1UL << index)) {
+            shadow->Stats.ElidedWrites++;
+            WdfSpinLockRelease(shadow->Lock);
+            return newValue;
+        }
+        WdfSpinLockRelease(shadow->Lock);
+    }
+
+    I219vWriteRegister(DeviceContext, Register, newValue);
+
+    return newValue;
+}
+
+// Получение статистики теневой копии регистров
+VOID
+I219vGetRegisterShadowStats(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PI219V_REGISTER_SHADOW_STATS ShadowStats
+    )
+{
+    PI219V_REGISTER_SHADOW shadow = &DeviceContext->RegisterShadow;
+
+    if (shadow->Lock == NULL) {
+        RtlZeroMemory(ShadowStats, sizeof(I219V_REGISTER_SHADOW_STATS));
+        return;
+    }
+
+    WdfSpinLockAcquire(shadow->Lock);
+    RtlCopyMemory(ShadowStats, &shadow->Stats, sizeof(I219V_REGISTER_SHADOW_STATS));
+    WdfSpinLockRelease(shadow->Lock);
+}
+
+// Порядок записи при фиксации транзакции: сначала параметры очередей и
+// фильтров, затем включение блоков приема/передачи, CTRL - последним
+static
+ULONG
+I219vTransactionRank(
+    _In_ UINT32 Register
+    )
+{
+    switch (Register) {
+    case I219V_REG_RXDCTL:
+    case I219V_REG_TXDCTL:
+        return 0;
+    case I219V_REG_CTRL_EXT:
+        return 2;
+    case I219V_REG_RCTL:
+    case I219V_REG_TCTL:
+        return 3;
+    case I219V_REG_CTRL:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+// Начало транзакции записи регистров
+VOID
+I219vBeginRegisterTransaction(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PI219V_REGISTER_TRANSACTION Transaction
+    )
+{
+    RtlZeroMemory(Transaction, sizeof(I219V_REGISTER_TRANSACTION));
+    Transaction->DeviceContext = DeviceContext;
+    Transaction->Status = STATUS_SUCCESS;
+}
+
+// Поиск или добавление записи транзакции для регистра
+static
+PI219V_REGISTER_TRANSACTION_ENTRY
+I219vTransactionEntry(
+    _Inout_ PI219V_REGISTER_TRANSACTION Transaction,
+    _In_ UINT32 Register
+    )
+{
+    PI219V_REGISTER_TRANSACTION_ENTRY entry;
+    ULONG i;
+
+    if (!NT_SUCCESS(Transaction->Status)) {
+        return NULL;
+    }
+
+    for (i = 0; i < Transaction->EntryCount; i++) {
+        if (Transaction->Entries[i].Register == Register) {
+            Transaction->CoalescedWrites++;
+            return &Transaction->Entries[i];
+        }
+    }
+
+    if (Transaction->EntryCount == I219V_REGISTER_TRANSACTION_MAX_ENTRIES) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "Register transaction is full (register 0x%x)", Register);
+        Transaction->Status = STATUS_BUFFER_OVERFLOW;
+        return NULL;
+    }
+
+    // Исходное значение берется из теневой копии
+    entry = &Transaction->Entries[Transaction->EntryCount++];
+    entry->Register = Register;
+    entry->OriginalValue = I219vShadowRead(Transaction->DeviceContext, Register, I219V_MMIO_CATEGORY_PROFILE);
+    entry->Value = entry->OriginalValue;
+
+    return entry;
+}
+
+// Применение изменения к записи транзакции с проверкой конфликта
+// Биты, уже заданные другим этапом, могут быть заданы повторно только
+// тем же значением; иначе транзакция отменяется.
+static
+VOID
+I219vTransactionStage(
+    _Inout_ PI219V_REGISTER_TRANSACTION Transaction,
+    _In_ UINT32 Register,
+    _In_ UINT32 Mask,
+    _In_ UINT32 Bits
+    )
+{
+    PI219V_REGISTER_TRANSACTION_ENTRY entry = I219vTransactionEntry(Transaction, Register);
+    UINT32 value;
+
+    if (entry == NULL) {
+        return;
+    }
+
+    value = (entry->Value & ~Mask) | (Bits & Mask);
+
+    if (((value ^ entry->Value) & entry->StagedMask) != 0) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE,
+                  "Conflicting staged values for register 0x%x: 0x%08x vs 0x%08x (mask 0x%08x)",
+                  Register, entry->Value, value, entry->StagedMask & Mask);
+        I219vTransactionFail(Transaction, STATUS_INVALID_PARAMETER);
+        return;
+    }
+
+    entry->Value = value;
+    entry->StagedMask |= Mask;
+}
+
+// Изменение битов регистра в транзакции
+VOID
+I219vTransactionModify(
+    _Inout_ PI219V_REGISTER_TRANSACTION Transaction,
+    _In_ UINT32 Register,
+    _In_ UINT32 ClearBits,
+    _In_ UINT32 SetBits
+    )
+{
+    I219vTransactionStage(Transaction, Register, ClearBits | SetBits, SetBits);
+}
+
+// Запись значения регистра в транзакции
+VOID
+I219vTransactionWrite(
+    _Inout_ PI219V_REGISTER_TRANSACTION Transaction,
+    _In_ UINT32 Register,
+    _In_ UINT32 Value
+    )
+{
+    I219vTransactionStage(Transaction, Register, 0xFFFFFFFF, Value);
+}
+
+// Отмена транзакции: фиксация не будет обращаться к устройству
+VOID
+I219vTransactionFail(
+    _Inout_ PI219V_REGISTER_TRANSACTION Transaction,
+    _In_ NTSTATUS Status
+    )
+{
+    if (NT_SUCCESS(Transaction->Status)) {
+        Transaction->Status = Status;
+    }
+}
+
+// Доступны ли регистры устройства (отображена область BAR0 или подключена модель)
+static
+BOOLEAN
+I219vRegistersAccessible(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+#if I219V_DEVICE_MODEL
+    if (DeviceContext->DeviceModel != NULL) {
+        return TRUE;
+    }
+#endif
+
+    return DeviceContext->RegisterBase != NULL;
+}
+
+// Фиксация транзакции записи регистров
+NTSTATUS
+I219vCommitRegisterTransaction(
+    _Inout_ PI219V_REGISTER_TRANSACTION Transaction
+    )
+{
+    PI219V_DEVICE_CONTEXT deviceContext = Transaction->DeviceContext;
+    I219V_REGISTER_TRANSACTION_ENTRY entry;
+    ULONG writes = 0;
+    ULONG i, j;
+
+    if (!NT_SUCCESS(Transaction->Status)) {
+        TraceEvents(TRACE_LEVEL_WARNING, TRACE_HARDWARE,
+                  "Register transaction aborted before commit: %!STATUS!", Transaction->Status);
+        return Transaction->Status;
+    }
+
+    if (!I219vRegistersAccessible(deviceContext)) {
+        return STATUS_DEVICE_NOT_READY;
+    }
+
+    // Упорядочивание записей (устойчивая сортировка вставками по рангу)
+    for (i = 1; i < Transaction->EntryCount; i++) {
+        entry = Transaction->Entries[i];
+        for (j = i; j > 0 && I219vTransactionRank(Transaction->Entries[j - 1].Register) > I219vTransactionRank(entry.Register); j--) {
+            Transaction->Entries[j] = Transaction->Entries[j - 1];
+        }
+        Transaction->Entries[j] = entry;
+    }
+
+    for (i = 0; i < Transaction->EntryCount; i++) {
+        if (Transaction->Entries[i].Value != Transaction->Entries[i].OriginalValue) {
+            I219vWriteRegisterEx(deviceContext, Transaction->Entries[i].Register, Transaction->Entries[i].Value,
+                                 I219V_MMIO_CATEGORY_PROFILE);
+            writes++;
+        }
+    }
+
+    if (writes == 0) {
+        return STATUS_SUCCESS;
+    }
+
+    // Один сброс отложенных записей; чтение всех единиц означает, что
+    // устройство не отвечает - восстанавливаются исходные значения
+    if (I219vReadRegisterEx(deviceContext, I219V_REG_STATUS, I219V_MMIO_CATEGORY_PROFILE) == 0xFFFFFFFF) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE,
+                  "Device not responding after register transaction, rolling back %u writes", writes);
+
+        for (i = Transaction->EntryCount; i > 0; i--) {
+            if (Transaction->Entries[i - 1].Value != Transaction->Entries[i - 1].OriginalValue) {
+                I219vWriteRegisterEx(deviceContext, Transaction->Entries[i - 1].Register, Transaction->Entries[i - 1].OriginalValue,
+                                     I219V_MMIO_CATEGORY_PROFILE);
+            }
+        }
+
+        // Состояние устройства неизвестно - копия читается заново
+        I219vInvalidateRegisterShadow(deviceContext);
+        return STATUS_DEVICE_NOT_CONNECTED;
+    }
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_HARDWARE,
+              "Register transaction committed: %u writes, %u registers, %u coalesced",
+              writes, Transaction->EntryCount, Transaction->CoalescedWrites);
+
+    return STATUS_SUCCESS;
+}
+
+// Проверка отображения области регистров для быстрых обращений
+// Выполняется один раз после отображения BAR0: быстрые обращения не
+// проверяют базовый адрес и размер области при каждом вызове.
+NTSTATUS
+I219vValidateFastRegisterMap(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    DeviceContext->FastRegistersValidated = FALSE;
+
+    if (DeviceContext->RegisterBase == NULL) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "RegisterBase is NULL");
+        return STATUS_DEVICE_CONFIGURATION_ERROR;
+    }
+
+    if (DeviceContext->RegisterSize < I219V_FAST_REGISTER_SPAN) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE,
+                  "Register space 0x%x is smaller than fast register map 0x%x",
+                  DeviceContext->RegisterSize, (ULONG)I219V_FAST_REGISTER_SPAN);
+        return STATUS_DEVICE_CONFIGURATION_ERROR;
+    }
+
+    DeviceContext->FastRegistersValidated = TRUE;
+
+    return STATUS_SUCCESS;
+}
+
+#if I219V_DEVICE_MODEL
+// Подключение модели к контексту устройства
+// Теневая копия регистров сбрасывается: ее значения относились к другому
+// источнику. Признак проверки области снимается, чтобы быстрые обращения
+// пути данных шли через слой доступа и обслуживались моделью.
+VOID
+I219vAttachDeviceModel(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ PI219V_DEVICE_MODEL Model
+    )
+{
+    DeviceContext->FastRegistersValidated = FALSE;
+    DeviceContext->DeviceModel = Model;
+    I219vInvalidateRegisterShadow(DeviceContext);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Device model attached");
+}
+
+// Отключение модели от контекста устройства
+// Быстрые обращения возвращаются к области регистров после повторной проверки.
+VOID
+I219vDetachDeviceModel(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    DeviceContext->DeviceModel = NULL;
+    I219vInvalidateRegisterShadow(DeviceContext);
+
+    if (DeviceContext->RegisterBase != NULL) {
+        (VOID)I219vValidateFastRegisterMap(DeviceContext);
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Device model detached");
+}
+#endif // I219V_DEVICE_MODEL
+
 // Чтение MAC-адреса из EEPROM устройства
 NTSTATUS
 I219vReadMacAddress(
@@ -142,32 +705,25 @@ I219vInitializeHardware(
     _In_ PI219V_DEVICE_CONTEXT DeviceContext
     )
 {
-    UINT32 ctrlReg;
+    NTSTATUS status;
     
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Initializing I219-v hardware");
     
-    // Сброс устройства
-    I219vWriteRegister(DeviceContext, I219V_REG_CTRL, I219V_CTRL_RST);
-    
-    // Ожидание завершения сброса
-    // В реальной реализации нужно использовать таймаут
-    for (int i = 0; i < 10; i++) {
-        ctrlReg = I219vReadRegister(DeviceContext, I219V_REG_CTRL);
-        if ((ctrlReg & I219V_CTRL_RST) == 0) {
-            break;
-        }
-        // Задержка 1 мс
-        NdisMSleep(1000);
+    // Сброс MAC и PHY одной записью CTRL; фазы проверяет таймер
+    status = I219vStartReset(DeviceContext, I219V_RESET_FLAG_MAC | I219V_RESET_FLAG_PHY);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "I219vStartReset failed %!STATUS!", status);
+        return status;
     }
     
-    // Проверка, что сброс завершился
-    ctrlReg = I219vReadRegister(DeviceContext, I219V_REG_CTRL);
-    if (ctrlReg & I219V_CTRL_RST) {
+    // Ожидание выхода MAC из сброса (PHY продолжает сброс)
+    status = I219vWaitReset(DeviceContext, TRUE);
+    if (!NT_SUCCESS(status)) {
         TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "Device reset failed");
         return STATUS_DEVICE_NOT_READY;
     }
     
-    // Инициализация регистров устройства
+    // Инициализация регистров MAC (параллельно со сбросом PHY)
     
     // Отключение прерываний
     I219vWriteRegister(DeviceContext, I219V_REG_IMC, 0xFFFFFFFF);
@@ -175,11 +731,6 @@ I219vInitializeHardware(
     // Очистка регистра состояния прерываний
     I219vReadRegister(DeviceContext, I219V_REG_ICR);
     
-    // Настройка управляющего регистра
-    ctrlReg = I219vReadRegister(DeviceContext, I219V_REG_CTRL);
-    ctrlReg |= I219V_CTRL_SLU;  // Установка бита SLU (Set Link Up)
-    I219vWriteRegister(DeviceContext, I219V_REG_CTRL, ctrlReg);
-    
     // Настройка регистра управления приемом
     I219vWriteRegister(DeviceContext, I219V_REG_RCTL, 
                      I219V_RCTL_EN |        // Включение приема
@@ -206,11 +757,28 @@ I219vInitializeHardware(
     I219vWriteRegister(DeviceContext, I219V_REG_RAL, ral);
     I219vWriteRegister(DeviceContext, I219V_REG_RAH, rah);
     
+    // Ожидание готовности PHY перед установкой соединения
+    status = I219vWaitReset(DeviceContext, FALSE);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "PHY reset failed %!STATUS!", status);
+        return status;
+    }
+    
+    // Настройка управляющего регистра (бит SLU - Set Link Up)
+    I219vModifyRegister(DeviceContext, I219V_REG_CTRL, 0, I219V_CTRL_SLU);
+    
+    // CTRL.RST сбрасывает VME: восстанавливаем по настройкам оффлоада VLAN и маркировки QoS
+    I219vApplyVlanMode(DeviceContext);
+    
+    // Таймеры задержки прерываний сохраненного профиля (CTRL.RST их обнуляет)
+    I219vRestoreModerationRegisters(DeviceContext);
+    
     // Включение прерываний
+    // (MDAC разрешает модуль PHY на время асинхронной операции MDIC)
     I219vWriteRegister(DeviceContext, I219V_REG_IMS, 
-                     I219V_IMS_RXDW |       // Прерывание при приеме пакета
-                     I219V_IMS_TXDW |       // Прерывание при передаче пакета
-                     I219V_IMS_LSC);        // Прерывание при изменении состояния соединения
+                     I219V_ICR_RX_CAUSES |  // Прием пакета (RXDW) и мелкий пакет (SRPD)
+                     I219V_ICR_TX_CAUSES |  // Передача пакета
+                     I219V_ICR_LINK_CAUSES);// Изменение состояния соединения
     
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "I219-v hardware initialized successfully");
     
@@ -229,14 +797,10 @@ I219vShutdownHardware(
     I219vWriteRegister(DeviceContext, I219V_REG_IMC, 0xFFFFFFFF);
     
     // Отключение приема
-    UINT32 rctl = I219vReadRegister(DeviceContext, I219V_REG_RCTL);
-    rctl &= ~I219V_RCTL_EN;
-    I219vWriteRegister(DeviceContext, I219V_REG_RCTL, rctl);
+    I219vModifyRegister(DeviceContext, I219V_REG_RCTL, I219V_RCTL_EN, 0);
     
     // Отключение передачи
-    UINT32 tctl = I219vReadRegister(DeviceContext, I219V_REG_TCTL);
-    tctl &= ~I219V_TCTL_EN;
-    I219vWriteRegister(DeviceContext, I219V_REG_TCTL, tctl);
+    I219vModifyRegister(DeviceContext, I219V_REG_TCTL, I219V_TCTL_EN, 0);
     
     // Сброс устройства
     I219vWriteRegister(DeviceContext, I219V_REG_CTRL, I219V_CTRL_RST);
@@ -253,20 +817,24 @@ I219vEnableDevice(
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Enabling I219-v device");
     
     // Включение приема
-    UINT32 rctl = I219vReadRegister(DeviceContext, I219V_REG_RCTL);
-    rctl |= I219V_RCTL_EN;
-    I219vWriteRegister(DeviceContext, I219V_REG_RCTL, rctl);
+    I219vModifyRegister(DeviceContext, I219V_REG_RCTL, 0, I219V_RCTL_EN);
     
     // Включение передачи
-    UINT32 tctl = I219vReadRegister(DeviceContext, I219V_REG_TCTL);
-    tctl |= I219V_TCTL_EN;
-    I219vWriteRegister(DeviceContext, I219V_REG_TCTL, tctl);
+    I219vModifyRegister(DeviceContext, I219V_REG_TCTL, 0, I219V_TCTL_EN);
+    
+    // Автомаскирование: чтение ICR в ISR само маскирует причины пути данных,
+    // поэтому ISR обходится одним чтением ICR без записи в IMC. Причины
+    // сбрасываются чтением ICR (отдельного регистра EIAC у MAC семейства PCH нет).
+    I219vWriteRegister(DeviceContext, I219V_REG_IAM, I219V_ICR_AUTO_MASK_CAUSES);
+    I219vModifyRegister(DeviceContext, I219V_REG_CTRL_EXT, 0, I219V_CTRL_EXT_IAME);
+    DeviceContext->InterruptAutoMask = TRUE;
     
     // Включение прерываний
+    // (MDAC разрешает модуль PHY на время асинхронной операции MDIC)
     I219vWriteRegister(DeviceContext, I219V_REG_IMS, 
-                     I219V_IMS_RXDW |       // Прерывание при приеме пакета
-                     I219V_IMS_TXDW |       // Прерывание при передаче пакета
-                     I219V_IMS_LSC);        // Прерывание при изменении состояния соединения
+                     I219V_ICR_RX_CAUSES |  // Прием пакета (RXDW) и мелкий пакет (SRPD)
+                     I219V_ICR_TX_CAUSES |  // Передача пакета
+                     I219V_ICR_LINK_CAUSES);// Изменение состояния соединения
     
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "I219-v device enabled");
 }
@@ -283,14 +851,10 @@ I219vDisableDevice(
     I219vWriteRegister(DeviceContext, I219V_REG_IMC, 0xFFFFFFFF);
     
     // Отключение приема
-    UINT32 rctl = I219vReadRegister(DeviceContext, I219V_REG_RCTL);
-    rctl &= ~I219V_RCTL_EN;
-    I219vWriteRegister(DeviceContext, I219V_REG_RCTL, rctl);
+    I219vModifyRegister(DeviceContext, I219V_REG_RCTL, I219V_RCTL_EN, 0);
     
     // Отключение передачи
-    UINT32 tctl = I219vReadRegister(DeviceContext, I219V_REG_TCTL);
-    tctl &= ~I219V_TCTL_EN;
-    I219vWriteRegister(DeviceContext, I219V_REG_TCTL, tctl);
+    I219vModifyRegister(DeviceContext, I219V_REG_TCTL, I219V_TCTL_EN, 0);
     
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "I219-v device disabled");
 }
@@ -305,13 +869,11 @@ I219vPauseDevice(
     
     // Отключение прерываний приема и передачи, оставляем только LSC
     I219vWriteRegister(DeviceContext, I219V_REG_IMC, 
-                     I219V_IMS_RXDW |       // Прерывание при приеме пакета
-                     I219V_IMS_TXDW);       // Прерывание при передаче пакета
+                     I219V_ICR_RX_CAUSES |  // Прием пакета (RXDW) и мелкий пакет (SRPD)
+                     I219V_ICR_TX_CAUSES);  // Передача пакета
     
     // Отключение приема
-    UINT32 rctl = I219vReadRegister(DeviceContext, I219V_REG_RCTL);
-    rctl &= ~I219V_RCTL_EN;
-    I219vWriteRegister(DeviceContext, I219V_REG_RCTL, rctl);
+    I219vModifyRegister(DeviceContext, I219V_REG_RCTL, I219V_RCTL_EN, 0);
     
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "I219-v device paused");
 }
@@ -325,15 +887,32 @@ I219vRestartDevice(
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Restarting I219-v device");
     
     // Включение приема
-    UINT32 rctl = I219vReadRegister(DeviceContext, I219V_REG_RCTL);
-    rctl |= I219V_RCTL_EN;
-    I219vWriteRegister(DeviceContext, I219V_REG_RCTL, rctl);
+    I219vModifyRegister(DeviceContext, I219V_REG_RCTL, 0, I219V_RCTL_EN);
     
     // Включение прерываний
+    // (MDAC разрешает модуль PHY на время асинхронной операции MDIC)
     I219vWriteRegister(DeviceContext, I219V_REG_IMS, 
-                     I219V_IMS_RXDW |       // Прерывание при приеме пакета
-                     I219V_IMS_TXDW |       // Прерывание при передаче пакета
-                     I219V_IMS_LSC);        // Прерывание при изменении состояния соединения
+                     I219V_ICR_RX_CAUSES |  // Прием пакета (RXDW) и мелкий пакет (SRPD)
+                     I219V_ICR_TX_CAUSES |  // Передача пакета
+                     I219V_ICR_LINK_CAUSES);// Изменение состояния соединения
     
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "I219-v device restarted");
 }
+
+// Скорость соединения (Мбит/с) по регистру STATUS
+// MAC фиксирует результат автосогласования в STATUS.SPEED, поэтому скорость
+// и дуплекс доступны одним чтением MMIO без обращения к PHY через MDIC.
+UINT32
+I219vDecodeLinkSpeed(
+    _In_ UINT32 Status
+    )
+{
+    switch (Status & I219V_STATUS_SPEED_MASK) {
+    case I219V_STATUS_SPEED_10:
+        return 10;
+    case I219V_STATUS_SPEED_100:
+        return 100;
+    default:
+        return 1000;
+    }
+}
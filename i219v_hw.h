@@ -22,14 +22,18 @@ Environment:
 #include <ntddk.h>
 #include <wdf.h>
 #include <netadaptercx.h>
+#include "i219v_mmio.h"
 
 // Определения регистров устройства Intel i219-v
 #define I219V_REG_CTRL      0x0000  // Регистр управления
 #define I219V_REG_STATUS    0x0008  // Регистр статуса
 #define I219V_REG_EERD      0x0014  // EEPROM Read Register
+#define I219V_REG_CTRL_EXT  0x0018  // Extended Device Control Register
 #define I219V_REG_ICR       0x00C0  // Interrupt Cause Read Register
+#define I219V_REG_ICS       0x00C8  // Interrupt Cause Set Register
 #define I219V_REG_IMS       0x00D0  // Interrupt Mask Set Register
 #define I219V_REG_IMC       0x00D8  // Interrupt Mask Clear Register
+#define I219V_REG_IAM       0x00E0  // Interrupt Acknowledge Auto Mask Register
 #define I219V_REG_RCTL      0x0100  // Receive Control Register
 #define I219V_REG_TCTL      0x0400  // Transmit Control Register
 #define I219V_REG_RDBAL     0x2800  // Rx Descriptor Base Address Low
@@ -48,6 +52,19 @@ Environment:
 // Биты регистра управления (CTRL)
 #define I219V_CTRL_RST      0x04000000  // Device Reset
 #define I219V_CTRL_SLU      0x00000040  // Set Link Up
+#define I219V_CTRL_PHY_RST  0x80000000  // PHY Reset (снимается сбросом MAC)
+
+// Биты регистра статуса (STATUS)
+#define I219V_STATUS_FD     0x00000001  // Full Duplex
+#define I219V_STATUS_LU     0x00000002  // Link Up
+#define I219V_STATUS_SPEED_MASK 0x000000C0  // Скорость соединения (результат автосогласования)
+#define I219V_STATUS_SPEED_10   0x00000000  // 10 Мбит/с
+#define I219V_STATUS_SPEED_100  0x00000040  // 100 Мбит/с
+#define I219V_STATUS_SPEED_1000 0x00000080  // 1000 Мбит/с (значение 11b также означает 1000 Мбит/с)
+#define I219V_STATUS_LAN_INIT_DONE 0x00000200  // Загрузка конфигурации после сброса завершена
+
+// Биты расширенного регистра управления (CTRL_EXT)
+#define I219V_CTRL_EXT_IAME 0x08000000  // Interrupt Acknowledge Auto-mask Enable
 
 // Биты регистра управления приемом (RCTL)
 #define I219V_RCTL_EN       0x00000002  // Receiver Enable
@@ -62,7 +79,192 @@ Environment:
 #define I219V_IMS_TXDW      0x00000001  // Transmit Descriptor Written Back
 #define I219V_IMS_RXDW      0x00000080  // Receive Descriptor Written Back
 #define I219V_IMS_LSC       0x00000004  // Link Status Change
+#define I219V_IMS_SRPD      0x00010000  // Small Receive Packet Detected
+#define I219V_IMS_MDAC      0x00000200  // MDI/O Access Complete
+
+// Причины прерывания, обрабатываемые драйвером (совпадают с битами ICR)
+// Мелкий пакет (RSRPD) вызывает прерывание сразу, минуя таймеры RDTR/RADV
+#define I219V_ICR_RX_CAUSES     (I219V_IMS_RXDW | I219V_IMS_SRPD)
+#define I219V_ICR_TX_CAUSES     I219V_IMS_TXDW
+#define I219V_ICR_LINK_CAUSES   I219V_IMS_LSC
+#define I219V_ICR_PHY_CAUSES    I219V_IMS_MDAC
+#define I219V_ICR_HANDLED_CAUSES (I219V_ICR_RX_CAUSES | I219V_ICR_TX_CAUSES | I219V_ICR_LINK_CAUSES | I219V_ICR_PHY_CAUSES)
+
+// Бит ICR: прерывание выставлено этим устройством; чтение ICR с этим битом
+// при CTRL_EXT.IAME маскирует причины из IAM без записи в IMC
+#define I219V_ICR_INT_ASSERTED  0x80000000
+
+// Причины, маскируемые автоматически (причина соединения редка и
+// маскируется записью в IMC, чтобы не требовать повторного разрешения в DPC)
+#define I219V_ICR_AUTO_MASK_CAUSES (I219V_ICR_RX_CAUSES | I219V_ICR_TX_CAUSES)
+
+// Размер области регистров (BAR0) MAC семейства PCH
+#define I219V_REGISTER_SPACE_SIZE   0x20000
+
+// Карта регистров быстрого пути (ISR, DPC, дверные звонки RDT/TDT)
+// Быстрые обращения принимают имя из этой карты, а не смещение: регистр вне
+// карты не компилируется, а смещения карты проверяются при компиляции.
+// Отображение области регистров проверяется один раз в
+// I219vEvtDevicePrepareHardware (I219vValidateFastRegisterMap).
+#define I219V_FAST_REG_ICR          I219V_REG_ICR
+#define I219V_FAST_REG_IMS          I219V_REG_IMS
+#define I219V_FAST_REG_IMC          I219V_REG_IMC
+#define I219V_FAST_REG_RDT          I219V_REG_RDT
+#define I219V_FAST_REG_TDT          I219V_REG_TDT
+
+// Наибольшее смещение карты плюс размер регистра
+#define I219V_FAST_REGISTER_SPAN    (I219V_REG_TDT + sizeof(ULONG))
+
+#define I219V_FAST_REG_VALID(_Offset) \
+    (((_Offset) % sizeof(ULONG)) == 0 && (_Offset) + sizeof(ULONG) <= I219V_FAST_REGISTER_SPAN)
+
+C_ASSERT(I219V_FAST_REG_VALID(I219V_FAST_REG_ICR));
+C_ASSERT(I219V_FAST_REG_VALID(I219V_FAST_REG_IMS));
+C_ASSERT(I219V_FAST_REG_VALID(I219V_FAST_REG_IMC));
+C_ASSERT(I219V_FAST_REG_VALID(I219V_FAST_REG_RDT));
+C_ASSERT(I219V_FAST_REG_VALID(I219V_FAST_REG_TDT));
+C_ASSERT(I219V_FAST_REGISTER_SPAN <= I219V_REGISTER_SPACE_SIZE);
+
+// Поведенческая модель устройства (i219v_model.c) вместо области регистров
+// Компилируется только при сборке с I219V_DEVICE_MODEL=1 (свойство проекта
+// I219vDeviceModel: msbuild /p:I219vDeviceModel=1) в любой конфигурации.
+#ifndef I219V_DEVICE_MODEL
+#define I219V_DEVICE_MODEL          0
+#endif
+
+// Быстрые обращения к регистрам: без проверок и трассировки
+// (проверяющие I219vReadRegister/I219vWriteRegister остаются для остального кода)
+// Проверки заменяет однократная I219vValidateFastRegisterMap при отображении
+// BAR0: пока область не проверена (до PrepareHardware, после ReleaseHardware,
+// с подключенной моделью), обращения идут через проверяющий слой доступа.
+// Подключение модели снимает признак проверки, поэтому путь данных
+// обслуживается моделью без отдельного варианта быстрых обращений.
+// При включенном профилировщике обращения учитываются в категории пути данных.
+#if I219V_MMIO_PROFILER
+#define I219vReadRegisterFast(_DeviceContext, _Name) \
+    (!(_DeviceContext)->FastRegistersValidated ? \
+        I219vReadRegisterEx((_DeviceContext), I219V_FAST_REG_##_Name, I219V_MMIO_CATEGORY_DATAPATH) : \
+     (_DeviceContext)->MmioProfile.Enabled ? \
+        I219vMmioProfileRead((_DeviceContext), I219V_FAST_REG_##_Name, I219V_MMIO_CATEGORY_DATAPATH) : \
+        READ_REGISTER_ULONG((volatile ULONG*)((PUCHAR)(_DeviceContext)->RegisterBase + I219V_FAST_REG_##_Name)))
+
+#define I219vWriteRegisterFast(_DeviceContext, _Name, _Value) \
+    do { \
+        if (!(_DeviceContext)->FastRegistersValidated) { \
+            I219vWriteRegisterEx((_DeviceContext), I219V_FAST_REG_##_Name, (_Value), I219V_MMIO_CATEGORY_DATAPATH); \
+        } else if ((_DeviceContext)->MmioProfile.Enabled) { \
+            I219vMmioProfileWrite((_DeviceContext), I219V_FAST_REG_##_Name, (_Value), I219V_MMIO_CATEGORY_DATAPATH); \
+        } else { \
+            WRITE_REGISTER_ULONG((volatile ULONG*)((PUCHAR)(_DeviceContext)->RegisterBase + I219V_FAST_REG_##_Name), (_Value)); \
+        } \
+    } while (0)
+#else
+#define I219vReadRegisterFast(_DeviceContext, _Name) \
+    ((_DeviceContext)->FastRegistersValidated ? \
+        READ_REGISTER_ULONG((volatile ULONG*)((PUCHAR)(_DeviceContext)->RegisterBase + I219V_FAST_REG_##_Name)) : \
+        I219vReadRegisterEx((_DeviceContext), I219V_FAST_REG_##_Name, I219V_MMIO_CATEGORY_DATAPATH))
+
+#define I219vWriteRegisterFast(_DeviceContext, _Name, _Value) \
+    do { \
+        if ((_DeviceContext)->FastRegistersValidated) { \
+            WRITE_REGISTER_ULONG((volatile ULONG*)((PUCHAR)(_DeviceContext)->RegisterBase + I219V_FAST_REG_##_Name), (_Value)); \
+        } else { \
+            I219vWriteRegisterEx((_DeviceContext), I219V_FAST_REG_##_Name, (_Value), I219V_MMIO_CATEGORY_DATAPATH); \
+        } \
+    } while (0)
+#endif
+
+// Теневая копия управляющих регистров, принадлежащих драйверу
+// Чтение-модификация-запись этих регистров выполняется над копией без
+// чтения MMIO; каждая запись через I219vWriteRegister обновляет копию.
+// Запись бита CTRL.RST сбрасывает копию целиком (сброс меняет все регистры).
+// Биты состояния, изменяемые устройством, читаются через I219vReadRegister;
+// поэтому RXCW (состояние приема конфигурации) и EEER (состояние LPI)
+// в копию не входят.
+typedef enum _I219V_SHADOW_REGISTER {
+    I219V_SHADOW_CTRL = 0,
+    I219V_SHADOW_CTRL_EXT,
+    I219V_SHADOW_RCTL,
+    I219V_SHADOW_TCTL,
+    I219V_SHADOW_RXDCTL,
+    I219V_SHADOW_TXDCTL,
+    I219V_SHADOW_RXCSUM,
+    I219V_SHADOW_RFCTL,
+    I219V_SHADOW_TXCW,
+    I219V_SHADOW_TQAVCC,
+    I219V_SHADOW_REGISTER_COUNT
+} I219V_SHADOW_REGISTER;
+
+// Статистика теневой копии регистров
+typedef struct _I219V_REGISTER_SHADOW_STATS {
+    UINT64 Hits;                                    // Чтения, обслуженные копией
+    UINT64 Misses;                                  // Чтения MMIO для заполнения копии
+    UINT64 ElidedWrites;                            // Пропущенные записи без изменения значения
+    UINT64 Invalidations;                           // Сбросы копии (сброс устройства, D0, освобождение ресурсов)
+    UINT64 DiscardedFills;                          // Заполнения, отброшенные из-за записи во время чтения MMIO
+} I219V_REGISTER_SHADOW_STATS, *PI219V_REGISTER_SHADOW_STATS;
+
+// Состояние теневой копии регистров
+// Lock - листовая блокировка: может захватываться под GamingSettingsLock
+typedef struct _I219V_REGISTER_SHADOW {
+    WDFSPINLOCK Lock;                               // Защита копии
+    ULONG ValidMask;                                // Бит на регистр: копия совпадает с устройством
+    ULONG Generation;                               // Счетчик изменений копии (записи и сбросы)
+    UINT32 Values[I219V_SHADOW_REGISTER_COUNT];     // Значения регистров
+    I219V_REGISTER_SHADOW_STATS Stats;              // Статистика
+} I219V_REGISTER_SHADOW, *PI219V_REGISTER_SHADOW;
+
+C_ASSERT(I219V_SHADOW_REGISTER_COUNT <= sizeof(ULONG) * 8);
+
+// Транзакция записи регистров
+// Собирает итоговые значения регистров (повторные изменения одного регистра
+// сливаются в одну запись) и записывает их при фиксации в безопасном для
+// устройства порядке с одним сбросом отложенных записей. Ошибка на этапе
+// сбора отменяет транзакцию без обращения к устройству; ошибкой считается
+// и попытка этапа задать другое значение битам, уже заданным другим этапом
+// (порядок этапов не должен решать исход). Если устройство не отвечает
+// после записи, исходные значения восстанавливаются в обратном порядке.
+#define I219V_REGISTER_TRANSACTION_MAX_ENTRIES  16
+
+typedef struct _I219V_REGISTER_TRANSACTION_ENTRY {
+    UINT32 Register;                                // Смещение регистра
+    UINT32 OriginalValue;                           // Значение до транзакции (для отката)
+    UINT32 Value;                                   // Итоговое значение
+    UINT32 StagedMask;                              // Биты, заданные этапами сбора
+} I219V_REGISTER_TRANSACTION_ENTRY, *PI219V_REGISTER_TRANSACTION_ENTRY;
+
+typedef struct _I219V_REGISTER_TRANSACTION {
+    struct _I219V_DEVICE_CONTEXT* DeviceContext;
+    NTSTATUS Status;                                // Первая ошибка этапа сбора
+    ULONG EntryCount;
+    ULONG CoalescedWrites;                          // Изменения, слитые с уже собранными
+    I219V_REGISTER_TRANSACTION_ENTRY Entries[I219V_REGISTER_TRANSACTION_MAX_ENTRIES];
+} I219V_REGISTER_TRANSACTION, *PI219V_REGISTER_TRANSACTION;
 
 // Объявление функций для работы с аппаратным обеспечением
 UINT32 I219vReadRegister(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 Register);
 VOID I219vWriteRegister(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 Register, _In_ UINT32 Value);
+UINT32 I219vReadRegisterEx(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 Register, _In_ I219V_MMIO_CATEGORY Category);
+VOID I219vWriteRegisterEx(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 Register, _In_ UINT32 Value, _In_ I219V_MMIO_CATEGORY Category);
+NTSTATUS I219vValidateFastRegisterMap(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+
+#if I219V_DEVICE_MODEL
+// Подключение модели к контексту устройства вместо области регистров
+VOID I219vAttachDeviceModel(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ struct _I219V_DEVICE_MODEL* Model);
+VOID I219vDetachDeviceModel(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+#endif
+UINT32 I219vDecodeLinkSpeed(_In_ UINT32 Status);
+
+// Объявление функций теневой копии регистров
+NTSTATUS I219vInitializeRegisterShadow(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vInvalidateRegisterShadow(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+UINT32 I219vReadRegisterShadow(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 Register);
+UINT32 I219vModifyRegister(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 Register, _In_ UINT32 ClearBits, _In_ UINT32 SetBits);
+VOID I219vGetRegisterShadowStats(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_REGISTER_SHADOW_STATS ShadowStats);
+
+// Объявление функций транзакции записи регистров
+VOID I219vBeginRegisterTransaction(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_REGISTER_TRANSACTION Transaction);
+VOID I219vTransactionModify(_Inout_ PI219V_REGISTER_TRANSACTION Transaction, _In_ UINT32 Register, _In_ UINT32 ClearBits, _In_ UINT32 SetBits);
+VOID I219vTransactionWrite(_Inout_ PI219V_REGISTER_TRANSACTION Transaction, _In_ UINT32 Register, _In_ UINT32 Value);
+VOID I219vTransactionFail(_Inout_ PI219V_REGISTER_TRANSACTION Transaction, _In_ NTSTATUS Status);
+NTSTATUS I219vCommitRegisterTransaction(_Inout_ PI219V_REGISTER_TRANSACTION Transaction);
@@ -26,6 +26,26 @@ Environment:
 // Дополнительные регистры для игровых функций
 #define I219V_REG_TQAVCC        0x3004  // Регистр управления приоритетами трафика
 #define I219V_REG_ITR           0x00C4  // Регистр модерации прерываний
+#define I219V_REG_RDTR          0x2820  // Таймер задержки прерывания приема (от пакета)
+#define I219V_REG_RADV          0x282C  // Абсолютный таймер задержки прерывания приема
+#define I219V_REG_TIDV          0x3820  // Таймер задержки прерывания передачи (от пакета)
+#define I219V_REG_TADV          0x382C  // Абсолютный таймер задержки прерывания передачи
+#define I219V_REG_RSRPD         0x2C00  // Порог обнаружения мелких принятых пакетов
+#define I219V_REG_TXCW          0x0178  // Регистр управления передачей конфигурации
+#define I219V_REG_RXCW          0x0180  // Регистр управления приемом конфигурации
+#define I219V_REG_EEER          0x0E30  // Регистр Energy Efficient Ethernet
+#define I219V_REG_RXDCTL        0x2828  // Управление дескрипторами приема
+#define I219V_REG_TXDCTL        0x3828  // Управление дескрипторами передачи
+#define I219V_REG_RXCSUM        0x5000  // Управление контрольной суммой приема
+#define I219V_REG_RFCTL         0x5008  // Управление фильтрами приема
+
+// Таймеры задержки RDTR/RADV/TIDV/TADV: 16-битное поле, единицы 1.024 мкс
+#define I219V_DELAY_TIMER_UNIT_NS   1024
+#define I219V_DELAY_TIMER_MASK      0x0000FFFF
+#define I219V_DELAY_TIMER_FPD       0x80000000  // Flush Partial Descriptor Block (RDTR/TIDV)
+
+// Регистр RSRPD: размер пакета в байтах, 12-битное поле (0 - обнаружение отключено)
+#define I219V_RSRPD_SIZE_MASK       0x00000FFF
 
 // Биты для регистра TXCW
 #define I219V_TXCW_QOS_ENABLE   0x00000400  // Бит включения QoS
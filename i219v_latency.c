@@ -0,0 +1,323 @@
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_latency.c
+
+Abstract:
+
+    Реализация измерения задержки по этапам пути данных для драйвера Intel i219-v.
+    Метки времени в ISR и DPC сохраняются только для первого необработанного
+    прерывания с причиной приема и забираются продвижением очереди приема
+    вместе с собранными кадрами. Для каждого кадра фиксируется момент сбора
+    дескриптора; момент передачи стеку общий для всех кадров вызова. Этапы,
+    метки которых отсутствуют (режим опроса) или идут не по порядку (кадры
+    собраны до DPC), не учитываются.
+
+    Счетчик тактов читается одной инструкцией и переводится в наносекунды
+    по частоте, измеренной при инициализации относительно счетчика
+    производительности. Интервал гистограммы вычисляется по старшему
+    установленному биту, поэтому учет замера не требует деления.
+
+    Аппаратные метки времени приема у i219-v доступны только для пакетов
+    PTP и не передаются в унаследованных дескрипторах, поэтому этап
+    "прибытие в устройство - ISR" не измеряется.
+
+    При передаче метки хранятся в слоте первого дескриптора пакета, как и
+    метаданные. Пакеты одной пачки получают общую метку получения от стека,
+    запись дескрипторов отмечается для каждого пакета, запись TDT - одна на
+    вызов продвижения очереди. Завершение отмечается при обнаружении DD в
+    возврате пакетов. Если кольцо заполнено, первый отложенный пакет
+    сохраняет время, когда он был получен впервые, так что этап "получение -
+    запись дескрипторов" включает ожидание освобождения кольца.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+#include "Driver.h"
+#include "Device.h"
+#include "i219v_gaming.h"
+#include "i219v_latency.h"
+#include "DeviceContext.h"
+#include "Trace.h"
+
+// Длительность калибровки частоты TSC (мкс)
+#define I219V_LATENCY_CALIBRATION_US    1000
+
+// Наибольшая длительность в тактах, переводимая без переполнения
+#define I219V_LATENCY_MAX_CYCLES        0xFFFFFFFFULL
+
+// Перевод тактов в наносекунды
+static
+UINT32
+I219vLatencyCyclesToNs(
+    _In_ PI219V_LATENCY_STATE Latency,
+    _In_ UINT64 Cycles
+    )
+{
+    UINT64 ns;
+
+    if (Cycles > I219V_LATENCY_MAX_CYCLES) {
+        Cycles = I219V_LATENCY_MAX_CYCLES;
+    }
+
+    ns = (Cycles * Latency->NsPerCycleQ32) >> 32;
+
+    return (ns > MAXUINT32) ? MAXUINT32 : (UINT32)ns;
+}
+
+// Номер интервала лог-линейной гистограммы
+static
+UINT32
+I219vLatencyBucket(
+    _In_ UINT32 ValueNs
+    )
+{
+    ULONG msb;
+    UINT32 bucket;
+
+    if (ValueNs < I219V_LATENCY_SUB_BUCKETS) {
+        return ValueNs;
+    }
+
+    _BitScanReverse(&msb, ValueNs);
+
+    bucket = (msb - I219V_LATENCY_SUB_BUCKET_BITS + 1) * I219V_LATENCY_SUB_BUCKETS +
+             ((ValueNs >> (msb - I219V_LATENCY_SUB_BUCKET_BITS)) & (I219V_LATENCY_SUB_BUCKETS - 1));
+
+    return (bucket < I219V_LATENCY_BUCKET_COUNT) ? bucket : I219V_LATENCY_BUCKET_COUNT - 1;
+}
+
+// Учет одного замера в гистограмме
+static
+VOID
+I219vLatencyRecord(
+    _In_ PI219V_LATENCY_STATE Latency,
+    _Inout_ PI219V_LATENCY_HISTOGRAM Histogram,
+    _In_ UINT64 Cycles
+    )
+{
+    UINT32 ns = I219vLatencyCyclesToNs(Latency, Cycles);
+
+    Histogram->Samples++;
+    Histogram->TotalNs += ns;
+    if (ns > Histogram->MaxNs) {
+        Histogram->MaxNs = ns;
+    }
+    Histogram->Buckets[I219vLatencyBucket(ns)]++;
+}
+
+// Инициализация и калибровка счетчика тактов
+// Вызывается на PASSIVE_LEVEL из I219vEvtDeviceAdd.
+VOID
+I219vInitializeLatency(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_LATENCY_STATE latency = &DeviceContext->Latency;
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counterStart;
+    LARGE_INTEGER counterEnd;
+    UINT64 cyclesStart;
+    UINT64 cycles;
+    UINT64 elapsedNs;
+
+    counterStart = KeQueryPerformanceCounter(&frequency);
+    cyclesStart = I219V_LATENCY_TIMESTAMP();
+
+    KeStallExecutionProcessor(I219V_LATENCY_CALIBRATION_US);
+
+    cycles = I219V_LATENCY_TIMESTAMP() - cyclesStart;
+    counterEnd = KeQueryPerformanceCounter(NULL);
+
+    elapsedNs = ((UINT64)(counterEnd.QuadPart - counterStart.QuadPart) * 1000000000ULL) / (UINT64)frequency.QuadPart;
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+
+    RtlZeroMemory(latency, sizeof(I219V_LATENCY_STATE));
+
+    if (cycles != 0 && elapsedNs != 0) {
+        latency->CyclesPerUs = (UINT32)((cycles * 1000) / elapsedNs);
+        latency->NsPerCycleQ32 = (elapsedNs << 32) / cycles;
+    }
+
+    latency->Rx.CyclesPerUs = latency->CyclesPerUs;
+    latency->Rx.BucketSubBits = I219V_LATENCY_SUB_BUCKET_BITS;
+    latency->Tx.CyclesPerUs = latency->CyclesPerUs;
+    latency->Tx.BucketSubBits = I219V_LATENCY_SUB_BUCKET_BITS;
+
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "Latency instrumentation: %u TSC cycles/us", latency->CyclesPerUs);
+}
+
+// Сброс гистограмм (например, перед сравнением настроек ITR или опроса)
+VOID
+I219vResetLatencyStats(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_LATENCY_STATE latency = &DeviceContext->Latency;
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    RtlZeroMemory(latency->Rx.Stages, sizeof(latency->Rx.Stages));
+    RtlZeroMemory(latency->Tx.Stages, sizeof(latency->Tx.Stages));
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Получение гистограмм приема
+VOID
+I219vGetRxLatencyStats(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PI219V_RX_LATENCY_STATS RxLatencyStats
+    )
+{
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    RtlCopyMemory(RxLatencyStats, &DeviceContext->Latency.Rx, sizeof(I219V_RX_LATENCY_STATS));
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Получение гистограмм передачи
+VOID
+I219vGetTxLatencyStats(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PI219V_TX_LATENCY_STATS TxLatencyStats
+    )
+{
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    RtlCopyMemory(TxLatencyStats, &DeviceContext->Latency.Tx, sizeof(I219V_TX_LATENCY_STATS));
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Учет задержки собранных кадров
+// Вызывается из продвижения очереди приема под GamingSettingsLock.
+VOID
+I219vLatencyRecordRx(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_reads_(Count) const UINT64* HarvestCycles,
+    _In_reads_(Count) const UCHAR* TrafficClasses,
+    _In_ UINT32 Count,
+    _In_ UINT64 IndicateCycles
+    )
+{
+    PI219V_LATENCY_STATE latency = &DeviceContext->Latency;
+    UINT64 isrCycles;
+    UINT64 dpcCycles;
+    BOOLEAN isrValid;
+    BOOLEAN dpcValid;
+    UINT32 i;
+
+    if (Count == 0 || latency->NsPerCycleQ32 == 0) {
+        return;
+    }
+
+    isrCycles = (UINT64)InterlockedExchange64(&latency->RxIsrCycles, 0);
+    dpcCycles = (UINT64)InterlockedExchange64(&latency->RxDpcCycles, 0);
+
+    isrValid = (isrCycles != 0 && isrCycles <= IndicateCycles);
+    dpcValid = (dpcCycles != 0 && dpcCycles <= IndicateCycles);
+
+    if (isrValid && dpcValid && isrCycles <= dpcCycles) {
+        // Этап ISR - DPC общий для кадров вызова, но учитывается для каждого
+        // кадра, чтобы распределение отражало задержку пакетов, а не прерываний
+        for (i = 0; i < Count; i++) {
+            I219vLatencyRecord(latency, &latency->Rx.Stages[I219V_RX_STAGE_ISR_TO_DPC][TrafficClasses[i]],
+                               dpcCycles - isrCycles);
+        }
+    }
+
+    for (i = 0; i < Count; i++) {
+        UCHAR trafficClass = TrafficClasses[i];
+
+        if (dpcValid && dpcCycles <= HarvestCycles[i]) {
+            I219vLatencyRecord(latency, &latency->Rx.Stages[I219V_RX_STAGE_DPC_TO_HARVEST][trafficClass],
+                               HarvestCycles[i] - dpcCycles);
+        }
+
+        I219vLatencyRecord(latency, &latency->Rx.Stages[I219V_RX_STAGE_HARVEST_TO_INDICATE][trafficClass],
+                           IndicateCycles - HarvestCycles[i]);
+
+        if (isrValid) {
+            I219vLatencyRecord(latency, &latency->Rx.Stages[I219V_RX_STAGE_ISR_TO_INDICATE][trafficClass],
+                               IndicateCycles - isrCycles);
+        }
+    }
+}
+
+// Метка записи TDT для пакетов, поставленных текущим вызовом
+// Слоты обходятся по пакетам с шагом в количество их дескрипторов.
+// Вызывается из продвижения очереди передачи под GamingSettingsLock.
+VOID
+I219vLatencyStampDoorbell(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 FirstSlot,
+    _In_ UINT32 Tail,
+    _In_ UINT64 DoorbellCycles
+    )
+{
+    UINT32 slot = FirstSlot;
+
+    while (slot != Tail) {
+        PI219V_TX_LATENCY_SLOT latencySlot = &DeviceContext->TxLatencySlots[slot];
+
+        latencySlot->DoorbellCycles = DoorbellCycles;
+
+        if (latencySlot->Descriptors == 0) {
+            break;
+        }
+        slot = (slot + latencySlot->Descriptors) % I219V_TX_RING_SIZE;
+    }
+}
+
+// Учет задержки завершенного пакета передачи
+// Вызывается из возврата пакетов под GamingSettingsLock.
+VOID
+I219vLatencyRecordTx(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ PI219V_TX_LATENCY_SLOT Slot,
+    _In_ UINT64 CompleteCycles
+    )
+{
+    PI219V_LATENCY_STATE latency = &DeviceContext->Latency;
+    UCHAR priority = Slot->Priority;
+
+    if (Slot->SubmitCycles == 0 || latency->NsPerCycleQ32 == 0) {
+        return;
+    }
+
+    if (priority >= I219V_TRAFFIC_PRIORITY_COUNT) {
+        priority = I219V_TRAFFIC_PRIORITY_LOWEST;
+    }
+
+    // Метки идут по порядку, если пакет был поставлен и TDT записан на этом
+    // же процессоре; при переносе потока между процессорами этапы пропускаются
+    if (Slot->PostCycles >= Slot->SubmitCycles) {
+        I219vLatencyRecord(latency, &latency->Tx.Stages[I219V_TX_STAGE_SUBMIT_TO_POST][priority],
+                           Slot->PostCycles - Slot->SubmitCycles);
+    }
+
+    if (Slot->DoorbellCycles >= Slot->PostCycles) {
+        I219vLatencyRecord(latency, &latency->Tx.Stages[I219V_TX_STAGE_POST_TO_DOORBELL][priority],
+                           Slot->DoorbellCycles - Slot->PostCycles);
+
+        if (CompleteCycles >= Slot->DoorbellCycles) {
+            I219vLatencyRecord(latency, &latency->Tx.Stages[I219V_TX_STAGE_DOORBELL_TO_COMPLETE][priority],
+                               CompleteCycles - Slot->DoorbellCycles);
+        }
+    }
+
+    if (CompleteCycles >= Slot->SubmitCycles) {
+        I219vLatencyRecord(latency, &latency->Tx.Stages[I219V_TX_STAGE_SUBMIT_TO_COMPLETE][priority],
+                           CompleteCycles - Slot->SubmitCycles);
+    }
+
+    Slot->SubmitCycles = 0;
+}
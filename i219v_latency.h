@@ -0,0 +1,136 @@
+#pragma once
+
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_latency.h
+
+Abstract:
+
+    Заголовочный файл для измерения задержки по этапам пути данных Intel i219-v.
+    Метки времени берутся счетчиком тактов процессора (TSC). Для приема - в
+    ISR, в начале DPC, при сборе дескриптора и при передаче пакетов стеку;
+    для передачи - при получении пакета от стека, записи дескрипторов,
+    записи TDT и обнаружении завершения. Длительности этапов накапливаются
+    в лог-линейных гистограммах отдельно для каждого класса трафика (прием)
+    или уровня приоритета (передача).
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+#include "i219v_gaming.h"
+
+// Метка времени пути данных (такты TSC)
+#define I219V_LATENCY_TIMESTAMP()           ReadTimeStampCounter()
+
+// Лог-линейная гистограмма: значения 0-3 нс имеют собственные интервалы,
+// далее каждая степень двойки делится на I219V_LATENCY_SUB_BUCKETS равных
+// частей. Значения от 2^25 нс (~33 мс) попадают в последний интервал.
+#define I219V_LATENCY_SUB_BUCKET_BITS       2
+#define I219V_LATENCY_SUB_BUCKETS           (1 << I219V_LATENCY_SUB_BUCKET_BITS)
+#define I219V_LATENCY_BUCKET_COUNT          96
+
+// Этапы приема
+typedef enum _I219V_RX_LATENCY_STAGE {
+    I219V_RX_STAGE_ISR_TO_DPC = 0,          // Вход в ISR - начало DPC
+    I219V_RX_STAGE_DPC_TO_HARVEST = 1,      // Начало DPC - сбор дескриптора
+    I219V_RX_STAGE_HARVEST_TO_INDICATE = 2, // Сбор дескриптора - передача пакета стеку
+    I219V_RX_STAGE_ISR_TO_INDICATE = 3      // Вход в ISR - передача пакета стеку (итог)
+} I219V_RX_LATENCY_STAGE;
+
+#define I219V_RX_LATENCY_STAGE_COUNT        4
+
+// Этапы передачи
+typedef enum _I219V_TX_LATENCY_STAGE {
+    I219V_TX_STAGE_SUBMIT_TO_POST = 0,      // Получение от стека - запись дескрипторов (программный планировщик)
+    I219V_TX_STAGE_POST_TO_DOORBELL = 1,    // Запись дескрипторов - запись TDT
+    I219V_TX_STAGE_DOORBELL_TO_COMPLETE = 2,// Запись TDT - обнаружение DD (устройство и глубина кольца)
+    I219V_TX_STAGE_SUBMIT_TO_COMPLETE = 3   // Получение от стека - обнаружение DD (итог)
+} I219V_TX_LATENCY_STAGE;
+
+#define I219V_TX_LATENCY_STAGE_COUNT        4
+
+// Гистограмма длительности этапа
+typedef struct _I219V_LATENCY_HISTOGRAM {
+    UINT64 Samples;                                 // Количество замеров
+    UINT64 TotalNs;                                 // Сумма длительностей (нс)
+    UINT32 MaxNs;                                   // Наибольшая длительность (нс)
+    UINT32 Buckets[I219V_LATENCY_BUCKET_COUNT];     // Количество замеров по интервалам
+} I219V_LATENCY_HISTOGRAM, *PI219V_LATENCY_HISTOGRAM;
+
+// Гистограммы приема по этапам и классам трафика
+// Без приоритизации трафика пакеты не классифицируются и учитываются как фоновые.
+typedef struct _I219V_RX_LATENCY_STATS {
+    UINT32 CyclesPerUs;                             // Частота TSC, измеренная при инициализации
+    UINT32 BucketSubBits;                           // I219V_LATENCY_SUB_BUCKET_BITS (для разбора гистограмм)
+    I219V_LATENCY_HISTOGRAM Stages[I219V_RX_LATENCY_STAGE_COUNT][I219V_TRAFFIC_CLASS_COUNT];
+} I219V_RX_LATENCY_STATS, *PI219V_RX_LATENCY_STATS;
+
+// Гистограммы передачи по этапам и уровням приоритета
+typedef struct _I219V_TX_LATENCY_STATS {
+    UINT32 CyclesPerUs;                             // Частота TSC, измеренная при инициализации
+    UINT32 BucketSubBits;                           // I219V_LATENCY_SUB_BUCKET_BITS (для разбора гистограмм)
+    I219V_LATENCY_HISTOGRAM Stages[I219V_TX_LATENCY_STAGE_COUNT][I219V_TRAFFIC_PRIORITY_COUNT];
+} I219V_TX_LATENCY_STATS, *PI219V_TX_LATENCY_STATS;
+
+// Метки времени пакета передачи (по слоту первого дескриптора)
+typedef struct _I219V_TX_LATENCY_SLOT {
+    UINT64 SubmitCycles;                            // Пакет получен продвижением очереди
+    UINT64 PostCycles;                              // Дескрипторы пакета записаны
+    UINT64 DoorbellCycles;                          // TDT записан
+    UINT16 Descriptors;                             // Количество дескрипторов пакета
+    UCHAR Priority;                                 // Уровень приоритета (I219V_TRAFFIC_PRIORITY_LEVEL)
+} I219V_TX_LATENCY_SLOT, *PI219V_TX_LATENCY_SLOT;
+
+// Состояние измерения задержки
+typedef struct _I219V_LATENCY_STATE {
+    UINT32 CyclesPerUs;                             // Тактов TSC в микросекунде
+    UINT64 NsPerCycleQ32;                           // Наносекунд на такт (фиксированная точка Q32)
+    volatile LONG64 RxIsrCycles;                    // Вход в первый необработанный ISR с причиной приема
+    volatile LONG64 RxDpcCycles;                    // Начало первого необработанного DPC с причиной приема
+    I219V_RX_LATENCY_STATS Rx;                      // Гистограммы приема (защищены GamingSettingsLock)
+    UINT64 TxBlockedCycles;                         // Первый пакет, отложенный из-за заполнения кольца
+    I219V_TX_LATENCY_STATS Tx;                      // Гистограммы передачи (защищены GamingSettingsLock)
+} I219V_LATENCY_STATE, *PI219V_LATENCY_STATE;
+
+// Объявление функций измерения задержки
+VOID I219vInitializeLatency(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vResetLatencyStats(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vGetRxLatencyStats(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_RX_LATENCY_STATS RxLatencyStats);
+VOID I219vGetTxLatencyStats(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_TX_LATENCY_STATS TxLatencyStats);
+
+// Учет задержки собранных кадров (вызывается из продвижения очереди приема под GamingSettingsLock)
+VOID
+I219vLatencyRecordRx(
+    _In_ struct _I219V_DEVICE_CONTEXT* DeviceContext,
+    _In_reads_(Count) const UINT64* HarvestCycles,
+    _In_reads_(Count) const UCHAR* TrafficClasses,
+    _In_ UINT32 Count,
+    _In_ UINT64 IndicateCycles
+    );
+
+// Метка записи TDT для пакетов в слотах [FirstSlot, Tail) (вызывается под GamingSettingsLock)
+VOID
+I219vLatencyStampDoorbell(
+    _In_ struct _I219V_DEVICE_CONTEXT* DeviceContext,
+    _In_ UINT32 FirstSlot,
+    _In_ UINT32 Tail,
+    _In_ UINT64 DoorbellCycles
+    );
+
+// Учет задержки завершенного пакета передачи (вызывается под GamingSettingsLock)
+VOID
+I219vLatencyRecordTx(
+    _In_ struct _I219V_DEVICE_CONTEXT* DeviceContext,
+    _In_ PI219V_TX_LATENCY_SLOT Slot,
+    _In_ UINT64 CompleteCycles
+    );
@@ -0,0 +1,184 @@
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_mmio.c
+
+Abstract:
+
+    Реализация профилировщика обращений к регистрам Intel i219-v.
+    Слоты таблицы регистров занимаются атомарно (открытая адресация по
+    смещению регистра), счетчики обновляются атомарными операциями: учет
+    допустим на любом IRQL, включая ISR. Учет регистрируется в счетчике
+    активных обращений и повторно проверяет флаг включения; сброс сначала
+    выключает учет и дожидается завершения активных обращений, поэтому
+    обнуление таблицы не оставляет счетчиков в слотах без регистра.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+#include "Driver.h"
+#include "Device.h"
+#include "i219v_hw.h"
+#include "i219v_mmio.h"
+#include "i219v_latency.h"
+#include "DeviceContext.h"
+#include "Trace.h"
+
+C_ASSERT((I219V_MMIO_PROFILE_SLOTS & (I219V_MMIO_PROFILE_SLOTS - 1)) == 0);
+
+// Поиск или занятие слота регистра
+static
+PI219V_MMIO_REGISTER_PROFILE
+I219vMmioProfileSlot(
+    _In_ PI219V_MMIO_PROFILE Profile,
+    _In_ UINT32 Register
+    )
+{
+    PI219V_MMIO_REGISTER_PROFILE slot;
+    UINT32 key = Register + 1;
+    UINT32 index = (Register >> 2) & (I219V_MMIO_PROFILE_SLOTS - 1);
+    UINT32 probe;
+    LONG current;
+
+    for (probe = 0; probe < I219V_MMIO_PROFILE_SLOTS; probe++) {
+        slot = &Profile->Table.Registers[(index + probe) & (I219V_MMIO_PROFILE_SLOTS - 1)];
+
+        current = InterlockedCompareExchange((volatile LONG*)&slot->Register, (LONG)key, 0);
+        if (current == 0 || (UINT32)current == key) {
+            return slot;
+        }
+    }
+
+    InterlockedIncrement((volatile LONG*)&Profile->Table.DroppedAccesses);
+    return NULL;
+}
+
+// Учет обращения
+static
+VOID
+I219vMmioProfileRecord(
+    _In_ PI219V_MMIO_PROFILE Profile,
+    _In_ UINT32 Register,
+    _In_ I219V_MMIO_CATEGORY Category,
+    _In_ BOOLEAN Read,
+    _In_ UINT64 Cycles
+    )
+{
+    PI219V_MMIO_COUNTERS category = &Profile->Table.Categories[Category];
+    PI219V_MMIO_REGISTER_PROFILE slot;
+
+    // Регистрация до проверки флага: сброс, выключивший учет, дождется
+    // этого обращения или обращение увидит выключенный учет
+    InterlockedIncrement(&Profile->Recorders);
+    if (InterlockedCompareExchange(&Profile->Enabled, 0, 0) == 0) {
+        InterlockedDecrement(&Profile->Recorders);
+        return;
+    }
+
+    slot = I219vMmioProfileSlot(Profile, Register);
+
+    if (Read) {
+        InterlockedIncrement64((volatile LONG64*)&category->Reads);
+        InterlockedAdd64((volatile LONG64*)&category->ReadCycles, (LONG64)Cycles);
+        if (slot != NULL) {
+            InterlockedIncrement64((volatile LONG64*)&slot->Counters.Reads);
+            InterlockedAdd64((volatile LONG64*)&slot->Counters.ReadCycles, (LONG64)Cycles);
+        }
+    } else {
+        InterlockedIncrement64((volatile LONG64*)&category->Writes);
+        if (slot != NULL) {
+            InterlockedIncrement64((volatile LONG64*)&slot->Counters.Writes);
+        }
+    }
+
+    InterlockedDecrement(&Profile->Recorders);
+}
+
+// Учтенное чтение регистра
+// Задержка чтения MMIO - время ожидания ответа устройства по PCIe.
+ULONG
+I219vMmioProfileRead(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 Register,
+    _In_ I219V_MMIO_CATEGORY Category
+    )
+{
+    UINT64 start;
+    ULONG value;
+
+    start = I219V_LATENCY_TIMESTAMP();
+    value = READ_REGISTER_ULONG((volatile ULONG*)((PUCHAR)DeviceContext->RegisterBase + Register));
+
+    I219vMmioProfileRecord(&DeviceContext->MmioProfile, Register, Category, TRUE, I219V_LATENCY_TIMESTAMP() - start);
+
+    return value;
+}
+
+// Учтенная запись регистра
+// Записи MMIO отложенные (posted): их стоимость проявляется в следующем чтении.
+VOID
+I219vMmioProfileWrite(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 Register,
+    _In_ ULONG Value,
+    _In_ I219V_MMIO_CATEGORY Category
+    )
+{
+    WRITE_REGISTER_ULONG((volatile ULONG*)((PUCHAR)DeviceContext->RegisterBase + Register), Value);
+
+    I219vMmioProfileRecord(&DeviceContext->MmioProfile, Register, Category, FALSE, 0);
+}
+
+// Сброс таблицы профилировщика и включение/выключение учета
+// Таблица обнуляется только после завершения обращений, начавших учет до
+// выключения; учет короткий (несколько атомарных операций), ожидание
+// ограничено одновременными обращениями с других процессоров.
+VOID
+I219vResetMmioProfile(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ BOOLEAN Enable
+    )
+{
+    PI219V_MMIO_PROFILE profile = &DeviceContext->MmioProfile;
+
+    InterlockedExchange(&profile->Enabled, 0);
+    while (InterlockedCompareExchange(&profile->Recorders, 0, 0) != 0) {
+        YieldProcessor();
+    }
+
+    RtlZeroMemory(&profile->Table, sizeof(I219V_MMIO_PROFILE_STATS));
+
+#if I219V_MMIO_PROFILER
+    if (Enable) {
+        InterlockedExchange(&profile->Enabled, 1);
+    }
+#else
+    UNREFERENCED_PARAMETER(Enable);
+#endif
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "MMIO profiler reset, %s",
+              profile->Enabled ? "enabled" : "disabled");
+}
+
+// Получение таблицы профилировщика
+VOID
+I219vGetMmioProfile(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PI219V_MMIO_PROFILE_STATS ProfileStats
+    )
+{
+    PI219V_MMIO_PROFILE profile = &DeviceContext->MmioProfile;
+
+    RtlCopyMemory(ProfileStats, &profile->Table, sizeof(I219V_MMIO_PROFILE_STATS));
+    ProfileStats->Enabled = (UINT32)profile->Enabled;
+    ProfileStats->CyclesPerUs = DeviceContext->Latency.CyclesPerUs;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_mmio.h
+
+Abstract:
+
+    Заголовочный файл для профилировщика обращений к регистрам Intel i219-v.
+    Слой доступа к регистрам учитывает чтения и записи по смещению регистра
+    и по категории места вызова (путь данных, PHY, применение профиля,
+    управление, диагностика), а также такты TSC, затраченные на ожидание
+    чтений MMIO. Профилировщик включается при компиляции
+    (I219V_MMIO_PROFILER) и во время работы через IOCTL; учет ведется
+    атомарными операциями, так как обращения выполняются и из ISR.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+
+// Профилировщик компилируется по умолчанию и выключен до запроса через IOCTL;
+// I219V_MMIO_PROFILER=0 полностью убирает учет из слоя доступа к регистрам
+#ifndef I219V_MMIO_PROFILER
+#define I219V_MMIO_PROFILER                 1
+#endif
+
+// Размер таблицы регистров (степень двойки, открытая адресация)
+#define I219V_MMIO_PROFILE_SLOTS            64
+
+// Категории мест вызова
+typedef enum _I219V_MMIO_CATEGORY {
+    I219V_MMIO_CATEGORY_DATAPATH = 0,       // ISR, DPC, дверные звонки (быстрые обращения)
+    I219V_MMIO_CATEGORY_PHY = 1,            // Доступ к PHY через MDIC
+    I219V_MMIO_CATEGORY_PROFILE = 2,        // Транзакции применения профиля
+    I219V_MMIO_CATEGORY_CONTROL = 3,        // Прочие обращения: инициализация, состояние соединения, настройки
+    I219V_MMIO_CATEGORY_DIAGNOSTICS = 4     // Самотестирование
+} I219V_MMIO_CATEGORY;
+
+#define I219V_MMIO_CATEGORY_COUNT           5
+
+// Счетчики обращений
+typedef struct _I219V_MMIO_COUNTERS {
+    UINT64 Reads;                                   // Чтения
+    UINT64 Writes;                                  // Записи
+    UINT64 ReadCycles;                              // Такты TSC в ожидании чтений
+} I219V_MMIO_COUNTERS, *PI219V_MMIO_COUNTERS;
+
+// Счетчики регистра
+typedef struct _I219V_MMIO_REGISTER_PROFILE {
+    UINT32 Register;                                // Смещение регистра + 1 (0 - свободный слот)
+    UINT32 Reserved;
+    I219V_MMIO_COUNTERS Counters;
+} I219V_MMIO_REGISTER_PROFILE, *PI219V_MMIO_REGISTER_PROFILE;
+
+// Таблица профилировщика (возвращается через IOCTL)
+typedef struct _I219V_MMIO_PROFILE_STATS {
+    UINT32 Enabled;                                 // Учет включен
+    UINT32 CyclesPerUs;                             // Частота TSC (для перевода тактов во время)
+    UINT32 DroppedAccesses;                         // Обращения, не поместившиеся в таблицу регистров
+    UINT32 Reserved;
+    I219V_MMIO_COUNTERS Categories[I219V_MMIO_CATEGORY_COUNT];
+    I219V_MMIO_REGISTER_PROFILE Registers[I219V_MMIO_PROFILE_SLOTS];
+} I219V_MMIO_PROFILE_STATS, *PI219V_MMIO_PROFILE_STATS;
+
+// Управление профилировщиком: сброс таблицы и включение/выключение учета
+typedef struct _I219V_MMIO_PROFILE_CONTROL {
+    UINT32 Enable;
+} I219V_MMIO_PROFILE_CONTROL, *PI219V_MMIO_PROFILE_CONTROL;
+
+// Состояние профилировщика
+typedef struct _I219V_MMIO_PROFILE {
+    volatile LONG Enabled;                          // Учет включен
+    volatile LONG Recorders;                        // Обращения, обновляющие таблицу в данный момент
+    I219V_MMIO_PROFILE_STATS Table;                 // Счетчики (обновляются атомарно)
+} I219V_MMIO_PROFILE, *PI219V_MMIO_PROFILE;
+
+// Объявление функций профилировщика
+VOID I219vResetMmioProfile(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ BOOLEAN Enable);
+VOID I219vGetMmioProfile(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_MMIO_PROFILE_STATS ProfileStats);
+
+// Учтенные обращения к отображенному регистру (вызываются при включенном учете)
+ULONG
+I219vMmioProfileRead(
+    _In_ struct _I219V_DEVICE_CONTEXT* DeviceContext,
+    _In_ UINT32 Register,
+    _In_ I219V_MMIO_CATEGORY Category
+    );
+
+VOID
+I219vMmioProfileWrite(
+    _In_ struct _I219V_DEVICE_CONTEXT* DeviceContext,
+    _In_ UINT32 Register,
+    _In_ ULONG Value,
+    _In_ I219V_MMIO_CATEGORY Category
+    );
@@ -0,0 +1,436 @@
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_model.c
+
+Abstract:
+
+    Реализация поведенческой модели устройства Intel i219-v.
+    Запись TDT обрабатывает дескрипторы передачи от TDH до TDT (запись DD
+    при RS), поступление кадра записывает дескриптор приема в RDH;
+    дескрипторы и буферы адресуются через функцию перевода адресов стенда.
+    Модель позволяет выполнять путь данных, классификацию и модерацию без
+    оборудования и измерять их стоимость. Модуль содержит только модель и
+    не зависит от контекста устройства; подключение к контексту выполняет
+    слой доступа к регистрам (I219vAttachDeviceModel в i219v_hw.c).
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include "Datapath.h"
+#include "i219v_hw.h"
+#include "i219v_hw_extended.h"
+#include "i219v_phy.h"
+#include "i219v_model.h"
+#include "Trace.h"
+
+#if I219V_DEVICE_MODEL
+
+#define I219V_MODEL_REG(_Model, _Register)  ((_Model)->Registers[(_Register) / sizeof(UINT32)])
+
+// Дескрипторы приема и передачи занимают по 16 байт (RDLEN/TDLEN кратны 16)
+#define I219V_MODEL_DESC_SIZE               16
+
+C_ASSERT(sizeof(I219V_RX_DESC) == I219V_MODEL_DESC_SIZE);
+C_ASSERT(sizeof(I219V_TX_DESC) == I219V_MODEL_DESC_SIZE);
+
+// Сброс MAC: регистры возвращаются к значениям по умолчанию, PHY не затрагивается
+static
+VOID
+I219vModelResetMac(
+    _Inout_ PI219V_DEVICE_MODEL Model
+    )
+{
+    RtlZeroMemory(Model->Registers, sizeof(Model->Registers));
+    I219V_MODEL_REG(Model, I219V_REG_STATUS) = I219V_MODEL_STATUS_DEFAULT;
+}
+
+// Сброс PHY: регистры PHY возвращаются к значениям по умолчанию
+static
+VOID
+I219vModelResetPhy(
+    _Inout_ PI219V_DEVICE_MODEL Model
+    )
+{
+    RtlZeroMemory(Model->PhyRegisters, sizeof(Model->PhyRegisters));
+
+    // Регистры PHY: BMCR, BMSR (соединение установлено), идентификатор
+    Model->PhyRegisters[0] = I219V_MODEL_PHY_BMCR_DEFAULT;
+    Model->PhyRegisters[1] = I219V_MODEL_PHY_BMSR_DEFAULT;
+    Model->PhyRegisters[2] = I219V_MODEL_PHY_ID1;
+    Model->PhyRegisters[3] = I219V_MODEL_PHY_ID2;
+}
+
+// Выставление причин прерывания
+static
+VOID
+I219vModelRaise(
+    _Inout_ PI219V_DEVICE_MODEL Model,
+    _In_ UINT32 Causes
+    )
+{
+    I219V_MODEL_REG(Model, I219V_REG_ICR) |= Causes;
+
+    if ((Causes & I219V_MODEL_REG(Model, I219V_REG_IMS)) != 0) {
+        Model->Stats.Interrupts++;
+    }
+}
+
+// Кольцо дескрипторов в памяти стенда
+static
+PVOID
+I219vModelRing(
+    _In_ PI219V_DEVICE_MODEL Model,
+    _In_ UINT32 BaseLow,
+    _In_ UINT32 BaseHigh,
+    _In_ UINT32 LengthRegister,
+    _Out_ PUINT32 Count
+    )
+{
+    UINT32 length = I219V_MODEL_REG(Model, LengthRegister);
+    UINT64 base;
+
+    *Count = length / I219V_MODEL_DESC_SIZE;
+    if (*Count == 0 || Model->Translate == NULL) {
+        return NULL;
+    }
+
+    base = ((UINT64)I219V_MODEL_REG(Model, BaseHigh) << 32) | I219V_MODEL_REG(Model, BaseLow);
+
+    return Model->Translate(Model->TranslateContext, base, length);
+}
+
+// Обработка дескрипторов передачи от TDH до TDT
+static
+VOID
+I219vModelProcessTx(
+    _Inout_ PI219V_DEVICE_MODEL Model
+    )
+{
+    PI219V_TX_DESC ring;
+    UINT32 count;
+    UINT32 head;
+    UINT32 tail;
+    BOOLEAN reported = FALSE;
+
+    if ((I219V_MODEL_REG(Model, I219V_REG_TCTL) & I219V_TCTL_EN) == 0) {
+        return;
+    }
+
+    ring = (PI219V_TX_DESC)I219vModelRing(Model, I219V_REG_TDBAL, I219V_REG_TDBAH, I219V_REG_TDLEN, &count);
+    if (ring == NULL) {
+        return;
+    }
+
+    head = I219V_MODEL_REG(Model, I219V_REG_TDH) % count;
+    tail = I219V_MODEL_REG(Model, I219V_REG_TDT) % count;
+
+    while (head != tail) {
+        PI219V_TX_DESC desc = &ring[head];
+
+        Model->Stats.TxDescriptors++;
+        Model->Stats.TxBytes += desc->Length;
+        if (desc->CMD & I219V_TXD_CMD_EOP) {
+            Model->Stats.TxFrames++;
+        }
+
+        // Запись состояния только для дескрипторов с RS, как у устройства
+        if (desc->CMD & I219V_TXD_CMD_RS) {
+            KeMemoryBarrier();
+            desc->Status |= I219V_TXD_STAT_DD;
+            reported = TRUE;
+        }
+
+        head = (head + 1) % count;
+    }
+
+    I219V_MODEL_REG(Model, I219V_REG_TDH) = head;
+
+    if (reported) {
+        I219vModelRaise(Model, I219V_IMS_TXDW);
+    }
+}
+
+// Выполнение команды MDIC
+static
+UINT32
+I219vModelMdic(
+    _Inout_ PI219V_DEVICE_MODEL Model,
+    _In_ UINT32 Value
+    )
+{
+    UINT32 phyRegister = (Value >> I219V_MDIC_REG_SHIFT) & 0x1F;
+    UINT32 phyAddress = (Value >> I219V_MDIC_PHY_SHIFT) & 0x1F;
+    UINT32 operation = Value & (I219V_MDIC_OP_WRITE | I219V_MDIC_OP_READ);
+
+    Model->Stats.PhyOperations++;
+
+    if (phyAddress != I219V_REG_PHYADDR ||
+        (operation != I219V_MDIC_OP_WRITE && operation != I219V_MDIC_OP_READ)) {
+        return Value | I219V_MDIC_READY | I219V_MDIC_ERROR;
+    }
+
+    if (operation == I219V_MDIC_OP_WRITE) {
+        Model->PhyRegisters[phyRegister] = (UINT16)(Value & I219V_MDIC_DATA_MASK);
+
+        // Бит сброса BMCR самоочищающийся, сброс завершается мгновенно
+        if (phyRegister == 0 && (Value & I219V_MODEL_PHY_BMCR_RESET)) {
+            I219vModelResetPhy(Model);
+        }
+        return Value | I219V_MDIC_READY;
+    }
+
+    return (Value & ~I219V_MDIC_DATA_MASK) | Model->PhyRegisters[phyRegister] | I219V_MDIC_READY;
+}
+
+// Создание модели
+NTSTATUS
+I219vCreateDeviceModel(
+    _In_opt_ PI219V_MODEL_TRANSLATE Translate,
+    _In_opt_ PVOID TranslateContext,
+    _Out_ PI219V_DEVICE_MODEL* Model
+    )
+{
+    PI219V_DEVICE_MODEL model;
+
+    *Model = NULL;
+
+    model = (PI219V_DEVICE_MODEL)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(I219V_DEVICE_MODEL), I219V_MODEL_POOL_TAG);
+    if (model == NULL) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "Failed to allocate device model");
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    model->Translate = Translate;
+    model->TranslateContext = TranslateContext;
+
+    I219vModelResetMac(model);
+    I219vModelResetPhy(model);
+
+    *Model = model;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Device model created");
+
+    return STATUS_SUCCESS;
+}
+
+// Удаление модели
+VOID
+I219vDestroyDeviceModel(
+    _In_ PI219V_DEVICE_MODEL Model
+    )
+{
+    ExFreePoolWithTag(Model, I219V_MODEL_POOL_TAG);
+}
+
+// Чтение регистра модели
+UINT32
+I219vModelReadRegister(
+    _In_ PI219V_DEVICE_MODEL Model,
+    _In_ UINT32 Register
+    )
+{
+    UINT32 value;
+    UINT32 ims;
+
+    if (Register >= I219V_REGISTER_SPACE_SIZE || (Register % sizeof(UINT32)) != 0) {
+        return 0;
+    }
+
+    Model->Stats.RegisterReads++;
+
+    switch (Register) {
+    case I219V_REG_ICR:
+        // Чтение очищает причины; при выставленном прерывании и CTRL_EXT.IAME
+        // причины из IAM маскируются автоматически
+        value = I219V_MODEL_REG(Model, I219V_REG_ICR);
+        ims = I219V_MODEL_REG(Model, I219V_REG_IMS);
+
+        if ((value & ims) != 0) {
+            value |= I219V_ICR_INT_ASSERTED;
+
+            if (I219V_MODEL_REG(Model, I219V_REG_CTRL_EXT) & I219V_CTRL_EXT_IAME) {
+                I219V_MODEL_REG(Model, I219V_REG_IMS) = ims & ~I219V_MODEL_REG(Model, I219V_REG_IAM);
+            }
+        }
+
+        I219V_MODEL_REG(Model, I219V_REG_ICR) = 0;
+        return value;
+
+    case I219V_REG_ICS:
+    case I219V_REG_IMC:
+        // Регистры только для записи
+        return 0;
+
+    default:
+        return I219V_MODEL_REG(Model, Register);
+    }
+}
+
+// Запись регистра модели
+VOID
+I219vModelWriteRegister(
+    _In_ PI219V_DEVICE_MODEL Model,
+    _In_ UINT32 Register,
+    _In_ UINT32 Value
+    )
+{
+    if (Register >= I219V_REGISTER_SPACE_SIZE || (Register % sizeof(UINT32)) != 0) {
+        return;
+    }
+
+    Model->Stats.RegisterWrites++;
+
+    switch (Register) {
+    case I219V_REG_CTRL:
+        // Биты сброса самоочищающиеся (PHY_RST снимается сбросом MAC)
+        if (Value & I219V_CTRL_PHY_RST) {
+            I219vModelResetPhy(Model);
+        }
+        if (Value & I219V_CTRL_RST) {
+            I219vModelResetMac(Model);
+            Value &= ~(I219V_CTRL_RST | I219V_CTRL_PHY_RST);
+        }
+        I219V_MODEL_REG(Model, I219V_REG_CTRL) = Value;
+        break;
+
+    case I219V_REG_STATUS:
+        // Записью сбрасывается только LAN_INIT_DONE (выставляется сбросом MAC)
+        if ((Value & I219V_STATUS_LAN_INIT_DONE) == 0) {
+            I219V_MODEL_REG(Model, I219V_REG_STATUS) &= ~I219V_STATUS_LAN_INIT_DONE;
+        }
+        break;
+
+    case I219V_REG_ICR:
+        I219V_MODEL_REG(Model, I219V_REG_ICR) &= ~Value;
+        break;
+
+    case I219V_REG_ICS:
+        I219vModelRaise(Model, Value);
+        break;
+
+    case I219V_REG_IMS:
+        I219V_MODEL_REG(Model, I219V_REG_IMS) |= Value;
+        break;
+
+    case I219V_REG_IMC:
+        I219V_MODEL_REG(Model, I219V_REG_IMS) &= ~Value;
+        break;
+
+    case I219V_REG_PHYREG:
+        I219V_MODEL_REG(Model, I219V_REG_PHYREG) = I219vModelMdic(Model, Value);
+        I219vModelRaise(Model, I219V_IMS_MDAC);
+        break;
+
+    case I219V_REG_TDT:
+        I219V_MODEL_REG(Model, I219V_REG_TDT) = Value;
+        I219vModelProcessTx(Model);
+        break;
+
+    default:
+        I219V_MODEL_REG(Model, Register) = Value;
+        break;
+    }
+}
+
+// Поступление кадра из сети
+NTSTATUS
+I219vModelReceiveFrame(
+    _In_ PI219V_DEVICE_MODEL Model,
+    _In_reads_bytes_opt_(Length) const VOID* Frame,
+    _In_ UINT16 Length
+    )
+{
+    PI219V_RX_DESC ring;
+    PI219V_RX_DESC desc;
+    PVOID buffer;
+    UINT32 count;
+    UINT32 head;
+    UINT32 threshold;
+    UINT32 causes = I219V_IMS_RXDW;
+
+    if ((I219V_MODEL_REG(Model, I219V_REG_RCTL) & I219V_RCTL_EN) == 0) {
+        return STATUS_DEVICE_NOT_READY;
+    }
+
+    ring = (PI219V_RX_DESC)I219vModelRing(Model, I219V_REG_RDBAL, I219V_REG_RDBAH, I219V_REG_RDLEN, &count);
+    if (ring == NULL) {
+        return STATUS_INVALID_DEVICE_STATE;
+    }
+
+    // RDH == RDT: драйвер не передал устройству свободных дескрипторов
+    head = I219V_MODEL_REG(Model, I219V_REG_RDH) % count;
+    if (head == I219V_MODEL_REG(Model, I219V_REG_RDT) % count) {
+        Model->Stats.RxMissed++;
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    desc = &ring[head];
+
+    if (Frame != NULL && Length != 0) {
+        buffer = Model->Translate(Model->TranslateContext, desc->BufferAddr, Length);
+        if (buffer == NULL) {
+            return STATUS_INVALID_DEVICE_STATE;
+        }
+        RtlCopyMemory(buffer, Frame, Length);
+    }
+
+    desc->Length = Length;
+    desc->Checksum = 0;
+    desc->Errors = 0;
+    desc->VlanTag = 0;
+
+    // Бит DD записывается последним
+    KeMemoryBarrier();
+    desc->Status = I219V_RXD_STAT_DD | I219V_RXD_STAT_EOP;
+
+    I219V_MODEL_REG(Model, I219V_REG_RDH) = (head + 1) % count;
+
+    Model->Stats.RxFrames++;
+    Model->Stats.RxBytes += Length;
+
+    threshold = I219V_MODEL_REG(Model, I219V_REG_RSRPD) & I219V_RSRPD_SIZE_MASK;
+    if (threshold != 0 && Length <= threshold) {
+        causes |= I219V_IMS_SRPD;
+    }
+
+    I219vModelRaise(Model, causes);
+
+    return STATUS_SUCCESS;
+}
+
+// Изменение состояния соединения
+VOID
+I219vModelSetLink(
+    _In_ PI219V_DEVICE_MODEL Model,
+    _In_ BOOLEAN LinkUp
+    )
+{
+    if (LinkUp) {
+        I219V_MODEL_REG(Model, I219V_REG_STATUS) = I219V_MODEL_STATUS_DEFAULT;
+        Model->PhyRegisters[1] = I219V_MODEL_PHY_BMSR_DEFAULT;
+    } else {
+        I219V_MODEL_REG(Model, I219V_REG_STATUS) &= ~I219V_STATUS_LU;
+        Model->PhyRegisters[1] &= ~0x0004;  // BMSR: Link Status
+    }
+
+    I219vModelRaise(Model, I219V_IMS_LSC);
+}
+
+// Выставлено ли прерывание
+BOOLEAN
+I219vModelInterruptAsserted(
+    _In_ PI219V_DEVICE_MODEL Model
+    )
+{
+    return (I219V_MODEL_REG(Model, I219V_REG_ICR) & I219V_MODEL_REG(Model, I219V_REG_IMS)) != 0;
+}
+
+#endif // I219V_DEVICE_MODEL
@@ -0,0 +1,116 @@
+#pragma once
+
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_model.h
+
+Abstract:
+
+    Заголовочный файл для поведенческой модели устройства Intel i219-v.
+    Модель подключается к контексту устройства вместо отображенной области
+    регистров (I219vAttachDeviceModel, i219v_hw.h): все обращения
+    I219vReadRegister/I219vWriteRegister и быстрые обращения пути данных
+    обслуживаются ею. Моделируются CTRL/STATUS,
+    ICR/ICS/IMS/IMC/IAM, головы и хвосты колец приема и передачи с записью
+    дескрипторов в память стенда и ответы PHY через MDIC. Таймеры модерации
+    (ITR, RDTR/RADV, TIDV/TADV) не моделируются: причина прерывания
+    выставляется сразу. Модель не синхронизирована: стенд обращается к ней
+    из одного потока. Код модели компилируется только при I219V_DEVICE_MODEL
+    (свойство проекта I219vDeviceModel, по умолчанию выключено).
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+#include "i219v_hw.h"
+
+#if I219V_DEVICE_MODEL
+
+// Тег выделений памяти модели
+#define I219V_MODEL_POOL_TAG            'm912'
+
+// Размер файла регистров модели (вся область BAR0) и число регистров PHY
+#define I219V_MODEL_REGISTER_COUNT      (I219V_REGISTER_SPACE_SIZE / sizeof(UINT32))
+#define I219V_MODEL_PHY_REGISTER_COUNT  32
+
+// Состояние после сброса: соединение 1000 Мбит/с, полный дуплекс, конфигурация загружена
+#define I219V_MODEL_STATUS_DEFAULT      (I219V_STATUS_FD | I219V_STATUS_LU | I219V_STATUS_SPEED_1000 | I219V_STATUS_LAN_INIT_DONE)
+
+// Регистры PHY после сброса (BMCR, BMSR, идентификатор PHY семейства I217/I219)
+#define I219V_MODEL_PHY_BMCR_DEFAULT    0x1140
+#define I219V_MODEL_PHY_BMSR_DEFAULT    0x796D
+#define I219V_MODEL_PHY_ID1             0x0154
+#define I219V_MODEL_PHY_ID2             0x03A0
+#define I219V_MODEL_PHY_BMCR_RESET      0x8000
+
+// Перевод адреса устройства (логического адреса DMA) в адрес памяти стенда
+// Возвращает NULL, если область [DeviceAddress, DeviceAddress + Length) не отображена.
+typedef
+PVOID
+(*PI219V_MODEL_TRANSLATE)(
+    _In_opt_ PVOID Context,
+    _In_ UINT64 DeviceAddress,
+    _In_ UINT32 Length
+    );
+
+// Статистика модели
+typedef struct _I219V_MODEL_STATS {
+    UINT64 RegisterReads;                           // Чтения регистров
+    UINT64 RegisterWrites;                          // Записи регистров
+    UINT64 PhyOperations;                           // Операции MDIC
+    UINT64 TxDescriptors;                           // Обработанные дескрипторы передачи
+    UINT64 TxFrames;                                // Переданные кадры (дескрипторы с EOP)
+    UINT64 TxBytes;                                 // Переданные байты
+    UINT64 RxFrames;                                // Принятые кадры (записанные в кольцо)
+    UINT64 RxBytes;                                 // Принятые байты
+    UINT64 RxMissed;                                // Кадры, отброшенные без свободного дескриптора
+    UINT64 Interrupts;                              // Выставленные прерывания (причина при разрешенной маске)
+} I219V_MODEL_STATS, *PI219V_MODEL_STATS;
+
+// Состояние модели
+typedef struct _I219V_DEVICE_MODEL {
+    UINT32 Registers[I219V_MODEL_REGISTER_COUNT];   // Файл регистров (по смещению / 4)
+    UINT16 PhyRegisters[I219V_MODEL_PHY_REGISTER_COUNT]; // Регистры PHY
+    PI219V_MODEL_TRANSLATE Translate;               // Перевод адресов DMA (NULL - кольца не обрабатываются)
+    PVOID TranslateContext;                         // Контекст перевода адресов
+    I219V_MODEL_STATS Stats;                        // Статистика
+} I219V_DEVICE_MODEL, *PI219V_DEVICE_MODEL;
+
+// Создание и удаление модели
+NTSTATUS
+I219vCreateDeviceModel(
+    _In_opt_ PI219V_MODEL_TRANSLATE Translate,
+    _In_opt_ PVOID TranslateContext,
+    _Out_ PI219V_DEVICE_MODEL* Model
+    );
+
+VOID I219vDestroyDeviceModel(_In_ PI219V_DEVICE_MODEL Model);
+
+// Обращения к регистрам модели (вызываются слоем доступа к регистрам)
+UINT32 I219vModelReadRegister(_In_ PI219V_DEVICE_MODEL Model, _In_ UINT32 Register);
+VOID I219vModelWriteRegister(_In_ PI219V_DEVICE_MODEL Model, _In_ UINT32 Register, _In_ UINT32 Value);
+
+// Поступление кадра из сети: запись в дескриптор RDH и причина RXDW
+NTSTATUS
+I219vModelReceiveFrame(
+    _In_ PI219V_DEVICE_MODEL Model,
+    _In_reads_bytes_opt_(Length) const VOID* Frame,
+    _In_ UINT16 Length
+    );
+
+// Изменение состояния соединения (причина LSC)
+VOID I219vModelSetLink(_In_ PI219V_DEVICE_MODEL Model, _In_ BOOLEAN LinkUp);
+
+// Выставлено ли прерывание (есть причина, разрешенная IMS); стенд вызывает ISR
+BOOLEAN I219vModelInterruptAsserted(_In_ PI219V_DEVICE_MODEL Model);
+
+#endif // I219V_DEVICE_MODEL
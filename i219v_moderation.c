@@ -0,0 +1,838 @@
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_moderation.c
+
+Abstract:
+
+    Реализация динамической модерации прерываний для драйвера Intel i219-v.
+    Вместо фиксированного значения ITR, выбираемого при применении профиля,
+    модуль оценивает нагрузку за каждый интервал и перемещает ITR по шкале
+    уровней: при редком трафике модерация минимальна, при объемной передаче
+    максимальна. Профиль задает только границы шкалы. Понижение уровня
+    выполняется сразу, повышение - на один шаг и только если нагрузка
+    держится несколько интервалов подряд, что исключает колебания.
+    Оценку выполняет путь данных; если трафик прекратился при поднятом
+    уровне, оценку с нулевой нагрузкой выполняет таймер простоя.
+
+    В режиме бюджета задержки шкала уровней не используется: ITR равен
+    пределу, выведенному из бюджета за вычетом измеренной задержки от ISR
+    до передачи пакетов стеку. Предел уменьшается сразу при превышении
+    бюджета и растет постепенно, так что число прерываний минимально при
+    соблюдении бюджета.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+#include "Driver.h"
+#include "Device.h"
+#include "i219v_hw.h"
+#include "i219v_hw_extended.h"
+#include "i219v_moderation.h"
+#include "DeviceContext.h"
+#include "Trace.h"
+
+// Ключевое слово INF для бюджета задержки прерываний (мкс)
+#define I219V_MODERATION_KEYWORD_LATENCY_BUDGET  L"InterruptLatencyBudget"
+
+// Вес нового замера задержки в скользящем среднем (1/8)
+#define I219V_MODERATION_DELAY_EWMA_SHIFT        3
+
+// Значения регистра ITR для каждого уровня (единицы 256 нс)
+static const UINT32 ModerationItrTable[I219V_MODERATION_LEVEL_COUNT] = {
+    0,      // Без модерации
+    20,     // ~5 мкс
+    49,     // ~12.5 мкс (~80000 прерываний/с)
+    98,     // ~25 мкс (~40000 прерываний/с)
+    195,    // ~50 мкс (~20000 прерываний/с)
+    390,    // ~100 мкс (~10000 прерываний/с)
+    781,    // ~200 мкс (~5000 прерываний/с)
+    1562    // ~400 мкс (~2500 прерываний/с)
+};
+
+// Минимальная частота пакетов (пакетов/с), при которой оправдан уровень
+// Значения заданы для 1000 Мбит/с и масштабируются по скорости соединения:
+// уровень выбирается по доле загрузки канала, а не по абсолютной частоте.
+static const UINT32 ModerationRateTable[I219V_MODERATION_LEVEL_COUNT] = {
+    0,
+    2000,
+    8000,
+    20000,
+    40000,
+    70000,
+    100000,
+    150000
+};
+
+// Наибольший уровень для трафика из мелких пакетов (игровой и голосовой трафик)
+#define I219V_MODERATION_SMALL_PACKET_MAX_LEVEL  3
+
+// Выбор целевого уровня по нагрузке за интервал
+static
+UINT32
+I219vModerationTargetLevel(
+    _In_ UINT32 PacketRate,
+    _In_ UINT32 AveragePacketSize,
+    _In_ UINT32 LinkSpeedMbps
+    )
+{
+    UINT32 level = 0;
+
+    while (level + 1 < I219V_MODERATION_LEVEL_COUNT &&
+           (UINT64)PacketRate * I219V_MODERATION_REFERENCE_SPEED >=
+           (UINT64)ModerationRateTable[level + 1] * LinkSpeedMbps) {
+        level++;
+    }
+
+    if (level == 0) {
+        // Редкий трафик: задержка важнее числа прерываний
+        return 0;
+    }
+
+    if (AveragePacketSize >= I219V_MODERATION_BULK_PACKET_SIZE) {
+        // Объемная передача: на один уровень сильнее
+        if (level + 1 < I219V_MODERATION_LEVEL_COUNT) {
+            level++;
+        }
+    } else if (AveragePacketSize <= I219V_MODERATION_SMALL_PACKET_SIZE) {
+        // Поток мелких пакетов чувствителен к задержке
+        if (level > I219V_MODERATION_SMALL_PACKET_MAX_LEVEL) {
+            level = I219V_MODERATION_SMALL_PACKET_MAX_LEVEL;
+        }
+    }
+
+    return level;
+}
+
+// Обновление предела ITR в режиме бюджета задержки
+// Добавленная задержка = интервал ITR + задержка от ISR до передачи стеку,
+// поэтому на интервал ITR остается бюджет за вычетом измеренной задержки.
+static
+UINT32
+I219vModerationUpdateBudgetCap(
+    _Inout_ PI219V_MODERATION_STATE Moderation
+    )
+{
+    UINT32 budget = Moderation->Stats.LatencyBudgetUs;
+    UINT32 measured = Moderation->Stats.MeasuredDelayUs;
+    UINT32 cap = Moderation->Stats.BudgetItrCap;
+    UINT32 target;
+
+    target = (measured < budget) ? I219V_US_TO_ITR(budget - measured) : 0;
+    if (target > I219V_ITR_MAX) {
+        target = I219V_ITR_MAX;
+    }
+
+    if (measured + I219V_ITR_TO_US(cap) > budget) {
+        Moderation->Stats.BudgetOverruns++;
+    }
+
+    if (target < cap) {
+        // Бюджет превышен: предел снижается сразу
+        cap = target;
+    } else if (target > cap) {
+        // Запас по бюджету: предел растет на четверть разницы за интервал
+        cap += (target - cap + 3) / 4;
+    }
+
+    Moderation->Stats.BudgetItrCap = cap;
+
+    return cap;
+}
+
+// Значение ITR для текущего режима без новой оценки нагрузки
+static
+UINT32
+I219vModerationModeItr(
+    _In_ PI219V_MODERATION_STATE Moderation
+    )
+{
+    if (Moderation->Stats.Disabled) {
+        return 0;
+    }
+
+    if (Moderation->Stats.LatencyBudgetUs != I219V_LATENCY_BUDGET_AUTO) {
+        return Moderation->Stats.BudgetItrCap;
+    }
+
+    return ModerationItrTable[Moderation->Stats.CurrentLevel];
+}
+
+// Границы шкалы уровней по значению InterruptModeration профиля (0-100)
+static
+VOID
+I219vModerationLevelBounds(
+    _In_ UINT32 InterruptModeration,
+    _Out_ PUINT32 MinLevel,
+    _Out_ PUINT32 MaxLevel
+    )
+{
+    if (InterruptModeration > 100) {
+        InterruptModeration = 100;
+    }
+
+    // 0 -> уровни 0..2, 50 -> 1..4, 80 -> 2..6, 100 -> 3..7
+    *MinLevel = InterruptModeration * 3 / 100;
+    *MaxLevel = 2 + InterruptModeration * 5 / 100;
+}
+
+// Инициализация модуля модерации прерываний
+NTSTATUS
+I219vInitializeModeration(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    NTSTATUS status;
+    PI219V_MODERATION_STATE moderation = &DeviceContext->Moderation;
+    WDF_TIMER_CONFIG timerConfig;
+    WDF_OBJECT_ATTRIBUTES attributes;
+
+    RtlZeroMemory(moderation, sizeof(I219V_MODERATION_STATE));
+
+    // До применения профиля доступна вся шкала; до первого сообщения о
+    // соединении пороги соответствуют 1000 Мбит/с
+    moderation->Stats.MinLevel = 0;
+    moderation->Stats.MaxLevel = I219V_MODERATION_LEVEL_COUNT - 1;
+    moderation->Stats.LinkSpeedMbps = I219V_MODERATION_REFERENCE_SPEED;
+    moderation->IntervalStart = KeQueryInterruptTime();
+
+    // Однократный таймер: взводится путем данных, пока уровень выше нижней границы
+    WDF_TIMER_CONFIG_INIT(&timerConfig, I219vEvtModerationIdleTimer);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = DeviceContext->Device;
+
+    status = WdfTimerCreate(&timerConfig, &attributes, &moderation->IdleTimer);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfTimerCreate failed for moderation: %!STATUS!", status);
+        return status;
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "Interrupt moderation initialized");
+
+    return STATUS_SUCCESS;
+}
+
+// Остановка таймера простоя и сброс накопленной нагрузки
+// Вызывается при остановке адаптера.
+VOID
+I219vStopModeration(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_MODERATION_STATE moderation = &DeviceContext->Moderation;
+
+    if (moderation->IdleTimer != NULL) {
+        WdfTimerStop(moderation->IdleTimer, TRUE);
+    }
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    moderation->RxPackets = 0;
+    moderation->TxPackets = 0;
+    moderation->TxCompletions = 0;
+    moderation->Bytes = 0;
+    moderation->RaiseCount = 0;
+    moderation->IntervalStart = KeQueryInterruptTime();
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Установка границ шкалы по значению InterruptModeration профиля (0-100)
+// Вызывается под GamingSettingsLock; регистр записывает I219vApplyInterruptModeration.
+VOID
+I219vModerationSetBounds(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 InterruptModeration
+    )
+{
+    PI219V_MODERATION_STATE moderation = &DeviceContext->Moderation;
+    UINT32 minLevel;
+    UINT32 maxLevel;
+
+    I219vModerationLevelBounds(InterruptModeration, &minLevel, &maxLevel);
+
+    moderation->Stats.MinLevel = minLevel;
+    moderation->Stats.MaxLevel = maxLevel;
+
+    if (moderation->Stats.CurrentLevel < minLevel) {
+        moderation->Stats.CurrentLevel = minLevel;
+    } else if (moderation->Stats.CurrentLevel > maxLevel) {
+        moderation->Stats.CurrentLevel = maxLevel;
+    }
+
+    // В режиме бюджета задержки ITR определяется бюджетом, а не шкалой
+    moderation->Stats.CurrentItr = I219vModerationModeItr(moderation);
+    moderation->RaiseCount = 0;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
+              "Interrupt moderation bounds: levels %u-%u, current ITR %u",
+              minLevel, maxLevel, moderation->Stats.CurrentItr);
+}
+
+// Сбор записи ITR для транзакции применения профиля
+// Значение вычисляется так же, как его выставит I219vModerationSetBounds с
+// теми же границами, но состояние модуля не меняется: границы сохраняет
+// I219vModerationCommitSettings после успешной фиксации транзакции.
+VOID
+I219vStageInterruptModeration(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Inout_ PI219V_REGISTER_TRANSACTION Transaction,
+    _In_ UINT32 InterruptModeration
+    )
+{
+    I219V_MODERATION_STATE moderation;
+    UINT32 minLevel;
+    UINT32 maxLevel;
+
+    I219vModerationLevelBounds(InterruptModeration, &minLevel, &maxLevel);
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    moderation = DeviceContext->Moderation;
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    if (moderation.Stats.CurrentLevel < minLevel) {
+        moderation.Stats.CurrentLevel = minLevel;
+    } else if (moderation.Stats.CurrentLevel > maxLevel) {
+        moderation.Stats.CurrentLevel = maxLevel;
+    }
+
+    I219vTransactionWrite(Transaction, I219V_REG_ITR, I219vModerationModeItr(&moderation));
+    I219vTransactionModify(Transaction, I219V_REG_CTRL, 0, I219V_CTRL_ITR_ENABLE);
+}
+
+// Масштабирование порогов частоты пакетов по скорости соединения
+// Вызывается при запуске адаптера и по прерыванию LSC. При отсутствии
+// соединения (0) сохраняются пороги последней известной скорости.
+VOID
+I219vModerationSetLinkSpeed(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 LinkSpeedMbps
+    )
+{
+    PI219V_MODERATION_STATE moderation = &DeviceContext->Moderation;
+
+    if (LinkSpeedMbps == 0) {
+        return;
+    }
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    if (moderation->Stats.LinkSpeedMbps != LinkSpeedMbps) {
+        moderation->Stats.LinkSpeedMbps = LinkSpeedMbps;
+        moderation->RaiseCount = 0;
+    }
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
+              "Interrupt moderation thresholds scaled to %u Mbps", LinkSpeedMbps);
+}
+
+// Отключение модерации без изменения режима
+// ITR остается нулевым, пока модерация отключена; бюджет задержки и
+// границы шкалы сохраняются и действуют снова после включения.
+// Вызывается под GamingSettingsLock; регистр записывает I219vApplyInterruptModeration.
+VOID
+I219vModerationSetDisabled(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ BOOLEAN Disabled
+    )
+{
+    PI219V_MODERATION_STATE moderation = &DeviceContext->Moderation;
+
+    moderation->Stats.Disabled = Disabled;
+    moderation->Stats.CurrentItr = I219vModerationModeItr(moderation);
+    moderation->RaiseCount = 0;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
+              "Interrupt moderation %s, current ITR %u",
+              Disabled ? "disabled" : "enabled", moderation->Stats.CurrentItr);
+}
+
+// Сохранение бюджета задержки и пересчет ITR без записи в устройство
+static
+NTSTATUS
+I219vModerationSetLatencyBudget(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 LatencyBudgetUs
+    )
+{
+    PI219V_MODERATION_STATE moderation = &DeviceContext->Moderation;
+
+    if (LatencyBudgetUs > I219V_LATENCY_BUDGET_MAX_US) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Invalid interrupt latency budget: %u us", LatencyBudgetUs);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+
+    moderation->Stats.LatencyBudgetUs = LatencyBudgetUs;
+    moderation->RaiseCount = 0;
+
+    if (LatencyBudgetUs != I219V_LATENCY_BUDGET_AUTO) {
+        // Начальный предел без учета обратной связи; первый же интервал
+        // оценки уменьшит его на измеренную задержку
+        moderation->Stats.BudgetItrCap = I219V_US_TO_ITR(LatencyBudgetUs);
+    } else {
+        moderation->Stats.BudgetItrCap = 0;
+    }
+    moderation->Stats.CurrentItr = I219vModerationModeItr(moderation);
+
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "Interrupt latency budget set to %u us", LatencyBudgetUs);
+
+    return STATUS_SUCCESS;
+}
+
+// Установка бюджета добавленной задержки прерываний в микросекундах
+// (I219V_LATENCY_BUDGET_AUTO - автоматический режим по шкале профиля)
+NTSTATUS
+I219vSetInterruptLatencyBudget(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 LatencyBudgetUs
+    )
+{
+    NTSTATUS status;
+
+    status = I219vModerationSetLatencyBudget(DeviceContext, LatencyBudgetUs);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    // Вне D0 значение запишет I219vRestoreModerationRegisters
+    if (DeviceContext->DeviceInitialized) {
+        I219vApplyInterruptModeration(DeviceContext);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+// Загрузка бюджета задержки из ключевого слова INF
+NTSTATUS
+I219vLoadModerationConfiguration(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    NTSTATUS status;
+    NETCONFIGURATION configuration;
+    ULONG value;
+    DECLARE_CONST_UNICODE_STRING(latencyBudgetKeyword, I219V_MODERATION_KEYWORD_LATENCY_BUDGET);
+
+    status = NetAdapterOpenConfiguration(DeviceContext->NetAdapter, WDF_NO_OBJECT_ATTRIBUTES, &configuration);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "NetAdapterOpenConfiguration failed: %!STATUS!", status);
+        return status;
+    }
+
+    // Отсутствующее ключевое слово оставляет автоматический режим
+    status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS,
+                                        &latencyBudgetKeyword, &value);
+
+    NetConfigurationClose(configuration);
+
+    if (!NT_SUCCESS(status)) {
+        return STATUS_SUCCESS;
+    }
+
+    // Вызывается из EvtDeviceAdd до отображения регистров: только состояние,
+    // ITR запишет I219vRestoreModerationRegisters при входе в D0
+    return I219vModerationSetLatencyBudget(DeviceContext, value);
+}
+
+// Запись текущего значения ITR в устройство
+VOID
+I219vApplyInterruptModeration(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    UINT32 itrValue;
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    itrValue = DeviceContext->Moderation.Stats.CurrentItr;
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    // Механизм ITR остается включенным: при ITR = 0 модерация отсутствует,
+    // а путь данных может изменить ITR без изменения CTRL (повторная запись
+    // CTRL пропускается теневой копией)
+    I219vWriteRegister(DeviceContext, I219V_REG_ITR, itrValue);
+    I219vModifyRegister(DeviceContext, I219V_REG_CTRL, 0, I219V_CTRL_ITR_ENABLE);
+}
+
+// Перевод микросекунд в значение таймера задержки (единицы 1.024 мкс)
+static
+UINT32
+I219vDelayTimerValue(
+    _In_ UINT32 DelayUs
+    )
+{
+    return ((DelayUs * 1000 + I219V_DELAY_TIMER_UNIT_NS / 2) / I219V_DELAY_TIMER_UNIT_NS) & I219V_DELAY_TIMER_MASK;
+}
+
+// Восстановление регистров модерации после сброса устройства
+// Вызывается из I219vInitializeHardware: CTRL.RST обнуляет ITR, таймеры
+// задержки и RSRPD, а профиль и бюджет задержки, установленные до
+// отображения регистров, сохранены только в состоянии.
+VOID
+I219vRestoreModerationRegisters(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    I219V_DELAY_TIMERS timers;
+    UINT32 smallPacketThreshold;
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    timers = DeviceContext->Moderation.Stats.DelayTimers;
+    smallPacketThreshold = DeviceContext->Moderation.Stats.SmallPacketThreshold;
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    // Значения нормализованы I219vModerationCommitSettings; IDE в дескрипторах
+    // передачи (TxDelayEnabled) действует только при ненулевом TIDV
+    I219vWriteRegister(DeviceContext, I219V_REG_RDTR, I219vDelayTimerValue(timers.RxDelayUs));
+    I219vWriteRegister(DeviceContext, I219V_REG_RADV, I219vDelayTimerValue(timers.RxAbsoluteDelayUs));
+    I219vWriteRegister(DeviceContext, I219V_REG_TIDV, I219vDelayTimerValue(timers.TxDelayUs));
+    I219vWriteRegister(DeviceContext, I219V_REG_TADV, I219vDelayTimerValue(timers.TxAbsoluteDelayUs));
+    I219vWriteRegister(DeviceContext, I219V_REG_RSRPD, smallPacketThreshold & I219V_RSRPD_SIZE_MASK);
+
+    I219vApplyInterruptModeration(DeviceContext);
+}
+
+// Проверка и нормализация таймеров задержки на месте
+NTSTATUS
+I219vNormalizeDelayTimers(
+    _Inout_ PI219V_DELAY_TIMERS DelayTimers
+    )
+{
+    I219V_DELAY_TIMERS timers = *DelayTimers;
+
+    if (timers.RxDelayUs > I219V_DELAY_TIMER_MAX_US || timers.RxAbsoluteDelayUs > I219V_DELAY_TIMER_MAX_US ||
+        timers.TxDelayUs > I219V_DELAY_TIMER_MAX_US || timers.TxAbsoluteDelayUs > I219V_DELAY_TIMER_MAX_US) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Invalid interrupt delay timers");
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    // Абсолютный таймер имеет смысл только вместе с таймером "от пакета"
+    // и не может быть короче него
+    if (timers.RxDelayUs == 0) {
+        timers.RxAbsoluteDelayUs = 0;
+    } else if (timers.RxAbsoluteDelayUs != 0 && timers.RxAbsoluteDelayUs < timers.RxDelayUs) {
+        timers.RxAbsoluteDelayUs = timers.RxDelayUs;
+    }
+
+    if (timers.TxDelayUs == 0) {
+        timers.TxAbsoluteDelayUs = 0;
+    } else if (timers.TxAbsoluteDelayUs != 0 && timers.TxAbsoluteDelayUs < timers.TxDelayUs) {
+        timers.TxAbsoluteDelayUs = timers.TxDelayUs;
+    }
+
+    *DelayTimers = timers;
+
+    return STATUS_SUCCESS;
+}
+
+// Сбор записей таймеров задержки для транзакции
+// Значения проверяются и нормализуются на месте; сохраненные в состоянии
+// модуля таймеры не меняются.
+NTSTATUS
+I219vStageDelayTimers(
+    _Inout_ PI219V_REGISTER_TRANSACTION Transaction,
+    _Inout_ PI219V_DELAY_TIMERS DelayTimers
+    )
+{
+    NTSTATUS status;
+
+    status = I219vNormalizeDelayTimers(DelayTimers);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    I219vTransactionWrite(Transaction, I219V_REG_RDTR, I219vDelayTimerValue(DelayTimers->RxDelayUs));
+    I219vTransactionWrite(Transaction, I219V_REG_RADV, I219vDelayTimerValue(DelayTimers->RxAbsoluteDelayUs));
+    I219vTransactionWrite(Transaction, I219V_REG_TIDV, I219vDelayTimerValue(DelayTimers->TxDelayUs));
+    I219vTransactionWrite(Transaction, I219V_REG_TADV, I219vDelayTimerValue(DelayTimers->TxAbsoluteDelayUs));
+
+    return STATUS_SUCCESS;
+}
+
+// Сбор записи порога немедленного прерывания для транзакции
+NTSTATUS
+I219vStageSmallPacketDetect(
+    _Inout_ PI219V_REGISTER_TRANSACTION Transaction,
+    _In_ UINT32 ThresholdBytes
+    )
+{
+    if (ThresholdBytes > I219V_SMALL_PACKET_DETECT_MAX) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Invalid small packet threshold: %u", ThresholdBytes);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    I219vTransactionWrite(Transaction, I219V_REG_RSRPD, ThresholdBytes & I219V_RSRPD_SIZE_MASK);
+
+    return STATUS_SUCCESS;
+}
+
+// Сохранение настроек модерации после фиксации транзакции профиля
+// Вызывается без GamingSettingsLock. DelayTimers должны быть нормализованы
+// I219vStageDelayTimers; регистры уже записаны транзакцией.
+VOID
+I219vModerationCommitSettings(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 InterruptModeration,
+    _In_ PI219V_DELAY_TIMERS DelayTimers,
+    _In_ UINT32 SmallPacketThreshold
+    )
+{
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    I219vModerationSetBounds(DeviceContext, InterruptModeration);
+    // TIDV/TADV действуют только на дескрипторы с битом IDE
+    DeviceContext->Moderation.Stats.DelayTimers = *DelayTimers;
+    DeviceContext->Moderation.TxDelayEnabled = (DelayTimers->TxDelayUs != 0);
+    DeviceContext->Moderation.Stats.SmallPacketThreshold = SmallPacketThreshold;
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
+              "Interrupt delay timers: RX %u/%u us, TX %u/%u us; small packet detect threshold: %u bytes",
+              DelayTimers->RxDelayUs, DelayTimers->RxAbsoluteDelayUs,
+              DelayTimers->TxDelayUs, DelayTimers->TxAbsoluteDelayUs, SmallPacketThreshold);
+}
+
+// Настройка таймеров задержки прерываний приема и передачи
+// Используются профилями для объемного трафика: завершения передачи можно
+// откладывать значительно дольше приема, так как стек их не ожидает.
+NTSTATUS
+I219vConfigureDelayTimers(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ PI219V_DELAY_TIMERS DelayTimers
+    )
+{
+    NTSTATUS status;
+    I219V_REGISTER_TRANSACTION transaction;
+    I219V_DELAY_TIMERS timers = *DelayTimers;
+
+    I219vBeginRegisterTransaction(DeviceContext, &transaction);
+
+    status = I219vStageDelayTimers(&transaction, &timers);
+    if (!NT_SUCCESS(status)) {
+        I219vTransactionFail(&transaction, status);
+    }
+
+    status = I219vCommitRegisterTransaction(&transaction);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    // TIDV/TADV действуют только на дескрипторы с битом IDE
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    DeviceContext->Moderation.Stats.DelayTimers = timers;
+    DeviceContext->Moderation.TxDelayEnabled = (timers.TxDelayUs != 0);
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
+              "Interrupt delay timers: RX %u/%u us, TX %u/%u us",
+              timers.RxDelayUs, timers.RxAbsoluteDelayUs, timers.TxDelayUs, timers.TxAbsoluteDelayUs);
+
+    return STATUS_SUCCESS;
+}
+
+// Настройка немедленного прерывания для мелких принятых пакетов
+// Пакет не длиннее порога вызывает прерывание SRPD сразу, не дожидаясь
+// таймеров RDTR/RADV, поэтому объемный прием можно откладывать таймерами,
+// не увеличивая задержку игровых пакетов. Общий интервал ITR действует
+// на все причины, поэтому профиль задает и умеренную шкалу ITR.
+NTSTATUS
+I219vConfigureSmallPacketDetect(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 ThresholdBytes
+    )
+{
+    NTSTATUS status;
+    I219V_REGISTER_TRANSACTION transaction;
+
+    I219vBeginRegisterTransaction(DeviceContext, &transaction);
+
+    status = I219vStageSmallPacketDetect(&transaction, ThresholdBytes);
+    if (!NT_SUCCESS(status)) {
+        I219vTransactionFail(&transaction, status);
+    }
+
+    status = I219vCommitRegisterTransaction(&transaction);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    DeviceContext->Moderation.Stats.SmallPacketThreshold = ThresholdBytes;
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "Small packet detect threshold: %u bytes", ThresholdBytes);
+
+    return STATUS_SUCCESS;
+}
+
+// Замер задержки от ISR до передачи принятых пакетов стеку
+// Вызывается под GamingSettingsLock.
+VOID
+I219vModerationReportDelay(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 DelayUs
+    )
+{
+    PI219V_MODERATION_STATS stats = &DeviceContext->Moderation.Stats;
+
+    if (stats->DelaySamples == 0) {
+        stats->MeasuredDelayUs = DelayUs;
+    } else {
+        stats->MeasuredDelayUs = (UINT32)((INT32)stats->MeasuredDelayUs +
+            (((INT32)DelayUs - (INT32)stats->MeasuredDelayUs) >> I219V_MODERATION_DELAY_EWMA_SHIFT));
+    }
+
+    stats->DelaySamples++;
+}
+
+// Получение статистики модерации прерываний
+VOID
+I219vGetModerationStats(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PI219V_MODERATION_STATS ModerationStats
+    )
+{
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    RtlCopyMemory(ModerationStats, &DeviceContext->Moderation.Stats, sizeof(I219V_MODERATION_STATS));
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Учет нагрузки и оценка уровня по окончании интервала
+// Вызывается из путей передачи и приема под GamingSettingsLock.
+VOID
+I219vModerationSample(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 RxPackets,
+    _In_ UINT32 TxPackets,
+    _In_ UINT32 TxCompletions,
+    _In_ UINT32 Bytes,
+    _In_ UINT64 Now
+    )
+{
+    PI219V_MODERATION_STATE moderation = &DeviceContext->Moderation;
+    UINT64 elapsed;
+    UINT32 packets;
+    UINT32 sizedPackets;
+    UINT32 currentLevel;
+    UINT32 targetLevel;
+    UINT32 newItr;
+
+    moderation->RxPackets += RxPackets;
+    moderation->TxPackets += TxPackets;
+    moderation->TxCompletions += TxCompletions;
+    moderation->Bytes += Bytes;
+
+    elapsed = Now - moderation->IntervalStart;
+    if (elapsed < I219V_MODERATION_INTERVAL) {
+        return;
+    }
+
+    // Нагрузка на прерывания - принятые пакеты и завершения передачи
+    packets = moderation->RxPackets + moderation->TxCompletions;
+
+    moderation->Stats.LastPacketRate = (UINT32)((UINT64)packets * 10000000 / elapsed);
+    sizedPackets = moderation->RxPackets + moderation->TxPackets;
+    moderation->Stats.LastAveragePacketSize = sizedPackets != 0 ?
+        (UINT32)(moderation->Bytes / sizedPackets) : 0;
+    moderation->Stats.Evaluations++;
+
+    moderation->RxPackets = 0;
+    moderation->TxPackets = 0;
+    moderation->TxCompletions = 0;
+    moderation->Bytes = 0;
+    moderation->IntervalStart = Now;
+
+    if (moderation->Stats.Disabled) {
+        // Модерация отключена профилем: нагрузка только учитывается
+        newItr = 0;
+    } else if (moderation->Stats.LatencyBudgetUs != I219V_LATENCY_BUDGET_AUTO) {
+        // Режим бюджета задержки
+        newItr = I219vModerationUpdateBudgetCap(moderation);
+    } else {
+        currentLevel = moderation->Stats.CurrentLevel;
+        targetLevel = I219vModerationTargetLevel(moderation->Stats.LastPacketRate,
+                                                 moderation->Stats.LastAveragePacketSize,
+                                                 moderation->Stats.LinkSpeedMbps);
+
+        if (targetLevel < moderation->Stats.MinLevel) {
+            targetLevel = moderation->Stats.MinLevel;
+        } else if (targetLevel > moderation->Stats.MaxLevel) {
+            targetLevel = moderation->Stats.MaxLevel;
+        }
+
+        if (targetLevel < currentLevel) {
+            // Нагрузка упала: сразу к целевому уровню, чтобы не задерживать редкие пакеты
+            currentLevel = targetLevel;
+            moderation->RaiseCount = 0;
+            moderation->Stats.LevelDrops++;
+        } else if (targetLevel > currentLevel) {
+            // Нагрузка выросла: один шаг после нескольких интервалов подряд
+            if (++moderation->RaiseCount >= I219V_MODERATION_RAISE_HOLD) {
+                currentLevel++;
+                moderation->RaiseCount = 0;
+                moderation->Stats.LevelRaises++;
+            }
+        } else {
+            moderation->RaiseCount = 0;
+        }
+
+        moderation->Stats.CurrentLevel = currentLevel;
+        newItr = ModerationItrTable[currentLevel];
+    }
+
+    // Пока уровень выше нижней границы, таймер простоя отодвигается
+    // каждой оценкой и срабатывает, только если трафик прекратился
+    if (!moderation->Stats.Disabled &&
+        moderation->Stats.LatencyBudgetUs == I219V_LATENCY_BUDGET_AUTO &&
+        moderation->Stats.CurrentLevel > moderation->Stats.MinLevel &&
+        moderation->IdleTimer != NULL) {
+        WdfTimerStart(moderation->IdleTimer, WDF_REL_TIMEOUT_IN_MS(I219V_MODERATION_IDLE_TIMEOUT_MS));
+    }
+
+    if (newItr == moderation->Stats.CurrentItr) {
+        return;
+    }
+
+    moderation->Stats.CurrentItr = newItr;
+
+    I219vWriteRegister(DeviceContext, I219V_REG_ITR, newItr);
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_DRIVER,
+              "Interrupt moderation ITR %u (level %u, budget %u us), %u pps, avg %u bytes",
+              newItr, moderation->Stats.CurrentLevel, moderation->Stats.LatencyBudgetUs,
+              moderation->Stats.LastPacketRate, moderation->Stats.LastAveragePacketSize);
+}
+
+
+// Таймер простоя модерации
+// Путь данных не вызывался дольше интервала оценки: интервал завершается
+// с накопленной (обычно нулевой) нагрузкой, и уровень снижается так же,
+// как при падении нагрузки.
+VOID
+I219vEvtModerationIdleTimer(
+    _In_ WDFTIMER Timer
+    )
+{
+    PI219V_DEVICE_CONTEXT deviceContext = I219vGetDeviceContext(WdfTimerGetParentObject(Timer));
+    PI219V_MODERATION_STATE moderation = &deviceContext->Moderation;
+    UINT64 now = KeQueryInterruptTime();
+
+    WdfSpinLockAcquire(deviceContext->GamingSettingsLock);
+
+    if (now - moderation->IntervalStart >= I219V_MODERATION_INTERVAL) {
+        moderation->Stats.IdleDecays++;
+        I219vModerationSample(deviceContext, 0, 0, 0, 0, now);
+    }
+
+    WdfSpinLockRelease(deviceContext->GamingSettingsLock);
+}
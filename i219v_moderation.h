@@ -0,0 +1,155 @@
+#pragma once
+
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_moderation.h
+
+Abstract:
+
+    Заголовочный файл для модуля динамической модерации прерываний Intel i219-v.
+    Путь данных накапливает число пакетов, байт и завершений передачи за
+    интервал; по окончании интервала значение ITR смещается по шкале уровней
+    в пределах, заданных игровым профилем. Если задан бюджет задержки в
+    микросекундах, ITR выбирается как наибольшее значение, при котором
+    добавленная задержка (интервал ITR плюс измеренная задержка от ISR до
+    передачи пакета стеку) остается в пределах бюджета.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+
+// Количество уровней модерации (значения ITR задаются таблицей в i219v_moderation.c)
+#define I219V_MODERATION_LEVEL_COUNT        8
+
+// Длительность интервала оценки нагрузки (единицы KeQueryInterruptTime - 100 нс)
+#define I219V_MODERATION_INTERVAL           (10 * 10000)    // 10 мс
+
+// Время без оценок из пути данных, после которого уровень снижается по
+// таймеру простоя (мс). Без него уровень, поднятый нагрузкой, держался бы
+// до следующего пакета, и первый пакет после паузы ждал бы полный ITR.
+#define I219V_MODERATION_IDLE_TIMEOUT_MS    20
+
+// Количество интервалов подряд, в течение которых должна держаться более
+// высокая целевая модерация, прежде чем уровень будет повышен на один шаг
+#define I219V_MODERATION_RAISE_HOLD         2
+
+// Скорость соединения, для которой заданы пороги частоты пакетов (Мбит/с)
+#define I219V_MODERATION_REFERENCE_SPEED    1000
+
+// Средний размер пакета, начиная с которого трафик считается объемным (байт)
+#define I219V_MODERATION_BULK_PACKET_SIZE   1024
+
+// Средний размер пакета, до которого трафик считается чувствительным к задержке (байт)
+#define I219V_MODERATION_SMALL_PACKET_SIZE  256
+
+// Бюджет задержки (мкс): 0 - автоматический режим по шкале уровней профиля
+#define I219V_LATENCY_BUDGET_AUTO           0
+#define I219V_LATENCY_BUDGET_MAX_US         10000
+
+// Регистр ITR: интервал в единицах 256 нс, поле 16 бит
+#define I219V_ITR_UNIT_NS                   256
+#define I219V_ITR_MAX                       0xFFFF
+
+// Перевод микросекунд в единицы ITR и обратно
+#define I219V_US_TO_ITR(_us)                ((((UINT32)(_us)) * 1000 + I219V_ITR_UNIT_NS / 2) / I219V_ITR_UNIT_NS)
+#define I219V_ITR_TO_US(_itr)               ((((UINT32)(_itr)) * I219V_ITR_UNIT_NS + 500) / 1000)
+
+// Наибольшая задержка таймеров RDTR/RADV/TIDV/TADV (мкс, 16-битное поле по 1.024 мкс)
+#define I219V_DELAY_TIMER_MAX_US            65000
+
+// Порог немедленного прерывания для мелких принятых пакетов (байт, 0 - отключено)
+#define I219V_SMALL_PACKET_DETECT_DISABLED  0
+#define I219V_SMALL_PACKET_DETECT_MAX       4095
+
+// Таймеры задержки прерываний приема и передачи (мкс, 0 - таймер отключен)
+// Таймер "от пакета" перезапускается каждым новым пакетом, абсолютный
+// ограничивает общую задержку с первого отложенного пакета.
+typedef struct _I219V_DELAY_TIMERS {
+    UINT32 RxDelayUs;                               // RDTR
+    UINT32 RxAbsoluteDelayUs;                       // RADV
+    UINT32 TxDelayUs;                               // TIDV
+    UINT32 TxAbsoluteDelayUs;                       // TADV
+} I219V_DELAY_TIMERS, *PI219V_DELAY_TIMERS;
+
+// Статистика модерации прерываний
+typedef struct _I219V_MODERATION_STATS {
+    UINT64 Evaluations;                             // Количество завершенных интервалов оценки
+    UINT64 LevelRaises;                             // Повышения уровня модерации
+    UINT64 LevelDrops;                              // Понижения уровня модерации
+    UINT32 CurrentLevel;                            // Текущий уровень
+    UINT32 MinLevel;                                // Нижняя граница уровня (из профиля)
+    UINT32 MaxLevel;                                // Верхняя граница уровня (из профиля)
+    UINT32 CurrentItr;                              // Текущее значение регистра ITR (единицы 256 нс)
+    UINT32 LastPacketRate;                          // Пакетов в секунду за последний интервал
+    UINT32 LastAveragePacketSize;                   // Средний размер пакета за последний интервал (байт)
+    UINT32 LatencyBudgetUs;                         // Бюджет задержки (0 - автоматический режим)
+    UINT32 BudgetItrCap;                            // Текущий предел ITR, выведенный из бюджета и обратной связи
+    UINT32 MeasuredDelayUs;                         // Скользящее среднее задержки ISR - передача стеку (мкс)
+    UINT64 DelaySamples;                            // Количество замеров задержки
+    UINT64 BudgetOverruns;                          // Интервалы, в которых задержка превысила бюджет
+    I219V_DELAY_TIMERS DelayTimers;                 // Текущие таймеры задержки прерываний
+    UINT32 SmallPacketThreshold;                    // Порог RSRPD (байт, 0 - отключено)
+    UINT64 IdleDecays;                              // Оценки, выполненные таймером простоя
+    BOOLEAN Disabled;                               // Модерация отключена профилем (ITR = 0, режим сохраняется)
+    UINT32 LinkSpeedMbps;                           // Скорость, по которой масштабированы пороги частоты пакетов
+} I219V_MODERATION_STATS, *PI219V_MODERATION_STATS;
+
+// Состояние модуля модерации прерываний
+typedef struct _I219V_MODERATION_STATE {
+    UINT64 IntervalStart;                           // Начало текущего интервала (KeQueryInterruptTime)
+    UINT32 RxPackets;                               // Принятые пакеты за интервал
+    UINT32 TxPackets;                               // Поставленные в кольцо пакеты за интервал
+    UINT32 TxCompletions;                           // Завершенные пакеты передачи за интервал
+    UINT64 Bytes;                                   // Принятые и переданные байты за интервал
+    UINT32 RaiseCount;                              // Интервалов подряд с целевым уровнем выше текущего
+    BOOLEAN TxDelayEnabled;                         // Устанавливать IDE в дескрипторах передачи
+    WDFTIMER IdleTimer;                             // Снижение уровня при отсутствии трафика
+    I219V_MODERATION_STATS Stats;                   // Статистика
+} I219V_MODERATION_STATE, *PI219V_MODERATION_STATE;
+
+// Объявление функций для модерации прерываний
+NTSTATUS I219vInitializeModeration(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vStopModeration(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vModerationSetBounds(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 InterruptModeration);
+VOID I219vModerationSetLinkSpeed(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 LinkSpeedMbps);
+VOID I219vModerationSetDisabled(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ BOOLEAN Disabled);
+VOID I219vGetModerationStats(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_MODERATION_STATS ModerationStats);
+NTSTATUS I219vLoadModerationConfiguration(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+NTSTATUS I219vSetInterruptLatencyBudget(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 LatencyBudgetUs);
+VOID I219vApplyInterruptModeration(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vRestoreModerationRegisters(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+NTSTATUS I219vNormalizeDelayTimers(_Inout_ PI219V_DELAY_TIMERS DelayTimers);
+NTSTATUS I219vConfigureDelayTimers(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ PI219V_DELAY_TIMERS DelayTimers);
+NTSTATUS I219vConfigureSmallPacketDetect(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 ThresholdBytes);
+
+// Сбор регистров модерации в транзакцию применения профиля
+// Состояние модуля меняет только I219vModerationCommitSettings после фиксации.
+VOID I219vStageInterruptModeration(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Inout_ struct _I219V_REGISTER_TRANSACTION* Transaction, _In_ UINT32 InterruptModeration);
+NTSTATUS I219vStageDelayTimers(_Inout_ struct _I219V_REGISTER_TRANSACTION* Transaction, _Inout_ PI219V_DELAY_TIMERS DelayTimers);
+NTSTATUS I219vStageSmallPacketDetect(_Inout_ struct _I219V_REGISTER_TRANSACTION* Transaction, _In_ UINT32 ThresholdBytes);
+VOID I219vModerationCommitSettings(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 InterruptModeration, _In_ PI219V_DELAY_TIMERS DelayTimers, _In_ UINT32 SmallPacketThreshold);
+
+// Учет нагрузки в путях передачи и приема (вызывается под GamingSettingsLock)
+VOID I219vModerationSample(
+    _In_ struct _I219V_DEVICE_CONTEXT* DeviceContext,
+    _In_ UINT32 RxPackets,
+    _In_ UINT32 TxPackets,
+    _In_ UINT32 TxCompletions,
+    _In_ UINT32 Bytes,
+    _In_ UINT64 Now
+    );
+
+// Обратная связь: задержка от ISR до передачи пакетов стеку (вызывается под GamingSettingsLock)
+VOID I219vModerationReportDelay(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 DelayUs);
+
+EVT_WDF_TIMER I219vEvtModerationIdleTimer;
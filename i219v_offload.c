@@ -40,7 +40,7 @@ I219vInitializeOffloads(
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Initializing hardware offloads");
 
     // Настройка оффлоада контрольной суммы для приема
-    rxcsum = I219vReadRegister(DeviceContext, I219V_REG_RXCSUM);
+    rxcsum = I219vReadRegisterShadow(DeviceContext, I219V_REG_RXCSUM);
     
     // Включение оффлоада IP-контрольной суммы
     rxcsum |= I219V_RXCSUM_IPOFLD;
@@ -55,7 +55,7 @@ I219vInitializeOffloads(
               "Receive checksum offload configured, RXCSUM: 0x%08x", rxcsum);
 
     // Настройка оффлоада контрольной суммы для передачи
-    tctl = I219vReadRegister(DeviceContext, I219V_REG_TCTL);
+    tctl = I219vReadRegisterShadow(DeviceContext, I219V_REG_TCTL);
     tctlExt = I219vReadRegister(DeviceContext, I219V_REG_TCTL_EXT);
     
     // Запись регистров TCTL и TCTL_EXT
@@ -111,12 +111,13 @@ I219vConfigureVlan(
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Configuring VLAN support");
 
     // Чтение регистра CTRL
-    ctrl = I219vReadRegister(DeviceContext, I219V_REG_CTRL);
+    ctrl = I219vReadRegisterShadow(DeviceContext, I219V_REG_CTRL);
     
     // Чтение регистра RCTL
-    rctl = I219vReadRegister(DeviceContext, I219V_REG_RCTL);
+    rctl = I219vReadRegisterShadow(DeviceContext, I219V_REG_RCTL);
     
     // Включение поддержки VLAN
+    DeviceContext->VlanOffloadEnabled = TRUE;
     ctrl |= I219V_CTRL_VME;  // VLAN Mode Enable
     
     // Настройка приема VLAN-пакетов
@@ -201,7 +202,7 @@ I219vSetChecksumOffload(
               EnableUdpChecksum ? "enabled" : "disabled");
 
     // Чтение текущего значения регистра RXCSUM
-    rxcsum = I219vReadRegister(DeviceContext, I219V_REG_RXCSUM);
+    rxcsum = I219vReadRegisterShadow(DeviceContext, I219V_REG_RXCSUM);
 
     if (EnableIpChecksum) {
         // Включение оффлоада IP-контрольной суммы
@@ -265,31 +266,50 @@ I219vSetVlanOffload(
     _In_ BOOLEAN EnableVlanOffload
     )
 {
-    UINT32 ctrl;
-
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, 
               "%s VLAN offload", 
               EnableVlanOffload ? "Enabling" : "Disabling");
 
-    // Чтение текущего значения регистра CTRL
-    ctrl = I219vReadRegister(DeviceContext, I219V_REG_CTRL);
+    // Запоминаем запрос: CTRL.VME восстанавливается после сброса MAC
+    DeviceContext->VlanOffloadEnabled = EnableVlanOffload;
 
-    if (EnableVlanOffload) {
-        // Включение поддержки VLAN
-        ctrl |= I219V_CTRL_VME;  // VLAN Mode Enable
-    } else {
-        // Отключение поддержки VLAN
-        ctrl &= ~I219V_CTRL_VME;
+    // До инициализации оборудования регистры не отображены,
+    // бит будет установлен из I219vInitializeHardware
+    if (DeviceContext->DeviceInitialized) {
+        I219vApplyVlanMode(DeviceContext);
     }
 
-    // Запись регистра CTRL
-    I219vWriteRegister(DeviceContext, I219V_REG_CTRL, ctrl);
+    return STATUS_SUCCESS;
+}
 
-    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, 
-              "VLAN offload %s, CTRL: 0x%08x", 
-              EnableVlanOffload ? "enabled" : "disabled", ctrl);
+// Применение CTRL.VME по сохраненным настройкам
+// VME нужен как для оффлоада VLAN, так и для вставки тега 802.1p из
+// маркировки QoS, поэтому бит снимается, только если не нужен ни одному.
+VOID
+I219vApplyVlanMode(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    BOOLEAN enableVme;
+    UINT32 ctrl;
 
-    return STATUS_SUCCESS;
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    enableVme = DeviceContext->VlanOffloadEnabled ||
+                DeviceContext->QosMarkingConfig.EnablePriorityTagging;
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    if (enableVme) {
+        ctrl = I219vModifyRegister(DeviceContext, I219V_REG_CTRL, 0, I219V_CTRL_VME);
+    } else {
+        ctrl = I219vModifyRegister(DeviceContext, I219V_REG_CTRL, I219V_CTRL_VME, 0);
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, 
+              "VLAN mode %s (offload=%d, priority tagging=%d), CTRL: 0x%08x", 
+              enableVme ? "enabled" : "disabled",
+              DeviceContext->VlanOffloadEnabled,
+              DeviceContext->QosMarkingConfig.EnablePriorityTagging,
+              ctrl);
 }
 
 // Получение статистики оффлоадов
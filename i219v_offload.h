@@ -51,4 +51,5 @@ NTSTATUS I219vSetVlanFilter(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _I
 NTSTATUS I219vSetChecksumOffload(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ BOOLEAN EnableIpChecksum, _In_ BOOLEAN EnableTcpChecksum, _In_ BOOLEAN EnableUdpChecksum);
 NTSTATUS I219vSetTsoOffload(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ BOOLEAN EnableTso);
 NTSTATUS I219vSetVlanOffload(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ BOOLEAN EnableVlanOffload);
+VOID I219vApplyVlanMode(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 VOID I219vGetOffloadStatistics(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_OFFLOAD_STATISTICS OffloadStatistics);
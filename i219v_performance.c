@@ -26,72 +26,60 @@ Environment:
 #include "i219v_hw.h"
 #include "i219v_hw_extended.h"
 #include "i219v_performance.h"
+#include "i219v_moderation.h"
 #include "DeviceContext.h"
 #include "Trace.h"
 
 // Оптимизация параметров прерываний
+// Уровень модерации профиля задает только границы шкалы ITR (в тех же
+// единицах 0-100, что и InterruptModeration игрового профиля). Бюджет
+// задержки, заданный явно, и автоматический режим не изменяются: профиль
+// производительности выражает предпочтение, а не требование к задержке.
+// (Регистров EITR/EIAM у MAC семейства PCH нет - используется только ITR.)
 NTSTATUS
 I219vOptimizeInterrupts(
     _In_ PI219V_DEVICE_CONTEXT DeviceContext,
     _In_ I219V_INTERRUPT_MODERATION_LEVEL ModerationLevel
     )
 {
-    UINT32 eitr0;
+    UINT32 interruptModeration;
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, 
               "Optimizing interrupts, moderation level: %d", ModerationLevel);
 
-    // Настройка регистра EITR0 (Extended Interrupt Throttle Register)
-    // Этот регистр контролирует коалесцинг прерываний
     switch (ModerationLevel) {
     case I219V_INTERRUPT_MODERATION_DISABLED:
-        // Отключение модерации прерываний
-        eitr0 = 0;
+        // Модерация отключена: ITR = 0
+        interruptModeration = 0;
         break;
         
     case I219V_INTERRUPT_MODERATION_LOW:
         // Низкий уровень модерации (минимальная задержка)
-        // ITR = 2 мкс (значение 2)
-        eitr0 = 2;
+        interruptModeration = 20;
         break;
         
     case I219V_INTERRUPT_MODERATION_MEDIUM:
         // Средний уровень модерации (баланс между задержкой и пропускной способностью)
-        // ITR = 20 мкс (значение 20)
-        eitr0 = 20;
+        interruptModeration = 50;
         break;
         
     case I219V_INTERRUPT_MODERATION_HIGH:
         // Высокий уровень модерации (максимальная пропускная способность)
-        // ITR = 200 мкс (значение 200)
-        eitr0 = 200;
+        interruptModeration = 80;
         break;
         
     default:
         // По умолчанию - средний уровень модерации
-        eitr0 = 20;
+        interruptModeration = 50;
         break;
     }
 
-    // Запись регистра EITR0
-    I219vWriteRegister(DeviceContext, I219V_REG_EITR0, eitr0);
-    
-    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, 
-              "Interrupt moderation configured, EITR0: 0x%08x", eitr0);
-
-    // Настройка регистра IAM (Interrupt Acknowledge Auto-Mask)
-    // Этот регистр контролирует автоматическую маскировку прерываний
-    if (ModerationLevel != I219V_INTERRUPT_MODERATION_DISABLED) {
-        // Включение автоматической маскировки прерываний
-        I219vWriteRegister(DeviceContext, I219V_REG_EIAM, 0xFFFFFFFF);
-        TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, 
-                  "Interrupt auto-mask enabled");
-    } else {
-        // Отключение автоматической маскировки прерываний
-        I219vWriteRegister(DeviceContext, I219V_REG_EIAM, 0);
-        TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, 
-                  "Interrupt auto-mask disabled");
-    }
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    I219vModerationSetBounds(DeviceContext, interruptModeration);
+    I219vModerationSetDisabled(DeviceContext, ModerationLevel == I219V_INTERRUPT_MODERATION_DISABLED);
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    I219vApplyInterruptModeration(DeviceContext);
 
     return STATUS_SUCCESS;
 }
@@ -107,7 +95,7 @@ I219vOptimizeDma(
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Optimizing DMA parameters");
 
     // Настройка параметров DMA для приема
-    rxdctl = I219vReadRegister(DeviceContext, I219V_REG_RXDCTL);
+    rxdctl = I219vReadRegisterShadow(DeviceContext, I219V_REG_RXDCTL);
     
     // Установка порогов предвыборки, хоста и записи
     rxdctl &= ~(I219V_RXDCTL_PTHRESH_MASK | I219V_RXDCTL_HTHRESH_MASK | I219V_RXDCTL_WTHRESH_MASK);
@@ -125,7 +113,7 @@ I219vOptimizeDma(
               "DMA receive parameters configured, RXDCTL: 0x%08x", rxdctl);
 
     // Настройка параметров DMA для передачи
-    txdctl = I219vReadRegister(DeviceContext, I219V_REG_TXDCTL);
+    txdctl = I219vReadRegisterShadow(DeviceContext, I219V_REG_TXDCTL);
     
     // Установка порогов предвыборки, хоста и записи
     txdctl &= ~(I219V_TXDCTL_PTHRESH_MASK | I219V_TXDCTL_HTHRESH_MASK | I219V_TXDCTL_WTHRESH_MASK);
@@ -156,7 +144,7 @@ I219vOptimizeBufferSizes(
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Optimizing buffer sizes");
 
     // Настройка размеров буферов приема
-    rctl = I219vReadRegister(DeviceContext, I219V_REG_RCTL);
+    rctl = I219vReadRegisterShadow(DeviceContext, I219V_REG_RCTL);
     
     // Очистка битов размера буфера
     rctl &= ~I219V_RCTL_FLXBUF_MASK;
@@ -229,7 +217,7 @@ I219vOptimizeTransmitParameters(
               "Transmit IPG configured, TIPG: 0x%08x", tipg);
 
     // Настройка параметров передачи
-    tctl = I219vReadRegister(DeviceContext, I219V_REG_TCTL);
+    tctl = I219vReadRegisterShadow(DeviceContext, I219V_REG_TCTL);
     
     // Установка порога коллизий (CT)
     tctl &= ~I219V_TCTL_CT_MASK;
@@ -259,7 +247,7 @@ I219vOptimizeReceiveParameters(
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Optimizing receive parameters");
 
     // Настройка параметров приема
-    rctl = I219vReadRegister(DeviceContext, I219V_REG_RCTL);
+    rctl = I219vReadRegisterShadow(DeviceContext, I219V_REG_RCTL);
     
     // Установка типа дескриптора
     rctl &= ~I219V_RCTL_DTYP_MASK;
@@ -272,7 +260,7 @@ I219vOptimizeReceiveParameters(
               "Receive parameters configured, RCTL: 0x%08x", rctl);
 
     // Настройка фильтрации приема
-    rfctl = I219vReadRegister(DeviceContext, I219V_REG_RFCTL);
+    rfctl = I219vReadRegisterShadow(DeviceContext, I219V_REG_RFCTL);
     
     // Запись регистра RFCTL
     I219vWriteRegister(DeviceContext, I219V_REG_RFCTL, rfctl);
@@ -304,6 +292,14 @@ I219vApplyPerformanceOptimizations(
         return status;
     }
 
+    // Таймеры задержки прерываний приема и передачи
+    status = I219vConfigureDelayTimers(DeviceContext, &PerformanceProfile->DelayTimers);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, 
+                  "I219vConfigureDelayTimers failed %!STATUS!", status);
+        return status;
+    }
+
     // Оптимизация DMA
     status = I219vOptimizeDma(DeviceContext);
     if (!NT_SUCCESS(status)) {
@@ -388,6 +384,10 @@ I219vGetThroughputPerformanceProfile(
     PerformanceProfile->RxBufferSize = 4096;  // 4K
     PerformanceProfile->MaxRxQueues = 1;
     PerformanceProfile->MaxTxQueues = 1;
+    PerformanceProfile->DelayTimers.RxDelayUs = 16;
+    PerformanceProfile->DelayTimers.RxAbsoluteDelayUs = 64;
+    PerformanceProfile->DelayTimers.TxDelayUs = 128;   // Завершения передачи не влияют на задержку данных
+    PerformanceProfile->DelayTimers.TxAbsoluteDelayUs = 512;
 }
 
 // Получение профиля производительности для минимальной задержки
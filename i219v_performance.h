@@ -22,6 +22,7 @@ Environment:
 #include <ntddk.h>
 #include <wdf.h>
 #include <netadaptercx.h>
+#include "i219v_moderation.h"
 
 // Размеры колец дескрипторов
 #define I219V_RX_RING_SIZE    256
@@ -53,6 +54,7 @@ typedef struct _I219V_PERFORMANCE_PROFILE {
     UINT32 RxBufferSize;                              // Размер буфера приема
     UINT32 MaxRxQueues;                               // Максимальное количество очередей приема
     UINT32 MaxTxQueues;                               // Максимальное количество очередей передачи
+    I219V_DELAY_TIMERS DelayTimers;                   // Таймеры задержки прерываний RDTR/RADV/TIDV/TADV
 } I219V_PERFORMANCE_PROFILE, *PI219V_PERFORMANCE_PROFILE;
 
 // Объявление функций для оптимизации производительности
@@ -26,30 +26,165 @@ Environment:
 #include "i219v_hw.h"
 #include "i219v_hw_extended.h"
 #include "i219v_phy.h"
+#include "i219v_reset.h"
 #include "DeviceContext.h"
 #include "Trace.h"
 
-// Чтение регистра PHY
-USHORT
-I219vReadPhy(
+// Команда MDIC для операции с регистром PHY
+UINT32
+I219vPhyMdicCommand(
+    _In_ USHORT PhyRegister,
+    _In_ BOOLEAN Write,
+    _In_ USHORT PhyData
+    )
+{
+    return ((UINT32)PhyRegister << I219V_MDIC_REG_SHIFT) |
+           (I219V_REG_PHYADDR << I219V_MDIC_PHY_SHIFT) |
+           (Write ? (I219V_MDIC_OP_WRITE | PhyData) : I219V_MDIC_OP_READ);
+}
+
+// Ожидание READY операции, брошенной по таймауту
+// Вызывается владельцем MDIC вне блокировки механизма. Запись новой
+// команды до READY заменила бы выполняемую операцию на середине кадра MDIO.
+static
+VOID
+I219vPhyDrainMdic(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_PHY_ENGINE engine = &DeviceContext->PhyEngine;
+    UINT32 i;
+
+    for (i = 0; i < I219V_PHY_DRAIN_TIMEOUT_US / 10; i++) {
+        if (I219vReadRegisterEx(DeviceContext, I219V_REG_PHYREG, I219V_MMIO_CATEGORY_PHY) & I219V_MDIC_READY) {
+            return;
+        }
+        NdisStallExecution(10);
+    }
+
+    WdfSpinLockAcquire(engine->Lock);
+    engine->Stats.StuckOperations++;
+    WdfSpinLockRelease(engine->Lock);
+
+    TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE,
+              "MDIC not ready %u us after abandoned operation", I219V_PHY_DRAIN_TIMEOUT_US);
+}
+
+// Захват MDIC синхронной операцией
+// Ожидает завершения выполняемого асинхронного запроса; если он не
+// завершился за таймаут, запрос завершается с STATUS_IO_TIMEOUT. Брошенная
+// операция может еще выполняться, поэтому перед возвратом ожидается READY.
+// До создания механизма (инициализация устройства) захват не нужен.
+static
+VOID
+I219vPhyAcquireMdic(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_PHY_ENGINE engine = &DeviceContext->PhyEngine;
+    PI219V_PHY_REQUEST abandoned = NULL;
+    BOOLEAN drain = FALSE;
+    UINT32 i;
+
+    if (engine->Lock == NULL) {
+        return;
+    }
+
+    for (i = 0; ; i++) {
+        WdfSpinLockAcquire(engine->Lock);
+
+        if ((engine->Current == NULL || i * 10 >= I219V_PHY_ASYNC_TIMEOUT_US) && !engine->SyncActive) {
+            if (engine->Current != NULL) {
+                abandoned = engine->Current;
+                abandoned->Status = STATUS_IO_TIMEOUT;
+                engine->Current = NULL;
+                engine->Stats.Timeouts++;
+                engine->Draining = TRUE;
+            }
+
+            // Ожидание READY переходит к синхронной операции
+            drain = engine->Draining;
+            engine->Draining = FALSE;
+            engine->SyncActive = TRUE;
+            engine->Stats.SyncAccesses++;
+            WdfSpinLockRelease(engine->Lock);
+            break;
+        }
+
+        WdfSpinLockRelease(engine->Lock);
+        NdisStallExecution(10);
+    }
+
+    if (drain) {
+        I219vPhyDrainMdic(DeviceContext);
+    }
+
+    if (abandoned != NULL) {
+        TraceEvents(TRACE_LEVEL_WARNING, TRACE_HARDWARE,
+                  "Async PHY request for register 0x%04x timed out", abandoned->PhyRegister);
+        if (abandoned->Completion != NULL) {
+            abandoned->Completion(DeviceContext, abandoned);
+        }
+    }
+}
+
+// Попытка захвата MDIC без ожидания
+// Используется последовательностью сброса из таймера: при занятом MDIC
+// попытка повторяется на следующем срабатывании, в том числе пока брошенная
+// операция не выставила READY (механизм может быть остановлен, поэтому
+// READY проверяется здесь же). Освобождение - через I219vPhyReleaseMdic.
+BOOLEAN
+I219vPhyTryAcquireMdic(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_PHY_ENGINE engine = &DeviceContext->PhyEngine;
+    BOOLEAN acquired = FALSE;
+
+    if (engine->Lock == NULL) {
+        return TRUE;
+    }
+
+    WdfSpinLockAcquire(engine->Lock);
+    if (engine->Draining && engine->Current == NULL && !engine->SyncActive &&
+        (I219vReadRegisterEx(DeviceContext, I219V_REG_PHYREG, I219V_MMIO_CATEGORY_PHY) & I219V_MDIC_READY)) {
+        engine->Draining = FALSE;
+    }
+    if (engine->Current == NULL && !engine->SyncActive && !engine->Draining) {
+        engine->SyncActive = TRUE;
+        engine->Stats.SyncAccesses++;
+        acquired = TRUE;
+    }
+    WdfSpinLockRelease(engine->Lock);
+
+    return acquired;
+}
+
+// Чтение регистра PHY с результатом операции
+// STATUS_DEVICE_DATA_ERROR - ошибка MDIC, STATUS_IO_TIMEOUT - нет READY;
+// в обоих случаях PhyData равно 0.
+NTSTATUS
+I219vReadPhyEx(
     _In_ PI219V_DEVICE_CONTEXT DeviceContext,
-    _In_ USHORT PhyRegister
+    _In_ USHORT PhyRegister,
+    _Out_ PUSHORT PhyData
     )
 {
     UINT32 mdic;
     UINT32 i;
     USHORT phyData = 0;
 
+    *PhyData = 0;
+
     TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_HARDWARE, 
               "Reading PHY register 0x%04x", PhyRegister);
 
     // Формирование команды чтения PHY
-    mdic = ((UINT32)PhyRegister << 16) |
-           (I219V_REG_PHYADDR << 21) |
-           (1 << 27);  // Операция чтения
+    mdic = I219vPhyMdicCommand(PhyRegister, FALSE, 0);
 
     // Запись команды в регистр MDIC
-    I219vWriteRegister(DeviceContext, I219V_REG_PHYREG, mdic);
+    I219vPhyAcquireMdic(DeviceContext);
+    I219vWriteRegisterEx(DeviceContext, I219V_REG_PHYREG, mdic, I219V_MMIO_CATEGORY_PHY);
 
     // Ожидание завершения операции
     for (i = 0; i < I219V_PHY_TIMEOUT; i++) {
@@ -57,30 +192,48 @@ I219vReadPhy(
         NdisStallExecution(10);
 
         // Чтение регистра MDIC
-        mdic = I219vReadRegister(DeviceContext, I219V_REG_PHYREG);
+        mdic = I219vReadRegisterEx(DeviceContext, I219V_REG_PHYREG, I219V_MMIO_CATEGORY_PHY);
 
         // Проверка бита готовности
-        if (mdic & (1 << 28)) {
+        if (mdic & I219V_MDIC_READY) {
             // Операция завершена
-            if (mdic & (1 << 30)) {
+            if (mdic & I219V_MDIC_ERROR) {
                 // Ошибка доступа к PHY
+                I219vPhyReleaseMdic(DeviceContext);
                 TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, 
                           "PHY read error, register 0x%04x", PhyRegister);
-                return 0;
+                return STATUS_DEVICE_DATA_ERROR;
             }
 
             // Извлечение данных
-            phyData = (USHORT)(mdic & 0xFFFF);
+            I219vPhyReleaseMdic(DeviceContext);
+            phyData = (USHORT)(mdic & I219V_MDIC_DATA_MASK);
             TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_HARDWARE, 
                       "PHY register 0x%04x = 0x%04x", PhyRegister, phyData);
-            return phyData;
+            *PhyData = phyData;
+            return STATUS_SUCCESS;
         }
     }
 
     // Таймаут операции
+    I219vPhyAbandonMdic(DeviceContext);
     TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, 
               "PHY read timeout, register 0x%04x", PhyRegister);
-    return 0;
+    return STATUS_IO_TIMEOUT;
+}
+
+// Чтение регистра PHY (0 при ошибке или таймауте MDIC)
+USHORT
+I219vReadPhy(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ USHORT PhyRegister
+    )
+{
+    USHORT phyData;
+
+    (VOID)I219vReadPhyEx(DeviceContext, PhyRegister, &phyData);
+
+    return phyData;
 }
 
 // Запись в регистр PHY
@@ -98,13 +251,11 @@ I219vWritePhy(
               "Writing PHY register 0x%04x = 0x%04x", PhyRegister, PhyData);
 
     // Формирование команды записи PHY
-    mdic = ((UINT32)PhyRegister << 16) |
-           (I219V_REG_PHYADDR << 21) |
-           (2 << 27) |  // Операция записи
-           PhyData;
+    mdic = I219vPhyMdicCommand(PhyRegister, TRUE, PhyData);
 
     // Запись команды в регистр MDIC
-    I219vWriteRegister(DeviceContext, I219V_REG_PHYREG, mdic);
+    I219vPhyAcquireMdic(DeviceContext);
+    I219vWriteRegisterEx(DeviceContext, I219V_REG_PHYREG, mdic, I219V_MMIO_CATEGORY_PHY);
 
     // Ожидание завершения операции
     for (i = 0; i < I219V_PHY_TIMEOUT; i++) {
@@ -112,64 +263,700 @@ I219vWritePhy(
         NdisStallExecution(10);
 
         // Чтение регистра MDIC
-        mdic = I219vReadRegister(DeviceContext, I219V_REG_PHYREG);
+        mdic = I219vReadRegisterEx(DeviceContext, I219V_REG_PHYREG, I219V_MMIO_CATEGORY_PHY);
 
         // Проверка бита готовности
-        if (mdic & (1 << 28)) {
+        if (mdic & I219V_MDIC_READY) {
             // Операция завершена
-            if (mdic & (1 << 30)) {
+            if (mdic & I219V_MDIC_ERROR) {
                 // Ошибка доступа к PHY
                 TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, 
                           "PHY write error, register 0x%04x", PhyRegister);
             }
+            I219vPhyReleaseMdic(DeviceContext);
             return;
         }
     }
 
     // Таймаут операции
+    I219vPhyAbandonMdic(DeviceContext);
     TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, 
               "PHY write timeout, register 0x%04x", PhyRegister);
 }
 
-// Сброс PHY
+// Запуск следующего запроса очереди
+// Вызывается под блокировкой механизма.
+static
+VOID
+I219vPhyEngineStartNext(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_PHY_ENGINE engine = &DeviceContext->PhyEngine;
+    PI219V_PHY_REQUEST request;
+
+    if (engine->Current != NULL || engine->SyncActive || engine->Draining ||
+        !engine->Running || IsListEmpty(&engine->Pending)) {
+        return;
+    }
+
+    request = CONTAINING_RECORD(RemoveHeadList(&engine->Pending), I219V_PHY_REQUEST, ListEntry);
+    engine->QueueDepth--;
+
+    engine->Current = request;
+    engine->CurrentStart = KeQueryInterruptTime();
+
+    // Причина MDAC разрешается на время операции; ISR маскирует ее при срабатывании
+    I219vWriteRegisterEx(DeviceContext, I219V_REG_IMS, I219V_IMS_MDAC, I219V_MMIO_CATEGORY_PHY);
+    I219vWriteRegisterEx(DeviceContext, I219V_REG_PHYREG,
+                       I219vPhyMdicCommand(request->PhyRegister, request->Write, request->Data),
+                       I219V_MMIO_CATEGORY_PHY);
+
+    WdfTimerStart(engine->PollTimer, WDF_REL_TIMEOUT_IN_US(I219V_PHY_ASYNC_POLL_US));
+}
+
+// Освобождение MDIC после синхронной операции
+VOID
+I219vPhyReleaseMdic(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_PHY_ENGINE engine = &DeviceContext->PhyEngine;
+
+    if (engine->Lock == NULL) {
+        return;
+    }
+
+    WdfSpinLockAcquire(engine->Lock);
+    engine->SyncActive = FALSE;
+    I219vPhyEngineStartNext(DeviceContext);
+    WdfSpinLockRelease(engine->Lock);
+}
+
+// Освобождение MDIC после операции без READY (таймаут)
+// Операция может еще выполняться: следующая команда выдается только после
+// READY, который проверяет таймер опроса или следующий синхронный захват.
+VOID
+I219vPhyAbandonMdic(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_PHY_ENGINE engine = &DeviceContext->PhyEngine;
+
+    if (engine->Lock == NULL) {
+        return;
+    }
+
+    WdfSpinLockAcquire(engine->Lock);
+    engine->SyncActive = FALSE;
+    engine->Draining = TRUE;
+    engine->CurrentStart = KeQueryInterruptTime();
+    engine->Stats.Timeouts++;
+    if (engine->Running) {
+        WdfTimerStart(engine->PollTimer, WDF_REL_TIMEOUT_IN_US(I219V_PHY_ASYNC_POLL_US));
+    }
+    WdfSpinLockRelease(engine->Lock);
+}
+
+// Проверка выполняемой операции MDIC
+// Вызывается из DPC прерывания (MDAC) и из таймера опроса.
+static
+VOID
+I219vPhyEngineCheck(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ BOOLEAN Timer
+    )
+{
+    PI219V_PHY_ENGINE engine = &DeviceContext->PhyEngine;
+    PI219V_PHY_REQUEST completed = NULL;
+    PI219V_PHY_REQUEST request;
+    BOOLEAN stuck = FALSE;
+    UINT32 mdic;
+
+    WdfSpinLockAcquire(engine->Lock);
+
+    if (Timer) {
+        engine->Stats.TimerPolls++;
+    } else {
+        engine->Stats.InterruptServices++;
+    }
+
+    // Ожидание READY брошенной операции перед следующей командой
+    if (engine->Draining && !engine->SyncActive) {
+        mdic = I219vReadRegisterEx(DeviceContext, I219V_REG_PHYREG, I219V_MMIO_CATEGORY_PHY);
+
+        if (mdic & I219V_MDIC_READY) {
+            engine->Draining = FALSE;
+        } else if (KeQueryInterruptTime() - engine->CurrentStart >= (UINT64)I219V_PHY_DRAIN_TIMEOUT_US * 10) {
+            engine->Draining = FALSE;
+            engine->Stats.StuckOperations++;
+            stuck = TRUE;
+        } else {
+            WdfTimerStart(engine->PollTimer, WDF_REL_TIMEOUT_IN_US(I219V_PHY_ASYNC_POLL_US));
+        }
+
+        if (!engine->Draining) {
+            I219vPhyEngineStartNext(DeviceContext);
+        }
+    }
+
+    request = engine->Current;
+    if (request != NULL && !engine->SyncActive) {
+        mdic = I219vReadRegisterEx(DeviceContext, I219V_REG_PHYREG, I219V_MMIO_CATEGORY_PHY);
+
+        if (mdic & I219V_MDIC_READY) {
+            if (mdic & I219V_MDIC_ERROR) {
+                request->Status = STATUS_DEVICE_DATA_ERROR;
+                engine->Stats.Errors++;
+            } else {
+                request->Status = STATUS_SUCCESS;
+                if (!request->Write) {
+                    request->Data = (USHORT)(mdic & I219V_MDIC_DATA_MASK);
+                }
+            }
+            engine->Stats.Completed++;
+            completed = request;
+        } else if (KeQueryInterruptTime() - engine->CurrentStart >= (UINT64)I219V_PHY_ASYNC_TIMEOUT_US * 10) {
+            // Следующий запрос запускается после READY брошенной операции
+            request->Status = STATUS_IO_TIMEOUT;
+            engine->Stats.Timeouts++;
+            engine->Draining = TRUE;
+            engine->CurrentStart = KeQueryInterruptTime();
+            WdfTimerStart(engine->PollTimer, WDF_REL_TIMEOUT_IN_US(I219V_PHY_ASYNC_POLL_US));
+            completed = request;
+        } else {
+            WdfTimerStart(engine->PollTimer, WDF_REL_TIMEOUT_IN_US(I219V_PHY_ASYNC_POLL_US));
+        }
+
+        if (completed != NULL) {
+            engine->Current = NULL;
+            I219vPhyEngineStartNext(DeviceContext);
+        }
+    }
+
+    WdfSpinLockRelease(engine->Lock);
+
+    if (stuck) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE,
+                  "MDIC not ready %u us after abandoned operation", I219V_PHY_DRAIN_TIMEOUT_US);
+    }
+
+    if (completed != NULL) {
+        if (completed->Status == STATUS_IO_TIMEOUT) {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE,
+                      "Async PHY request for register 0x%04x timed out", completed->PhyRegister);
+        }
+        if (completed->Completion != NULL) {
+            completed->Completion(DeviceContext, completed);
+        }
+    }
+}
+
+// Создание блокировки и таймера механизма асинхронного доступа
+// Вызывается из I219vEvtDeviceAdd после инициализации устройства: до этого
+// PHY доступен только синхронно.
 NTSTATUS
-I219vResetPhy(
+I219vInitializePhyEngine(
     _In_ PI219V_DEVICE_CONTEXT DeviceContext
     )
 {
-    USHORT phyCtrl;
-    UINT32 i;
+    NTSTATUS status;
+    PI219V_PHY_ENGINE engine = &DeviceContext->PhyEngine;
+    WDF_TIMER_CONFIG timerConfig;
+    WDF_OBJECT_ATTRIBUTES attributes;
+    WDFSPINLOCK lock;
 
-    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Resetting PHY");
+    RtlZeroMemory(engine, sizeof(I219V_PHY_ENGINE));
+    InitializeListHead(&engine->Pending);
 
-    // Чтение регистра управления PHY
-    phyCtrl = I219vReadPhy(DeviceContext, I219V_PHY_CONTROL);
+    WDF_TIMER_CONFIG_INIT(&timerConfig, I219vEvtPhyPollTimer);
+    timerConfig.UseHighResolutionTimer = WdfTrue;
 
-    // Установка бита сброса
-    phyCtrl |= I219V_PHY_CTRL_RESET;
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = DeviceContext->Device;
 
-    // Запись регистра управления PHY
-    I219vWritePhy(DeviceContext, I219V_PHY_CONTROL, phyCtrl);
+    status = WdfTimerCreate(&timerConfig, &attributes, &engine->PollTimer);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "WdfTimerCreate failed: %!STATUS!", status);
+        return status;
+    }
 
-    // Ожидание завершения сброса
-    for (i = 0; i < I219V_PHY_RESET_TIMEOUT; i++) {
-        // Задержка 1 мс
-        NdisMSleep(1000);
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = DeviceContext->Device;
 
-        // Чтение регистра управления PHY
-        phyCtrl = I219vReadPhy(DeviceContext, I219V_PHY_CONTROL);
+    status = WdfSpinLockCreate(&attributes, &lock);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "WdfSpinLockCreate failed for PHY engine: %!STATUS!", status);
+        return status;
+    }
 
-        // Проверка бита сброса
-        if (!(phyCtrl & I219V_PHY_CTRL_RESET)) {
-            // Сброс завершен
-            TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "PHY reset completed");
-            return STATUS_SUCCESS;
+    // Блокировка публикуется последней: с ней синхронный доступ начинает захват MDIC
+    engine->Lock = lock;
+
+    return STATUS_SUCCESS;
+}
+
+// Запуск механизма (адаптер запущен, прерывание подключено)
+VOID
+I219vStartPhyEngine(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_PHY_ENGINE engine = &DeviceContext->PhyEngine;
+
+    WdfSpinLockAcquire(engine->Lock);
+    engine->Running = TRUE;
+    if (engine->Draining) {
+        WdfTimerStart(engine->PollTimer, WDF_REL_TIMEOUT_IN_US(I219V_PHY_ASYNC_POLL_US));
+    }
+    WdfSpinLockRelease(engine->Lock);
+}
+
+// Остановка механизма: выполняемый и ожидающие запросы отменяются
+VOID
+I219vStopPhyEngine(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_PHY_ENGINE engine = &DeviceContext->PhyEngine;
+    PI219V_PHY_REQUEST request;
+    LIST_ENTRY cancelled;
+
+    InitializeListHead(&cancelled);
+
+    WdfSpinLockAcquire(engine->Lock);
+
+    engine->Running = FALSE;
+
+    if (engine->Current != NULL) {
+        // Операция MDIC могла не завершиться: следующий захват дождется READY
+        InsertTailList(&cancelled, &engine->Current->ListEntry);
+        engine->Current = NULL;
+        engine->Draining = TRUE;
+        engine->CurrentStart = KeQueryInterruptTime();
+        engine->Stats.Cancelled++;
+    }
+
+    while (!IsListEmpty(&engine->Pending)) {
+        InsertTailList(&cancelled, RemoveHeadList(&engine->Pending));
+    }
+    engine->Stats.Cancelled += engine->QueueDepth;
+    engine->QueueDepth = 0;
+
+    WdfSpinLockRelease(engine->Lock);
+
+    WdfTimerStop(engine->PollTimer, TRUE);
+
+    while (!IsListEmpty(&cancelled)) {
+        request = CONTAINING_RECORD(RemoveHeadList(&cancelled), I219V_PHY_REQUEST, ListEntry);
+        request->Status = STATUS_CANCELLED;
+
+        if (request->Completion != NULL) {
+            request->Completion(DeviceContext, request);
+        }
+    }
+}
+
+// Проверка операции по прерыванию MDAC (вызывается из DPC прерывания)
+VOID
+I219vServicePhyEngine(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    if (DeviceContext->PhyEngine.Lock == NULL) {
+        return;
+    }
+
+    I219vPhyEngineCheck(DeviceContext, FALSE);
+}
+
+// Таймер опроса MDIC
+VOID
+I219vEvtPhyPollTimer(
+    _In_ WDFTIMER Timer
+    )
+{
+    PI219V_DEVICE_CONTEXT deviceContext = I219vGetDeviceContext(WdfTimerGetParentObject(Timer));
+
+    I219vPhyEngineCheck(deviceContext, TRUE);
+}
+
+// Заполнение запроса к PHY
+VOID
+I219vInitializePhyRequest(
+    _Out_ PI219V_PHY_REQUEST Request,
+    _In_ USHORT PhyRegister,
+    _In_ BOOLEAN Write,
+    _In_ USHORT Data,
+    _In_opt_ PI219V_PHY_COMPLETION Completion,
+    _In_opt_ PVOID Context
+    )
+{
+    RtlZeroMemory(Request, sizeof(I219V_PHY_REQUEST));
+    Request->PhyRegister = PhyRegister;
+    Request->Write = Write;
+    Request->Data = Data;
+    Request->Status = STATUS_PENDING;
+    Request->Completion = Completion;
+    Request->Context = Context;
+}
+
+// Постановка запроса в очередь
+// Возвращает STATUS_PENDING; результат передается обратному вызову завершения.
+NTSTATUS
+I219vSubmitPhyRequest(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Inout_ PI219V_PHY_REQUEST Request
+    )
+{
+    return I219vSubmitPhyRequests(DeviceContext, Request, 1);
+}
+
+// Постановка нескольких запросов
+// Запросы встают в очередь подряд под одной блокировкой и выполняются по
+// порядку; при ошибке не ставится ни один.
+NTSTATUS
+I219vSubmitPhyRequests(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Inout_updates_(Count) PI219V_PHY_REQUEST Requests,
+    _In_ ULONG Count
+    )
+{
+    PI219V_PHY_ENGINE engine = &DeviceContext->PhyEngine;
+    ULONG i;
+
+    if (engine->Lock == NULL || Count == 0) {
+        return STATUS_INVALID_DEVICE_REQUEST;
+    }
+
+    for (i = 0; i < Count; i++) {
+        if (Requests[i].PhyRegister > 0x1F) {
+            return STATUS_INVALID_DEVICE_REQUEST;
+        }
+        Requests[i].Status = STATUS_PENDING;
+    }
+
+    WdfSpinLockAcquire(engine->Lock);
+
+    if (!engine->Running) {
+        WdfSpinLockRelease(engine->Lock);
+        return STATUS_DEVICE_NOT_READY;
+    }
+
+    for (i = 0; i < Count; i++) {
+        InsertTailList(&engine->Pending, &Requests[i].ListEntry);
+    }
+    engine->QueueDepth += Count;
+    if (engine->QueueDepth > engine->Stats.MaxQueueDepth) {
+        engine->Stats.MaxQueueDepth = engine->QueueDepth;
+    }
+    engine->Stats.Submitted += Count;
+
+    I219vPhyEngineStartNext(DeviceContext);
+
+    WdfSpinLockRelease(engine->Lock);
+
+    return STATUS_PENDING;
+}
+
+// Блокировка кэша регистров соединения (до создания механизма - однопоточная инициализация)
+static
+VOID
+I219vPhyLinkCacheLock(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    if (DeviceContext->PhyEngine.Lock != NULL) {
+        WdfSpinLockAcquire(DeviceContext->PhyEngine.Lock);
+    }
+}
+
+static
+VOID
+I219vPhyLinkCacheUnlock(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    if (DeviceContext->PhyEngine.Lock != NULL) {
+        WdfSpinLockRelease(DeviceContext->PhyEngine.Lock);
+    }
+}
+
+// Сброс кэша регистров соединения
+// Обновление, начатое до сброса, не сделает кэш действительным.
+VOID
+I219vInvalidatePhyLinkCache(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_PHY_LINK_CACHE cache = &DeviceContext->PhyLinkCache;
+
+    I219vPhyLinkCacheLock(DeviceContext);
+    cache->Valid = FALSE;
+    cache->Generation++;
+    cache->Stats.Invalidations++;
+    I219vPhyLinkCacheUnlock(DeviceContext);
+}
+
+// Получение регистров соединения
+// Действительный кэш читается из памяти; иначе регистры читаются
+// синхронно (PASSIVE_LEVEL), и результат сохраняется, только если оба
+// чтения MDIC успешны и кэш не был сброшен во время чтения. Ошибка MDIC
+// возвращается вызывающему, кэш остается недействительным.
+NTSTATUS
+I219vGetPhyLinkRegisters(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PUSHORT PhyStatus,
+    _Out_ PUSHORT CopperStatus
+    )
+{
+    PI219V_PHY_LINK_CACHE cache = &DeviceContext->PhyLinkCache;
+    NTSTATUS status;
+    UINT32 generation;
+    USHORT phyStatus = 0;
+    USHORT copperStatus = 0;
+
+    *PhyStatus = 0;
+    *CopperStatus = 0;
+
+    I219vPhyLinkCacheLock(DeviceContext);
+    if (cache->Valid) {
+        *PhyStatus = cache->PhyStatus;
+        *CopperStatus = cache->CopperStatus;
+        cache->Stats.Hits++;
+        I219vPhyLinkCacheUnlock(DeviceContext);
+        return STATUS_SUCCESS;
+    }
+    generation = cache->Generation;
+    cache->Stats.Misses++;
+    I219vPhyLinkCacheUnlock(DeviceContext);
+
+    status = I219vReadPhyEx(DeviceContext, I219V_PHY_STATUS, &phyStatus);
+    if (NT_SUCCESS(status)) {
+        status = I219vReadPhyEx(DeviceContext, I219V_PHY_COPPER_STAT, &copperStatus);
+    }
+
+    I219vPhyLinkCacheLock(DeviceContext);
+    if (!NT_SUCCESS(status)) {
+        cache->Stats.FillFailures++;
+    } else if (cache->Generation == generation) {
+        cache->PhyStatus = phyStatus;
+        cache->CopperStatus = copperStatus;
+        cache->Valid = TRUE;
+    } else {
+        cache->Stats.DiscardedFills++;
+    }
+    I219vPhyLinkCacheUnlock(DeviceContext);
+
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    *PhyStatus = phyStatus;
+    *CopperStatus = copperStatus;
+
+    return STATUS_SUCCESS;
+}
+
+// Набор регистров снимка диагностики
+// Элементы сгруппированы по страницам: выбор страницы записывается один раз
+// на группу. Регистры 0-15 читаются без выбора страницы.
+typedef struct _I219V_PHY_DIAG_REGISTER_ID {
+    USHORT Page;
+    USHORT Register;
+} I219V_PHY_DIAG_REGISTER_ID;
+
+static const I219V_PHY_DIAG_REGISTER_ID I219vPhyDiagRegisterSet[] = {
+    { 0, I219V_PHY_CONTROL },
+    { 0, I219V_PHY_STATUS },
+    { 0, I219V_PHY_ID1 },
+    { 0, I219V_PHY_ID2 },
+    { 0, I219V_PHY_AUTONEG_ADV },
+    { 0, I219V_PHY_1000T_CTRL },
+    { 0, I219V_PHY_1000T_STATUS },
+    { 0, I219V_PHY_COPPER_CTRL },
+    { 0, I219V_PHY_COPPER_STAT },
+};
+
+C_ASSERT(ARRAYSIZE(I219vPhyDiagRegisterSet) <= I219V_PHY_DIAG_MAX_REGISTERS);
+
+// Сброс известной страницы PHY (после сброса PHY)
+VOID
+I219vInvalidatePhyPage(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    I219vPhyLinkCacheLock(DeviceContext);
+    DeviceContext->PhyDiagnostics.PageValid = FALSE;
+    I219vPhyLinkCacheUnlock(DeviceContext);
+}
+
+// Завершение операции снимка
+// Последняя операция копирует снимок в выходной буфер и завершает IOCTL.
+static
+VOID
+I219vPhyDiagComplete(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ PI219V_PHY_REQUEST Request
+    )
+{
+    PI219V_PHY_DIAG_STATE diag = &DeviceContext->PhyDiagnostics;
+    PI219V_PHY_DIAG_REGISTER entry = (PI219V_PHY_DIAG_REGISTER)Request->Context;
+    WDFREQUEST ioctl = NULL;
+    NTSTATUS status = STATUS_SUCCESS;
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+
+    WdfSpinLockAcquire(DeviceContext->PhyEngine.Lock);
+
+    if (NT_SUCCESS(Request->Status)) {
+        if (entry != NULL) {
+            entry->Value = Request->Data;
+            entry->Valid = TRUE;
+        }
+    } else {
+        if (NT_SUCCESS(diag->Record.Status)) {
+            diag->Record.Status = Request->Status;
+        }
+        if (entry == NULL) {
+            diag->PageFailed = TRUE;
+        }
+    }
+
+    if (--diag->Remaining == 0) {
+        // Страница известна, только если все записи выбора страницы выполнены
+        diag->PageValid = diag->NextPageValid && !diag->PageFailed;
+        diag->Page = diag->NextPage;
+
+        diag->Record.Sequence = ++diag->Snapshots;
+        now = KeQueryPerformanceCounter(&frequency);
+        diag->Record.ElapsedUs = (UINT32)(((now.QuadPart - diag->Start) * 1000000) / frequency.QuadPart);
+        diag->Record.Engine = DeviceContext->PhyEngine.Stats;
+        diag->Record.LinkCache = DeviceContext->PhyLinkCache.Stats;
+        diag->Record.Reset = DeviceContext->ResetSequencer.Stats;
+
+        // Остановленный механизм отменяет операции: снимок не возвращается
+        if (diag->Record.Status == STATUS_CANCELLED) {
+            status = STATUS_CANCELLED;
+        } else {
+            RtlCopyMemory(diag->Output, &diag->Record, sizeof(I219V_PHY_DIAGNOSTICS));
+        }
+
+        ioctl = diag->Request;
+        diag->Request = NULL;
+        diag->Output = NULL;
+    }
+
+    WdfSpinLockRelease(DeviceContext->PhyEngine.Lock);
+
+    if (ioctl != NULL) {
+        WdfRequestCompleteWithInformation(ioctl, status, NT_SUCCESS(status) ? sizeof(I219V_PHY_DIAGNOSTICS) : 0);
+    }
+}
+
+// Запуск снимка диагностики PHY
+// Возвращает STATUS_PENDING: запрос завершается из I219vPhyDiagComplete.
+// Одновременно выполняется один снимок. Механизм асинхронного доступа должен
+// быть запущен (адаптер запущен).
+NTSTATUS
+I219vStartPhyDiagnostics(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ WDFREQUEST Request,
+    _Out_ PI219V_PHY_DIAGNOSTICS Output
+    )
+{
+    PI219V_PHY_DIAG_STATE diag = &DeviceContext->PhyDiagnostics;
+    PI219V_PHY_DIAG_REGISTER entry;
+    NTSTATUS status;
+    ULONG count = 0;
+    ULONG i;
+    BOOLEAN pageValid;
+    USHORT page;
+
+    if (DeviceContext->PhyEngine.Lock == NULL) {
+        return STATUS_DEVICE_NOT_READY;
+    }
+
+    WdfSpinLockAcquire(DeviceContext->PhyEngine.Lock);
+    if (diag->Request != NULL) {
+        WdfSpinLockRelease(DeviceContext->PhyEngine.Lock);
+        return STATUS_DEVICE_BUSY;
+    }
+    diag->Request = Request;
+    pageValid = diag->PageValid;
+    page = diag->Page;
+    WdfSpinLockRelease(DeviceContext->PhyEngine.Lock);
+
+    RtlZeroMemory(&diag->Record, sizeof(I219V_PHY_DIAGNOSTICS));
+    diag->Record.RegisterCount = ARRAYSIZE(I219vPhyDiagRegisterSet);
+
+    for (i = 0; i < ARRAYSIZE(I219vPhyDiagRegisterSet); i++) {
+        entry = &diag->Record.Registers[i];
+        entry->Page = I219vPhyDiagRegisterSet[i].Page;
+        entry->Register = I219vPhyDiagRegisterSet[i].Register;
+
+        if (entry->Register >= I219V_PHY_PAGED_REGISTER_MIN && (!pageValid || page != entry->Page)) {
+            I219vInitializePhyRequest(&diag->Operations[count++], I219V_PHY_PAGE_SELECT, TRUE,
+                                      (USHORT)(entry->Page << I219V_PHY_PAGE_SHIFT), I219vPhyDiagComplete, NULL);
+            diag->Record.PageSelects++;
+            pageValid = TRUE;
+            page = entry->Page;
         }
+
+        I219vInitializePhyRequest(&diag->Operations[count++], entry->Register, FALSE, 0, I219vPhyDiagComplete, entry);
+    }
+
+    // Возврат на страницу 0 для остальных источников запросов
+    if (pageValid && page != 0) {
+        I219vInitializePhyRequest(&diag->Operations[count++], I219V_PHY_PAGE_SELECT, TRUE, 0, I219vPhyDiagComplete, NULL);
+        diag->Record.PageSelects++;
+        page = 0;
+    }
+
+    diag->Record.Operations = count;
+    diag->Output = Output;
+    diag->Remaining = count;
+    diag->PageFailed = FALSE;
+    diag->NextPageValid = pageValid;
+    diag->NextPage = page;
+    diag->Start = KeQueryPerformanceCounter(NULL).QuadPart;
+
+    status = I219vSubmitPhyRequests(DeviceContext, diag->Operations, count);
+    if (status != STATUS_PENDING) {
+        WdfSpinLockAcquire(DeviceContext->PhyEngine.Lock);
+        diag->Request = NULL;
+        diag->Output = NULL;
+        WdfSpinLockRelease(DeviceContext->PhyEngine.Lock);
+        return status;
+    }
+
+    return STATUS_PENDING;
+}
+
+// Сброс PHY (PASSIVE_LEVEL)
+// Снятие BMCR.RESET проверяет таймер последовательности сброса.
+NTSTATUS
+I219vResetPhy(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    NTSTATUS status;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Resetting PHY");
+
+    status = I219vStartReset(DeviceContext, I219V_RESET_FLAG_PHY);
+    if (NT_SUCCESS(status)) {
+        status = I219vWaitReset(DeviceContext, FALSE);
     }
 
-    // Таймаут сброса
-    TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "PHY reset timeout");
-    return STATUS_DEVICE_NOT_READY;
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "PHY reset failed %!STATUS!", status);
+        return STATUS_DEVICE_NOT_READY;
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "PHY reset completed in %u us",
+              DeviceContext->ResetSequencer.Current.PhyUs);
+    return STATUS_SUCCESS;
 }
 
 // Инициализация PHY
@@ -306,30 +1093,32 @@ I219vConfigureEee(
               "EEE Register: 0x%08x", eeer);
 }
 
-// Получение состояния соединения
-VOID
+// Получение состояния соединения по регистрам PHY
+// Подробный путь: быстрый путь (I219vIndicateLinkState) декодирует STATUS.
+// При ошибке MDIC возвращается ошибка и состояние "нет соединения".
+NTSTATUS
 I219vGetLinkState(
     _In_ PI219V_DEVICE_CONTEXT DeviceContext,
     _Out_ PNET_ADAPTER_LINK_STATE LinkState
     )
 {
+    NTSTATUS ntStatus;
     USHORT phyStatus, copperStat;
     UINT32 status;
     NDIS_LINK_SPEED linkSpeed = 0;
     MEDIA_DUPLEX_STATE duplexState = MediaDuplexStateUnknown;
 
-    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Getting link state");
-
-    // Чтение статуса PHY
-    phyStatus = I219vReadPhy(DeviceContext, I219V_PHY_STATUS);
-    
-    // Чтение статуса меди
-    copperStat = I219vReadPhy(DeviceContext, I219V_PHY_COPPER_STAT);
+    // Статус PHY и статус меди из кэша (MDIC - только после изменения соединения)
+    ntStatus = I219vGetPhyLinkRegisters(DeviceContext, &phyStatus, &copperStat);
+    if (!NT_SUCCESS(ntStatus)) {
+        NET_ADAPTER_LINK_STATE_INIT_DISCONNECTED(LinkState);
+        return ntStatus;
+    }
     
     // Чтение статуса устройства
     status = I219vReadRegister(DeviceContext, I219V_REG_STATUS);
 
-    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, 
+    TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_HARDWARE, 
               "PHY Status: 0x%04x, Copper Status: 0x%04x, Device Status: 0x%08x", 
               phyStatus, copperStat, status);
 
@@ -341,29 +1130,29 @@ I219vGetLinkState(
         switch (copperStat & I219V_PHY_COPPER_STAT_SPEED_MASK) {
         case I219V_PHY_COPPER_STAT_SPEED_1000:
             linkSpeed = NDIS_LINK_SPEED_1000MBPS;
-            TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Link speed: 1000 Mbps");
+            TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_HARDWARE, "Link speed: 1000 Mbps");
             break;
         case I219V_PHY_COPPER_STAT_SPEED_100:
             linkSpeed = NDIS_LINK_SPEED_100MBPS;
-            TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Link speed: 100 Mbps");
+            TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_HARDWARE, "Link speed: 100 Mbps");
             break;
         case I219V_PHY_COPPER_STAT_SPEED_10:
             linkSpeed = NDIS_LINK_SPEED_10MBPS;
-            TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Link speed: 10 Mbps");
+            TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_HARDWARE, "Link speed: 10 Mbps");
             break;
         default:
             linkSpeed = NDIS_LINK_SPEED_UNKNOWN;
-            TraceEvents(TRACE_LEVEL_WARNING, TRACE_HARDWARE, "Unknown link speed");
+            TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_HARDWARE, "Unknown link speed");
             break;
         }
         
         // Определение режима дуплекса
         if (copperStat & I219V_PHY_COPPER_STAT_DUPLEX) {
             duplexState = MediaDuplexStateFull;
-            TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Duplex: Full");
+            TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_HARDWARE, "Duplex: Full");
         } else {
             duplexState = MediaDuplexStateHalf;
-            TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Duplex: Half");
+            TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_HARDWARE, "Duplex: Half");
         }
         
         // Инициализация состояния соединения
@@ -379,9 +1168,11 @@ I219vGetLinkState(
         );
     } else {
         // Соединение отсутствует
-        TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Link down");
+        TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_HARDWARE, "Link down");
         NET_ADAPTER_LINK_STATE_INIT_DISCONNECTED(LinkState);
     }
+
+    return STATUS_SUCCESS;
 }
 
 // Настройка управления питанием PHY
@@ -22,11 +22,23 @@ Environment:
 #include <ntddk.h>
 #include <wdf.h>
 #include <netadaptercx.h>
+#include "i219v_reset.h"
 
 // Константы для PHY
 #define I219V_PHY_TIMEOUT        100     // Таймаут операций PHY (в 10 мкс)
 #define I219V_PHY_RESET_TIMEOUT  100     // Таймаут сброса PHY (в мс)
 
+// Регистр MDIC (доступ к PHY через интерфейс MDI)
+#define I219V_REG_PHYREG         0x0020  // MDI Control Register
+#define I219V_REG_PHYADDR        2       // Адрес PHY на шине MDIO
+#define I219V_MDIC_DATA_MASK     0x0000FFFF  // Данные регистра PHY
+#define I219V_MDIC_REG_SHIFT     16          // Сдвиг номера регистра PHY
+#define I219V_MDIC_PHY_SHIFT     21          // Сдвиг адреса PHY
+#define I219V_MDIC_OP_WRITE      0x04000000  // Операция записи
+#define I219V_MDIC_OP_READ       0x08000000  // Операция чтения
+#define I219V_MDIC_READY         0x10000000  // Операция завершена
+#define I219V_MDIC_ERROR         0x40000000  // Ошибка доступа к PHY
+
 // Ожидаемые идентификаторы PHY для Intel i219-v
 #define I219V_PHY_ID1_EXPECTED   0x0000  // Идентификатор 1
 #define I219V_PHY_ID2_EXPECTED   0x0000  // Идентификатор 2
@@ -34,11 +46,205 @@ Environment:
 
 // Объявление функций для работы с PHY
 USHORT I219vReadPhy(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ USHORT PhyRegister);
+NTSTATUS I219vReadPhyEx(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ USHORT PhyRegister, _Out_ PUSHORT PhyData);
 VOID I219vWritePhy(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ USHORT PhyRegister, _In_ USHORT PhyData);
 NTSTATUS I219vResetPhy(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 NTSTATUS I219vInitializePhy(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 VOID I219vConfigureEee(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
-VOID I219vGetLinkState(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PNET_ADAPTER_LINK_STATE LinkState);
+NTSTATUS I219vGetLinkState(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PNET_ADAPTER_LINK_STATE LinkState);
 VOID I219vConfigurePowerManagement(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ BOOLEAN EnableWakeOnLan);
 VOID I219vConfigureLeds(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 NTSTATUS I219vDiagnosticPhy(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+
+// Асинхронный доступ к PHY
+// Запросы ставятся в очередь и выполняются по одному; завершение операции
+// MDIC определяется прерыванием MDAC или коротким таймером опроса, поток
+// вызывающего не ждет. Синхронные I219vReadPhy/I219vWritePhy остаются для
+// инициализации и захватывают MDIC у механизма на время операции.
+#define I219V_PHY_ASYNC_POLL_US     50      // Интервал опроса MDIC таймером (мкс)
+#define I219V_PHY_ASYNC_TIMEOUT_US  2000    // Таймаут одной операции (мкс)
+
+// Операция, брошенная по таймауту, может еще выполняться: новая команда
+// MDIC выдается только после READY (не дольше этого времени, мкс)
+#define I219V_PHY_DRAIN_TIMEOUT_US  1000
+
+struct _I219V_PHY_REQUEST;
+
+// Завершение запроса (DISPATCH_LEVEL или ниже, вне блокировки механизма)
+typedef
+VOID
+(*PI219V_PHY_COMPLETION)(
+    _In_ struct _I219V_DEVICE_CONTEXT* DeviceContext,
+    _In_ struct _I219V_PHY_REQUEST* Request
+    );
+
+// Запрос к PHY (память принадлежит вызывающему до завершения)
+typedef struct _I219V_PHY_REQUEST {
+    LIST_ENTRY ListEntry;                           // Очередь механизма
+    USHORT PhyRegister;                             // Регистр PHY
+    USHORT Data;                                    // Данные записи или результат чтения
+    BOOLEAN Write;                                  // Операция записи
+    NTSTATUS Status;                                // STATUS_PENDING до завершения
+    PI219V_PHY_COMPLETION Completion;               // Обратный вызов завершения (может отсутствовать)
+    PVOID Context;                                  // Контекст вызывающего
+} I219V_PHY_REQUEST, *PI219V_PHY_REQUEST;
+
+// Статистика механизма асинхронного доступа
+typedef struct _I219V_PHY_ENGINE_STATS {
+    UINT64 Submitted;                               // Поставленные запросы
+    UINT64 Completed;                               // Завершенные операции MDIC
+    UINT64 Errors;                                  // Операции с ошибкой MDIC
+    UINT64 Timeouts;                                // Операции, не завершившиеся за таймаут
+    UINT64 Cancelled;                               // Запросы, отмененные при остановке
+    UINT64 InterruptServices;                       // Проверки по прерыванию MDAC
+    UINT64 TimerPolls;                              // Проверки по таймеру
+    UINT64 SyncAccesses;                            // Синхронные операции (захват MDIC)
+    UINT64 StuckOperations;                         // Брошенные операции без READY за время ожидания
+    UINT32 MaxQueueDepth;                           // Наибольшая длина очереди
+} I219V_PHY_ENGINE_STATS, *PI219V_PHY_ENGINE_STATS;
+
+// Состояние механизма асинхронного доступа
+typedef struct _I219V_PHY_ENGINE {
+    WDFSPINLOCK Lock;                               // Защита очереди и MDIC
+    WDFTIMER PollTimer;                             // Таймер опроса MDIC
+    LIST_ENTRY Pending;                             // Ожидающие запросы
+    PI219V_PHY_REQUEST Current;                     // Выполняемый запрос
+    UINT64 CurrentStart;                            // Начало операции (KeQueryInterruptTime)
+    UINT32 QueueDepth;                              // Длина очереди
+    BOOLEAN Running;                                // Механизм принимает запросы
+    BOOLEAN SyncActive;                             // MDIC захвачен синхронной операцией
+    BOOLEAN Draining;                               // Ожидание READY брошенной операции (CurrentStart - начало)
+    I219V_PHY_ENGINE_STATS Stats;                   // Статистика
+} I219V_PHY_ENGINE, *PI219V_PHY_ENGINE;
+
+// Объявление функций асинхронного доступа к PHY
+NTSTATUS I219vInitializePhyEngine(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vStartPhyEngine(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vStopPhyEngine(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vServicePhyEngine(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+
+VOID
+I219vInitializePhyRequest(
+    _Out_ PI219V_PHY_REQUEST Request,
+    _In_ USHORT PhyRegister,
+    _In_ BOOLEAN Write,
+    _In_ USHORT Data,
+    _In_opt_ PI219V_PHY_COMPLETION Completion,
+    _In_opt_ PVOID Context
+    );
+
+NTSTATUS I219vSubmitPhyRequest(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Inout_ PI219V_PHY_REQUEST Request);
+
+// Постановка нескольких запросов подряд (между ними не встанут запросы других источников)
+NTSTATUS
+I219vSubmitPhyRequests(
+    _In_ struct _I219V_DEVICE_CONTEXT* DeviceContext,
+    _Inout_updates_(Count) PI219V_PHY_REQUEST Requests,
+    _In_ ULONG Count
+    );
+
+EVT_WDF_TIMER I219vEvtPhyPollTimer;
+
+// Прямой доступ к MDIC в обход очереди (последовательность сброса)
+UINT32 I219vPhyMdicCommand(_In_ USHORT PhyRegister, _In_ BOOLEAN Write, _In_ USHORT PhyData);
+BOOLEAN I219vPhyTryAcquireMdic(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vPhyReleaseMdic(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vPhyAbandonMdic(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+
+// Кэш регистров PHY, определяющих состояние соединения
+// Значения статуса PHY и статуса меди меняются только при изменении
+// соединения: кэш сбрасывается прерыванием LSC, остановкой адаптера,
+// выходом из D0 (или явно, например при сбросе PHY) и заполняется первым
+// подробным запросом состояния (I219vGetLinkState); повторные запросы
+// читают память. Быстрый путь сообщения о соединении PHY не читает, поэтому
+// кэш не обновляется заранее. Защищен блокировкой механизма асинхронного
+// доступа.
+typedef struct _I219V_PHY_LINK_CACHE_STATS {
+    UINT64 Hits;                                    // Запросы, обслуженные из кэша
+    UINT64 Misses;                                  // Запросы с синхронным чтением PHY
+    UINT64 Invalidations;                           // Сбросы кэша
+    UINT64 FillFailures;                            // Заполнения с ошибкой или таймаутом MDIC
+    UINT64 DiscardedFills;                          // Заполнения, устаревшие из-за сброса во время чтения
+} I219V_PHY_LINK_CACHE_STATS, *PI219V_PHY_LINK_CACHE_STATS;
+
+typedef struct _I219V_PHY_LINK_CACHE {
+    BOOLEAN Valid;                                  // Значения действительны
+    USHORT PhyStatus;                               // I219V_PHY_STATUS
+    USHORT CopperStatus;                            // I219V_PHY_COPPER_STAT
+    UINT32 Generation;                              // Номер сброса кэша
+    I219V_PHY_LINK_CACHE_STATS Stats;               // Статистика
+} I219V_PHY_LINK_CACHE, *PI219V_PHY_LINK_CACHE;
+
+// Объявление функций кэша регистров соединения
+VOID I219vInvalidatePhyLinkCache(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+
+NTSTATUS
+I219vGetPhyLinkRegisters(
+    _In_ struct _I219V_DEVICE_CONTEXT* DeviceContext,
+    _Out_ PUSHORT PhyStatus,
+    _Out_ PUSHORT CopperStatus
+    );
+
+// Снимок диагностики PHY
+// Объявленный набор регистров читается одним проходом механизма
+// асинхронного доступа: операции ставятся в очередь подряд, регистр выбора
+// страницы записывается только при смене страницы, а текущая страница
+// запоминается между снимками. IOCTL завершается из обратного вызова
+// последней операции, поток и процессор не ждут MDIC.
+#define I219V_PHY_PAGE_SELECT           0x1F    // Регистр выбора страницы
+#define I219V_PHY_PAGE_SHIFT            5       // Сдвиг номера страницы в регистре выбора
+#define I219V_PHY_PAGED_REGISTER_MIN    0x10    // Регистры 0-15 (IEEE) не зависят от страницы
+#define I219V_PHY_DIAG_MAX_REGISTERS    16
+
+// Операции снимка: чтение и не больше одной записи выбора страницы на
+// регистр, плюс возврат на страницу 0 (ее регистры читают другие источники)
+#define I219V_PHY_DIAG_MAX_OPERATIONS   (I219V_PHY_DIAG_MAX_REGISTERS * 2 + 1)
+
+// Регистр снимка
+typedef struct _I219V_PHY_DIAG_REGISTER {
+    USHORT Page;                                    // Страница
+    USHORT Register;                                // Номер регистра на странице
+    USHORT Value;                                   // Значение
+    USHORT Valid;                                   // Чтение выполнено без ошибки
+} I219V_PHY_DIAG_REGISTER, *PI219V_PHY_DIAG_REGISTER;
+
+// Снимок диагностики PHY (возвращается через IOCTL)
+typedef struct _I219V_PHY_DIAGNOSTICS {
+    UINT64 Sequence;                                // Номер снимка
+    NTSTATUS Status;                                // Первая ошибка операций снимка
+    UINT32 RegisterCount;                           // Заполненные элементы Registers
+    UINT32 Operations;                              // Операции MDIC снимка
+    UINT32 PageSelects;                             // Из них записи выбора страницы
+    UINT32 ElapsedUs;                               // Постановка в очередь - завершение последней операции
+    UINT32 Reserved;
+    I219V_PHY_DIAG_REGISTER Registers[I219V_PHY_DIAG_MAX_REGISTERS];
+    I219V_PHY_ENGINE_STATS Engine;                  // Статистика механизма асинхронного доступа
+    I219V_PHY_LINK_CACHE_STATS LinkCache;           // Статистика кэша регистров соединения
+    I219V_RESET_STATS Reset;                        // Длительности фаз последнего сброса
+} I219V_PHY_DIAGNOSTICS, *PI219V_PHY_DIAGNOSTICS;
+
+// Состояние снимка (защищено блокировкой механизма асинхронного доступа)
+typedef struct _I219V_PHY_DIAG_STATE {
+    WDFREQUEST Request;                             // Ожидающий IOCTL (NULL - снимок не выполняется)
+    PI219V_PHY_DIAGNOSTICS Output;                  // Выходной буфер IOCTL
+    UINT32 Remaining;                               // Незавершенные операции
+    BOOLEAN PageValid;                              // Текущая страница PHY известна
+    BOOLEAN PageFailed;                             // Запись выбора страницы в снимке не выполнена
+    BOOLEAN NextPageValid;                          // Страница после завершения снимка известна
+    USHORT Page;                                    // Текущая страница PHY
+    USHORT NextPage;                                // Страница после завершения снимка
+    LONGLONG Start;                                 // Постановка операций (KeQueryPerformanceCounter)
+    UINT64 Snapshots;                               // Выполненные снимки
+    I219V_PHY_REQUEST Operations[I219V_PHY_DIAG_MAX_OPERATIONS];
+    I219V_PHY_DIAGNOSTICS Record;                   // Собираемый снимок
+} I219V_PHY_DIAG_STATE, *PI219V_PHY_DIAG_STATE;
+
+// Объявление функций снимка диагностики
+NTSTATUS
+I219vStartPhyDiagnostics(
+    _In_ struct _I219V_DEVICE_CONTEXT* DeviceContext,
+    _In_ WDFREQUEST Request,
+    _Out_ PI219V_PHY_DIAGNOSTICS Output
+    );
+
+VOID I219vInvalidatePhyPage(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
@@ -0,0 +1,284 @@
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_qos.c
+
+Abstract:
+
+    Реализация маркировки QoS для драйвера Intel i219-v.
+    Записывает выбранный драйвером приоритет пакета в поле DSCP заголовка
+    IPv4/IPv6 и/или в биты PCP тега 802.1Q, чтобы коммутаторы и маршрутизаторы
+    локальной сети могли продолжить приоритизацию.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+#include "Driver.h"
+#include "Device.h"
+#include "Adapter.h"
+#include "i219v_hw.h"
+#include "i219v_gaming.h"
+#include "i219v_offload.h"
+#include "i219v_qos.h"
+#include "DeviceContext.h"
+#include "Trace.h"
+
+// Ключевые слова INF для маркировки
+#define I219V_QOS_KEYWORD_DSCP_MARKING      L"DscpMarking"
+#define I219V_QOS_KEYWORD_PRIORITY_VLAN     L"*PriorityVLANTag"
+#define I219V_QOS_KEYWORD_VLAN_ID           L"VlanID"
+
+// Значения *PriorityVLANTag, включающие приоритет 802.1p (см. I219v.inf)
+#define I219V_PRIORITY_VLAN_TAG_PRIORITY            2
+#define I219V_PRIORITY_VLAN_TAG_PRIORITY_AND_VLAN   3
+
+// Смещение поля TCI в кадре с тегом 802.1Q
+#define I219V_VLAN_TCI_OFFSET       14
+
+// Перезапись поля DSCP заголовка IP с сохранением битов ECN
+static
+VOID
+I219vQosRewriteDscp(
+    _Inout_ PUCHAR IpHeader,
+    _In_ UCHAR IpVersion,
+    _In_ UCHAR Dscp
+    )
+{
+    if (IpVersion == 4) {
+        UCHAR oldTos = IpHeader[1];
+        UCHAR newTos = (UCHAR)((Dscp << 2) | (oldTos & 0x03));
+        UINT16 oldWord, newWord, checksum;
+        UINT32 sum;
+
+        if (newTos == oldTos) {
+            return;
+        }
+
+        // Инкрементальное обновление контрольной суммы заголовка (RFC 1624):
+        // HC' = ~(~HC + ~m + m'), где m - 16-битное слово, содержащее TOS
+        oldWord = (UINT16)((IpHeader[0] << 8) | oldTos);
+        newWord = (UINT16)((IpHeader[0] << 8) | newTos);
+
+        sum = (UINT16)~((IpHeader[10] << 8) | IpHeader[11]);
+        sum += (UINT16)~oldWord;
+        sum += newWord;
+        sum = (sum & 0xFFFF) + (sum >> 16);
+        sum = (sum & 0xFFFF) + (sum >> 16);
+        checksum = (UINT16)~sum;
+
+        IpHeader[1] = newTos;
+        IpHeader[10] = (UCHAR)(checksum >> 8);
+        IpHeader[11] = (UCHAR)(checksum & 0xFF);
+    } else if (IpVersion == 6) {
+        // Traffic Class занимает младшие 4 бита первого байта и старшие 4 бита второго.
+        // Контрольной суммы заголовка в IPv6 нет, а псевдозаголовок TCP/UDP
+        // Traffic Class не включает.
+        UCHAR oldTc = (UCHAR)(((IpHeader[0] & 0x0F) << 4) | (IpHeader[1] >> 4));
+        UCHAR newTc = (UCHAR)((Dscp << 2) | (oldTc & 0x03));
+
+        IpHeader[0] = (UCHAR)((IpHeader[0] & 0xF0) | (newTc >> 4));
+        IpHeader[1] = (UCHAR)((IpHeader[1] & 0x0F) | ((newTc & 0x0F) << 4));
+    }
+}
+
+// Получение таблицы маркировки по умолчанию
+VOID
+I219vGetDefaultQosMarkingMap(
+    _Out_ PI219V_QOS_MARKING_MAP MarkingMap
+    )
+{
+    // Игровой трафик
+    MarkingMap->Dscp[I219V_TRAFFIC_PRIORITY_HIGHEST] = I219V_DSCP_EF;
+    MarkingMap->Pcp[I219V_TRAFFIC_PRIORITY_HIGHEST] = 6;
+
+    // Голосовой чат
+    MarkingMap->Dscp[I219V_TRAFFIC_PRIORITY_HIGH] = I219V_DSCP_AF41;
+    MarkingMap->Pcp[I219V_TRAFFIC_PRIORITY_HIGH] = 5;
+
+    // Стриминг
+    MarkingMap->Dscp[I219V_TRAFFIC_PRIORITY_MEDIUM] = I219V_DSCP_AF21;
+    MarkingMap->Pcp[I219V_TRAFFIC_PRIORITY_MEDIUM] = 4;
+
+    // Загрузки
+    MarkingMap->Dscp[I219V_TRAFFIC_PRIORITY_LOW] = I219V_DSCP_BE;
+    MarkingMap->Pcp[I219V_TRAFFIC_PRIORITY_LOW] = 0;
+
+    // Фоновые задачи
+    MarkingMap->Dscp[I219V_TRAFFIC_PRIORITY_LOWEST] = I219V_DSCP_CS1;
+    MarkingMap->Pcp[I219V_TRAFFIC_PRIORITY_LOWEST] = 1;
+}
+
+// Инициализация маркировки QoS (по умолчанию маркировка отключена)
+VOID
+I219vInitializeQosMarking(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    I219V_QOS_MARKING_CONFIG defaultConfig;
+
+    RtlZeroMemory(&defaultConfig, sizeof(I219V_QOS_MARKING_CONFIG));
+    I219vGetDefaultQosMarkingMap(&defaultConfig.Map);
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    RtlCopyMemory(&DeviceContext->QosMarkingConfig, &defaultConfig, sizeof(I219V_QOS_MARKING_CONFIG));
+    RtlZeroMemory(&DeviceContext->QosMarkingStats, sizeof(I219V_QOS_MARKING_STATS));
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Чтение настроек маркировки из ключевых слов INF
+NTSTATUS
+I219vLoadQosMarkingConfiguration(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    NTSTATUS status;
+    NETCONFIGURATION configuration;
+    I219V_QOS_MARKING_CONFIG markingConfig;
+    ULONG value;
+    DECLARE_CONST_UNICODE_STRING(dscpKeyword, I219V_QOS_KEYWORD_DSCP_MARKING);
+    DECLARE_CONST_UNICODE_STRING(priorityVlanKeyword, I219V_QOS_KEYWORD_PRIORITY_VLAN);
+    DECLARE_CONST_UNICODE_STRING(vlanIdKeyword, I219V_QOS_KEYWORD_VLAN_ID);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "Loading QoS marking configuration");
+
+    I219vGetQosMarkingConfig(DeviceContext, &markingConfig);
+
+    status = NetAdapterOpenConfiguration(DeviceContext->NetAdapter, WDF_NO_OBJECT_ATTRIBUTES, &configuration);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "NetAdapterOpenConfiguration failed: %!STATUS!", status);
+        return status;
+    }
+
+    // Отсутствующие ключевые слова оставляют значения по умолчанию
+    if (NT_SUCCESS(NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS,
+                                              &dscpKeyword, &value))) {
+        markingConfig.EnableDscpMarking = (value != 0);
+    }
+
+    if (NT_SUCCESS(NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS,
+                                              &priorityVlanKeyword, &value))) {
+        markingConfig.EnablePriorityTagging = (value == I219V_PRIORITY_VLAN_TAG_PRIORITY ||
+                                               value == I219V_PRIORITY_VLAN_TAG_PRIORITY_AND_VLAN);
+    }
+
+    if (NT_SUCCESS(NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS,
+                                              &vlanIdKeyword, &value)) &&
+        value <= I219V_QOS_MAX_VLAN_ID) {
+        markingConfig.VlanId = (UINT16)value;
+    }
+
+    NetConfigurationClose(configuration);
+
+    return I219vSetQosMarkingConfig(DeviceContext, &markingConfig);
+}
+
+// Установка настроек маркировки
+NTSTATUS
+I219vSetQosMarkingConfig(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ PI219V_QOS_MARKING_CONFIG MarkingConfig
+    )
+{
+    UINT32 i;
+
+    // Проверка таблицы соответствия
+    for (i = 0; i < I219V_QOS_PRIORITY_LEVELS; i++) {
+        if (MarkingConfig->Map.Dscp[i] > I219V_QOS_MAX_DSCP ||
+            MarkingConfig->Map.Pcp[i] > I219V_QOS_MAX_PCP) {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER,
+                      "Invalid QoS marking for priority %u: DSCP=%u, PCP=%u",
+                      i, MarkingConfig->Map.Dscp[i], MarkingConfig->Map.Pcp[i]);
+            return STATUS_INVALID_PARAMETER;
+        }
+    }
+
+    if (MarkingConfig->VlanId > I219V_QOS_MAX_VLAN_ID) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Invalid QoS VLAN ID: %u", MarkingConfig->VlanId);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    RtlCopyMemory(&DeviceContext->QosMarkingConfig, MarkingConfig, sizeof(I219V_QOS_MARKING_CONFIG));
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    // Вставка тега из поля Special дескриптора требует CTRL.VME.
+    // До инициализации оборудования бит выставит I219vInitializeHardware
+    // по сохраненной конфигурации; после сброса MAC он применяется заново.
+    if (DeviceContext->DeviceInitialized) {
+        I219vApplyVlanMode(DeviceContext);
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
+              "QoS marking configured: DSCP=%d, 802.1p=%d, VLAN ID=%u",
+              MarkingConfig->EnableDscpMarking,
+              MarkingConfig->EnablePriorityTagging,
+              MarkingConfig->VlanId);
+
+    return STATUS_SUCCESS;
+}
+
+// Получение текущих настроек маркировки
+VOID
+I219vGetQosMarkingConfig(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PI219V_QOS_MARKING_CONFIG MarkingConfig
+    )
+{
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    RtlCopyMemory(MarkingConfig, &DeviceContext->QosMarkingConfig, sizeof(I219V_QOS_MARKING_CONFIG));
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Маркировка передаваемого пакета
+// Вызывается из пути передачи под GamingSettingsLock для классифицированных
+// пакетов с разобранными заголовками. Приоритет берется из метаданных; если
+// тег 802.1Q должен быть вставлен аппаратно, в метаданных выставляются
+// InsertVlanTag и VlanTag (поле Special дескриптора вместе с CMD.VLE).
+VOID
+I219vQosMarkPacket(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Inout_ PI219V_PACKET_METADATA Metadata
+    )
+{
+    PI219V_QOS_MARKING_CONFIG markingConfig = &DeviceContext->QosMarkingConfig;
+    PUCHAR frame = Metadata->HeaderBuffer;
+    I219V_TRAFFIC_PRIORITY_LEVEL priority = Metadata->Priority;
+    UCHAR pcp;
+
+    Metadata->InsertVlanTag = FALSE;
+    Metadata->VlanTag = 0;
+
+    if ((UINT32)priority >= I219V_QOS_PRIORITY_LEVELS) {
+        return;
+    }
+
+    // Перезапись DSCP
+    if (markingConfig->EnableDscpMarking && Metadata->Headers.IpVersion != 0) {
+        I219vQosRewriteDscp(frame + Metadata->Headers.L3Offset, Metadata->Headers.IpVersion, markingConfig->Map.Dscp[priority]);
+        DeviceContext->QosMarkingStats.DscpMarkedPackets++;
+    }
+
+    // Установка приоритета 802.1p
+    if (markingConfig->EnablePriorityTagging) {
+        pcp = markingConfig->Map.Pcp[priority];
+
+        if (Metadata->Headers.VlanTagged) {
+            // Кадр уже содержит тег - PCP (старшие 3 бита TCI) переписывается на месте
+            frame[I219V_VLAN_TCI_OFFSET] = (UCHAR)((frame[I219V_VLAN_TCI_OFFSET] & 0x1F) | (pcp << 5));
+        } else {
+            Metadata->VlanTag = (UINT16)((pcp << 13) | markingConfig->VlanId);
+            Metadata->InsertVlanTag = TRUE;
+        }
+
+        DeviceContext->QosMarkingStats.PriorityTaggedPackets++;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_qos.h
+
+Abstract:
+
+    Заголовочный файл для модуля маркировки QoS Intel i219-v.
+    Содержит объявления функций и структур для записи DSCP и 802.1p
+    приоритета в передаваемые пакеты.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+#include "i219v_gaming.h"
+
+// Количество уровней приоритета, для которых задается маркировка
+// (соответствует I219V_TRAFFIC_PRIORITY_HIGHEST..I219V_TRAFFIC_PRIORITY_LOWEST)
+#define I219V_QOS_PRIORITY_LEVELS   5
+
+// Допустимые значения полей маркировки
+#define I219V_QOS_MAX_DSCP          63      // DSCP - 6 бит
+#define I219V_QOS_MAX_PCP           7       // 802.1p PCP - 3 бита
+#define I219V_QOS_MAX_VLAN_ID       4094    // Максимальный VLAN ID
+
+// Значения DSCP по умолчанию (RFC 4594)
+#define I219V_DSCP_EF               46      // Expedited Forwarding
+#define I219V_DSCP_AF41             34      // Assured Forwarding 41
+#define I219V_DSCP_AF21             18      // Assured Forwarding 21
+#define I219V_DSCP_BE               0       // Best Effort
+#define I219V_DSCP_CS1              8       // Class Selector 1 (фоновый трафик)
+
+// Таблица соответствия уровня приоритета и кодов маркировки
+typedef struct _I219V_QOS_MARKING_MAP {
+    UCHAR Dscp[I219V_QOS_PRIORITY_LEVELS];          // Код DSCP для каждого уровня приоритета
+    UCHAR Pcp[I219V_QOS_PRIORITY_LEVELS];           // Приоритет 802.1p для каждого уровня приоритета
+} I219V_QOS_MARKING_MAP, *PI219V_QOS_MARKING_MAP;
+
+// Настройки маркировки QoS
+typedef struct _I219V_QOS_MARKING_CONFIG {
+    BOOLEAN EnableDscpMarking;                      // Перезапись поля DSCP в заголовке IPv4/IPv6
+    BOOLEAN EnablePriorityTagging;                  // Установка битов PCP тега 802.1Q
+    UINT16 VlanId;                                  // VLAN ID для вставляемого тега (0 - только приоритет)
+    I219V_QOS_MARKING_MAP Map;                      // Таблица соответствия
+} I219V_QOS_MARKING_CONFIG, *PI219V_QOS_MARKING_CONFIG;
+
+// Статистика маркировки QoS
+typedef struct _I219V_QOS_MARKING_STATS {
+    UINT64 DscpMarkedPackets;                       // Пакеты с перезаписанным DSCP
+    UINT64 PriorityTaggedPackets;                   // Пакеты с установленным PCP
+    UINT64 UnparsedPackets;                         // Пакеты, заголовки которых не удалось разобрать
+} I219V_QOS_MARKING_STATS, *PI219V_QOS_MARKING_STATS;
+
+// Объявление функций для маркировки QoS
+VOID I219vInitializeQosMarking(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+NTSTATUS I219vLoadQosMarkingConfiguration(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+NTSTATUS I219vSetQosMarkingConfig(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ PI219V_QOS_MARKING_CONFIG MarkingConfig);
+VOID I219vGetQosMarkingConfig(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_QOS_MARKING_CONFIG MarkingConfig);
+VOID I219vGetDefaultQosMarkingMap(_Out_ PI219V_QOS_MARKING_MAP MarkingMap);
+
+// Маркировка пакета в пути передачи (вызывается под GamingSettingsLock)
+VOID I219vQosMarkPacket(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Inout_ PI219V_PACKET_METADATA Metadata);
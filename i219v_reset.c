@@ -0,0 +1,351 @@
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_reset.c
+
+Abstract:
+
+    Реализация последовательности сброса MAC и PHY Intel i219-v.
+    Фазы проверяются таймером высокого разрешения (DISPATCH_LEVEL): каждое
+    срабатывание выполняет одно-два обращения к регистрам и перезапускает
+    таймер, пока фаза не завершится или не истечет ее таймаут. Шаг опроса
+    ограничен частотой системных часов, а не I219V_RESET_POLL_US; поток
+    PnP при этом не занимает процессор ожиданием. Регистр PHY
+    читается через MDIC в два срабатывания (команда, затем результат), без
+    ожидания в цикле. Пока последовательность выполняется, ее состояние меняет
+    только таймер; запускающий поток ждет события MacReady и Complete.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+#include "Driver.h"
+#include "Device.h"
+#include "i219v_hw.h"
+#include "i219v_hw_extended.h"
+#include "i219v_phy.h"
+#include "i219v_reset.h"
+#include "DeviceContext.h"
+#include "Trace.h"
+
+// Таймауты фаз по номеру фазы (мкс)
+static const UINT32 I219vResetPhaseTimeoutUs[] = {
+    0,                                      // I219V_RESET_PHASE_IDLE
+    I219V_RESET_MAC_TIMEOUT_US,             // I219V_RESET_PHASE_MAC
+    I219V_RESET_LAN_INIT_TIMEOUT_US,        // I219V_RESET_PHASE_LAN_INIT
+    I219V_RESET_PHY_TIMEOUT_US              // I219V_RESET_PHASE_PHY
+};
+
+// Интервал между отсчетами счетчика производительности (мкс)
+static
+UINT32
+I219vResetElapsedUs(
+    _In_ PI219V_RESET_SEQUENCER Sequencer,
+    _In_ LONGLONG From,
+    _In_ LONGLONG To
+    )
+{
+    return (UINT32)(((To - From) * 1000000) / Sequencer->Frequency);
+}
+
+// Переход к фазе
+static
+VOID
+I219vResetEnterPhase(
+    _In_ PI219V_RESET_SEQUENCER Sequencer,
+    _In_ I219V_RESET_PHASE Phase,
+    _In_ LONGLONG Now
+    )
+{
+    Sequencer->PhaseStart = Now;
+    Sequencer->Phase = Phase;
+}
+
+// Завершение последовательности: учет длительностей и пробуждение потока
+static
+VOID
+I219vResetFinish(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ NTSTATUS Status,
+    _In_ LONGLONG Now
+    )
+{
+    PI219V_RESET_SEQUENCER sequencer = &DeviceContext->ResetSequencer;
+
+    // Чтение BMCR, не получившее READY, может еще выполняться
+    if (sequencer->MdicOwned) {
+        I219vPhyAbandonMdic(DeviceContext);
+        sequencer->MdicOwned = FALSE;
+    }
+
+    sequencer->Current.Status = Status;
+    sequencer->Current.TotalUs = I219vResetElapsedUs(sequencer, sequencer->Start, Now);
+
+    sequencer->Stats.Resets++;
+    if (!NT_SUCCESS(Status)) {
+        sequencer->Current.FailedPhase = (UINT32)sequencer->Phase;
+        sequencer->Stats.Failures++;
+    }
+    if (sequencer->Current.TotalUs > sequencer->Stats.MaxTotalUs) {
+        sequencer->Stats.MaxTotalUs = sequencer->Current.TotalUs;
+    }
+    sequencer->Stats.Last = sequencer->Current;
+
+    sequencer->Phase = NT_SUCCESS(Status) ? I219V_RESET_PHASE_DONE : I219V_RESET_PHASE_FAILED;
+
+    if (NT_SUCCESS(Status)) {
+        TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE,
+                  "Reset complete: MAC %u us, LAN init %u us, PHY %u us, total %u us, %u polls",
+                  sequencer->Current.MacUs, sequencer->Current.LanInitUs, sequencer->Current.PhyUs,
+                  sequencer->Current.TotalUs, sequencer->Current.Polls);
+    } else {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE,
+                  "Reset failed in phase %u after %u us: %!STATUS!",
+                  sequencer->Current.FailedPhase, sequencer->Current.TotalUs, Status);
+    }
+
+    KeSetEvent(&sequencer->MacReady, IO_NO_INCREMENT, FALSE);
+    KeSetEvent(&sequencer->Complete, IO_NO_INCREMENT, FALSE);
+}
+
+// Создание таймера последовательности сброса
+// Вызывается из I219vEvtDeviceAdd: сброс выполняется при каждом входе в D0.
+NTSTATUS
+I219vInitializeResetSequencer(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    NTSTATUS status;
+    PI219V_RESET_SEQUENCER sequencer = &DeviceContext->ResetSequencer;
+    WDF_TIMER_CONFIG timerConfig;
+    WDF_OBJECT_ATTRIBUTES attributes;
+
+    RtlZeroMemory(sequencer, sizeof(I219V_RESET_SEQUENCER));
+    KeInitializeEvent(&sequencer->MacReady, NotificationEvent, FALSE);
+    KeInitializeEvent(&sequencer->Complete, NotificationEvent, FALSE);
+
+    WDF_TIMER_CONFIG_INIT(&timerConfig, I219vEvtResetPollTimer);
+    timerConfig.UseHighResolutionTimer = WdfTrue;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = DeviceContext->Device;
+
+    status = WdfTimerCreate(&timerConfig, &attributes, &sequencer->PollTimer);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "WdfTimerCreate failed for reset sequencer: %!STATUS!", status);
+        return status;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+// Запуск сброса (PASSIVE_LEVEL)
+// С I219V_RESET_FLAG_MAC сброс выполняется записью CTRL.RST; вместе с
+// I219V_RESET_FLAG_PHY в той же записи выставляется CTRL.PHY_RST, и PHY
+// сбрасывается параллельно с MAC. Один I219V_RESET_FLAG_PHY выполняет
+// программный сброс PHY битом BMCR.RESET.
+NTSTATUS
+I219vStartReset(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 Flags
+    )
+{
+    PI219V_RESET_SEQUENCER sequencer = &DeviceContext->ResetSequencer;
+    LARGE_INTEGER frequency;
+    UINT32 ctrlReg;
+    USHORT phyCtrl;
+
+    if (sequencer->PollTimer == NULL) {
+        return STATUS_INVALID_DEVICE_STATE;
+    }
+
+    if ((Flags & (I219V_RESET_FLAG_MAC | I219V_RESET_FLAG_PHY)) == 0) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (sequencer->Phase != I219V_RESET_PHASE_IDLE &&
+        sequencer->Phase != I219V_RESET_PHASE_DONE &&
+        sequencer->Phase != I219V_RESET_PHASE_FAILED) {
+        return STATUS_DEVICE_BUSY;
+    }
+
+    RtlZeroMemory(&sequencer->Current, sizeof(I219V_RESET_TIMING));
+    sequencer->Current.Flags = Flags;
+    sequencer->MdicOwned = FALSE;
+
+    KeClearEvent(&sequencer->MacReady);
+    KeClearEvent(&sequencer->Complete);
+
+    sequencer->Start = KeQueryPerformanceCounter(&frequency).QuadPart;
+    sequencer->Frequency = frequency.QuadPart;
+
+    // Сброс PHY заново запускает автосогласование и возвращает PHY на страницу 0
+    if (Flags & I219V_RESET_FLAG_PHY) {
+        I219vInvalidatePhyLinkCache(DeviceContext);
+        I219vInvalidatePhyPage(DeviceContext);
+    }
+
+    if (Flags & I219V_RESET_FLAG_MAC) {
+        ctrlReg = I219vReadRegister(DeviceContext, I219V_REG_CTRL) | I219V_CTRL_RST;
+        if (Flags & I219V_RESET_FLAG_PHY) {
+            ctrlReg |= I219V_CTRL_PHY_RST;
+        }
+
+        I219vResetEnterPhase(sequencer, I219V_RESET_PHASE_MAC, sequencer->Start);
+        I219vWriteRegister(DeviceContext, I219V_REG_CTRL, ctrlReg);
+    } else {
+        // MAC не сбрасывается: регистры MAC доступны сразу
+        KeSetEvent(&sequencer->MacReady, IO_NO_INCREMENT, FALSE);
+
+        phyCtrl = I219vReadPhy(DeviceContext, I219V_PHY_CONTROL);
+        I219vWritePhy(DeviceContext, I219V_PHY_CONTROL, phyCtrl | I219V_PHY_CTRL_RESET);
+
+        I219vResetEnterPhase(sequencer, I219V_RESET_PHASE_PHY, KeQueryPerformanceCounter(NULL).QuadPart);
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Reset started: %s%s",
+              (Flags & I219V_RESET_FLAG_MAC) ? "MAC " : "",
+              (Flags & I219V_RESET_FLAG_PHY) ? "PHY" : "");
+
+    WdfTimerStart(sequencer->PollTimer, WDF_REL_TIMEOUT_IN_US(I219V_RESET_POLL_US));
+
+    return STATUS_SUCCESS;
+}
+
+// Ожидание сброса (PASSIVE_LEVEL)
+// MacOnly - ожидание только выхода MAC из сброса: поток программирует
+// регистры MAC, пока PHY продолжает сброс.
+NTSTATUS
+I219vWaitReset(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ BOOLEAN MacOnly
+    )
+{
+    PI219V_RESET_SEQUENCER sequencer = &DeviceContext->ResetSequencer;
+    LARGE_INTEGER timeout;
+    NTSTATUS status;
+
+    if (sequencer->Phase == I219V_RESET_PHASE_IDLE) {
+        return STATUS_INVALID_DEVICE_STATE;
+    }
+
+    timeout.QuadPart = WDF_REL_TIMEOUT_IN_MS(
+        (I219V_RESET_MAC_TIMEOUT_US + I219V_RESET_LAN_INIT_TIMEOUT_US + I219V_RESET_PHY_TIMEOUT_US) / 1000 +
+        I219V_RESET_WAIT_SLACK_MS);
+
+    status = KeWaitForSingleObject(MacOnly ? &sequencer->MacReady : &sequencer->Complete,
+                                   Executive, KernelMode, FALSE, &timeout);
+    if (status == STATUS_TIMEOUT) {
+        // Таймер не довел последовательность до конца: остановка и завершение здесь
+        WdfTimerStop(sequencer->PollTimer, TRUE);
+        if (sequencer->Phase != I219V_RESET_PHASE_DONE && sequencer->Phase != I219V_RESET_PHASE_FAILED) {
+            I219vResetFinish(DeviceContext, STATUS_IO_TIMEOUT, KeQueryPerformanceCounter(NULL).QuadPart);
+        }
+    }
+
+    if (sequencer->Phase == I219V_RESET_PHASE_FAILED &&
+        (!MacOnly || sequencer->Current.FailedPhase == I219V_RESET_PHASE_MAC)) {
+        return sequencer->Current.Status;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+// Обработчик таймера опроса: проверка текущей фазы
+VOID
+I219vEvtResetPollTimer(
+    _In_ WDFTIMER Timer
+    )
+{
+    PI219V_DEVICE_CONTEXT deviceContext = I219vGetDeviceContext(WdfTimerGetParentObject(Timer));
+    PI219V_RESET_SEQUENCER sequencer = &deviceContext->ResetSequencer;
+    LONGLONG now;
+    UINT32 value;
+
+    if (sequencer->Phase == I219V_RESET_PHASE_IDLE ||
+        sequencer->Phase == I219V_RESET_PHASE_DONE ||
+        sequencer->Phase == I219V_RESET_PHASE_FAILED) {
+        return;
+    }
+
+    sequencer->Current.Polls++;
+    now = KeQueryPerformanceCounter(NULL).QuadPart;
+
+    switch (sequencer->Phase) {
+    case I219V_RESET_PHASE_MAC:
+        value = I219vReadRegister(deviceContext, I219V_REG_CTRL);
+        if ((value & I219V_CTRL_RST) == 0) {
+            sequencer->Current.MacUs = I219vResetElapsedUs(sequencer, sequencer->PhaseStart, now);
+
+            // Регистры MAC вернулись к значениям по умолчанию
+            I219vInvalidateRegisterShadow(deviceContext);
+
+            I219vResetEnterPhase(sequencer,
+                                 (sequencer->Current.Flags & I219V_RESET_FLAG_PHY) ? I219V_RESET_PHASE_LAN_INIT : I219V_RESET_PHASE_DONE,
+                                 now);
+            KeSetEvent(&sequencer->MacReady, IO_NO_INCREMENT, FALSE);
+        }
+        break;
+
+    case I219V_RESET_PHASE_LAN_INIT:
+        value = I219vReadRegister(deviceContext, I219V_REG_STATUS);
+        if (value & I219V_STATUS_LAN_INIT_DONE) {
+            sequencer->Current.LanInitUs = I219vResetElapsedUs(sequencer, sequencer->PhaseStart, now);
+
+            // Бит не самоочищается: сброс после обнаружения, чтобы следующий
+            // сброс ждал новой загрузки конфигурации (как e1000e)
+            I219vWriteRegister(deviceContext, I219V_REG_STATUS, value & ~I219V_STATUS_LAN_INIT_DONE);
+
+            I219vResetEnterPhase(sequencer, I219V_RESET_PHASE_PHY, now);
+        }
+        break;
+
+    case I219V_RESET_PHASE_PHY:
+        if (!sequencer->MdicOwned) {
+            // Команда чтения BMCR; результат проверяется на следующем срабатывании
+            if (I219vPhyTryAcquireMdic(deviceContext)) {
+                sequencer->MdicOwned = TRUE;
+                I219vWriteRegisterEx(deviceContext, I219V_REG_PHYREG,
+                                   I219vPhyMdicCommand(I219V_PHY_CONTROL, FALSE, 0),
+                                   I219V_MMIO_CATEGORY_PHY);
+            }
+        } else {
+            value = I219vReadRegisterEx(deviceContext, I219V_REG_PHYREG, I219V_MMIO_CATEGORY_PHY);
+            if (value & I219V_MDIC_READY) {
+                I219vPhyReleaseMdic(deviceContext);
+                sequencer->MdicOwned = FALSE;
+
+                // PHY отвечает без ошибки и снял бит сброса
+                if ((value & I219V_MDIC_ERROR) == 0 &&
+                    ((USHORT)(value & I219V_MDIC_DATA_MASK) & I219V_PHY_CTRL_RESET) == 0) {
+                    sequencer->Current.PhyUs = I219vResetElapsedUs(sequencer, sequencer->PhaseStart, now);
+                    I219vResetEnterPhase(sequencer, I219V_RESET_PHASE_DONE, now);
+                }
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    if (sequencer->Phase == I219V_RESET_PHASE_DONE) {
+        I219vResetFinish(deviceContext, STATUS_SUCCESS, now);
+        return;
+    }
+
+    if (I219vResetElapsedUs(sequencer, sequencer->PhaseStart, now) >= I219vResetPhaseTimeoutUs[sequencer->Phase]) {
+        I219vResetFinish(deviceContext, STATUS_DEVICE_NOT_READY, now);
+        return;
+    }
+
+    WdfTimerStart(sequencer->PollTimer, WDF_REL_TIMEOUT_IN_US(I219V_RESET_POLL_US));
+}
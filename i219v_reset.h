@@ -0,0 +1,103 @@
+#pragma once
+
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_reset.h
+
+Abstract:
+
+    Заголовочный файл для последовательности сброса MAC и PHY Intel i219-v.
+    Сброс ведется конечным автоматом на таймере высокого разрешения: поток
+    PnP запускает сброс и ждет событие, а не засыпает по 1 мс на каждую
+    проверку. Сброс MAC и PHY выполняется одной записью CTRL (RST и
+    PHY_RST), поэтому PHY выходит из сброса одновременно с MAC, а поток
+    программирует регистры MAC, пока PHY загружает конфигурацию.
+    Длительность каждой фазы сохраняется. Таймер высокого разрешения не
+    срабатывает чаще системных часов (минимальный интервал часов, обычно
+    0.5-1 мс): запрошенный интервал опроса 20 мкс - нижняя граница, а не
+    фактический шаг. Длительности фаз измеряются счетчиком
+    производительности, но фиксируются в срабатывании таймера, поэтому
+    завышены не более чем на один интервал срабатывания.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+
+// Запрашиваемый интервал опроса таймером (мкс); фактический интервал
+// ограничен снизу частотой системных часов
+#define I219V_RESET_POLL_US                 20
+
+// Таймауты фаз (мкс)
+#define I219V_RESET_MAC_TIMEOUT_US          10000   // Самоочистка CTRL.RST
+#define I219V_RESET_LAN_INIT_TIMEOUT_US     10000   // STATUS.LAN_INIT_DONE
+#define I219V_RESET_PHY_TIMEOUT_US          (I219V_PHY_RESET_TIMEOUT * 1000)   // BMCR.RESET
+
+// Запас ожидания потока сверх таймаутов фаз (мс): таймер завершает
+// последовательность сам, ожидание с таймаутом - только защита
+#define I219V_RESET_WAIT_SLACK_MS           50
+
+// Состав сброса
+#define I219V_RESET_FLAG_MAC                0x00000001  // Сброс MAC (CTRL.RST)
+#define I219V_RESET_FLAG_PHY                0x00000002  // Сброс PHY (с MAC - CTRL.PHY_RST, иначе BMCR.RESET)
+
+// Фазы последовательности
+typedef enum _I219V_RESET_PHASE {
+    I219V_RESET_PHASE_IDLE = 0,             // Сброс не выполняется
+    I219V_RESET_PHASE_MAC = 1,              // Ожидание самоочистки CTRL.RST
+    I219V_RESET_PHASE_LAN_INIT = 2,         // Ожидание загрузки конфигурации (STATUS.LAN_INIT_DONE)
+    I219V_RESET_PHASE_PHY = 3,              // Ожидание снятия BMCR.RESET (чтение через MDIC)
+    I219V_RESET_PHASE_DONE = 4,             // Сброс завершен
+    I219V_RESET_PHASE_FAILED = 5            // Таймаут фазы
+} I219V_RESET_PHASE;
+
+// Длительности фаз одного сброса
+typedef struct _I219V_RESET_TIMING {
+    UINT32 Flags;                                   // Состав сброса (I219V_RESET_FLAG_*)
+    NTSTATUS Status;                                // Результат
+    UINT32 MacUs;                                   // Запись CTRL.RST - самоочистка
+    UINT32 LanInitUs;                               // Самоочистка CTRL.RST - STATUS.LAN_INIT_DONE
+    UINT32 PhyUs;                                   // Начало фазы PHY - снятие BMCR.RESET
+    UINT32 TotalUs;                                 // Вся последовательность
+    UINT32 Polls;                                   // Срабатывания таймера (не число интервалов I219V_RESET_POLL_US)
+    UINT32 FailedPhase;                             // Фаза, завершившаяся таймаутом (I219V_RESET_PHASE)
+} I219V_RESET_TIMING, *PI219V_RESET_TIMING;
+
+// Статистика сбросов
+typedef struct _I219V_RESET_STATS {
+    UINT64 Resets;                                  // Выполненные последовательности
+    UINT64 Failures;                                // Последовательности с таймаутом
+    UINT32 MaxTotalUs;                              // Наибольшая длительность
+    I219V_RESET_TIMING Last;                        // Последний сброс
+} I219V_RESET_STATS, *PI219V_RESET_STATS;
+
+// Состояние последовательности сброса
+// Пока фаза не IDLE/DONE/FAILED, состояние меняет только таймер.
+typedef struct _I219V_RESET_SEQUENCER {
+    WDFTIMER PollTimer;                             // Таймер опроса
+    KEVENT MacReady;                                // MAC вышел из сброса или последовательность завершена
+    KEVENT Complete;                                // Последовательность завершена
+    volatile I219V_RESET_PHASE Phase;               // Текущая фаза
+    LONGLONG Frequency;                             // Частота KeQueryPerformanceCounter
+    LONGLONG Start;                                 // Начало последовательности
+    LONGLONG PhaseStart;                            // Начало текущей фазы
+    BOOLEAN MdicOwned;                              // Чтение BMCR выдано, MDIC захвачен
+    I219V_RESET_TIMING Current;                     // Текущий сброс
+    I219V_RESET_STATS Stats;                        // Статистика
+} I219V_RESET_SEQUENCER, *PI219V_RESET_SEQUENCER;
+
+// Объявление функций последовательности сброса
+NTSTATUS I219vInitializeResetSequencer(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+NTSTATUS I219vStartReset(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 Flags);
+NTSTATUS I219vWaitReset(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ BOOLEAN MacOnly);
+
+EVT_WDF_TIMER I219vEvtResetPollTimer;
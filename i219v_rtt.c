@@ -0,0 +1,300 @@
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_rtt.c
+
+Abstract:
+
+    Реализация пассивного измерения RTT для драйвера Intel i219-v.
+    Для TCP замер начинается при отправке сегмента с данными и завершается
+    приемом подтверждения, покрывающего его последний байт (одновременно
+    замеряется не более одного сегмента на поток, повторные передачи
+    отменяют замер - алгоритм Карна). Для игровых UDP-потоков замер
+    начинается отправкой пакета после паузы встречного направления и
+    завершается первым встречным пакетом (запрос / ответ). Результаты хранятся в записях трекера потоков и в
+    глобальной статистике с разрешением в микросекунды.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+#include "Driver.h"
+#include "Device.h"
+#include "i219v_gaming.h"
+#include "i219v_flow.h"
+#include "i219v_rtt.h"
+#include "DeviceContext.h"
+#include "Trace.h"
+
+// Флаги заголовка TCP
+#define I219V_TCP_FLAG_FIN      0x01
+#define I219V_TCP_FLAG_SYN      0x02
+#define I219V_TCP_FLAG_ACK      0x10
+
+// Разбор сегмента TCP: номера последовательности/подтверждения и длина данных
+static
+BOOLEAN
+I219vRttParseTcp(
+    _In_ PI219V_PACKET_METADATA Metadata,
+    _Out_ PUINT32 Sequence,
+    _Out_ PUINT32 Acknowledgment,
+    _Out_ PUCHAR Flags,
+    _Out_ PUINT32 PayloadLength
+    )
+{
+    PUCHAR ipHeader = Metadata->HeaderBuffer + Metadata->Headers.L3Offset;
+    PUCHAR tcpHeader = Metadata->HeaderBuffer + Metadata->Headers.L4Offset;
+    UINT32 l3End;
+    UINT32 tcpHeaderLength;
+
+    if (Metadata->Headers.L4Offset == 0 ||
+        Metadata->HeaderBufferLength < (UINT32)Metadata->Headers.L4Offset + 20) {
+        return FALSE;
+    }
+
+    // Конец IP-пакета (кадр может содержать дополнение до минимальной длины)
+    if (Metadata->Headers.IpVersion == 4) {
+        l3End = Metadata->Headers.L3Offset + ((ipHeader[2] << 8) | ipHeader[3]);
+    } else {
+        l3End = Metadata->Headers.L3Offset + 40 + ((ipHeader[4] << 8) | ipHeader[5]);
+    }
+
+    tcpHeaderLength = (tcpHeader[12] >> 4) * 4;
+    if (tcpHeaderLength < 20 || l3End < (UINT32)Metadata->Headers.L4Offset + tcpHeaderLength) {
+        return FALSE;
+    }
+
+    *Sequence = ((UINT32)tcpHeader[4] << 24) | ((UINT32)tcpHeader[5] << 16) | ((UINT32)tcpHeader[6] << 8) | tcpHeader[7];
+    *Acknowledgment = ((UINT32)tcpHeader[8] << 24) | ((UINT32)tcpHeader[9] << 16) | ((UINT32)tcpHeader[10] << 8) | tcpHeader[11];
+    *Flags = tcpHeader[13];
+    *PayloadLength = l3End - Metadata->Headers.L4Offset - tcpHeaderLength;
+
+    return TRUE;
+}
+
+// Обновление скользящего среднего, минимума и максимума
+static
+VOID
+I219vRttAccumulate(
+    _In_ UINT32 RttUs,
+    _In_ BOOLEAN FirstSample,
+    _Inout_ PUINT32 AverageUs,
+    _Inout_ PUINT32 MinUs,
+    _Inout_ PUINT32 PeakUs
+    )
+{
+    if (FirstSample) {
+        *AverageUs = RttUs;
+        *MinUs = RttUs;
+        *PeakUs = RttUs;
+        return;
+    }
+
+    *AverageUs = (UINT32)((INT64)*AverageUs + ((INT64)RttUs - (INT64)*AverageUs) / (1 << I219V_RTT_EWMA_SHIFT));
+    *MinUs = min(*MinUs, RttUs);
+    *PeakUs = max(*PeakUs, RttUs);
+}
+
+// Учет замера RTT в потоке и в глобальной статистике
+static
+VOID
+I219vRttRecordSample(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Inout_ PI219V_FLOW_ENTRY Entry,
+    _In_ UINT64 RttUs,
+    _In_ BOOLEAN Tcp
+    )
+{
+    PI219V_RTT_STATS stats = &DeviceContext->Rtt.Stats;
+    UINT32 rtt;
+
+    if (RttUs > I219V_RTT_MAX_SAMPLE_US) {
+        stats->DiscardedSamples++;
+        return;
+    }
+
+    rtt = (UINT32)RttUs;
+
+    // Статистика потока
+    I219vRttAccumulate(rtt, Entry->RttSamples == 0, &Entry->AverageRttUs, &Entry->MinRttUs, &Entry->PeakRttUs);
+    Entry->LastRttUs = rtt;
+    Entry->RttSamples++;
+
+    // Глобальная статистика
+    I219vRttAccumulate(rtt, stats->Samples == 0, &stats->AverageRttUs, &stats->MinRttUs, &stats->PeakRttUs);
+    stats->CurrentRttUs = rtt;
+    stats->Samples++;
+    if (Tcp) {
+        stats->TcpSamples++;
+    } else {
+        stats->UdpSamples++;
+    }
+
+    // Поля статистики производительности в миллисекундах
+    DeviceContext->GamingPerformanceStats.CurrentLatencyMs = stats->CurrentRttUs / 1000;
+    DeviceContext->GamingPerformanceStats.AverageLatencyMs = stats->AverageRttUs / 1000;
+    DeviceContext->GamingPerformanceStats.PeakLatencyMs = stats->PeakRttUs / 1000;
+}
+
+// Инициализация модуля RTT
+VOID
+I219vInitializeRtt(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    LARGE_INTEGER frequency;
+
+    KeQueryPerformanceCounter(&frequency);
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    RtlZeroMemory(&DeviceContext->Rtt, sizeof(I219V_RTT_STATE));
+    DeviceContext->Rtt.PerformanceFrequency = frequency;
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Текущее время в микросекундах
+UINT64
+I219vRttGetTimeUs(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    UINT64 counter = (UINT64)KeQueryPerformanceCounter(NULL).QuadPart;
+    UINT64 frequency = (UINT64)DeviceContext->Rtt.PerformanceFrequency.QuadPart;
+
+    // Деление в два шага исключает переполнение при большом времени работы
+    return (counter / frequency) * 1000000 + ((counter % frequency) * 1000000) / frequency;
+}
+
+// Получение глобальной статистики RTT
+VOID
+I219vGetRttStats(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PI219V_RTT_STATS RttStats
+    )
+{
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    RtlCopyMemory(RttStats, &DeviceContext->Rtt.Stats, sizeof(I219V_RTT_STATS));
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Начало замера при отправке пакета
+// Вызывается из пути передачи под GamingSettingsLock после учета потока.
+VOID
+I219vRttOnTransmit(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ PI219V_PACKET_METADATA Metadata,
+    _In_ UINT64 NowUs
+    )
+{
+    PI219V_FLOW_ENTRY entry = Metadata->FlowEntry;
+
+    if (entry == NULL) {
+        return;
+    }
+
+    // Ответ на замеряемый пакет так и не пришел
+    if (entry->RttPending && NowUs - entry->RttPendingTimeUs > I219V_RTT_MAX_SAMPLE_US) {
+        entry->RttPending = FALSE;
+        DeviceContext->Rtt.Stats.DiscardedSamples++;
+    }
+
+    if (Metadata->Headers.Protocol == I219V_IP_PROTOCOL_TCP) {
+        UINT32 sequence, acknowledgment, payloadLength, segmentEnd;
+        UCHAR flags;
+
+        if (!I219vRttParseTcp(Metadata, &sequence, &acknowledgment, &flags, &payloadLength)) {
+            return;
+        }
+
+        // SYN и FIN занимают по одному номеру последовательности
+        segmentEnd = sequence + payloadLength +
+                     ((flags & I219V_TCP_FLAG_SYN) ? 1 : 0) +
+                     ((flags & I219V_TCP_FLAG_FIN) ? 1 : 0);
+
+        // Чистые подтверждения не замеряются
+        if (segmentEnd == sequence) {
+            return;
+        }
+
+        if (entry->RttPending) {
+            // Повторная передача уже замеряемых данных делает замер недостоверным
+            if ((INT32)(segmentEnd - entry->RttPendingSeqEnd) <= 0) {
+                entry->RttPending = FALSE;
+                DeviceContext->Rtt.Stats.DiscardedSamples++;
+            }
+            return;
+        }
+
+        entry->RttPending = TRUE;
+        entry->RttPendingSeqEnd = segmentEnd;
+        entry->RttPendingTimeUs = NowUs;
+    } else if (Metadata->Headers.Protocol == I219V_IP_PROTOCOL_UDP &&
+               entry->Class == I219V_TRAFFIC_CLASS_GAME) {
+        // Игровой UDP: запросом считается пакет, отправленный после паузы
+        // встречного направления дольше I219V_RTT_UDP_QUIET_US. Если сервер
+        // шлет поток обновлений, встречный пакет мог быть отправлен до
+        // получения запроса, и замер не начинается.
+        if (!entry->RttPending &&
+            (entry->RttReverseTimeUs == 0 || NowUs - entry->RttReverseTimeUs > I219V_RTT_UDP_QUIET_US)) {
+            entry->RttPending = TRUE;
+            entry->RttPendingTimeUs = NowUs;
+        }
+    }
+}
+
+// Завершение замера при приеме пакета встречного направления
+// Вызывается из пути приема под GamingSettingsLock; Metadata описывает принятый кадр.
+VOID
+I219vRttOnReceive(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ PI219V_PACKET_METADATA Metadata,
+    _In_ UINT64 NowUs
+    )
+{
+    PI219V_FLOW_ENTRY entry;
+    UINT32 sequence, acknowledgment, payloadLength;
+    UCHAR flags;
+
+    if (Metadata->Headers.Protocol != I219V_IP_PROTOCOL_TCP &&
+        Metadata->Headers.Protocol != I219V_IP_PROTOCOL_UDP) {
+        return;
+    }
+
+    entry = I219vFlowTrackerFindReverse(DeviceContext, Metadata);
+    if (entry == NULL) {
+        return;
+    }
+
+    if (Metadata->Headers.Protocol == I219V_IP_PROTOCOL_UDP) {
+        // Время встречного пакета учитывается и без замера: по нему
+        // I219vRttOnTransmit определяет паузу перед следующим запросом
+        entry->RttReverseTimeUs = NowUs;
+
+        if (entry->RttPending) {
+            entry->RttPending = FALSE;
+            I219vRttRecordSample(DeviceContext, entry, NowUs - entry->RttPendingTimeUs, FALSE);
+        }
+        return;
+    }
+
+    if (!entry->RttPending) {
+        return;
+    }
+
+    if (!I219vRttParseTcp(Metadata, &sequence, &acknowledgment, &flags, &payloadLength) ||
+        (flags & I219V_TCP_FLAG_ACK) == 0 ||
+        (INT32)(acknowledgment - entry->RttPendingSeqEnd) < 0) {
+        return;
+    }
+
+    entry->RttPending = FALSE;
+    I219vRttRecordSample(DeviceContext, entry, NowUs - entry->RttPendingTimeUs, TRUE);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_rtt.h
+
+Abstract:
+
+    Заголовочный файл для модуля пассивного измерения RTT Intel i219-v.
+    RTT вычисляется по сопоставлению отправленных и принятых пакетов
+    одного потока без генерации служебного трафика:
+    TCP - по паре "номер последовательности / подтверждение",
+    UDP (игровые потоки) - по интервалу "запрос / ответ".
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+#include "i219v_gaming.h"
+
+// Замеры дольше этого значения считаются устаревшими (мкс)
+#define I219V_RTT_MAX_SAMPLE_US     1000000
+
+// UDP: замер начинается, только если встречное направление молчит дольше
+// этого интервала (мкс). Игровые серверы шлют обновления с частотой тиков
+// (8-50 мс), поэтому поток обновлений замеров не дает: первый встречный
+// пакет измерял бы интервал отправки сервера, а не задержку ответа.
+#define I219V_RTT_UDP_QUIET_US      200000
+
+// Вес нового замера в скользящем среднем (1/8, как SRTT в TCP)
+#define I219V_RTT_EWMA_SHIFT        3
+
+// Глобальная статистика RTT (микросекунды)
+typedef struct _I219V_RTT_STATS {
+    UINT64 Samples;                                 // Общее количество замеров
+    UINT64 TcpSamples;                              // Замеры по TCP (seq/ack)
+    UINT64 UdpSamples;                              // Замеры по UDP (запрос/ответ)
+    UINT64 DiscardedSamples;                        // Отброшенные замеры (устаревшие, повторные передачи)
+    UINT32 CurrentRttUs;                            // Последний замер
+    UINT32 AverageRttUs;                            // Скользящее среднее
+    UINT32 MinRttUs;                                // Минимальный замер
+    UINT32 PeakRttUs;                               // Максимальный замер
+} I219V_RTT_STATS, *PI219V_RTT_STATS;
+
+// Состояние модуля RTT
+typedef struct _I219V_RTT_STATE {
+    LARGE_INTEGER PerformanceFrequency;             // Частота KeQueryPerformanceCounter
+    I219V_RTT_STATS Stats;                          // Глобальная статистика
+} I219V_RTT_STATE, *PI219V_RTT_STATE;
+
+// Объявление функций для измерения RTT
+VOID I219vInitializeRtt(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+UINT64 I219vRttGetTimeUs(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vGetRttStats(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_RTT_STATS RttStats);
+
+// Обработка пакетов в путях передачи и приема (вызываются под GamingSettingsLock)
+VOID I219vRttOnTransmit(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ PI219V_PACKET_METADATA Metadata, _In_ UINT64 NowUs);
+VOID I219vRttOnReceive(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ PI219V_PACKET_METADATA Metadata, _In_ UINT64 NowUs);
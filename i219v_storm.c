@@ -0,0 +1,320 @@
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_storm.c
+
+Abstract:
+
+    Реализация защиты от шторма прерываний для драйвера Intel i219-v.
+    При нулевой или малой модерации поток мелких пакетов от неисправного
+    или злонамеренного узла может вызывать прерывания с такой частотой,
+    что потоки пользователя не получают процессорного времени. DPC
+    оценивает частоту прерываний в каждом окне; при превышении порога
+    причины приема и передачи маскируются, а очереди уведомляются
+    периодическим таймером. Работа за один вызов по-прежнему ограничена
+    бюджетами сбора кадров и возврата пакетов в продвижении очередей.
+    Возврат в режим прерываний выполняется, когда частота пакетов держится
+    ниже порога выхода несколько окон подряд (гистерезис исключает
+    колебания между режимами).
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+#include "Driver.h"
+#include "Device.h"
+#include "Queue.h"
+#include "i219v_hw.h"
+#include "i219v_storm.h"
+#include "DeviceContext.h"
+#include "Trace.h"
+
+// Перевод количества событий за интервал (100 нс) в частоту в секунду
+static
+UINT32
+I219vStormRate(
+    _In_ UINT64 Events,
+    _In_ UINT64 Elapsed
+    )
+{
+    UINT64 rate = (Events * 10000000ULL) / Elapsed;
+
+    return (rate > MAXUINT32) ? MAXUINT32 : (UINT32)rate;
+}
+
+// Создание таймера опроса
+// Вызывается из I219vEvtDeviceAdd после создания объекта прерывания.
+NTSTATUS
+I219vInitializeStormGuard(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    NTSTATUS status;
+    PI219V_STORM_STATE storm = &DeviceContext->Storm;
+    WDF_TIMER_CONFIG timerConfig;
+    WDF_OBJECT_ATTRIBUTES attributes;
+
+    RtlZeroMemory(storm, sizeof(I219V_STORM_STATE));
+
+    WDF_TIMER_CONFIG_INIT_PERIODIC(&timerConfig, I219vEvtStormPollTimer, I219V_STORM_POLL_PERIOD_MS);
+    timerConfig.UseHighResolutionTimer = WdfTrue;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = DeviceContext->Device;
+
+    status = WdfTimerCreate(&timerConfig, &attributes, &storm->PollTimer);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfTimerCreate failed: %!STATUS!", status);
+        return status;
+    }
+
+    storm->WindowStart = KeQueryInterruptTime();
+
+    return STATUS_SUCCESS;
+}
+
+// Переход в режим опроса
+// Вызывается под GamingSettingsLock.
+static
+VOID
+I219vStormEnterPolling(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT64 Now
+    )
+{
+    PI219V_STORM_STATE storm = &DeviceContext->Storm;
+
+    // Причины приема и передачи больше не разрешаются уведомлениями очередей.
+    // Режим и маска меняются под блокировкой прерывания: уведомление очереди,
+    // проверившее режим до перехода, не разрешит причину после записи IMC.
+    WdfInterruptAcquireLock(DeviceContext->Interrupt);
+    InterlockedExchange(&storm->PollingActive, 1);
+    I219vWriteRegister(DeviceContext, I219V_REG_IMC, I219V_ICR_RX_CAUSES | I219V_ICR_TX_CAUSES);
+    WdfInterruptReleaseLock(DeviceContext->Interrupt);
+
+    storm->PollingStart = Now;
+    storm->WindowStart = Now;
+    storm->WindowPackets = 0;
+    storm->CalmWindows = 0;
+    storm->Stats.StormsDetected++;
+    storm->Stats.PollingActive = TRUE;
+
+    WdfTimerStart(storm->PollTimer, WDF_REL_TIMEOUT_IN_MS(I219V_STORM_POLL_PERIOD_MS));
+
+    TraceEvents(TRACE_LEVEL_WARNING, TRACE_QUEUE,
+              "Interrupt storm detected (%u interrupts/s), switching to polling",
+              storm->Stats.LastInterruptRate);
+}
+
+// Возврат в режим прерываний
+// Вызывается из таймера опроса под GamingSettingsLock.
+static
+VOID
+I219vStormExitPolling(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT64 Now
+    )
+{
+    PI219V_STORM_STATE storm = &DeviceContext->Storm;
+    UINT32 causes = 0;
+
+    WdfTimerStop(storm->PollTimer, FALSE);
+
+    // Разрешаются причины очередей, ожидающих уведомления; причины,
+    // зафиксированные в ICR во время опроса, сразу вызовут прерывание
+    WdfInterruptAcquireLock(DeviceContext->Interrupt);
+    InterlockedExchange(&storm->PollingActive, 0);
+    if (DeviceContext->RxNotificationEnabled) {
+        causes |= I219V_ICR_RX_CAUSES;
+    }
+    if (DeviceContext->TxNotificationEnabled) {
+        causes |= I219V_ICR_TX_CAUSES;
+    }
+    if (causes != 0) {
+        I219vWriteRegister(DeviceContext, I219V_REG_IMS, causes);
+    }
+    WdfInterruptReleaseLock(DeviceContext->Interrupt);
+
+    storm->Stats.PollingTimeMs += (Now - storm->PollingStart) / 10000;
+    storm->Stats.PollingExits++;
+    storm->Stats.PollingActive = FALSE;
+
+    // Окно оценки частоты прерываний начинается заново
+    storm->WindowStart = Now;
+    storm->WindowInterrupts = DeviceContext->InterruptStats.Interrupts;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_QUEUE,
+              "Packet rate normalized (%u packets/s), returning to interrupt mode",
+              storm->Stats.LastPolledPacketRate);
+}
+
+// Разрешение причин пути данных
+// Вызывается уведомлениями очередей и DPC прерывания. Возвращает FALSE,
+// если причины остаются замаскированными режимом опроса.
+BOOLEAN
+I219vStormUnmaskCauses(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ UINT32 Causes
+    )
+{
+    BOOLEAN unmasked = FALSE;
+
+    WdfInterruptAcquireLock(DeviceContext->Interrupt);
+    if (!DeviceContext->Storm.PollingActive) {
+        I219vWriteRegisterFast(DeviceContext, IMS, Causes);
+        unmasked = TRUE;
+    }
+    WdfInterruptReleaseLock(DeviceContext->Interrupt);
+
+    return unmasked;
+}
+
+// Остановка таймера опроса и сброс режима
+// Вызывается при остановке адаптера и выходе из D0: после перезапуска
+// устройство начинает в режиме прерываний с новым окном оценки.
+VOID
+I219vStopStormGuard(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_STORM_STATE storm = &DeviceContext->Storm;
+    UINT64 now = KeQueryInterruptTime();
+
+    if (storm->PollTimer != NULL) {
+        WdfTimerStop(storm->PollTimer, TRUE);
+    }
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+
+    if (storm->PollingActive) {
+        storm->Stats.PollingTimeMs += (now - storm->PollingStart) / 10000;
+        storm->Stats.PollingExits++;
+    }
+
+    InterlockedExchange(&storm->PollingActive, 0);
+    storm->Stats.PollingActive = FALSE;
+    storm->WindowStart = now;
+    storm->WindowInterrupts = DeviceContext->InterruptStats.Interrupts;
+    storm->WindowPackets = 0;
+    storm->CalmWindows = 0;
+
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Проверка частоты прерываний по окончании окна
+// Вызывается из DPC прерывания; блокировка берется только при смене окна.
+VOID
+I219vStormCheckInterruptRate(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_STORM_STATE storm = &DeviceContext->Storm;
+    UINT64 now = KeQueryInterruptTime();
+    UINT64 elapsed;
+    UINT64 interrupts;
+
+    if (storm->PollingActive || now - storm->WindowStart < I219V_STORM_WINDOW) {
+        return;
+    }
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+
+    // Повторная проверка: окно могло быть закрыто другим DPC
+    elapsed = now - storm->WindowStart;
+    if (!storm->PollingActive && elapsed >= I219V_STORM_WINDOW) {
+        interrupts = DeviceContext->InterruptStats.Interrupts - storm->WindowInterrupts;
+
+        storm->Stats.LastInterruptRate = I219vStormRate(interrupts, elapsed);
+        if (storm->Stats.LastInterruptRate > storm->Stats.PeakInterruptRate) {
+            storm->Stats.PeakInterruptRate = storm->Stats.LastInterruptRate;
+        }
+
+        storm->WindowStart = now;
+        storm->WindowInterrupts = DeviceContext->InterruptStats.Interrupts;
+
+        if (storm->Stats.LastInterruptRate >= I219V_STORM_ENTER_INTERRUPT_RATE) {
+            I219vStormEnterPolling(DeviceContext, now);
+        }
+    }
+
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
+
+// Таймер опроса
+// Уведомляет очереди, ожидающие новых кадров или завершений, как это
+// сделал бы DPC прерывания, и по окончании окна оценивает частоту пакетов.
+VOID
+I219vEvtStormPollTimer(
+    _In_ WDFTIMER Timer
+    )
+{
+    PI219V_DEVICE_CONTEXT deviceContext = I219vGetDeviceContext(WdfTimerGetParentObject(Timer));
+    PI219V_STORM_STATE storm = &deviceContext->Storm;
+    UINT64 now = KeQueryInterruptTime();
+    UINT64 elapsed;
+    BOOLEAN notifyRx;
+    BOOLEAN notifyTx;
+
+    if (!storm->PollingActive) {
+        return;
+    }
+
+    notifyRx = (InterlockedExchange(&deviceContext->RxNotificationEnabled, 0) != 0);
+    notifyTx = (InterlockedExchange(&deviceContext->TxNotificationEnabled, 0) != 0);
+
+    if (notifyRx) {
+        NetRxQueueNotifyMoreReceivedPacketsAvailable(deviceContext->RxQueue);
+    }
+    if (notifyTx) {
+        NetTxQueueNotifyMoreCompletedPacketsAvailable(deviceContext->TxQueue);
+    }
+
+    WdfSpinLockAcquire(deviceContext->GamingSettingsLock);
+
+    storm->Stats.PollTicks++;
+    if (notifyRx) {
+        storm->Stats.PolledRxNotifications++;
+    }
+    if (notifyTx) {
+        storm->Stats.PolledTxNotifications++;
+    }
+
+    elapsed = now - storm->WindowStart;
+    if (storm->PollingActive && elapsed >= I219V_STORM_WINDOW) {
+        storm->Stats.LastPolledPacketRate = I219vStormRate(storm->WindowPackets, elapsed);
+        storm->WindowStart = now;
+        storm->WindowPackets = 0;
+
+        if (storm->Stats.LastPolledPacketRate < I219V_STORM_EXIT_PACKET_RATE) {
+            storm->CalmWindows++;
+        } else {
+            storm->CalmWindows = 0;
+        }
+
+        if (storm->CalmWindows >= I219V_STORM_CALM_WINDOWS) {
+            I219vStormExitPolling(deviceContext, now);
+        }
+    }
+
+    WdfSpinLockRelease(deviceContext->GamingSettingsLock);
+}
+
+// Получение статистики защиты от шторма прерываний
+VOID
+I219vGetStormStats(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PI219V_STORM_STATS StormStats
+    )
+{
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    RtlCopyMemory(StormStats, &DeviceContext->Storm.Stats, sizeof(I219V_STORM_STATS));
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+}
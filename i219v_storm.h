@@ -0,0 +1,87 @@
+#pragma once
+
+/*++
+
+Copyright (c) 2025 Manus AI
+
+Module Name:
+
+    i219v_storm.h
+
+Abstract:
+
+    Заголовочный файл для защиты от шторма прерываний Intel i219-v.
+    DPC отслеживает частоту прерываний в окне; при превышении порога
+    причины приема и передачи маскируются, и очереди обслуживаются
+    периодическим таймером опроса. Когда частота пакетов снижается и
+    держится низкой несколько окон подряд, драйвер возвращается в режим
+    прерываний.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <netadaptercx.h>
+
+// Длительность окна оценки частоты прерываний (единицы KeQueryInterruptTime - 100 нс)
+#define I219V_STORM_WINDOW                  (10 * 10000)    // 10 мс
+
+// Частота прерываний, начиная с которой включается опрос (прерываний/с)
+#define I219V_STORM_ENTER_INTERRUPT_RATE    40000
+
+// Частота пакетов, ниже которой опрос может быть выключен (пакетов/с)
+// Каждый пакет может вызвать прерывание, поэтому частота пакетов - верхняя
+// оценка частоты прерываний после возврата из режима опроса.
+#define I219V_STORM_EXIT_PACKET_RATE        10000
+
+// Количество окон подряд с низкой частотой пакетов до выхода из опроса
+#define I219V_STORM_CALM_WINDOWS            10
+
+// Период таймера опроса (мс)
+#define I219V_STORM_POLL_PERIOD_MS          1
+
+// Статистика защиты от шторма прерываний
+typedef struct _I219V_STORM_STATS {
+    UINT64 StormsDetected;                          // Переходы в режим опроса
+    UINT64 PollingExits;                            // Возвраты в режим прерываний
+    UINT64 PollTicks;                               // Срабатывания таймера опроса
+    UINT64 PolledRxNotifications;                   // Уведомления очереди приема из таймера
+    UINT64 PolledTxNotifications;                   // Уведомления очереди передачи из таймера
+    UINT64 PollingTimeMs;                           // Суммарное время в режиме опроса (мс)
+    UINT32 LastInterruptRate;                       // Частота прерываний за последнее окно (прерываний/с)
+    UINT32 PeakInterruptRate;                       // Наибольшая частота прерываний за окно
+    UINT32 LastPolledPacketRate;                    // Частота пакетов за последнее окно опроса (пакетов/с)
+    BOOLEAN PollingActive;                          // Текущий режим: TRUE - опрос
+} I219V_STORM_STATS, *PI219V_STORM_STATS;
+
+// Состояние защиты от шторма прерываний
+typedef struct _I219V_STORM_STATE {
+    WDFTIMER PollTimer;                             // Периодический таймер опроса
+    volatile LONG PollingActive;                    // Причины приема и передачи замаскированы, работает опрос
+    UINT64 WindowStart;                             // Начало окна оценки (KeQueryInterruptTime)
+    UINT64 WindowInterrupts;                        // InterruptStats.Interrupts в начале окна
+    UINT64 PollingStart;                            // Время перехода в режим опроса
+    UINT32 WindowPackets;                           // Пакеты, обработанные путем данных за окно опроса
+    UINT32 CalmWindows;                             // Окон подряд с частотой пакетов ниже порога
+    I219V_STORM_STATS Stats;                        // Статистика
+} I219V_STORM_STATE, *PI219V_STORM_STATE;
+
+// Объявление обработчика таймера опроса
+EVT_WDF_TIMER I219vEvtStormPollTimer;
+
+// Объявление функций защиты от шторма прерываний
+NTSTATUS I219vInitializeStormGuard(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vStopStormGuard(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+VOID I219vGetStormStats(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_STORM_STATS StormStats);
+
+// Разрешение причин приема и передачи вне режима опроса (проверка режима
+// и запись IMS выполняются под блокировкой прерывания)
+BOOLEAN I219vStormUnmaskCauses(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _In_ UINT32 Causes);
+
+// Проверка частоты прерываний (вызывается из DPC прерывания)
+VOID I219vStormCheckInterruptRate(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+
@@ -25,7 +25,11 @@ Environment:
 #include "Adapter.h"
 #include "i219v_hw.h"
 #include "i219v_hw_extended.h"
+#include "i219v_gaming.h"
+#include "i219v_phy.h"
+#include "i219v_model.h"
 #include "i219v_test.h"
+#include "Datapath.h"
 #include "DeviceContext.h"
 #include "Trace.h"
 
@@ -45,9 +49,9 @@ I219vRunSelfTest(
     RtlZeroMemory(TestResults, sizeof(I219V_SELF_TEST_RESULTS));
 
     // Проверка доступности регистров
-    ctrl = I219vReadRegister(DeviceContext, I219V_REG_CTRL);
-    status = I219vReadRegister(DeviceContext, I219V_REG_STATUS);
-    eecd = I219vReadRegister(DeviceContext, I219V_REG_EECD);
+    ctrl = I219vReadRegisterEx(DeviceContext, I219V_REG_CTRL, I219V_MMIO_CATEGORY_DIAGNOSTICS);
+    status = I219vReadRegisterEx(DeviceContext, I219V_REG_STATUS, I219V_MMIO_CATEGORY_DIAGNOSTICS);
+    eecd = I219vReadRegisterEx(DeviceContext, I219V_REG_EECD, I219V_MMIO_CATEGORY_DIAGNOSTICS);
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, 
               "Register values: CTRL=0x%08x, STATUS=0x%08x, EECD=0x%08x", 
@@ -84,8 +88,8 @@ I219vRunSelfTest(
         UINT32 ral0, rah0;
         
         // Чтение регистров MAC-адреса
-        ral0 = I219vReadRegister(DeviceContext, I219V_REG_RAL0);
-        rah0 = I219vReadRegister(DeviceContext, I219V_REG_RAH0);
+        ral0 = I219vReadRegisterEx(DeviceContext, I219V_REG_RAL0, I219V_MMIO_CATEGORY_DIAGNOSTICS);
+        rah0 = I219vReadRegisterEx(DeviceContext, I219V_REG_RAH0, I219V_MMIO_CATEGORY_DIAGNOSTICS);
         
         // Проверка валидности MAC-адреса
         if (ral0 != 0 || (rah0 & 0x0000FFFF) != 0) {
@@ -208,14 +212,14 @@ I219vTestRegisters(
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Testing device registers");
 
     // Сохранение текущего значения регистра
-    UINT32 originalValue = I219vReadRegister(DeviceContext, I219V_REG_FCTTV);
+    UINT32 originalValue = I219vReadRegisterEx(DeviceContext, I219V_REG_FCTTV, I219V_MMIO_CATEGORY_DIAGNOSTICS);
 
     // Запись тестового значения
     testValue = 0x12345678;
-    I219vWriteRegister(DeviceContext, I219V_REG_FCTTV, testValue);
+    I219vWriteRegisterEx(DeviceContext, I219V_REG_FCTTV, testValue, I219V_MMIO_CATEGORY_DIAGNOSTICS);
 
     // Чтение записанного значения
-    readValue = I219vReadRegister(DeviceContext, I219V_REG_FCTTV);
+    readValue = I219vReadRegisterEx(DeviceContext, I219V_REG_FCTTV, I219V_MMIO_CATEGORY_DIAGNOSTICS);
 
     // Проверка соответствия
     if (readValue == testValue) {
@@ -230,7 +234,7 @@ I219vTestRegisters(
     }
 
     // Восстановление оригинального значения
-    I219vWriteRegister(DeviceContext, I219V_REG_FCTTV, originalValue);
+    I219vWriteRegisterEx(DeviceContext, I219V_REG_FCTTV, originalValue, I219V_MMIO_CATEGORY_DIAGNOSTICS);
 
     return status;
 }
@@ -286,8 +290,8 @@ I219vTestMacAddress(
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Testing MAC address");
 
     // Чтение регистров MAC-адреса
-    ral0 = I219vReadRegister(DeviceContext, I219V_REG_RAL0);
-    rah0 = I219vReadRegister(DeviceContext, I219V_REG_RAH0);
+    ral0 = I219vReadRegisterEx(DeviceContext, I219V_REG_RAL0, I219V_MMIO_CATEGORY_DIAGNOSTICS);
+    rah0 = I219vReadRegisterEx(DeviceContext, I219V_REG_RAH0, I219V_MMIO_CATEGORY_DIAGNOSTICS);
 
     // Проверка валидности MAC-адреса
     if (ral0 != 0 || (rah0 & 0x0000FFFF) != 0) {
@@ -325,7 +329,7 @@ I219vTestLinkStatus(
     phyStatus = I219vReadPhy(DeviceContext, I219V_PHY_STATUS);
     
     // Чтение статуса устройства
-    status = I219vReadRegister(DeviceContext, I219V_REG_STATUS);
+    status = I219vReadRegisterEx(DeviceContext, I219V_REG_STATUS, I219V_MMIO_CATEGORY_DIAGNOSTICS);
 
     // Проверка состояния соединения
     if ((phyStatus & I219V_PHY_STATUS_LINK_UP) && (status & I219V_STATUS_LU)) {
@@ -378,12 +382,12 @@ I219vTestStatistics(
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Testing statistics registers");
 
     // Чтение регистров статистики
-    gprc = I219vReadRegister(DeviceContext, I219V_REG_GPRC);
-    gptc = I219vReadRegister(DeviceContext, I219V_REG_GPTC);
-    gorcl = I219vReadRegister(DeviceContext, I219V_REG_GORCL);
-    gorch = I219vReadRegister(DeviceContext, I219V_REG_GORCH);
-    gotcl = I219vReadRegister(DeviceContext, I219V_REG_GOTCL);
-    gotch = I219vReadRegister(DeviceContext, I219V_REG_GOTCH);
+    gprc = I219vReadRegisterEx(DeviceContext, I219V_REG_GPRC, I219V_MMIO_CATEGORY_DIAGNOSTICS);
+    gptc = I219vReadRegisterEx(DeviceContext, I219V_REG_GPTC, I219V_MMIO_CATEGORY_DIAGNOSTICS);
+    gorcl = I219vReadRegisterEx(DeviceContext, I219V_REG_GORCL, I219V_MMIO_CATEGORY_DIAGNOSTICS);
+    gorch = I219vReadRegisterEx(DeviceContext, I219V_REG_GORCH, I219V_MMIO_CATEGORY_DIAGNOSTICS);
+    gotcl = I219vReadRegisterEx(DeviceContext, I219V_REG_GOTCL, I219V_MMIO_CATEGORY_DIAGNOSTICS);
+    gotch = I219vReadRegisterEx(DeviceContext, I219V_REG_GOTCH, I219V_MMIO_CATEGORY_DIAGNOSTICS);
 
     // Вывод значений статистики
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Statistics:");
@@ -409,8 +413,8 @@ I219vTestOffloads(
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Testing hardware offloads");
 
     // Чтение регистров оффлоадов
-    rxcsum = I219vReadRegister(DeviceContext, I219V_REG_RXCSUM);
-    ctrl = I219vReadRegister(DeviceContext, I219V_REG_CTRL);
+    rxcsum = I219vReadRegisterEx(DeviceContext, I219V_REG_RXCSUM, I219V_MMIO_CATEGORY_DIAGNOSTICS);
+    ctrl = I219vReadRegisterEx(DeviceContext, I219V_REG_CTRL, I219V_MMIO_CATEGORY_DIAGNOSTICS);
 
     // Проверка оффлоада контрольной суммы
     if (rxcsum & I219V_RXCSUM_IPOFLD) {
@@ -435,6 +439,964 @@ I219vTestOffloads(
     return status;
 }
 
+// Количество повторов микробенчмарка классификации
+#define I219V_CLASSIFY_BENCHMARK_ITERATIONS 10000
+
+// Микробенчмарк классификации трафика
+// Сравнивает поштучную цепочку проверок портов (I219vClassifyPorts:
+// игры, затем голос, затем стриминг) с пакетной классификацией (скалярной
+// и SSE2) на синтетической пачке и проверяет, что все варианты дают
+// одинаковый результат.
+NTSTATUS
+I219vBenchmarkClassification(
+    _Out_ PI219V_CLASSIFY_BENCHMARK_RESULTS Results
+    )
+{
+    static const UINT16 samplePorts[] = { 3074, 27015, 3478, 9987, 64738, 1935, 443, 8936, 80, 53, 0, 50000 };
+    I219V_CLASSIFY_BATCH batch;
+    UCHAR perPacketClass[I219V_CLASSIFY_BATCH_SIZE];
+    UCHAR scalarClass[I219V_CLASSIFY_BATCH_SIZE];
+    LARGE_INTEGER start, end;
+    volatile UCHAR sink = 0;
+    UINT32 iteration, i;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Benchmarking traffic classification");
+
+    RtlZeroMemory(Results, sizeof(I219V_CLASSIFY_BENCHMARK_RESULTS));
+    Results->PacketsPerBatch = I219V_CLASSIFY_BATCH_SIZE;
+    Results->Iterations = I219V_CLASSIFY_BENCHMARK_ITERATIONS;
+
+    // Синтетическая пачка: смесь игровых, голосовых, стриминговых и прочих портов,
+    // часть пакетов без заголовка L4
+    batch.Count = I219V_CLASSIFY_BATCH_SIZE;
+    for (i = 0; i < I219V_CLASSIFY_BATCH_SIZE; i++) {
+        batch.SourcePort[i] = (UINT16)(49152 + i * 131);
+        batch.DestinationPort[i] = samplePorts[(i * 7) % RTL_NUMBER_OF(samplePorts)];
+        batch.Protocol[i] = (i % 11 == 10) ? 1 : ((i & 1) ? I219V_IP_PROTOCOL_UDP : I219V_IP_PROTOCOL_TCP);
+    }
+
+    // Поштучная классификация
+    start = KeQueryPerformanceCounter(NULL);
+    for (iteration = 0; iteration < I219V_CLASSIFY_BENCHMARK_ITERATIONS; iteration++) {
+        for (i = 0; i < batch.Count; i++) {
+            if (batch.Protocol[i] == I219V_IP_PROTOCOL_TCP || batch.Protocol[i] == I219V_IP_PROTOCOL_UDP) {
+                perPacketClass[i] = (UCHAR)I219vClassifyPorts(batch.SourcePort[i], batch.DestinationPort[i]);
+            } else {
+                perPacketClass[i] = (UCHAR)I219V_TRAFFIC_CLASS_BACKGROUND;
+            }
+        }
+        sink ^= perPacketClass[iteration % I219V_CLASSIFY_BATCH_SIZE];
+    }
+    end = KeQueryPerformanceCounter(NULL);
+    Results->PerPacketTicks = (UINT64)(end.QuadPart - start.QuadPart);
+
+    // Скалярная пакетная классификация
+    start = KeQueryPerformanceCounter(NULL);
+    for (iteration = 0; iteration < I219V_CLASSIFY_BENCHMARK_ITERATIONS; iteration++) {
+        I219vClassifyBatchScalar(&batch);
+        sink ^= batch.Class[iteration % I219V_CLASSIFY_BATCH_SIZE];
+    }
+    end = KeQueryPerformanceCounter(NULL);
+    Results->ScalarBatchTicks = (UINT64)(end.QuadPart - start.QuadPart);
+    RtlCopyMemory(scalarClass, batch.Class, sizeof(scalarClass));
+
+    // Векторная пакетная классификация
+    start = KeQueryPerformanceCounter(NULL);
+    for (iteration = 0; iteration < I219V_CLASSIFY_BENCHMARK_ITERATIONS; iteration++) {
+        I219vClassifyBatch(&batch);
+        sink ^= batch.Class[iteration % I219V_CLASSIFY_BATCH_SIZE];
+    }
+    end = KeQueryPerformanceCounter(NULL);
+    Results->VectorBatchTicks = (UINT64)(end.QuadPart - start.QuadPart);
+
+    UNREFERENCED_PARAMETER(sink);
+
+    Results->ResultsMatch =
+        RtlCompareMemory(perPacketClass, scalarClass, sizeof(perPacketClass)) == sizeof(perPacketClass) &&
+        RtlCompareMemory(perPacketClass, batch.Class, sizeof(perPacketClass)) == sizeof(perPacketClass);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE,
+              "Classification benchmark (%u x %u packets): per-packet=%llu, scalar batch=%llu, SSE2 batch=%llu ticks",
+              Results->Iterations, Results->PacketsPerBatch,
+              Results->PerPacketTicks, Results->ScalarBatchTicks, Results->VectorBatchTicks);
+
+    if (!Results->ResultsMatch) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "Batch classification results differ from per-packet classification");
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+#if I219V_DEVICE_MODEL
+
+#define I219V_MODEL_TEST_RING_SIZE          8
+#define I219V_MODEL_TEST_FRAME_SIZE         64
+#define I219V_MODEL_TEST_ITERATIONS         10000
+#define I219V_MODEL_TEST_PHY_REGISTER       0x10
+#define I219V_MODEL_TEST_PHY_VALUE          0x5A5A
+
+// Память теста: кольца, буферы приема и кадр
+typedef struct _I219V_MODEL_TEST_MEMORY {
+    I219V_RX_DESC RxRing[I219V_MODEL_TEST_RING_SIZE];
+    I219V_TX_DESC TxRing[I219V_MODEL_TEST_RING_SIZE];
+    UCHAR RxBuffers[I219V_MODEL_TEST_RING_SIZE][I219V_MODEL_TEST_FRAME_SIZE];
+    UCHAR Frame[I219V_MODEL_TEST_FRAME_SIZE];
+} I219V_MODEL_TEST_MEMORY, *PI219V_MODEL_TEST_MEMORY;
+
+// Перевод адресов теста: адрес устройства совпадает с виртуальным адресом
+static
+PVOID
+I219vTestModelTranslate(
+    _In_opt_ PVOID Context,
+    _In_ UINT64 DeviceAddress,
+    _In_ UINT32 Length
+    )
+{
+    UNREFERENCED_PARAMETER(Context);
+    UNREFERENCED_PARAMETER(Length);
+
+    return (PVOID)(ULONG_PTR)DeviceAddress;
+}
+
+// Семантика регистров модели через слой доступа к регистрам
+static
+BOOLEAN
+I219vTestModelRegisters(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    // Маска прерываний: IMS устанавливает, IMC сбрасывает
+    I219vWriteRegister(DeviceContext, I219V_REG_IMS, I219V_IMS_RXDW | I219V_IMS_TXDW);
+    I219vWriteRegister(DeviceContext, I219V_REG_IMC, I219V_IMS_RXDW);
+    if (I219vReadRegister(DeviceContext, I219V_REG_IMS) != I219V_IMS_TXDW) {
+        return FALSE;
+    }
+
+    // ICR: причина из ICS, очистка чтением, автомаскирование по IAM
+    I219vWriteRegister(DeviceContext, I219V_REG_CTRL_EXT, I219V_CTRL_EXT_IAME);
+    I219vWriteRegister(DeviceContext, I219V_REG_IAM, I219V_ICR_AUTO_MASK_CAUSES);
+    I219vWriteRegister(DeviceContext, I219V_REG_ICS, I219V_IMS_TXDW);
+    if (I219vReadRegister(DeviceContext, I219V_REG_ICR) != (I219V_IMS_TXDW | I219V_ICR_INT_ASSERTED) ||
+        I219vReadRegister(DeviceContext, I219V_REG_ICR) != 0 ||
+        I219vReadRegister(DeviceContext, I219V_REG_IMS) != 0) {
+        return FALSE;
+    }
+
+    // Сброс: бит RST самоочищающийся, соединение установлено
+    I219vWriteRegister(DeviceContext, I219V_REG_CTRL, I219V_CTRL_RST);
+    if ((I219vReadRegister(DeviceContext, I219V_REG_CTRL) & I219V_CTRL_RST) != 0 ||
+        I219vReadRegister(DeviceContext, I219V_REG_CTRL_EXT) != 0 ||
+        (I219vReadRegister(DeviceContext, I219V_REG_STATUS) & I219V_STATUS_LU) == 0) {
+        return FALSE;
+    }
+
+    // PHY через MDIC: запись, чтение и идентификатор (регистр 2)
+    I219vWritePhy(DeviceContext, I219V_MODEL_TEST_PHY_REGISTER, I219V_MODEL_TEST_PHY_VALUE);
+    if (I219vReadPhy(DeviceContext, I219V_MODEL_TEST_PHY_REGISTER) != I219V_MODEL_TEST_PHY_VALUE ||
+        I219vReadPhy(DeviceContext, 2) != I219V_MODEL_PHY_ID1) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// Настройка колец модели
+static
+VOID
+I219vTestModelSetupRings(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Inout_ PI219V_MODEL_TEST_MEMORY Memory
+    )
+{
+    UINT64 rxBase = (UINT64)(ULONG_PTR)Memory->RxRing;
+    UINT64 txBase = (UINT64)(ULONG_PTR)Memory->TxRing;
+    UINT32 i;
+
+    for (i = 0; i < I219V_MODEL_TEST_RING_SIZE; i++) {
+        Memory->RxRing[i].BufferAddr = (UINT64)(ULONG_PTR)Memory->RxBuffers[i];
+    }
+
+    for (i = 0; i < I219V_MODEL_TEST_FRAME_SIZE; i++) {
+        Memory->Frame[i] = (UCHAR)i;
+    }
+
+    I219vWriteRegister(DeviceContext, I219V_REG_RDBAL, (UINT32)rxBase);
+    I219vWriteRegister(DeviceContext, I219V_REG_RDBAH, (UINT32)(rxBase >> 32));
+    I219vWriteRegister(DeviceContext, I219V_REG_RDLEN, sizeof(Memory->RxRing));
+    I219vWriteRegister(DeviceContext, I219V_REG_RDH, 0);
+    I219vWriteRegister(DeviceContext, I219V_REG_RDT, I219V_MODEL_TEST_RING_SIZE - 1);
+
+    I219vWriteRegister(DeviceContext, I219V_REG_TDBAL, (UINT32)txBase);
+    I219vWriteRegister(DeviceContext, I219V_REG_TDBAH, (UINT32)(txBase >> 32));
+    I219vWriteRegister(DeviceContext, I219V_REG_TDLEN, sizeof(Memory->TxRing));
+    I219vWriteRegister(DeviceContext, I219V_REG_TDH, 0);
+    I219vWriteRegister(DeviceContext, I219V_REG_TDT, 0);
+
+    I219vWriteRegister(DeviceContext, I219V_REG_IMS, I219V_ICR_HANDLED_CAUSES);
+    I219vWriteRegister(DeviceContext, I219V_REG_RCTL, I219V_RCTL_EN | I219V_RCTL_BAM | I219V_RCTL_SECRC);
+    I219vWriteRegister(DeviceContext, I219V_REG_TCTL, I219V_TCTL_EN | I219V_TCTL_PSP);
+}
+
+// Передача кадров через кольцо модели: те же быстрые обращения, что и в пути данных
+static
+BOOLEAN
+I219vTestModelTx(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Inout_ PI219V_MODEL_TEST_MEMORY Memory,
+    _Out_ PUINT64 Ticks
+    )
+{
+    LARGE_INTEGER start, end;
+    UINT32 iteration;
+    UINT32 tail = 0;
+    BOOLEAN passed = TRUE;
+
+    start = KeQueryPerformanceCounter(NULL);
+    for (iteration = 0; iteration < I219V_MODEL_TEST_ITERATIONS && passed; iteration++) {
+        PI219V_TX_DESC desc = &Memory->TxRing[tail];
+
+        desc->BufferAddr = (UINT64)(ULONG_PTR)Memory->Frame;
+        desc->Length = I219V_MODEL_TEST_FRAME_SIZE;
+        desc->CMD = I219V_TXD_CMD_IFCS | I219V_TXD_CMD_EOP | I219V_TXD_CMD_RS;
+        desc->Status = 0;
+
+        tail = (tail + 1) % I219V_MODEL_TEST_RING_SIZE;
+        I219vWriteRegisterFast(DeviceContext, TDT, tail);
+
+        if ((I219vReadRegisterFast(DeviceContext, ICR) & I219V_ICR_TX_CAUSES) == 0 ||
+            (desc->Status & I219V_TXD_STAT_DD) == 0) {
+            passed = FALSE;
+        }
+    }
+    end = KeQueryPerformanceCounter(NULL);
+
+    *Ticks = (UINT64)(end.QuadPart - start.QuadPart);
+
+    return passed && I219vReadRegister(DeviceContext, I219V_REG_TDH) == tail;
+}
+
+// Прием кадров через кольцо модели с возвратом дескрипторов через RDT
+static
+BOOLEAN
+I219vTestModelRx(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Inout_ PI219V_MODEL_TEST_MEMORY Memory,
+    _Out_ PUINT64 Ticks
+    )
+{
+    LARGE_INTEGER start, end;
+    UINT32 iteration;
+    UINT32 head = 0;
+    BOOLEAN passed = TRUE;
+
+    start = KeQueryPerformanceCounter(NULL);
+    for (iteration = 0; iteration < I219V_MODEL_TEST_ITERATIONS && passed; iteration++) {
+        PI219V_RX_DESC desc = &Memory->RxRing[head];
+
+        if (!NT_SUCCESS(I219vModelReceiveFrame(DeviceContext->DeviceModel, Memory->Frame, I219V_MODEL_TEST_FRAME_SIZE)) ||
+            (I219vReadRegisterFast(DeviceContext, ICR) & I219V_ICR_RX_CAUSES) == 0 ||
+            (desc->Status & I219V_RXD_STAT_DD) == 0 ||
+            desc->Length != I219V_MODEL_TEST_FRAME_SIZE ||
+            RtlCompareMemory(Memory->RxBuffers[head], Memory->Frame, I219V_MODEL_TEST_FRAME_SIZE) != I219V_MODEL_TEST_FRAME_SIZE) {
+            passed = FALSE;
+        }
+
+        // Возврат дескриптора устройству
+        desc->Status = 0;
+        I219vWriteRegisterFast(DeviceContext, RDT, head);
+        head = (head + 1) % I219V_MODEL_TEST_RING_SIZE;
+    }
+    end = KeQueryPerformanceCounter(NULL);
+
+    *Ticks = (UINT64)(end.QuadPart - start.QuadPart);
+
+    return passed && I219vReadRegister(DeviceContext, I219V_REG_RDH) == head;
+}
+
+// Тест пути данных на поведенческой модели устройства
+// Модель подключается к отдельному контексту, поэтому работающее устройство
+// не затрагивается. Измеряет стоимость обращений к регистрам и обработки
+// колец без оборудования.
+NTSTATUS
+I219vBenchmarkDeviceModel(
+    _Out_ PI219V_MODEL_BENCHMARK_RESULTS Results
+    )
+{
+    PI219V_DEVICE_CONTEXT deviceContext;
+    PI219V_MODEL_TEST_MEMORY memory;
+    PI219V_DEVICE_MODEL model;
+    NTSTATUS status;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Benchmarking datapath on device model");
+
+    RtlZeroMemory(Results, sizeof(I219V_MODEL_BENCHMARK_RESULTS));
+    Results->Iterations = I219V_MODEL_TEST_ITERATIONS;
+    Results->FrameSize = I219V_MODEL_TEST_FRAME_SIZE;
+
+    deviceContext = (PI219V_DEVICE_CONTEXT)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(I219V_DEVICE_CONTEXT), I219V_MODEL_POOL_TAG);
+    memory = (PI219V_MODEL_TEST_MEMORY)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(I219V_MODEL_TEST_MEMORY), I219V_MODEL_POOL_TAG);
+    if (deviceContext == NULL || memory == NULL) {
+        status = STATUS_INSUFFICIENT_RESOURCES;
+        goto Exit;
+    }
+
+    status = I219vCreateDeviceModel(I219vTestModelTranslate, NULL, &model);
+    if (!NT_SUCCESS(status)) {
+        goto Exit;
+    }
+
+    I219vAttachDeviceModel(deviceContext, model);
+
+    Results->RegisterSemanticsPassed = I219vTestModelRegisters(deviceContext);
+
+    I219vTestModelSetupRings(deviceContext, memory);
+    Results->RingSemanticsPassed =
+        I219vTestModelTx(deviceContext, memory, &Results->TxTicks) &&
+        I219vTestModelRx(deviceContext, memory, &Results->RxTicks);
+
+    I219vDetachDeviceModel(deviceContext);
+    I219vDestroyDeviceModel(model);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE,
+              "Device model benchmark (%u x %u bytes): tx=%llu, rx=%llu ticks",
+              Results->Iterations, Results->FrameSize, Results->TxTicks, Results->RxTicks);
+
+    if (!Results->RegisterSemanticsPassed || !Results->RingSemanticsPassed) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "Device model test failed: registers %d, rings %d",
+                  Results->RegisterSemanticsPassed, Results->RingSemanticsPassed);
+        status = STATUS_UNSUCCESSFUL;
+    }
+
+Exit:
+    if (memory != NULL) {
+        ExFreePoolWithTag(memory, I219V_MODEL_POOL_TAG);
+    }
+    if (deviceContext != NULL) {
+        ExFreePoolWithTag(deviceContext, I219V_MODEL_POOL_TAG);
+    }
+
+    return status;
+}
+
+#define I219V_MODEL_TEST_PHY_REQUESTS       3
+#define I219V_MODEL_TEST_SERVICE_LIMIT      1000
+
+// Дескриптор безопасности тестового устройства: доступ только из ядра
+static const UNICODE_STRING I219vTestModelDeviceSddl = RTL_CONSTANT_STRING(L"D:P");
+
+// Создание управляющего устройства для тестов на модели
+// Таймеры механизма PHY и последовательности сброса находят контекст через
+// родительское устройство, поэтому контекст размещается в отдельном
+// управляющем устройстве, а не в пуле; работающее устройство не затрагивается.
+static
+NTSTATUS
+I219vTestCreateModelDevice(
+    _In_ PI219V_DEVICE_MODEL Model,
+    _Out_ WDFDEVICE* Device
+    )
+{
+    PWDFDEVICE_INIT deviceInit;
+    WDF_OBJECT_ATTRIBUTES attributes;
+    PI219V_DEVICE_CONTEXT deviceContext;
+    WDFDEVICE device;
+    NTSTATUS status;
+
+    *Device = NULL;
+
+    deviceInit = WdfControlDeviceInitAllocate(WdfGetDriver(), &I219vTestModelDeviceSddl);
+    if (deviceInit == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, I219V_DEVICE_CONTEXT);
+
+    status = WdfDeviceCreate(&deviceInit, &attributes, &device);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE, "WdfDeviceCreate failed for model test device: %!STATUS!", status);
+        WdfDeviceInitFree(deviceInit);
+        return status;
+    }
+
+    deviceContext = I219vGetDeviceContext(device);
+    RtlZeroMemory(deviceContext, sizeof(I219V_DEVICE_CONTEXT));
+    deviceContext->Device = device;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = device;
+
+    status = WdfSpinLockCreate(&attributes, &deviceContext->GamingSettingsLock);
+    if (NT_SUCCESS(status)) {
+        status = I219vInitializeRegisterShadow(deviceContext);
+    }
+    if (NT_SUCCESS(status)) {
+        status = I219vInitializePhyEngine(deviceContext);
+    }
+    if (NT_SUCCESS(status)) {
+        status = I219vInitializeResetSequencer(deviceContext);
+    }
+    if (NT_SUCCESS(status)) {
+        status = I219vInitializeModeration(deviceContext);
+    }
+    if (!NT_SUCCESS(status)) {
+        WdfObjectDelete(device);
+        return status;
+    }
+
+    I219vInitializeRtt(deviceContext);
+
+    I219vAttachDeviceModel(deviceContext, Model);
+    I219vStartPhyEngine(deviceContext);
+
+    WdfControlFinishInitializing(device);
+
+    *Device = device;
+
+    return STATUS_SUCCESS;
+}
+
+// Удаление тестового устройства: таймеры останавливаются до удаления
+static
+VOID
+I219vTestDeleteModelDevice(
+    _In_ WDFDEVICE Device
+    )
+{
+    PI219V_DEVICE_CONTEXT deviceContext = I219vGetDeviceContext(Device);
+
+    I219vStopModeration(deviceContext);
+    I219vStopPhyEngine(deviceContext);
+    WdfTimerStop(deviceContext->ResetSequencer.PollTimer, TRUE);
+    I219vDetachDeviceModel(deviceContext);
+
+    WdfObjectDelete(Device);
+}
+
+// Завершение запроса PHY: подсчет завершений
+static
+VOID
+I219vTestModelPhyCompletion(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ PI219V_PHY_REQUEST Request
+    )
+{
+    UNREFERENCED_PARAMETER(DeviceContext);
+
+    InterlockedIncrement((volatile LONG*)Request->Context);
+}
+
+// Ожидание завершений: MDAC обслуживается так же, как из DPC прерывания
+static
+BOOLEAN
+I219vTestModelWaitPhy(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _In_ volatile LONG* Completed,
+    _In_ LONG Expected
+    )
+{
+    UINT32 i;
+
+    for (i = 0; i < I219V_MODEL_TEST_SERVICE_LIMIT && *Completed < Expected; i++) {
+        I219vServicePhyEngine(DeviceContext);
+    }
+
+    return *Completed == Expected;
+}
+
+// Механизм асинхронного доступа к PHY: порядок очереди, результаты,
+// отмена при остановке и ожидание READY перед следующей операцией
+static
+BOOLEAN
+I219vTestModelPhyEngine(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_PHY_ENGINE engine = &DeviceContext->PhyEngine;
+    I219V_PHY_REQUEST requests[I219V_MODEL_TEST_PHY_REQUESTS];
+    volatile LONG completed = 0;
+    UINT64 completedBefore;
+    USHORT data;
+    UINT32 i;
+
+    // Запись, чтение записанного значения и идентификатора в порядке постановки
+    I219vInitializePhyRequest(&requests[0], I219V_MODEL_TEST_PHY_REGISTER, TRUE, I219V_MODEL_TEST_PHY_VALUE,
+                              I219vTestModelPhyCompletion, (PVOID)&completed);
+    I219vInitializePhyRequest(&requests[1], I219V_MODEL_TEST_PHY_REGISTER, FALSE, 0,
+                              I219vTestModelPhyCompletion, (PVOID)&completed);
+    I219vInitializePhyRequest(&requests[2], 2, FALSE, 0,
+                              I219vTestModelPhyCompletion, (PVOID)&completed);
+
+    if (I219vSubmitPhyRequests(DeviceContext, requests, I219V_MODEL_TEST_PHY_REQUESTS) != STATUS_PENDING ||
+        !I219vTestModelWaitPhy(DeviceContext, &completed, I219V_MODEL_TEST_PHY_REQUESTS)) {
+        return FALSE;
+    }
+
+    for (i = 0; i < I219V_MODEL_TEST_PHY_REQUESTS; i++) {
+        if (requests[i].Status != STATUS_SUCCESS) {
+            return FALSE;
+        }
+    }
+
+    if (requests[1].Data != I219V_MODEL_TEST_PHY_VALUE ||
+        requests[2].Data != I219V_MODEL_PHY_ID1 ||
+        engine->Stats.Submitted != I219V_MODEL_TEST_PHY_REQUESTS ||
+        engine->Stats.Completed != I219V_MODEL_TEST_PHY_REQUESTS ||
+        engine->Stats.MaxQueueDepth != I219V_MODEL_TEST_PHY_REQUESTS) {
+        return FALSE;
+    }
+
+    // Остановка: выполняемый и ожидающий запросы отменяются, если таймер
+    // не завершил их раньше; каждый запрос завершается ровно один раз
+    completed = 0;
+    completedBefore = engine->Stats.Completed;
+    I219vInitializePhyRequest(&requests[0], I219V_MODEL_TEST_PHY_REGISTER, FALSE, 0,
+                              I219vTestModelPhyCompletion, (PVOID)&completed);
+    I219vInitializePhyRequest(&requests[1], 2, FALSE, 0,
+                              I219vTestModelPhyCompletion, (PVOID)&completed);
+
+    if (I219vSubmitPhyRequests(DeviceContext, requests, 2) != STATUS_PENDING) {
+        return FALSE;
+    }
+
+    I219vStopPhyEngine(DeviceContext);
+
+    if (completed != 2 ||
+        (requests[0].Status != STATUS_SUCCESS && requests[0].Status != STATUS_CANCELLED) ||
+        (requests[1].Status != STATUS_SUCCESS && requests[1].Status != STATUS_CANCELLED) ||
+        engine->Stats.Cancelled + (engine->Stats.Completed - completedBefore) != 2) {
+        return FALSE;
+    }
+
+    // Остановленный механизм не принимает запросы
+    if (I219vSubmitPhyRequest(DeviceContext, &requests[0]) != STATUS_DEVICE_NOT_READY) {
+        return FALSE;
+    }
+
+    // После запуска синхронное чтение дожидается READY отмененной операции
+    I219vStartPhyEngine(DeviceContext);
+
+    if (!NT_SUCCESS(I219vReadPhyEx(DeviceContext, I219V_MODEL_TEST_PHY_REGISTER, &data)) ||
+        data != I219V_MODEL_TEST_PHY_VALUE ||
+        engine->Draining ||
+        engine->Stats.StuckOperations != 0) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// Кэш регистров соединения: заполнение при промахе, попадание без MDIC,
+// новое состояние после сброса кэша (как в обработчике LSC)
+static
+BOOLEAN
+I219vTestModelLinkCache(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_DEVICE_MODEL model = DeviceContext->DeviceModel;
+    PI219V_PHY_LINK_CACHE cache = &DeviceContext->PhyLinkCache;
+    I219V_PHY_LINK_CACHE_STATS before;
+    NET_ADAPTER_LINK_STATE linkState;
+    USHORT phyStatus, copperStatus;
+    USHORT cachedStatus, cachedCopper;
+    UINT64 phyOperations;
+
+    I219vInvalidatePhyLinkCache(DeviceContext);
+    before = cache->Stats;
+
+    // Промах: оба регистра читаются через MDIC, кэш становится действительным
+    phyOperations = model->Stats.PhyOperations;
+    if (!NT_SUCCESS(I219vGetPhyLinkRegisters(DeviceContext, &phyStatus, &copperStatus)) ||
+        phyStatus != model->PhyRegisters[I219V_PHY_STATUS] ||
+        copperStatus != model->PhyRegisters[I219V_PHY_COPPER_STAT] ||
+        model->Stats.PhyOperations - phyOperations != 2 ||
+        cache->Stats.Misses - before.Misses != 1 ||
+        !cache->Valid) {
+        return FALSE;
+    }
+
+    // Потеря соединения без сброса кэша: значения из памяти, без MDIC
+    I219vModelSetLink(model, FALSE);
+    phyOperations = model->Stats.PhyOperations;
+    if (!NT_SUCCESS(I219vGetPhyLinkRegisters(DeviceContext, &cachedStatus, &cachedCopper)) ||
+        cachedStatus != phyStatus ||
+        cachedCopper != copperStatus ||
+        model->Stats.PhyOperations != phyOperations ||
+        cache->Stats.Hits - before.Hits != 1) {
+        return FALSE;
+    }
+
+    // После сброса кэша состояние читается заново
+    I219vInvalidatePhyLinkCache(DeviceContext);
+    if (!NT_SUCCESS(I219vGetLinkState(DeviceContext, &linkState)) ||
+        linkState.MediaConnectState != MediaConnectStateDisconnected ||
+        cache->PhyStatus != model->PhyRegisters[I219V_PHY_STATUS] ||
+        cache->Stats.Invalidations - before.Invalidations != 1 ||
+        cache->Stats.Misses - before.Misses != 2 ||
+        cache->Stats.FillFailures != before.FillFailures ||
+        cache->Stats.DiscardedFills != before.DiscardedFills) {
+        return FALSE;
+    }
+
+    // Восстановление соединения для следующих тестов
+    I219vModelSetLink(model, TRUE);
+    I219vInvalidatePhyLinkCache(DeviceContext);
+
+    return !cache->Valid;
+}
+
+// Последовательность сброса: фазы, их длительности и сброс LAN_INIT_DONE
+// Модель выполняет сброс мгновенно, поэтому каждая фаза завершается на
+// первом срабатывании таймера; полный сброс занимает не меньше четырех
+// срабатываний (MAC, LAN_INIT, команда чтения BMCR, результат чтения).
+static
+BOOLEAN
+I219vTestModelReset(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext,
+    _Out_ PI219V_RESET_TIMING Timing
+    )
+{
+    PI219V_RESET_SEQUENCER sequencer = &DeviceContext->ResetSequencer;
+    PI219V_RESET_TIMING last = &sequencer->Stats.Last;
+
+    RtlZeroMemory(Timing, sizeof(I219V_RESET_TIMING));
+
+    // Сброс MAC и PHY с ожиданием выхода MAC, затем всей последовательности
+    if (!NT_SUCCESS(I219vStartReset(DeviceContext, I219V_RESET_FLAG_MAC | I219V_RESET_FLAG_PHY)) ||
+        !NT_SUCCESS(I219vWaitReset(DeviceContext, TRUE)) ||
+        !NT_SUCCESS(I219vWaitReset(DeviceContext, FALSE))) {
+        return FALSE;
+    }
+
+    *Timing = *last;
+
+    if (sequencer->Phase != I219V_RESET_PHASE_DONE ||
+        last->Status != STATUS_SUCCESS ||
+        last->Flags != (I219V_RESET_FLAG_MAC | I219V_RESET_FLAG_PHY) ||
+        last->Polls < 4 ||
+        last->MacUs + last->LanInitUs + last->PhyUs > last->TotalUs) {
+        return FALSE;
+    }
+
+    // Бит загрузки конфигурации сброшен: следующий сброс ждет новой загрузки
+    if (I219vReadRegister(DeviceContext, I219V_REG_STATUS) & I219V_STATUS_LAN_INIT_DONE) {
+        return FALSE;
+    }
+
+    // Сброс только PHY (BMCR.RESET): фазы MAC и LAN_INIT пропускаются
+    if (!NT_SUCCESS(I219vStartReset(DeviceContext, I219V_RESET_FLAG_PHY)) ||
+        !NT_SUCCESS(I219vWaitReset(DeviceContext, FALSE))) {
+        return FALSE;
+    }
+
+    return sequencer->Phase == I219V_RESET_PHASE_DONE &&
+           last->Status == STATUS_SUCCESS &&
+           last->Flags == I219V_RESET_FLAG_PHY &&
+           last->MacUs == 0 &&
+           last->LanInitUs == 0 &&
+           sequencer->Stats.Resets == 2 &&
+           sequencer->Stats.Failures == 0;
+}
+
+// Применение профиля до отображения регистров (как из EvtDeviceAdd)
+// Профиль только сохраняется, не обращаясь к устройству; регистры
+// записываются последовательностью входа в D0 (I219vEvtDeviceD0Entry).
+static
+BOOLEAN
+I219vTestModelProfileBeforeMap(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_DEVICE_MODEL model = DeviceContext->DeviceModel;
+    I219V_GAMING_PROFILE profile;
+    UINT64 reads;
+    UINT64 writes;
+
+    DeviceContext->DeviceInitialized = FALSE;
+    I219vGetCompetitiveGamingProfile(&profile);
+
+    reads = model->Stats.RegisterReads;
+    writes = model->Stats.RegisterWrites;
+
+    if (!NT_SUCCESS(I219vApplyGamingProfile(DeviceContext, &profile)) ||
+        model->Stats.RegisterReads != reads ||
+        model->Stats.RegisterWrites != writes ||
+        DeviceContext->GamingProfile.ProfileType != I219V_GAMING_PROFILE_COMPETITIVE ||
+        DeviceContext->Moderation.Stats.DelayTimers.RxDelayUs != profile.DelayTimers.RxDelayUs ||
+        DeviceContext->Moderation.Stats.SmallPacketThreshold != profile.SmallPacketThreshold) {
+        return FALSE;
+    }
+
+    // Вход в D0: сброс и инициализация, затем восстановление профиля
+    if (!NT_SUCCESS(I219vInitializeHardware(DeviceContext))) {
+        return FALSE;
+    }
+    DeviceContext->DeviceInitialized = TRUE;
+
+    if (!NT_SUCCESS(I219vRestoreGamingRegisters(DeviceContext))) {
+        return FALSE;
+    }
+
+    // Соревновательный профиль: QoS и минимальный порог дескрипторов, без EEE;
+    // ITR, таймеры задержки приема и RSRPD восстановлены после сброса
+    return (I219vReadRegister(DeviceContext, I219V_REG_TXCW) & I219V_TXCW_QOS_ENABLE) != 0 &&
+           I219vReadRegister(DeviceContext, I219V_REG_ITR) == DeviceContext->Moderation.Stats.CurrentItr &&
+           (I219vReadRegister(DeviceContext, I219V_REG_CTRL) & I219V_CTRL_ITR_ENABLE) != 0 &&
+           I219vReadRegister(DeviceContext, I219V_REG_RDTR) != 0 &&
+           I219vReadRegister(DeviceContext, I219V_REG_RADV) >= I219vReadRegister(DeviceContext, I219V_REG_RDTR) &&
+           I219vReadRegister(DeviceContext, I219V_REG_TIDV) == 0 &&
+           I219vReadRegister(DeviceContext, I219V_REG_RSRPD) == I219V_GAMING_COMPETITIVE_SMALL_PACKET_SIZE &&
+           (I219vReadRegister(DeviceContext, I219V_REG_RXDCTL) & I219V_RXDCTL_PTHRESH_MASK) == (1 << I219V_RXDCTL_PTHRESH_SHIFT) &&
+           (I219vReadRegister(DeviceContext, I219V_REG_CTRL) & I219V_CTRL_EEE_ENABLE) == 0;
+}
+
+#define I219V_MODEL_TEST_NET_RING_SIZE      8
+#define I219V_MODEL_TEST_TX_FRAGMENTS       4
+
+// Память теста продвижения колец передачи: кольцо устройства того же
+// размера, что и в пути данных, адреса фрагментов и кадр
+typedef struct _I219V_MODEL_TEST_TX_MEMORY {
+    I219V_TX_DESC TxRing[I219V_TX_RING_SIZE];
+    NET_FRAGMENT_VIRTUAL_ADDRESS VirtualAddresses[I219V_MODEL_TEST_NET_RING_SIZE];
+    NET_FRAGMENT_LOGICAL_ADDRESS LogicalAddresses[I219V_MODEL_TEST_NET_RING_SIZE];
+    UCHAR Frame[I219V_MODEL_TEST_FRAME_SIZE];
+} I219V_MODEL_TEST_TX_MEMORY, *PI219V_MODEL_TEST_TX_MEMORY;
+
+// Выделение кольца NetAdapterCx с EndCount элементами, переданными драйверу
+// Поля заголовка кольца обычно заполняет NetAdapterCx и для драйвера
+// они только для чтения.
+static
+NET_RING*
+I219vTestAllocateNetRing(
+    _In_ UINT16 ElementStride,
+    _In_ UINT32 EndCount
+    )
+{
+    NET_RING* ring;
+
+    ring = (NET_RING*)ExAllocatePool2(POOL_FLAG_NON_PAGED,
+                                      FIELD_OFFSET(NET_RING, Buffer) + (SIZE_T)ElementStride * I219V_MODEL_TEST_NET_RING_SIZE,
+                                      I219V_MODEL_POOL_TAG);
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    *(UINT16*)&ring->ElementStride = ElementStride;
+    *(UINT32*)&ring->NumberOfElements = I219V_MODEL_TEST_NET_RING_SIZE;
+    *(UINT32*)&ring->ElementIndexMask = I219V_MODEL_TEST_NET_RING_SIZE - 1;
+    *(UINT32*)&ring->EndIndex = EndCount;
+
+    return ring;
+}
+
+// Расширение фрагментов поверх массива теста
+// (раскладка NetExtensionGetData: Reserved[0] - первый элемент, Reserved[1] - шаг)
+static
+VOID
+I219vTestSetNetExtension(
+    _Out_ NET_EXTENSION* Extension,
+    _In_ PVOID Base,
+    _In_ SIZE_T Stride
+    )
+{
+    RtlZeroMemory(Extension, sizeof(NET_EXTENSION));
+    Extension->Reserved[0] = Base;
+    Extension->Reserved[1] = (PVOID)Stride;
+}
+
+// Продвижение и возврат колец передачи Queue.c на модели
+// Пакеты: игнорируемый (1 фрагмент), отправляемый (2 фрагмента) и снова
+// игнорируемый (1 фрагмент). Модель завершает дескрипторы при записи TDT,
+// поэтому тот же вызов возвращает все пакеты: начало и продвижение обоих
+// колец должны дойти до конца, включая фрагменты игнорируемых пакетов.
+static
+BOOLEAN
+I219vTestModelTxAdvance(
+    _In_ PI219V_DEVICE_CONTEXT DeviceContext
+    )
+{
+    PI219V_MODEL_TEST_TX_MEMORY memory;
+    NET_RING* packetRing;
+    NET_RING* fragmentRing;
+    NET_PACKET* packet;
+    UINT64 txBase;
+    UINT64 packetsSent;
+    BOOLEAN passed = FALSE;
+    UINT32 i;
+
+    memory = (PI219V_MODEL_TEST_TX_MEMORY)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(I219V_MODEL_TEST_TX_MEMORY), I219V_MODEL_POOL_TAG);
+    packetRing = I219vTestAllocateNetRing((UINT16)sizeof(NET_PACKET), 3);
+    fragmentRing = I219vTestAllocateNetRing((UINT16)sizeof(NET_FRAGMENT), I219V_MODEL_TEST_TX_FRAGMENTS);
+    if (memory == NULL || packetRing == NULL || fragmentRing == NULL) {
+        goto Exit;
+    }
+
+    for (i = 0; i < I219V_MODEL_TEST_TX_FRAGMENTS; i++) {
+        NET_FRAGMENT* fragment = NetRingGetFragmentAtIndex(fragmentRing, i);
+
+        fragment->ValidLength = I219V_MODEL_TEST_FRAME_SIZE;
+        fragment->Capacity = I219V_MODEL_TEST_FRAME_SIZE;
+        fragment->Offset = 0;
+        memory->VirtualAddresses[i].VirtualAddress = memory->Frame;
+        memory->LogicalAddresses[i].LogicalAddress = (UINT64)(ULONG_PTR)memory->Frame;
+    }
+
+    packet = NetRingGetPacketAtIndex(packetRing, 0);
+    packet->FragmentIndex = 0;
+    packet->FragmentCount = 1;
+    packet->Ignore = 1;
+
+    packet = NetRingGetPacketAtIndex(packetRing, 1);
+    packet->FragmentIndex = 1;
+    packet->FragmentCount = 2;
+
+    packet = NetRingGetPacketAtIndex(packetRing, 2);
+    packet->FragmentIndex = 3;
+    packet->FragmentCount = 1;
+    packet->Ignore = 1;
+
+    I219vTestSetNetExtension(&DeviceContext->TxVirtualAddressExtension,
+                             memory->VirtualAddresses, sizeof(NET_FRAGMENT_VIRTUAL_ADDRESS));
+    I219vTestSetNetExtension(&DeviceContext->TxLogicalAddressExtension,
+                             memory->LogicalAddresses, sizeof(NET_FRAGMENT_LOGICAL_ADDRESS));
+
+    // Кольцо устройства и очередь передачи, как после I219vInitializeQueues
+    txBase = (UINT64)(ULONG_PTR)memory->TxRing;
+    I219vWriteRegister(DeviceContext, I219V_REG_TDBAL, (UINT32)txBase);
+    I219vWriteRegister(DeviceContext, I219V_REG_TDBAH, (UINT32)(txBase >> 32));
+    I219vWriteRegister(DeviceContext, I219V_REG_TDLEN, sizeof(memory->TxRing));
+    I219vWriteRegister(DeviceContext, I219V_REG_TDH, 0);
+    I219vWriteRegister(DeviceContext, I219V_REG_TDT, 0);
+    I219vWriteRegister(DeviceContext, I219V_REG_TCTL, I219V_TCTL_EN | I219V_TCTL_PSP);
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    DeviceContext->TxRing = memory->TxRing;
+    DeviceContext->TxNextToUse = 0;
+    DeviceContext->TxNextToClean = 0;
+    DeviceContext->TrafficPrioritizationEnabled = FALSE;
+    packetsSent = DeviceContext->GamingPerformanceStats.TotalPacketsSent;
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+    I219vTxAdvanceRings(DeviceContext, packetRing, fragmentRing);
+
+    passed = packetRing->BeginIndex == 3 &&
+             packetRing->NextIndex == 3 &&
+             fragmentRing->BeginIndex == I219V_MODEL_TEST_TX_FRAGMENTS &&
+             fragmentRing->NextIndex == I219V_MODEL_TEST_TX_FRAGMENTS &&
+             DeviceContext->TxNextToUse == 2 &&
+             DeviceContext->TxNextToClean == 2 &&
+             DeviceContext->GamingPerformanceStats.TotalPacketsSent == packetsSent + 1 &&
+             I219vReadRegister(DeviceContext, I219V_REG_TDT) == 2 &&
+             I219vReadRegister(DeviceContext, I219V_REG_TDH) == 2 &&
+             memory->TxRing[0].BufferAddr == (UINT64)(ULONG_PTR)memory->Frame &&
+             (memory->TxRing[0].CMD & I219V_TXD_CMD_EOP) == 0 &&
+             (memory->TxRing[1].CMD & I219V_TXD_CMD_EOP) != 0;
+
+    // Модель больше не должна обращаться к памяти теста
+    I219vWriteRegister(DeviceContext, I219V_REG_TCTL, 0);
+    I219vWriteRegister(DeviceContext, I219V_REG_TDLEN, 0);
+
+    WdfSpinLockAcquire(DeviceContext->GamingSettingsLock);
+    DeviceContext->TxRing = NULL;
+    WdfSpinLockRelease(DeviceContext->GamingSettingsLock);
+
+Exit:
+    if (fragmentRing != NULL) {
+        ExFreePoolWithTag(fragmentRing, I219V_MODEL_POOL_TAG);
+    }
+    if (packetRing != NULL) {
+        ExFreePoolWithTag(packetRing, I219V_MODEL_POOL_TAG);
+    }
+    if (memory != NULL) {
+        ExFreePoolWithTag(memory, I219V_MODEL_POOL_TAG);
+    }
+
+    return passed;
+}
+
+// Тест управляющего пути на поведенческой модели устройства
+// Выполняется на отдельном управляющем устройстве с собственным контекстом.
+NTSTATUS
+I219vTestDeviceModelControl(
+    _Out_ PI219V_MODEL_CONTROL_TEST_RESULTS Results
+    )
+{
+    PI219V_DEVICE_CONTEXT deviceContext;
+    PI219V_DEVICE_MODEL model;
+    I219V_RESET_TIMING resetTiming;
+    WDFDEVICE device;
+    NTSTATUS status;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "Testing control path on device model");
+
+    RtlZeroMemory(Results, sizeof(I219V_MODEL_CONTROL_TEST_RESULTS));
+
+    status = I219vCreateDeviceModel(I219vTestModelTranslate, NULL, &model);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    status = I219vTestCreateModelDevice(model, &device);
+    if (!NT_SUCCESS(status)) {
+        I219vDestroyDeviceModel(model);
+        return status;
+    }
+
+    deviceContext = I219vGetDeviceContext(device);
+
+    Results->PhyEnginePassed = I219vTestModelPhyEngine(deviceContext);
+    Results->LinkCachePassed = I219vTestModelLinkCache(deviceContext);
+    Results->ResetPassed = I219vTestModelReset(deviceContext, &resetTiming);
+    Results->ResetTotalUs = resetTiming.TotalUs;
+    Results->ResetPolls = resetTiming.Polls;
+    Results->PhyOperations = (UINT32)deviceContext->PhyEngine.Stats.Completed;
+    Results->ProfileBeforeMapPassed = I219vTestModelProfileBeforeMap(deviceContext);
+    Results->TxAdvancePassed = I219vTestModelTxAdvance(deviceContext);
+
+    I219vTestDeleteModelDevice(device);
+    I219vDestroyDeviceModel(model);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE,
+              "Device model reset: MAC %u us, LAN init %u us, PHY %u us, total %u us, %u polls",
+              resetTiming.MacUs, resetTiming.LanInitUs, resetTiming.PhyUs, resetTiming.TotalUs, resetTiming.Polls);
+
+    if (!Results->PhyEnginePassed || !Results->LinkCachePassed || !Results->ResetPassed ||
+        !Results->ProfileBeforeMapPassed || !Results->TxAdvancePassed) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_HARDWARE,
+                  "Device model control test failed: PHY engine %d, link cache %d, reset %d, profile before map %d, TX advance %d",
+                  Results->PhyEnginePassed, Results->LinkCachePassed, Results->ResetPassed,
+                  Results->ProfileBeforeMapPassed, Results->TxAdvancePassed);
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+#else
+
+// Модель устройства не скомпилирована (I219V_DEVICE_MODEL=0)
+NTSTATUS
+I219vBenchmarkDeviceModel(
+    _Out_ PI219V_MODEL_BENCHMARK_RESULTS Results
+    )
+{
+    RtlZeroMemory(Results, sizeof(I219V_MODEL_BENCHMARK_RESULTS));
+
+    return STATUS_NOT_SUPPORTED;
+}
+
+NTSTATUS
+I219vTestDeviceModelControl(
+    _Out_ PI219V_MODEL_CONTROL_TEST_RESULTS Results
+    )
+{
+    RtlZeroMemory(Results, sizeof(I219V_MODEL_CONTROL_TEST_RESULTS));
+
+    return STATUS_NOT_SUPPORTED;
+}
+
+#endif // I219V_DEVICE_MODEL
+
 // Выполнение всех тестов
 NTSTATUS
 I219vRunAllTests(
@@ -473,6 +1435,30 @@ I219vRunAllTests(
     status = I219vTestOffloads(DeviceContext);
     TestResults->OffloadsTestPassed = NT_SUCCESS(status);
 
+    // Тест пакетной классификации
+    {
+        I219V_CLASSIFY_BENCHMARK_RESULTS benchmarkResults;
+
+        status = I219vBenchmarkClassification(&benchmarkResults);
+        TestResults->ClassificationTestPassed = NT_SUCCESS(status);
+    }
+
+    // Тест пути данных на модели устройства (пропускается, если модель не скомпилирована)
+    {
+        I219V_MODEL_BENCHMARK_RESULTS modelResults;
+
+        status = I219vBenchmarkDeviceModel(&modelResults);
+        TestResults->DeviceModelTestPassed = NT_SUCCESS(status) || status == STATUS_NOT_SUPPORTED;
+    }
+
+    // Тест управляющего пути на модели устройства (пропускается, если модель не скомпилирована)
+    {
+        I219V_MODEL_CONTROL_TEST_RESULTS controlResults;
+
+        status = I219vTestDeviceModelControl(&controlResults);
+        TestResults->DeviceModelControlTestPassed = NT_SUCCESS(status) || status == STATUS_NOT_SUPPORTED;
+    }
+
     // Самодиагностика
     status = I219vRunSelfTest(DeviceContext, &TestResults->SelfTestResults);
     TestResults->SelfTestPassed = NT_SUCCESS(status);
@@ -484,6 +1470,9 @@ I219vRunAllTests(
         TestResults->LinkStatusTestPassed &&
         TestResults->StatisticsTestPassed &&
         TestResults->OffloadsTestPassed &&
+        TestResults->ClassificationTestPassed &&
+        TestResults->DeviceModelTestPassed &&
+        TestResults->DeviceModelControlTestPassed &&
         TestResults->SelfTestPassed) {
         TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HARDWARE, "All tests passed");
         status = STATUS_SUCCESS;
@@ -44,10 +44,45 @@ typedef struct _I219V_TEST_RESULTS {
     BOOLEAN LinkStatusTestPassed;     // Результат теста состояния соединения
     BOOLEAN StatisticsTestPassed;     // Результат теста статистики
     BOOLEAN OffloadsTestPassed;       // Результат теста оффлоадов
+    BOOLEAN ClassificationTestPassed; // Результат теста пакетной классификации
+    BOOLEAN DeviceModelTestPassed;    // Результат теста пути данных на модели устройства
+    BOOLEAN DeviceModelControlTestPassed; // Результат тестов управляющего пути на модели устройства
     BOOLEAN SelfTestPassed;           // Результат самодиагностики
     I219V_SELF_TEST_RESULTS SelfTestResults;  // Детальные результаты самодиагностики
 } I219V_TEST_RESULTS, *PI219V_TEST_RESULTS;
 
+// Результаты микробенчмарка классификации трафика
+typedef struct _I219V_CLASSIFY_BENCHMARK_RESULTS {
+    UINT32 PacketsPerBatch;       // Пакетов в пачке
+    UINT32 Iterations;            // Количество повторов
+    UINT64 PerPacketTicks;        // Время поштучной классификации (такты KeQueryPerformanceCounter)
+    UINT64 ScalarBatchTicks;      // Время скалярной пакетной классификации
+    UINT64 VectorBatchTicks;      // Время векторной (SSE2) пакетной классификации
+    BOOLEAN ResultsMatch;         // Результаты всех вариантов совпадают
+} I219V_CLASSIFY_BENCHMARK_RESULTS, *PI219V_CLASSIFY_BENCHMARK_RESULTS;
+
+// Результаты теста пути данных на поведенческой модели устройства
+typedef struct _I219V_MODEL_BENCHMARK_RESULTS {
+    UINT32 Iterations;            // Количество кадров в каждом направлении
+    UINT32 FrameSize;             // Размер кадра (байт)
+    UINT64 TxTicks;               // Время передачи: дескриптор, TDT, ICR (такты KeQueryPerformanceCounter)
+    UINT64 RxTicks;               // Время приема: кадр, ICR, проверка и возврат дескриптора
+    BOOLEAN RegisterSemanticsPassed; // Семантика ICR/ICS/IMS/IMC, CTRL.RST и MDIC
+    BOOLEAN RingSemanticsPassed;  // Головы, хвосты и запись дескрипторов колец
+} I219V_MODEL_BENCHMARK_RESULTS, *PI219V_MODEL_BENCHMARK_RESULTS;
+
+// Результаты тестов управляющего пути на поведенческой модели устройства
+typedef struct _I219V_MODEL_CONTROL_TEST_RESULTS {
+    UINT32 PhyOperations;         // Операции MDIC, завершенные механизмом PHY
+    UINT32 ResetTotalUs;          // Длительность сброса MAC и PHY на модели (мкс)
+    UINT32 ResetPolls;            // Срабатывания таймера сброса MAC и PHY
+    BOOLEAN PhyEnginePassed;      // Очередь, результаты и отмена запросов механизма PHY
+    BOOLEAN LinkCachePassed;      // Заполнение, попадания и сброс кэша регистров соединения
+    BOOLEAN ResetPassed;          // Фазы сброса, их длительности и сброс LAN_INIT_DONE
+    BOOLEAN ProfileBeforeMapPassed; // Профиль до отображения регистров сохраняется и записывается в D0
+    BOOLEAN TxAdvancePassed;      // Индексы колец после продвижения и возврата передачи Queue.c
+} I219V_MODEL_CONTROL_TEST_RESULTS, *PI219V_MODEL_CONTROL_TEST_RESULTS;
+
 // Объявление функций для тестирования
 NTSTATUS I219vRunSelfTest(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_SELF_TEST_RESULTS TestResults);
 NTSTATUS I219vTestRegisters(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
@@ -56,4 +91,7 @@ NTSTATUS I219vTestMacAddress(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 NTSTATUS I219vTestLinkStatus(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 NTSTATUS I219vTestStatistics(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
 NTSTATUS I219vTestOffloads(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext);
+NTSTATUS I219vBenchmarkClassification(_Out_ PI219V_CLASSIFY_BENCHMARK_RESULTS Results);
+NTSTATUS I219vBenchmarkDeviceModel(_Out_ PI219V_MODEL_BENCHMARK_RESULTS Results);
+NTSTATUS I219vTestDeviceModelControl(_Out_ PI219V_MODEL_CONTROL_TEST_RESULTS Results);
 NTSTATUS I219vRunAllTests(_In_ struct _I219V_DEVICE_CONTEXT* DeviceContext, _Out_ PI219V_TEST_RESULTS TestResults);